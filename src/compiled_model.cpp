@@ -0,0 +1,406 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iomanip> // std::setprecision
+#include <algorithm>	// std::min, std::reverse
+#include <functional> // std::hash
+#include <memory> // std::shared_ptr
+#include <tuple> // std::tie
+#include <cstdlib> // std::getenv, std::system
+#include <cstdio> // std::remove, std::rename
+#include <dlfcn.h> // dlopen, dlsym, dlclose
+#include <sys/stat.h> // mkdir
+#include <unistd.h> // getpid
+#include "utils.hpp"
+#include "constants.hpp"
+#include "distributions.hpp"
+#include "hmm_base.hpp"
+#include "compiled_model.hpp"
+
+ModelCompilationException::ModelCompilationException(const std::string& message) :
+	std::runtime_error("ModelCompilationException: " + message) {}
+
+/* ===================== CODE GENERATION ===================== */
+
+/* Exact (round-trip) C++ literal of the given log probability. */
+static std::string __literal(double value) {
+	if(value == utils::kNegInf) return "kNegInf";
+	if(value == utils::kInf) return "kInf";
+	if(value != value) return "kNaN";
+	std::ostringstream oss;
+	oss << std::setprecision(17) << value;
+	return oss.str();
+}
+
+/* The generated kernels follow the linear memory algorithms step by step (same sums in the same order), the
+null transitions being skipped since adding them does not change a log sum. */
+std::string generate_model_source(const RawModel& model) {
+	std::size_t num_states = model.A.size();
+	std::size_t silent = model.silent_states_index;
+	if(num_states == 0) throw ModelCompilationException(error_message::kModelCompilationEmptyModel);
+	for(std::size_t i = 0; i < silent; ++i){
+		if(model.B[i] == nullptr || ! model.B[i]->is_discrete()) throw ModelCompilationException(error_message::kModelCompilationNotDiscrete);
+	}
+	std::size_t num_symbols = model.alphabet.size();
+	std::ostringstream out;
+	out << "/* Generated by compile_model. Do not edit. */" << std::endl
+		<< "#include <cstddef>" << std::endl << "#include <cmath>" << std::endl << "#include <limits>" << std::endl << std::endl
+		<< "namespace {" << std::endl << std::endl
+		<< "const double kInf = std::numeric_limits<double>::infinity();" << std::endl
+		<< "const double kNegInf = -std::numeric_limits<double>::infinity();" << std::endl
+		<< "const double kNaN = std::numeric_limits<double>::quiet_NaN();" << std::endl
+		<< "const std::size_t N = " << num_states << ";" << std::endl << std::endl
+		<< "/* Same as utils::sum_log_prob. */" << std::endl
+		<< "inline double sum_log_prob(double log_x, double log_y){" << std::endl
+		<< "\tif(log_x == kInf || log_y == kInf) return kInf;" << std::endl
+		<< "\tif(log_x == kNegInf) return log_y;" << std::endl
+		<< "\tif(log_y == kNegInf) return log_x;" << std::endl
+		<< "\treturn (log_x > log_y) ? log_x + std::log(1 + std::exp(log_y - log_x)) : log_y + std::log(1 + std::exp(log_x - log_y));" << std::endl
+		<< "}" << std::endl << std::endl;
+
+	/* Emissions. */
+	out << "/* Emission log probabilities, the last column being the symbols out of the alphabet. */" << std::endl
+		<< "const double B[N][" << num_symbols + 1 << "] = {" << std::endl;
+	for(std::size_t i = 0; i < num_states; ++i){
+		DiscreteDistribution* distribution = (i < silent) ? static_cast<DiscreteDistribution*>(model.B[i]) : nullptr;
+		out << "\t{";
+		for(std::size_t k = 0; k <= num_symbols; ++k){
+			double emission = (distribution != nullptr && k < num_symbols && distribution->contains(model.alphabet[k])) ?
+				(*distribution)[model.alphabet[k]] : utils::kNegInf;
+			out << __literal(emission) << ((k < num_symbols) ? ", " : "");
+		}
+		out << "}" << ((i + 1 < num_states) ? "," : "") << std::endl;
+	}
+	out << "};" << std::endl << std::endl;
+
+	/* Forward, see LinearMemoryForwardAlgorithm::forward_init. */
+	out << "void forward_init(std::size_t s, double* a){" << std::endl << "\tdouble a0[N];" << std::endl;
+	for(std::size_t i = silent; i < num_states; ++i){
+		out << "\ta0[" << i << "] = " << __literal(model.pi_begin[i]) << ";" << std::endl;
+		for(std::size_t j = silent; j < i; ++j){
+			if(model.A[j][i] == utils::kNegInf) continue;
+			out << "\ta0[" << i << "] = sum_log_prob(a0[" << i << "], " << __literal(model.A[j][i]) << " + a0[" << j << "]);" << std::endl;
+		}
+	}
+	for(std::size_t i = 0; i < silent; ++i){
+		out << "\ta0[" << i << "] = " << __literal(model.pi_begin[i]) << ";" << std::endl;
+		for(std::size_t j = silent; j < num_states; ++j){
+			if(model.A[j][i] == utils::kNegInf) continue;
+			out << "\ta0[" << i << "] = sum_log_prob(a0[" << i << "], " << __literal(model.A[j][i]) << " + a0[" << j << "]);" << std::endl;
+		}
+	}
+	for(std::size_t i = 0; i < silent; ++i){
+		out << "\ta[" << i << "] = a0[" << i << "] + B[" << i << "][s];" << std::endl;
+	}
+	for(std::size_t i = silent; i < num_states; ++i){
+		out << "\ta[" << i << "] = kNegInf;" << std::endl;
+		for(std::size_t j = 0; j < i; ++j){
+			if(model.A[j][i] == utils::kNegInf) continue;
+			out << "\ta[" << i << "] = sum_log_prob(a[" << i << "], " << __literal(model.A[j][i]) << " + a[" << j << "]);" << std::endl;
+		}
+	}
+	out << "}" << std::endl << std::endl;
+
+	/* See LinearMemoryForwardAlgorithm::forward_step. */
+	out << "void forward_step(std::size_t s, const double* p, double* a){" << std::endl;
+	for(std::size_t i = 0; i < num_states; ++i){
+		out << "\ta[" << i << "] = kNegInf;" << std::endl;
+		for(std::size_t j = 0; j < ((i < silent) ? num_states : i); ++j){
+			if(model.A[j][i] == utils::kNegInf) continue;
+			out << "\ta[" << i << "] = sum_log_prob(a[" << i << "], " << ((i < silent) ? "p[" : "a[") << j << "] + " << __literal(model.A[j][i]) << ");" << std::endl;
+		}
+		if(i < silent){
+			out << "\ta[" << i << "] = a[" << i << "] + B[" << i << "][s];" << std::endl;
+		}
+	}
+	out << "}" << std::endl << std::endl;
+
+	/* Viterbi, see LinearMemoryViterbiDecodingAlgorithm::viterbi_init. psi holds the predecessor of each state,
+	N meaning none : the first column for the silent states before the first symbol, the second one for the first symbol. */
+	out << "void viterbi_init(std::size_t s, double* phi, std::size_t* psi){" << std::endl
+		<< "\tdouble phi0[N];" << std::endl << "\tdouble m;" << std::endl << "\tdouble c;" << std::endl << "\tstd::size_t k;" << std::endl
+		<< "\tfor(std::size_t i = 0; i < 2 * N; ++i) psi[i] = N;" << std::endl
+		<< "\tfor(std::size_t i = 0; i < N; ++i){ phi0[i] = kNegInf; phi[i] = kNegInf; }" << std::endl;
+	for(std::size_t i = silent; i < num_states; ++i){
+		out << "\tm = " << __literal(model.pi_begin[i]) << "; k = N;" << std::endl;
+		for(std::size_t j = silent; j < i; ++j){
+			if(model.A[j][i] == utils::kNegInf) continue;
+			out << "\tc = " << __literal(model.A[j][i]) << " + phi0[" << j << "]; if(c > m){ m = c; k = " << j << "; }" << std::endl;
+		}
+		out << "\tif(m != kNegInf) phi0[" << i << "] = m;" << std::endl << "\tpsi[" << i << "] = k;" << std::endl;
+	}
+	for(std::size_t i = 0; i < silent; ++i){
+		out << "\tm = " << __literal(model.pi_begin[i]) << "; k = N;" << std::endl;
+		for(std::size_t j = silent; j < num_states; ++j){
+			if(model.A[j][i] == utils::kNegInf) continue;
+			out << "\tc = " << __literal(model.A[j][i]) << " + phi0[" << j << "]; if(c > m){ m = c; k = " << j << "; }" << std::endl;
+		}
+		out << "\tif(m != kNegInf) phi[" << i << "] = m + B[" << i << "][s];" << std::endl << "\tpsi[N + " << i << "] = k;" << std::endl;
+	}
+	for(std::size_t i = silent; i < num_states; ++i){
+		out << "\tm = kNegInf; k = N;" << std::endl;
+		for(std::size_t j = 0; j < i; ++j){
+			if(model.A[j][i] == utils::kNegInf) continue;
+			out << "\tc = " << __literal(model.A[j][i]) << " + phi[" << j << "]; if(c > m){ m = c; k = " << j << "; }" << std::endl;
+		}
+		out << "\tif(m != kNegInf && k < N){ phi[" << i << "] = m; psi[N + " << i << "] = k; }" << std::endl;
+	}
+	out << "\t(void) c;" << std::endl << "}" << std::endl << std::endl;
+
+	/* See LinearMemoryViterbiDecodingAlgorithm::viterbi_step. */
+	out << "void viterbi_step(std::size_t s, const double* p, double* phi, std::size_t* psi){" << std::endl
+		<< "\tdouble m;" << std::endl << "\tdouble c;" << std::endl << "\tstd::size_t k;" << std::endl;
+	for(std::size_t i = 0; i < num_states; ++i){
+		out << "\tm = kNegInf; k = N;" << std::endl;
+		for(std::size_t j = 0; j < ((i < silent) ? num_states : i); ++j){
+			if(model.A[j][i] == utils::kNegInf) continue;
+			out << "\tc = " << ((i < silent) ? "p[" : "phi[") << j << "] + " << __literal(model.A[j][i]) << "; if(c > m){ m = c; k = " << j << "; }" << std::endl;
+		}
+		out << "\tif(m != kNegInf && k != N){ phi[" << i << "] = m" << ((i < silent) ? " + B[" + std::to_string(i) + "][s]" : "")
+			<< "; psi[" << i << "] = k; }" << std::endl
+			<< "\telse{ phi[" << i << "] = kNegInf; psi[" << i << "] = N; }" << std::endl;
+	}
+	out << "\t(void) c;" << std::endl << "}" << std::endl << std::endl;
+	out << "} // namespace" << std::endl << std::endl;
+
+	/* Entry points. */
+	out << "extern \"C\" void hmm_forward(const std::size_t* symbols, std::size_t length, double* alpha){" << std::endl
+		<< "\tdouble previous[N];" << std::endl
+		<< "\tforward_init(symbols[0], alpha);" << std::endl
+		<< "\tfor(std::size_t t = 1; t < length; ++t){" << std::endl
+		<< "\t\tfor(std::size_t i = 0; i < N; ++i) previous[i] = alpha[i];" << std::endl
+		<< "\t\tforward_step(symbols[t], previous, alpha);" << std::endl
+		<< "\t}" << std::endl << "}" << std::endl << std::endl;
+
+	/* See LinearMemoryForwardAlgorithm::forward_terminate. */
+	out << "extern \"C\" double hmm_forward_terminate(const double* alpha){" << std::endl
+		<< "\tdouble log_prob = kNegInf;" << std::endl;
+	for(std::size_t i = 0; i < ((model.is_finite) ? num_states : silent); ++i){
+		if(model.is_finite && model.pi_end[i] == utils::kNegInf) continue;
+		out << "\tlog_prob = sum_log_prob(log_prob, alpha[" << i << "]" << ((model.is_finite) ? " + " + __literal(model.pi_end[i]) : "") << ");" << std::endl;
+	}
+	out << "\treturn log_prob;" << std::endl << "}" << std::endl << std::endl;
+
+	/* See LinearMemoryViterbiDecodingAlgorithm::decode_indices and viterbi_terminate. psi holds length + 1 columns. */
+	out << "extern \"C\" std::size_t hmm_viterbi(const std::size_t* symbols, std::size_t length, double* phi, std::size_t* psi){" << std::endl
+		<< "\tdouble previous[N];" << std::endl
+		<< "\tviterbi_init(symbols[0], phi, psi);" << std::endl
+		<< "\tfor(std::size_t t = 1; t < length; ++t){" << std::endl
+		<< "\t\tfor(std::size_t i = 0; i < N; ++i) previous[i] = phi[i];" << std::endl
+		<< "\t\tviterbi_step(symbols[t], previous, phi, psi + (t + 1) * N);" << std::endl
+		<< "\t}" << std::endl
+		<< "\tdouble max_phi = kNegInf;" << std::endl << "\tstd::size_t max_state = N;" << std::endl;
+	for(std::size_t i = 0; i < ((model.is_finite) ? num_states : silent); ++i){
+		if(model.is_finite){
+			out << "\tphi[" << i << "] = phi[" << i << "] + " << __literal(model.pi_end[i]) << ";" << std::endl;
+		}
+		out << "\tif(phi[" << i << "] > max_phi){ max_phi = phi[" << i << "]; max_state = " << i << "; }" << std::endl;
+	}
+	out << "\treturn max_state;" << std::endl << "}" << std::endl;
+	return out.str();
+}
+
+/* ===================== BUILD AND LOAD ===================== */
+
+/* Quoted for the shell, including the single quotes in path. */
+static std::string __shell_quote(const std::string& path) {
+	std::string quoted = "'";
+	for(char c : path){
+		quoted += (c == '\'') ? std::string("'\\''") : std::string(1, c);
+	}
+	return quoted + "'";
+}
+
+/* False if the file cannot be read. */
+static bool __read_file(const std::string& path, std::string& content) {
+	std::ifstream in(path, std::ios::binary);
+	if(! in.is_open()) return false;
+	std::ostringstream oss;
+	oss << in.rdbuf();
+	content = oss.str();
+	return true;
+}
+
+/* Builds source in library_path. The source and the object are written under temporary names then renamed, so that
+concurrent builds never load a partial object nor compare a partial source. */
+static void __build_model(const std::string& source, const std::string& base_path, const std::string& library_path) {
+	std::string temporary_path = base_path + "." + std::to_string(getpid()) + ".tmp";
+	std::string source_path = temporary_path + ".cpp";
+	std::ofstream source_file(source_path);
+	if(! source_file.is_open()){
+		throw ModelCompilationException(error_message::format(error_message::kModelCompilationWriteFailed, source_path));
+	}
+	source_file << source;
+	source_file.close();
+	if(! source_file){
+		std::remove(source_path.c_str());
+		throw ModelCompilationException(error_message::format(error_message::kModelCompilationWriteFailed, source_path));
+	}
+	std::string build_path = temporary_path + ".so";
+	const char* compiler = std::getenv("CXX");
+	std::string command = ((compiler != nullptr && compiler[0] != '\0') ? std::string(compiler) : hmm_config::kDefaultModelCompiler)
+		+ " -std=c++11 -O2 -shared -fPIC -o " + __shell_quote(build_path) + " " + __shell_quote(source_path);
+	if(std::system(command.c_str()) != 0){
+		std::remove(build_path.c_str());
+		std::remove(source_path.c_str());
+		throw ModelCompilationException(error_message::format(error_message::kModelCompilationCompilerFailed, command));
+	}
+	/* The object first : a source in the cache always comes with its object. */
+	if(std::rename(build_path.c_str(), library_path.c_str()) != 0 
+		|| std::rename(source_path.c_str(), (base_path + ".cpp").c_str()) != 0){
+		std::remove(build_path.c_str());
+		std::remove(source_path.c_str());
+		throw ModelCompilationException(error_message::format(error_message::kModelCompilationWriteFailed, library_path));
+	}
+}
+
+std::shared_ptr<const CompiledModel> compile_model(const RawModel& model, const std::string& cache_directory) {
+	std::string source = generate_model_source(model);
+	std::ostringstream oss;
+	oss << std::hex << std::hash<std::string>()(source);
+	mkdir(cache_directory.c_str(), 0755);
+	/* The cached source is compared to the model's, the sources whose hashes collide going to the next free suffix. */
+	for(std::size_t suffix = 0; ; ++suffix){
+		std::string base_path = cache_directory + "/hmm_" + oss.str() + ((suffix == 0) ? "" : "_" + std::to_string(suffix));
+		std::string library_path = base_path + ".so";
+		std::string cached_source;
+		if(__read_file(base_path + ".cpp", cached_source)){
+			if(cached_source != source) continue;
+			if(std::ifstream(library_path).good()) return std::make_shared<CompiledModel>(model, library_path);
+		}
+		__build_model(source, base_path, library_path);
+		return std::make_shared<CompiledModel>(model, library_path);
+	}
+}
+
+CompiledModel::CompiledModel(const RawModel& model, const std::string& library_path) :
+	_handle(dlopen(library_path.c_str(), RTLD_NOW | RTLD_LOCAL)), _forward(nullptr), _forward_terminate(nullptr), _viterbi(nullptr),
+	_num_states(model.A.size()), _silent_states_index(model.silent_states_index), _symbols() {
+		if(_handle == nullptr){
+			throw ModelCompilationException(error_message::format(error_message::kModelCompilationLoadFailed, dlerror()));
+		}
+		/* POSIX guarantees that the object pointers returned by dlsym can be cast to function pointers. */
+		_forward = reinterpret_cast<ForwardFunction>(dlsym(_handle, "hmm_forward"));
+		_forward_terminate = reinterpret_cast<ForwardTerminateFunction>(dlsym(_handle, "hmm_forward_terminate"));
+		_viterbi = reinterpret_cast<ViterbiFunction>(dlsym(_handle, "hmm_viterbi"));
+		if(_forward == nullptr || _forward_terminate == nullptr || _viterbi == nullptr){
+			dlclose(_handle);
+			throw ModelCompilationException(error_message::format(error_message::kModelCompilationLoadFailed, library_path));
+		}
+		for(std::size_t k = 0; k < model.alphabet.size(); ++k){
+			_symbols[model.alphabet[k]] = k;
+		}
+	}
+
+CompiledModel::~CompiledModel() {
+	dlclose(_handle);
+}
+
+std::vector<std::size_t> CompiledModel::_symbols_indices(const std::vector<std::string>& sequence, std::size_t length) const {
+	std::vector<std::size_t> indices(length);
+	for(std::size_t t = 0; t < length; ++t){
+		std::unordered_map<std::string, std::size_t>::const_iterator it = _symbols.find(sequence[t]);
+		indices[t] = (it == _symbols.end()) ? _symbols.size() : it->second;
+	}
+	return indices;
+}
+
+std::vector<double> CompiledModel::forward(const std::vector<std::string>& sequence, std::size_t t_max) const {
+	if(t_max == 0) t_max = sequence.size();
+	if(sequence.size() == 0) throw std::logic_error("forward on empty sequence");
+	std::size_t length = std::min(sequence.size(), t_max);
+	std::vector<double> alpha(_num_states);
+	_forward(_symbols_indices(sequence, length).data(), length, alpha.data());
+	return alpha;
+}
+
+double CompiledModel::log_likelihood(const std::vector<std::string>& sequence) const {
+	std::vector<double> alpha = forward(sequence, sequence.size());
+	return _forward_terminate(alpha.data());
+}
+
+std::pair<std::vector<std::size_t>, double> CompiledModel::decode_indices(const std::vector<std::string>& sequence, std::size_t t_max) const {
+	if(t_max == 0) t_max = sequence.size();
+	if(sequence.size() == 0) throw std::logic_error("viterbi on empty sequence");
+	std::size_t length = std::min(sequence.size(), t_max);
+	std::vector<double> phi(_num_states);
+	std::vector<std::size_t> psi((length + 1) * _num_states);
+	std::size_t max_state_index = _viterbi(_symbols_indices(sequence, length).data(), length, phi.data(), psi.data());
+	if(max_state_index >= _num_states || phi[max_state_index] == utils::kNegInf){
+		/* Sequence is impossible. */
+		return std::make_pair(std::vector<std::size_t>(), utils::kNegInf);
+	}
+	/* Emitting states point to the previous column, silent states to their own column. */
+	std::vector<std::size_t> path(1, max_state_index);
+	std::size_t column = length;
+	std::size_t state = max_state_index;
+	while(psi[column * _num_states + state] != _num_states){
+		std::size_t previous = psi[column * _num_states + state];
+		if(state < _silent_states_index) --column;
+		state = previous;
+		path.push_back(state);
+	}
+	std::reverse(path.begin(), path.end());
+	return std::make_pair(path, phi[max_state_index]);
+}
+
+/* ===================== COMPILED ALGORITHMS ===================== */
+
+CompiledForwardAlgorithm::CompiledForwardAlgorithm(RawModel* model, const std::string& cache_directory) :
+	ForwardAlgorithm(hmm_config::kCompiledForwardAlgorithmName, model), _cache_directory(cache_directory), _compiled() {}
+CompiledForwardAlgorithm* CompiledForwardAlgorithm::clone() const { return new CompiledForwardAlgorithm(*this); }
+CompiledForwardAlgorithm::~CompiledForwardAlgorithm() {}
+
+void CompiledForwardAlgorithm::set_model(RawModel* model) {
+	HMMAlgorithm::set_model(model);
+	_compiled.reset();
+}
+
+const CompiledModel& CompiledForwardAlgorithm::_compiled_model() {
+	if(! _compiled) _compiled = compile_model(*_model, _cache_directory);
+	return *_compiled;
+}
+
+std::vector<double> CompiledForwardAlgorithm::forward(const std::vector<std::string>& sequence, std::size_t t_max) {
+	return _compiled_model().forward(sequence, t_max);
+}
+
+double CompiledForwardAlgorithm::log_likelihood(const std::vector<std::string>& sequence) {
+	return _compiled_model().log_likelihood(sequence);
+}
+
+double CompiledForwardAlgorithm::log_likelihood(const std::vector<std::vector<std::string>>& sequences) {
+	double likelihood = 0;
+	for(const std::vector<std::string>& sequence : sequences){
+		likelihood += log_likelihood(sequence);
+	}
+	return likelihood;
+}
+
+CompiledViterbiDecodingAlgorithm::CompiledViterbiDecodingAlgorithm(RawModel* model, const std::string& cache_directory) :
+	DecodingAlgorithm(hmm_config::kCompiledViterbiDecodeAlgorithmName, model), _cache_directory(cache_directory), _compiled() {}
+CompiledViterbiDecodingAlgorithm* CompiledViterbiDecodingAlgorithm::clone() const { return new CompiledViterbiDecodingAlgorithm(*this); }
+CompiledViterbiDecodingAlgorithm::~CompiledViterbiDecodingAlgorithm() {}
+
+void CompiledViterbiDecodingAlgorithm::set_model(RawModel* model) {
+	HMMAlgorithm::set_model(model);
+	_compiled.reset();
+}
+
+const CompiledModel& CompiledViterbiDecodingAlgorithm::_compiled_model() {
+	if(! _compiled) _compiled = compile_model(*_model, _cache_directory);
+	return *_compiled;
+}
+
+std::pair<std::vector<std::string>, double> CompiledViterbiDecodingAlgorithm::decode(const std::vector<std::string>& sequence, std::size_t t_max) {
+	std::vector<std::size_t> path_indices;
+	double max_phi_T;
+	std::tie(path_indices, max_phi_T) = _compiled_model().decode_indices(sequence, t_max);
+	std::vector<std::string> path;
+	path.reserve(path_indices.size());
+	for(std::size_t path_index : path_indices){
+		path.push_back(_model->states_names[path_index]);
+	}
+	return std::make_pair(path, max_phi_T);
+}
@@ -0,0 +1,102 @@
+#ifndef __COMPILED_MODEL_HPP
+#define __COMPILED_MODEL_HPP
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <utility>	// std::pair
+#include <memory>	// std::shared_ptr
+#include <stdexcept>
+#include "constants.hpp"
+#include "hmm_base.hpp"
+#include "hmm_algorithms.hpp"
+
+/* <-------- Exceptions --------> */
+
+class ModelCompilationException : public std::runtime_error {
+public:
+	ModelCompilationException(const std::string&);
+};
+
+/* <----------------------------> */
+
+/* Forward and Viterbi kernels generated for a brewed RawModel and built as a shared object (see compile_model).
+The transitions, the silent states topological order and the log probabilities are constants of the generated
+code, null transitions being left out. Results are the same as the ones of the linear memory algorithms, up to the 
+rounding when these go through the silent closure of the model. */
+class CompiledModel {
+private:
+	typedef void (*ForwardFunction)(const std::size_t*, std::size_t, double*);
+	typedef double (*ForwardTerminateFunction)(const double*);
+	typedef std::size_t (*ViterbiFunction)(const std::size_t*, std::size_t, double*, std::size_t*);
+
+	void* _handle;
+	ForwardFunction _forward;
+	ForwardTerminateFunction _forward_terminate;
+	ViterbiFunction _viterbi;
+	std::size_t _num_states;
+	std::size_t _silent_states_index;
+	/* Index of each symbol in the generated emissions, the symbols out of the alphabet being mapped to the
+	number of symbols. */
+	std::unordered_map<std::string, std::size_t> _symbols;
+
+	std::vector<std::size_t> _symbols_indices(const std::vector<std::string>& sequence, std::size_t length) const;
+
+public:
+	/* Loads the shared object built from model. */
+	CompiledModel(const RawModel& model, const std::string& library_path);
+	CompiledModel(const CompiledModel&) = delete;
+	CompiledModel& operator=(const CompiledModel&) = delete;
+	/* Same parameters and results as the ForwardAlgorithm and LinearMemoryViterbiDecodingAlgorithm methods. */
+	std::vector<double> forward(const std::vector<std::string>& sequence, std::size_t t_max) const;
+	double log_likelihood(const std::vector<std::string>& sequence) const;
+	std::pair<std::vector<std::size_t>, double> decode_indices(const std::vector<std::string>& sequence, std::size_t t_max) const;
+	~CompiledModel();
+};
+
+/* Returns the C++ source of the kernels specialized for the given brewed model. */
+std::string generate_model_source(const RawModel& model);
+
+/* Generates the source of the model, builds it with the system compiler ($CXX, or hmm_config::kDefaultModelCompiler)
+and loads it. Built objects are cached in cache_directory next to their source, which is compared to the model's 
+before loading them, hence a model is only built once. Throws a ModelCompilationException if the model cannot be compiled or loaded. */
+std::shared_ptr<const CompiledModel> compile_model(const RawModel& model,
+	const std::string& cache_directory = hmm_config::kDefaultModelCacheDirectory);
+
+
+/* ===================== COMPILED ALGORITHMS ===================== */
+
+/* Compile the model on first use, and again after each set_model (called by the hmm after each brew). */
+
+class CompiledForwardAlgorithm : public ForwardAlgorithm {
+private:
+	std::string _cache_directory;
+	std::shared_ptr<const CompiledModel> _compiled;
+	const CompiledModel& _compiled_model();
+public:
+	CompiledForwardAlgorithm(RawModel*, const std::string& cache_directory = hmm_config::kDefaultModelCacheDirectory);
+	CompiledForwardAlgorithm* clone() const;
+	void set_model(RawModel*);
+	using ForwardAlgorithm::forward;
+	using ForwardAlgorithm::log_likelihood;
+	std::vector<double> forward(const std::vector<std::string>&, std::size_t);
+	double log_likelihood(const std::vector<std::string>&);
+	double log_likelihood(const std::vector<std::vector<std::string>>&);
+	~CompiledForwardAlgorithm();
+};
+
+class CompiledViterbiDecodingAlgorithm : public DecodingAlgorithm {
+private:
+	std::string _cache_directory;
+	std::shared_ptr<const CompiledModel> _compiled;
+	const CompiledModel& _compiled_model();
+public:
+	CompiledViterbiDecodingAlgorithm(RawModel*, const std::string& cache_directory = hmm_config::kDefaultModelCacheDirectory);
+	CompiledViterbiDecodingAlgorithm* clone() const;
+	void set_model(RawModel*);
+	using DecodingAlgorithm::decode;
+	std::pair<std::vector<std::string>, double> decode(const std::vector<std::string>&, std::size_t);
+	~CompiledViterbiDecodingAlgorithm();
+};
+
+#endif
@@ -41,6 +41,42 @@ namespace error_message {
 	const std::string kHMMAddedTransitionFromEndState = "tried to add a transition from an end state";
 	const std::string kHMMAddedTransitionToBeginState = "tried to add a transition to a begin state";
 	const std::string kHMMTransitionNegativeProbability = "tried to set a transition with a negative probability";
+	const std::string kHMMMatricesDimensionMismatch = "the given matrices dimensions do not match the number of states";
+	const std::string kHMMMatricesReservedStateName = "a state given in the matrices has the name of the begin or end state";
+
+	/* Model compilation */
+	const std::string kModelCompilationEmptyModel = "tried to compile a model which was not brewed";
+	const std::string kModelCompilationNotDiscrete = "only models with discrete distributions can be compiled";
+	const std::string kModelCompilationWriteFailed = "could not write the generated source in the cache directory";
+	const std::string kModelCompilationCompilerFailed = "the compiler failed to build the generated source";
+	const std::string kModelCompilationLoadFailed = "could not load the compiled model";
+
+	/* Scalar models */
+	const std::string kScalarModelNotDiscrete = "only models with discrete distributions have a scalar model";
+
+	/* Numeric sequences */
+	const std::string kAlgorithmNumericSequenceNotSupported = "the algorithm does not support numeric sequences";
+	const std::string kNumericSequenceNotContinuous = "only models with continuous distributions accept numeric sequences";
+	const std::string kFrameMatrixDimension = "the size of the frames data is not a multiple of their non null dimension";
+	const std::string kFrameDimensionMismatch = "the dimension of the frames does not match the one of the distributions";
+
+	/* Training */
+	const std::string kTrainingWeightsMismatch = "the training weights must be non negative, one per sequence";
+	const std::string kTraceWriteFailed = "could not write the training trace";
+	const std::string kAlgorithmSufficientStatisticsNotSupported = "the training algorithm does not support sufficient statistics";
+	const std::string kSufficientStatisticsMismatch = "the sufficient statistics do not have the same kind of counts of the same parameters";
+	const std::string kSufficientStatisticsMalformed = "malformed sufficient statistics";
+	const std::string kCheckpointWriteFailed = "could not write the training checkpoint";
+	const std::string kCheckpointMalformed = "not a training checkpoint";
+	const std::string kCheckpointMismatch = "the training checkpoint was saved for another model or other sequences";
+	const std::string kCheckpointNumericSequenceNotSupported = "training checkpoints are only supported for symbols";
+
+	/* CPU dispatch */
+	const std::string kInstructionSetNotSupported = "the processor does not support the instruction set";
+
+	const std::string kDistributionNotUnivariate = "the distribution is multivariate and needs frames of its dimension";
+	const std::string kGaussianMixtureParameters = "the sizes of the weights, means and covariances do not match the dimension of the mixture";
+	const std::string kCovarianceNotPositiveDefinite = "the covariance matrix is not positive definite";
 
 }
 
@@ -64,6 +100,15 @@ namespace hmm_config {
 	const double kDefaultConvergenceThreshold = 1e-9;
 	const unsigned int kDefaultMaxIterations = 1e8;
 	const unsigned int kDefaultMinIterations = 0;
+	const std::size_t kDefaultPathCountingMaxLength = 1000000;
+	const std::string kDefaultModelCacheDirectory = ".hmm_cache";
+	const std::string kDefaultModelCompiler = "c++";
+	const std::size_t kDefaultEmissionsBlockSize = 256;
+	const double kMinimumVariance = 1e-6;
+	const std::size_t kDefaultPrefixCacheCapacity = 4096;
+	const std::size_t kDefaultPrefixCacheCheckpointInterval = 16;
+	const std::string kInstructionSetVariable = "HMM_INSTRUCTION_SET";
+	const unsigned int kDefaultCheckpointInterval = 1;
 
 	const std::string kDefaultHMMName = "HiddenMarkovModel";
 	const std::string kDefaultStartStateLabel = "begin_state";
@@ -77,6 +122,12 @@ namespace hmm_config {
 	const std::string kLinearMemoryViterbiDecodeAlgorithmName = "Linear Memory Viterbi Decode";
 	const std::string kLinearMemoryViterbiTrainingAlgorithmName = "Linear Memory Viterbi Training";
 	const std::string kLinearMemoryBaumWelchTrainingAlgorithmName = "Linear Memory Baum-Welch Training";
+	const std::string kPathCountingViterbiTrainingAlgorithmName = "Path Counting Viterbi Training";
+	const std::string kCompiledForwardAlgorithmName = "Compiled Forward";
+	const std::string kCompiledViterbiDecodeAlgorithmName = "Compiled Viterbi Decode";
+	const std::string kSinglePrecisionForwardAlgorithmName = "Single Precision Forward";
+	const std::string kSinglePrecisionViterbiDecodeAlgorithmName = "Single Precision Viterbi Decode";
+	const std::string kPrefixCachedForwardAlgorithmName = "Prefix Cached Forward";
 }
 
 namespace distribution_config {
@@ -85,6 +136,8 @@ namespace distribution_config {
 	const std::string kContinuousDistributionName = "Continuous distribution";
 	const std::string kNormalDistributionName = "Normal distribution";
 	const std::string kUniformDistributionName = "Uniform distribution";
+	const std::string kGaussianMixtureDistributionName = "Gaussian mixture distribution";
+	const std::size_t kGaussianMixtureBlockSize = 64;
 
 	const bool kDefaultLogUse = false;
 }
\ No newline at end of file
@@ -43,6 +43,43 @@ namespace error_message {
 	extern const std::string kHMMAddedTransitionFromEndState;
 	extern const std::string kHMMAddedTransitionToBeginState;
 	extern const std::string kHMMTransitionNegativeProbability;
+	extern const std::string kHMMMatricesDimensionMismatch;
+	extern const std::string kHMMMatricesReservedStateName;
+
+	/* Model compilation */
+	extern const std::string kModelCompilationEmptyModel;
+	extern const std::string kModelCompilationNotDiscrete;
+	extern const std::string kModelCompilationWriteFailed;
+	extern const std::string kModelCompilationCompilerFailed;
+	extern const std::string kModelCompilationLoadFailed;
+
+	/* Scalar models */
+	extern const std::string kScalarModelNotDiscrete;
+
+	/* Numeric sequences */
+	extern const std::string kAlgorithmNumericSequenceNotSupported;
+	extern const std::string kNumericSequenceNotContinuous;
+	extern const std::string kFrameMatrixDimension;
+	extern const std::string kFrameDimensionMismatch;
+
+	/* Training */
+	extern const std::string kTrainingWeightsMismatch;
+	extern const std::string kTraceWriteFailed;
+	extern const std::string kAlgorithmSufficientStatisticsNotSupported;
+	extern const std::string kSufficientStatisticsMismatch;
+	extern const std::string kSufficientStatisticsMalformed;
+	extern const std::string kCheckpointWriteFailed;
+	extern const std::string kCheckpointMalformed;
+	extern const std::string kCheckpointMismatch;
+	extern const std::string kCheckpointNumericSequenceNotSupported;
+
+	/* CPU dispatch */
+	extern const std::string kInstructionSetNotSupported;
+
+	/* Gaussian mixtures */
+	extern const std::string kDistributionNotUnivariate;
+	extern const std::string kGaussianMixtureParameters;
+	extern const std::string kCovarianceNotPositiveDefinite;
 
 	template<typename T>
 	static std::string format(const std::string& error, const T& t) {
@@ -72,6 +109,15 @@ namespace hmm_config {
 	extern const double kDefaultConvergenceThreshold;
 	extern const unsigned int kDefaultMaxIterations;
 	extern const unsigned int kDefaultMinIterations;
+	extern const std::size_t kDefaultPathCountingMaxLength;
+	extern const std::string kDefaultModelCacheDirectory;
+	extern const std::string kDefaultModelCompiler;
+	extern const std::size_t kDefaultEmissionsBlockSize;
+	extern const double kMinimumVariance;
+	extern const std::size_t kDefaultPrefixCacheCapacity;
+	extern const std::size_t kDefaultPrefixCacheCheckpointInterval;
+	extern const std::string kInstructionSetVariable;
+	extern const unsigned int kDefaultCheckpointInterval;
 
 	extern const std::string kDefaultHMMName;
 	extern const std::string kDefaultStartStateLabel;
@@ -85,6 +131,12 @@ namespace hmm_config {
 	extern const std::string kLinearMemoryViterbiDecodeAlgorithmName;
 	extern const std::string kLinearMemoryViterbiTrainingAlgorithmName;
 	extern const std::string kLinearMemoryBaumWelchTrainingAlgorithmName;
+	extern const std::string kPathCountingViterbiTrainingAlgorithmName;
+	extern const std::string kCompiledForwardAlgorithmName;
+	extern const std::string kCompiledViterbiDecodeAlgorithmName;
+	extern const std::string kSinglePrecisionForwardAlgorithmName;
+	extern const std::string kSinglePrecisionViterbiDecodeAlgorithmName;
+	extern const std::string kPrefixCachedForwardAlgorithmName;
 }
 
 namespace distribution_config {
@@ -93,6 +145,8 @@ namespace distribution_config {
 	extern const std::string kContinuousDistributionName;
 	extern const std::string kNormalDistributionName;
 	extern const std::string kUniformDistributionName;
+	extern const std::string kGaussianMixtureDistributionName;
+	extern const std::size_t kGaussianMixtureBlockSize;
 
 	extern const bool kDefaultLogUse;
 }
@@ -0,0 +1,184 @@
+#include <string>
+#include <cstdlib> // std::getenv
+#include <stdexcept>
+#include "constants.hpp"
+#include "cpu_dispatch.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define __HMM_X86_DISPATCH
+#endif
+
+#if defined(__GNUC__)
+#define __HMM_KERNEL_BODY inline __attribute__((always_inline))
+#else
+#define __HMM_KERNEL_BODY inline
+#endif
+
+/* No fused multiply-add contraction (AVX-512 implies FMA), so that all the kernels round the same way. */
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize ("fp-contract=off")
+#endif
+
+namespace cpu_dispatch {
+	/* ===================== KERNEL BODIES ===================== */
+
+	/* Inlined in the kernels of each instruction set, which compiles them for its target. */
+
+	static __HMM_KERNEL_BODY void __normal_log_pdf(const double* x, std::size_t n, double mean,
+		double inverse_standard_deviation, double log_normalization, double* out){
+		for(std::size_t t = 0; t < n; ++t){
+			double z = (x[t] - mean) * inverse_standard_deviation;
+			out[t] = log_normalization - 0.5 * z * z;
+		}
+	}
+
+	static __HMM_KERNEL_BODY void __add_squared_distances(const double* x, std::size_t n, double mean, double precision,
+		double* quadratic){
+		for(std::size_t t = 0; t < n; ++t){
+			double diff = x[t] - mean;
+			quadratic[t] += diff * diff * precision;
+		}
+	}
+
+	static __HMM_KERNEL_BODY void __subtract(const double* x, std::size_t n, double mean, double* y){
+		for(std::size_t t = 0; t < n; ++t){
+			y[t] = x[t] - mean;
+		}
+	}
+
+	static __HMM_KERNEL_BODY void __subtract_scaled(const double* x, std::size_t n, double factor, double* y){
+		for(std::size_t t = 0; t < n; ++t){
+			y[t] -= factor * x[t];
+		}
+	}
+
+	static __HMM_KERNEL_BODY void __scale_add_squares(double* y, std::size_t n, double factor, double* quadratic){
+		for(std::size_t t = 0; t < n; ++t){
+			y[t] *= factor;
+			quadratic[t] += y[t] * y[t];
+		}
+	}
+
+	static __HMM_KERNEL_BODY void __log_densities(double* quadratic, std::size_t n, double log_constant){
+		for(std::size_t t = 0; t < n; ++t){
+			quadratic[t] = log_constant - 0.5 * quadratic[t];
+		}
+	}
+
+	/* ===================== KERNELS ===================== */
+
+	/* The kernels of an instruction set, compiled with the given function attributes, and their table. */
+#define __HMM_DEFINE_KERNELS(suffix, attributes) \
+	attributes static void normal_log_pdf_##suffix(const double* x, std::size_t n, double mean, \
+		double inverse_standard_deviation, double log_normalization, double* out){ \
+		__normal_log_pdf(x, n, mean, inverse_standard_deviation, log_normalization, out); \
+	} \
+	attributes static void add_squared_distances_##suffix(const double* x, std::size_t n, double mean, double precision, \
+		double* quadratic){ \
+		__add_squared_distances(x, n, mean, precision, quadratic); \
+	} \
+	attributes static void subtract_##suffix(const double* x, std::size_t n, double mean, double* y){ \
+		__subtract(x, n, mean, y); \
+	} \
+	attributes static void subtract_scaled_##suffix(const double* x, std::size_t n, double factor, double* y){ \
+		__subtract_scaled(x, n, factor, y); \
+	} \
+	attributes static void scale_add_squares_##suffix(double* y, std::size_t n, double factor, double* quadratic){ \
+		__scale_add_squares(y, n, factor, quadratic); \
+	} \
+	attributes static void log_densities_##suffix(double* quadratic, std::size_t n, double log_constant){ \
+		__log_densities(quadratic, n, log_constant); \
+	} \
+	static const Kernels __kernels_##suffix = {normal_log_pdf_##suffix, add_squared_distances_##suffix, \
+		subtract_##suffix, subtract_scaled_##suffix, scale_add_squares_##suffix, log_densities_##suffix};
+
+	__HMM_DEFINE_KERNELS(generic, )
+#ifdef __HMM_X86_DISPATCH
+	__HMM_DEFINE_KERNELS(sse42, __attribute__((target("sse4.2"))))
+	__HMM_DEFINE_KERNELS(avx2, __attribute__((target("avx2"))))
+	__HMM_DEFINE_KERNELS(avx512, __attribute__((target("avx512f"))))
+#endif
+
+#undef __HMM_DEFINE_KERNELS
+
+	static const Kernels& __kernels_of(InstructionSet instruction_set){
+		switch(instruction_set){
+#ifdef __HMM_X86_DISPATCH
+			case kSSE42: return __kernels_sse42;
+			case kAVX2: return __kernels_avx2;
+			case kAVX512: return __kernels_avx512;
+#endif
+			default: return __kernels_generic;
+		}
+	}
+
+	/* ===================== DISPATCH ===================== */
+
+	std::string instruction_set_name(InstructionSet instruction_set){
+		switch(instruction_set){
+			case kGeneric: return "generic";
+			case kSSE42: return "sse4.2";
+			case kAVX2: return "avx2";
+			case kAVX512: return "avx512";
+			default: return "";
+		}
+	}
+
+	static InstructionSet __detect(){
+#ifdef __HMM_X86_DISPATCH
+		/* Also checks that the operating system saves the wide registers (xgetbv). */
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx512f")) return kAVX512;
+		if(__builtin_cpu_supports("avx2")) return kAVX2;
+		if(__builtin_cpu_supports("sse4.2")) return kSSE42;
+#endif
+		return kGeneric;
+	}
+
+	InstructionSet detected_instruction_set(){
+		static const InstructionSet detected = __detect();
+		return detected;
+	}
+
+	bool supported(InstructionSet instruction_set){
+		return instruction_set < kNumInstructionSets && instruction_set <= detected_instruction_set();
+	}
+
+	/* The detected instruction set, or the one named by HMM_INSTRUCTION_SET if supported. */
+	static InstructionSet __initial_instruction_set(){
+		const char* name = std::getenv(hmm_config::kInstructionSetVariable.c_str());
+		if(name != nullptr){
+			for(int i = 0; i < kNumInstructionSets; ++i){
+				if(instruction_set_name(InstructionSet(i)) == name && supported(InstructionSet(i))) return InstructionSet(i);
+			}
+		}
+		return detected_instruction_set();
+	}
+
+	static InstructionSet& __active(){
+		static InstructionSet active = __initial_instruction_set();
+		return active;
+	}
+
+	InstructionSet instruction_set(){
+		return __active();
+	}
+
+	void set_instruction_set(InstructionSet instruction_set){
+		if(! supported(instruction_set)){
+			throw std::invalid_argument(error_message::format(error_message::kInstructionSetNotSupported,
+				instruction_set_name(instruction_set)));
+		}
+		__active() = instruction_set;
+	}
+
+	void reset_instruction_set(){
+		__active() = detected_instruction_set();
+	}
+
+	const Kernels& kernels(){
+		return __kernels_of(__active());
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef __CPU_DISPATCH_HPP
+#define __CPU_DISPATCH_HPP
+
+#include <string>
+#include <cstddef>
+
+/* Numeric kernels of the emission evaluation, compiled once per instruction set and bound at runtime to the best one
+the processor supports, so that a single build runs everywhere and still uses the wider vectors of the recent
+processors. The kernels are the same loops compiled for each target (the compiler vectorizes them when optimizing),
+element-wise and compiled without floating point contraction, hence giving the same results whatever the instruction
+set. Only the generic kernels exist on the other architectures and compilers. */
+namespace cpu_dispatch {
+	enum InstructionSet {
+		kGeneric,
+		kSSE42,
+		kAVX2,
+		kAVX512,
+		kNumInstructionSets
+	};
+
+	struct Kernels {
+		/* out[t] = log_normalization - 0.5 * ((x[t] - mean) * inverse_standard_deviation)^2 */
+		void (*normal_log_pdf)(const double* x, std::size_t n, double mean, double inverse_standard_deviation,
+			double log_normalization, double* out);
+		/* quadratic[t] += (x[t] - mean)^2 * precision */
+		void (*add_squared_distances)(const double* x, std::size_t n, double mean, double precision, double* quadratic);
+		/* y[t] = x[t] - mean */
+		void (*subtract)(const double* x, std::size_t n, double mean, double* y);
+		/* y[t] -= factor * x[t] */
+		void (*subtract_scaled)(const double* x, std::size_t n, double factor, double* y);
+		/* y[t] *= factor, then quadratic[t] += y[t]^2 */
+		void (*scale_add_squares)(double* y, std::size_t n, double factor, double* quadratic);
+		/* quadratic[t] = log_constant - 0.5 * quadratic[t] */
+		void (*log_densities)(double* quadratic, std::size_t n, double log_constant);
+	};
+
+	std::string instruction_set_name(InstructionSet);
+	/* Best instruction set of the processor (cpuid), detected once. */
+	InstructionSet detected_instruction_set();
+	bool supported(InstructionSet);
+	/* Instruction set of the kernels in use : the detected one, unless overridden by set_instruction_set or, at the
+	first use, by the environment variable HMM_INSTRUCTION_SET (generic, sse4.2, avx2 or avx512). */
+	InstructionSet instruction_set();
+	/* Throws if the processor does not support the instruction set. Not synchronized with the running algorithms.
+	reset_instruction_set goes back to the detected instruction set. */
+	void set_instruction_set(InstructionSet);
+	void reset_instruction_set();
+	const Kernels& kernels();
+}
+
+#endif
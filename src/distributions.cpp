@@ -5,9 +5,12 @@
 #include <functional>
 #include <vector>
 #include <fstream>
+#include <sstream>
+#include <stdexcept>
 #include "constants.hpp"
 #include "distributions.hpp"
 #include "utils.hpp"
+#include "cpu_dispatch.hpp"
 
 /* <-------- Exceptions --------> */
 DistributionException::DistributionException(const std::string& msg) : std::logic_error(msg) {}
@@ -202,8 +205,11 @@ DiscreteDistribution::~DiscreteDistribution() {}
 
 
 
+/* log(sqrt(2 * pi)) */
+static const double __kLogSqrtTwoPi = 0.5 * log(2 * acos(-1.0));
+
 ContinuousDistribution::ContinuousDistribution(const std::string& name) : 
-	Distribution(name) {}
+	Distribution(name), _density(0) {}
 
 ContinuousDistribution::ContinuousDistribution() : 
 	ContinuousDistribution(distribution_config::kContinuousDistributionName) {}
@@ -211,12 +217,403 @@ ContinuousDistribution::ContinuousDistribution() :
 bool ContinuousDistribution::is_continuous() const { return true; }
 bool ContinuousDistribution::is_normal() const { return false; }
 bool ContinuousDistribution::is_uniform() const { return false; }
+bool ContinuousDistribution::is_gaussian_mixture() const { return false; }
+std::size_t ContinuousDistribution::dimension() const { return 1; }
+
+void ContinuousDistribution::log_pdf(const double* x, std::size_t n, double* out) const {
+	for(std::size_t i = 0; i < n; ++i){
+		out[i] = log_pdf(x[i]);
+	}
+}
+
+double ContinuousDistribution::pdf(double x) const { return exp(log_pdf(x)); }
+
+double& ContinuousDistribution::operator[] (const std::string& symbol) {
+	return operator[](std::stod(symbol));
+}
+
+double& ContinuousDistribution::operator[] (double x) {
+	_density = (this->uses_log_probabilities()) ? log_pdf(x) : pdf(x);
+	return _density;
+}
+
+void ContinuousDistribution::log_normalize() {
+	if(! this->uses_log_probabilities()) {
+		log_probabilities(true);
+	}
+}
+
 ContinuousDistribution::~ContinuousDistribution() {}
 
-NormalDistribution::NormalDistribution() : ContinuousDistribution(distribution_config::kNormalDistributionName) {}
+
+NormalDistribution::NormalDistribution() : NormalDistribution(0.0, 1.0) {}
+
+NormalDistribution::NormalDistribution(double mean, double standard_deviation) : 
+	ContinuousDistribution(distribution_config::kNormalDistributionName), _mean(mean), _standard_deviation(standard_deviation) {}
+
+NormalDistribution::NormalDistribution(const NormalDistribution& other) : 
+	ContinuousDistribution(other), _mean(other._mean), _standard_deviation(other._standard_deviation) {}
+
+NormalDistribution* NormalDistribution::clone() const {
+	return new NormalDistribution(*this);
+}
+
+double NormalDistribution::mean() const { return _mean; }
+double NormalDistribution::standard_deviation() const { return _standard_deviation; }
 bool NormalDistribution::is_normal() const { return true; }
+bool NormalDistribution::empty() const { return ! (_standard_deviation > 0); }
+
+std::string NormalDistribution::to_string() const {
+	return Distribution::to_string() + ": mean(" + std::to_string(_mean) + ") standard deviation(" + std::to_string(_standard_deviation) + ")";
+}
+
+void NormalDistribution::save(std::ofstream& out) {
+	out << _mean << global_config::kProbabilitySeparator << _standard_deviation << std::endl;
+}
+
+void NormalDistribution::load(std::ifstream& in) {
+	std::string line;
+	std::string mean_str;
+	std::string standard_deviation_str;
+	std::getline(in, line);
+	std::tie(mean_str, standard_deviation_str) = utils::split_first(line, global_config::kProbabilitySeparator);
+	_mean = std::stod(mean_str);
+	_standard_deviation = std::stod(standard_deviation_str);
+}
+
+double NormalDistribution::log_pdf(double x) const {
+	double log_density;
+	log_pdf(&x, 1, &log_density);
+	return log_density;
+}
+
+void NormalDistribution::log_pdf(const double* x, std::size_t n, double* out) const {
+	/* Constants hoisted out of the loop, run by the kernel of the instruction set of the processor. */
+	const double inverse_standard_deviation = 1.0 / _standard_deviation;
+	const double log_normalization = - log(_standard_deviation) - __kLogSqrtTwoPi;
+	cpu_dispatch::kernels().normal_log_pdf(x, n, _mean, inverse_standard_deviation, log_normalization, out);
+}
+
+bool NormalDistribution::operator==(const Distribution& other) const {
+	if(other.is_continuous() && static_cast<const ContinuousDistribution&>(other).is_normal()){
+		const NormalDistribution& normal = static_cast<const NormalDistribution&>(other);
+		return uses_log_probabilities() == normal.uses_log_probabilities() && 
+			_mean == normal._mean && _standard_deviation == normal._standard_deviation;
+	}
+	return false;
+}
+
+bool NormalDistribution::operator!=(const Distribution& other) const {
+	return ! operator==(other);
+}
+
 NormalDistribution::~NormalDistribution() {}
 
-UniformDistribution::UniformDistribution() : ContinuousDistribution(distribution_config::kUniformDistributionName) {}
+
+UniformDistribution::UniformDistribution() : UniformDistribution(0.0, 1.0) {}
+
+UniformDistribution::UniformDistribution(double lower_bound, double upper_bound) : 
+	ContinuousDistribution(distribution_config::kUniformDistributionName), _lower_bound(lower_bound), _upper_bound(upper_bound) {}
+
+UniformDistribution::UniformDistribution(const UniformDistribution& other) : 
+	ContinuousDistribution(other), _lower_bound(other._lower_bound), _upper_bound(other._upper_bound) {}
+
+UniformDistribution* UniformDistribution::clone() const {
+	return new UniformDistribution(*this);
+}
+
+double UniformDistribution::lower_bound() const { return _lower_bound; }
+double UniformDistribution::upper_bound() const { return _upper_bound; }
 bool UniformDistribution::is_uniform() const { return true; }
+bool UniformDistribution::empty() const { return ! (_upper_bound > _lower_bound); }
+
+std::string UniformDistribution::to_string() const {
+	return Distribution::to_string() + ": [" + std::to_string(_lower_bound) + ", " + std::to_string(_upper_bound) + "]";
+}
+
+void UniformDistribution::save(std::ofstream& out) {
+	out << _lower_bound << global_config::kProbabilitySeparator << _upper_bound << std::endl;
+}
+
+void UniformDistribution::load(std::ifstream& in) {
+	std::string line;
+	std::string lower_bound_str;
+	std::string upper_bound_str;
+	std::getline(in, line);
+	std::tie(lower_bound_str, upper_bound_str) = utils::split_first(line, global_config::kProbabilitySeparator);
+	_lower_bound = std::stod(lower_bound_str);
+	_upper_bound = std::stod(upper_bound_str);
+}
+
+double UniformDistribution::log_pdf(double x) const {
+	double log_density;
+	log_pdf(&x, 1, &log_density);
+	return log_density;
+}
+
+void UniformDistribution::log_pdf(const double* x, std::size_t n, double* out) const {
+	const double lower_bound = _lower_bound;
+	const double upper_bound = _upper_bound;
+	const double log_density = - log(_upper_bound - _lower_bound);
+	for(std::size_t i = 0; i < n; ++i){
+		out[i] = (x[i] >= lower_bound && x[i] <= upper_bound) ? log_density : utils::kNegInf;
+	}
+}
+
+bool UniformDistribution::operator==(const Distribution& other) const {
+	if(other.is_continuous() && static_cast<const ContinuousDistribution&>(other).is_uniform()){
+		const UniformDistribution& uniform = static_cast<const UniformDistribution&>(other);
+		return uses_log_probabilities() == uniform.uses_log_probabilities() && 
+			_lower_bound == uniform._lower_bound && _upper_bound == uniform._upper_bound;
+	}
+	return false;
+}
+
+bool UniformDistribution::operator!=(const Distribution& other) const {
+	return ! operator==(other);
+}
+
 UniformDistribution::~UniformDistribution() {}
+
+
+GaussianMixtureDistribution::GaussianMixtureDistribution() : 
+	GaussianMixtureDistribution(1, std::vector<double>({1.0}), std::vector<double>({0.0}), std::vector<double>({1.0})) {}
+
+GaussianMixtureDistribution::GaussianMixtureDistribution(std::size_t dimension, const std::vector<double>& weights, 
+	const std::vector<double>& means, const std::vector<double>& covariances, bool full_covariance) : 
+	ContinuousDistribution(distribution_config::kGaussianMixtureDistributionName), _dimension(dimension), 
+	_full_covariance(full_covariance), _weights(weights), _means(means), _covariances(covariances), 
+	_log_constants(), _precisions() {
+		_precompute();
+	}
+
+GaussianMixtureDistribution::GaussianMixtureDistribution(const GaussianMixtureDistribution& other) : 
+	ContinuousDistribution(other), _dimension(other._dimension), _full_covariance(other._full_covariance), 
+	_weights(other._weights), _means(other._means), _covariances(other._covariances), 
+	_log_constants(other._log_constants), _precisions(other._precisions) {}
+
+GaussianMixtureDistribution* GaussianMixtureDistribution::clone() const {
+	return new GaussianMixtureDistribution(*this);
+}
+
+void GaussianMixtureDistribution::_precompute() {
+	const std::size_t dimension = _dimension;
+	const std::size_t num_components = _weights.size();
+	const std::size_t covariance_size = (_full_covariance) ? dimension * dimension : dimension;
+	if(dimension == 0 || _means.size() != num_components * dimension || _covariances.size() != num_components * covariance_size){
+		throw std::invalid_argument(error_message::kGaussianMixtureParameters);
+	}
+	_log_constants.assign(num_components, 0.0);
+	_precisions.assign(_covariances.size(), 0.0);
+	for(std::size_t k = 0; k < num_components; ++k){
+		const double* covariance = _covariances.data() + k * covariance_size;
+		double* precision = _precisions.data() + k * covariance_size;
+		double log_determinant = 0.0;
+		if(_full_covariance){
+			/* Cholesky decomposition covariance = L * L^T. */
+			for(std::size_t i = 0; i < dimension; ++i){
+				for(std::size_t j = 0; j <= i; ++j){
+					double s = covariance[i * dimension + j];
+					for(std::size_t l = 0; l < j; ++l){
+						s -= precision[i * dimension + l] * precision[j * dimension + l];
+					}
+					if(i == j){
+						if(! (s > 0)) throw std::invalid_argument(error_message::kCovarianceNotPositiveDefinite);
+						log_determinant += log(s);
+						precision[i * dimension + i] = 1.0 / sqrt(s);
+					}
+					else{
+						precision[i * dimension + j] = s * precision[j * dimension + j];
+					}
+				}
+			}
+		}
+		else{
+			for(std::size_t d = 0; d < dimension; ++d){
+				if(! (covariance[d] > 0)) throw std::invalid_argument(error_message::kCovarianceNotPositiveDefinite);
+				log_determinant += log(covariance[d]);
+				precision[d] = 1.0 / covariance[d];
+			}
+		}
+		_log_constants[k] = log(_weights[k]) - (double) dimension * __kLogSqrtTwoPi - 0.5 * log_determinant;
+	}
+}
+
+std::size_t GaussianMixtureDistribution::dimension() const { return _dimension; }
+std::size_t GaussianMixtureDistribution::num_components() const { return _weights.size(); }
+bool GaussianMixtureDistribution::has_full_covariance() const { return _full_covariance; }
+const std::vector<double>& GaussianMixtureDistribution::weights() const { return _weights; }
+const std::vector<double>& GaussianMixtureDistribution::means() const { return _means; }
+const std::vector<double>& GaussianMixtureDistribution::covariances() const { return _covariances; }
+bool GaussianMixtureDistribution::is_gaussian_mixture() const { return true; }
+bool GaussianMixtureDistribution::empty() const { return _weights.empty(); }
+
+std::string GaussianMixtureDistribution::to_string() const {
+	return Distribution::to_string() + ": " + std::to_string(num_components()) + " components of dimension " + 
+		std::to_string(_dimension) + ((_full_covariance) ? " (full covariances)" : " (diagonal covariances)");
+}
+
+/* Values separated by spaces. */
+static void __save_values(std::ofstream& out, const double* values, std::size_t n) {
+	for(std::size_t i = 0; i < n; ++i){
+		if(i > 0) out << ' ';
+		out << values[i];
+	}
+}
+
+static void __load_values(const std::string& line, std::vector<double>& values) {
+	std::istringstream iss(line);
+	std::string value;
+	while(iss >> value){
+		values.push_back(std::stod(value));
+	}
+}
+
+void GaussianMixtureDistribution::save(std::ofstream& out) {
+	const std::size_t covariance_size = (_full_covariance) ? _dimension * _dimension : _dimension;
+	out << num_components() << global_config::kProbabilitySeparator << _dimension << global_config::kProbabilitySeparator 
+		<< _full_covariance << std::endl;
+	for(std::size_t k = 0; k < num_components(); ++k){
+		out << _weights[k] << global_config::kProbabilitySeparator;
+		__save_values(out, _means.data() + k * _dimension, _dimension);
+		out << global_config::kProbabilitySeparator;
+		__save_values(out, _covariances.data() + k * covariance_size, covariance_size);
+		out << std::endl;
+	}
+}
+
+void GaussianMixtureDistribution::load(std::ifstream& in) {
+	std::string line;
+	std::string num_components_str;
+	std::string dimension_str;
+	std::string full_covariance_str;
+	std::getline(in, line);
+	std::tie(num_components_str, line) = utils::split_first(line, global_config::kProbabilitySeparator);
+	std::tie(dimension_str, full_covariance_str) = utils::split_first(line, global_config::kProbabilitySeparator);
+	std::size_t num_components = (std::size_t) std::stoi(num_components_str);
+	_dimension = (std::size_t) std::stoi(dimension_str);
+	_full_covariance = (std::stoi(full_covariance_str) != 0);
+	_weights.clear();
+	_means.clear();
+	_covariances.clear();
+	std::string weight_str;
+	std::string means_str;
+	std::string covariances_str;
+	for(std::size_t k = 0; k < num_components; ++k){
+		std::getline(in, line);
+		std::tie(weight_str, line) = utils::split_first(line, global_config::kProbabilitySeparator);
+		std::tie(means_str, covariances_str) = utils::split_first(line, global_config::kProbabilitySeparator);
+		_weights.push_back(std::stod(weight_str));
+		__load_values(means_str, _means);
+		__load_values(covariances_str, _covariances);
+	}
+	_precompute();
+}
+
+double GaussianMixtureDistribution::log_pdf(double x) const {
+	if(_dimension != 1) throw std::invalid_argument(error_message::kDistributionNotUnivariate);
+	double log_density;
+	log_pdf(&x, 1, &log_density);
+	return log_density;
+}
+
+void GaussianMixtureDistribution::log_pdf(const double* x, std::size_t n, double* out) const {
+	_log_pdf(x, n, out, nullptr);
+}
+
+void GaussianMixtureDistribution::log_component_pdf(const double* x, std::size_t n, double* out) const {
+	std::vector<double> log_densities(n);
+	_log_pdf(x, n, log_densities.data(), out);
+}
+
+void GaussianMixtureDistribution::_log_pdf(const double* x, std::size_t n, double* out, double* components_out) const {
+	const std::size_t dimension = _dimension;
+	const std::size_t num_components = _weights.size();
+	const std::size_t block_size = std::min(n, distribution_config::kGaussianMixtureBlockSize);
+	/* The observations are processed by blocks, transposed to [value][step] so that the inner loops run over the 
+	steps of the block with contiguous accesses and without reductions, run by the kernels of the instruction set of 
+	the processor. A block and the parameters of a component stay in cache while the component is evaluated at every 
+	step of the block. */
+	const cpu_dispatch::Kernels& kernels = cpu_dispatch::kernels();
+	std::vector<double> frames(dimension * block_size);
+	std::vector<double> residuals((_full_covariance) ? dimension * block_size : 0);
+	std::vector<double> components(num_components * block_size);
+	std::vector<double> max_component(block_size);
+	std::vector<double> sum(block_size);
+	for(std::size_t begin = 0; begin < n; begin += block_size){
+		const std::size_t m = std::min(block_size, n - begin);
+		const double* block = x + begin * dimension;
+		for(std::size_t t = 0; t < m; ++t){
+			for(std::size_t d = 0; d < dimension; ++d){
+				frames[d * block_size + t] = block[t * dimension + d];
+			}
+		}
+		for(std::size_t k = 0; k < num_components; ++k){
+			const double* mean = _means.data() + k * dimension;
+			/* Mahalanobis distances, accumulated in the component log densities. */
+			double* quadratic = components.data() + k * block_size;
+			std::fill(quadratic, quadratic + m, 0.0);
+			if(_full_covariance){
+				/* Solves L * y = x - mean by forward substitution, the distance being |y|^2. */
+				const double* factor = _precisions.data() + k * dimension * dimension;
+				for(std::size_t i = 0; i < dimension; ++i){
+					double* y_i = residuals.data() + i * block_size;
+					const double* x_i = frames.data() + i * block_size;
+					kernels.subtract(x_i, m, mean[i], y_i);
+					for(std::size_t j = 0; j < i; ++j){
+						kernels.subtract_scaled(residuals.data() + j * block_size, m, factor[i * dimension + j], y_i);
+					}
+					kernels.scale_add_squares(y_i, m, factor[i * dimension + i], quadratic);
+				}
+			}
+			else{
+				const double* precision = _precisions.data() + k * dimension;
+				for(std::size_t d = 0; d < dimension; ++d){
+					kernels.add_squared_distances(frames.data() + d * block_size, m, mean[d], precision[d], quadratic);
+				}
+			}
+			kernels.log_densities(quadratic, m, _log_constants[k]);
+		}
+		if(components_out != nullptr){
+			for(std::size_t t = 0; t < m; ++t){
+				for(std::size_t k = 0; k < num_components; ++k){
+					components_out[(begin + t) * num_components + k] = components[k * block_size + t];
+				}
+			}
+		}
+		/* Log sum of the components, relative to their max. */
+		std::fill(max_component.data(), max_component.data() + m, utils::kNegInf);
+		std::fill(sum.data(), sum.data() + m, 0.0);
+		for(std::size_t k = 0; k < num_components; ++k){
+			const double* component = components.data() + k * block_size;
+			for(std::size_t t = 0; t < m; ++t){
+				max_component[t] = std::max(max_component[t], component[t]);
+			}
+		}
+		for(std::size_t k = 0; k < num_components; ++k){
+			const double* component = components.data() + k * block_size;
+			for(std::size_t t = 0; t < m; ++t){
+				sum[t] += exp(component[t] - max_component[t]);
+			}
+		}
+		for(std::size_t t = 0; t < m; ++t){
+			out[begin + t] = (max_component[t] == utils::kNegInf) ? utils::kNegInf : max_component[t] + log(sum[t]);
+		}
+	}
+}
+
+bool GaussianMixtureDistribution::operator==(const Distribution& other) const {
+	if(other.is_continuous() && static_cast<const ContinuousDistribution&>(other).is_gaussian_mixture()){
+		const GaussianMixtureDistribution& mixture = static_cast<const GaussianMixtureDistribution&>(other);
+		return uses_log_probabilities() == mixture.uses_log_probabilities() && _dimension == mixture._dimension && 
+			_full_covariance == mixture._full_covariance && _weights == mixture._weights && 
+			_means == mixture._means && _covariances == mixture._covariances;
+	}
+	return false;
+}
+
+bool GaussianMixtureDistribution::operator!=(const Distribution& other) const {
+	return ! operator==(other);
+}
+
+GaussianMixtureDistribution::~GaussianMixtureDistribution() {}
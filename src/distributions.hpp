@@ -7,6 +7,7 @@
 #include <numeric>
 #include <functional>
 #include <fstream>
+#include <vector>
 #include "constants.hpp"
 #include "utils.hpp"
 
@@ -107,6 +108,10 @@ public:
 
 
 class ContinuousDistribution : public Distribution {
+private:
+	/* Value referenced by operator[]. */
+	double _density;
+
 protected:
 	ContinuousDistribution(const std::string&);
 
@@ -116,21 +121,124 @@ public:
 	bool is_continuous() const;
 	virtual bool is_normal() const;
 	virtual bool is_uniform() const;
+	virtual bool is_gaussian_mixture() const;
+	/* Number of values of an observation, 1 for univariate distributions. */
+	virtual std::size_t dimension() const;
+	/* Log of the density at x. */
+	virtual double log_pdf(double x) const = 0;
+	/* Logs of the densities at the n observations of dimension() values stored row-major from x, written in out[0], 
+	..., out[n - 1]. */
+	virtual void log_pdf(const double* x, std::size_t n, double* out) const;
+	double pdf(double x) const;
+	/* Density (or its log if the distribution uses log probabilities) at the value given as a number or as a 
+	string, e.g. "1.5". The returned reference is not a parameter of the distribution. */
+	double& operator[] (const std::string& symbol);
+	double& operator[] (double x);
+	/* Densities integrate to 1, nothing to do. */
+	void log_normalize();
 	virtual ~ContinuousDistribution();
 };
 
 class NormalDistribution : public ContinuousDistribution {
+private:
+	double _mean;
+	double _standard_deviation;
 public:
 	NormalDistribution();
+	NormalDistribution(double mean, double standard_deviation);
+	NormalDistribution(const NormalDistribution&);
+
+	/* Covariant return type */
+	virtual NormalDistribution* clone() const;
+
+	double mean() const;
+	double standard_deviation() const;
 	bool is_normal() const;
+	bool empty() const;
+	std::string to_string() const;
+	void save(std::ofstream& out);
+	void load(std::ifstream& in);
+	double log_pdf(double x) const;
+	void log_pdf(const double* x, std::size_t n, double* out) const;
+	bool operator==(const Distribution& other) const;
+	bool operator!=(const Distribution& other) const;
 	virtual ~NormalDistribution();
 };
 
 class UniformDistribution : public ContinuousDistribution {
+private:
+	double _lower_bound;
+	double _upper_bound;
 public:
 	UniformDistribution();
+	UniformDistribution(double lower_bound, double upper_bound);
+	UniformDistribution(const UniformDistribution&);
+
+	/* Covariant return type */
+	virtual UniformDistribution* clone() const;
+
+	double lower_bound() const;
+	double upper_bound() const;
 	bool is_uniform() const;
+	bool empty() const;
+	std::string to_string() const;
+	void save(std::ofstream& out);
+	void load(std::ifstream& in);
+	double log_pdf(double x) const;
+	void log_pdf(const double* x, std::size_t n, double* out) const;
+	bool operator==(const Distribution& other) const;
+	bool operator!=(const Distribution& other) const;
 	virtual ~UniformDistribution();
 };
 
+/* Mixture of num_components() multivariate normal distributions over observations of dimension() values. The 
+parameters are stored row-major, one row per component : the means have dimension() values per component and the 
+covariances either dimension() values (diagonal covariances, the default) or dimension() * dimension() values (full 
+covariances). The weights are expected to sum to 1. */
+class GaussianMixtureDistribution : public ContinuousDistribution {
+private:
+	std::size_t _dimension;
+	bool _full_covariance;
+	std::vector<double> _weights;
+	std::vector<double> _means;
+	std::vector<double> _covariances;
+	/* Derived from the parameters by _precompute() : the log of the weight times the normalization of each component, 
+	and the inverses of the variances (diagonal covariances) or the lower Cholesky factors with inverted diagonal (full 
+	covariances) of the components. */
+	std::vector<double> _log_constants;
+	std::vector<double> _precisions;
+	void _precompute();
+	/* log_pdf, also writing the log densities of the weighted components to components_out if not null. */
+	void _log_pdf(const double* x, std::size_t n, double* out, double* components_out) const;
+public:
+	GaussianMixtureDistribution();
+	GaussianMixtureDistribution(std::size_t dimension, const std::vector<double>& weights, const std::vector<double>& means, 
+		const std::vector<double>& covariances, bool full_covariance = false);
+	GaussianMixtureDistribution(const GaussianMixtureDistribution&);
+
+	/* Covariant return type */
+	virtual GaussianMixtureDistribution* clone() const;
+
+	std::size_t dimension() const;
+	std::size_t num_components() const;
+	bool has_full_covariance() const;
+	const std::vector<double>& weights() const;
+	const std::vector<double>& means() const;
+	const std::vector<double>& covariances() const;
+	bool is_gaussian_mixture() const;
+	bool empty() const;
+	std::string to_string() const;
+	void save(std::ofstream& out);
+	void load(std::ifstream& in);
+	/* Only for mixtures of dimension 1. */
+	double log_pdf(double x) const;
+	void log_pdf(const double* x, std::size_t n, double* out) const;
+	/* Logs of the weighted densities of the components at the n observations stored row-major from x, written 
+	row-major in out : out[t * num_components() + k] for observation t and component k. */
+	void log_component_pdf(const double* x, std::size_t n, double* out) const;
+	bool operator==(const Distribution& other) const;
+	bool operator!=(const Distribution& other) const;
+	virtual ~GaussianMixtureDistribution();
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,34 @@
+#include <vector>
+#include <string>
+#include "distributions.hpp"
+#include "hmm_base.hpp"
+#include "fixed_size_model.hpp"
+
+/* The alphabet size is rounded up to the next bucket to keep the number of specializations small. */
+template<std::size_t N>
+FixedSizeEngine* __make_fixed_size_engine(const RawModel& model) {
+	std::size_t alphabet_size = model.alphabet.size();
+	if(alphabet_size <= 2) return new FixedSizeModel<N, 2>(model);
+	if(alphabet_size <= 4) return new FixedSizeModel<N, 4>(model);
+	if(alphabet_size <= 8) return new FixedSizeModel<N, 8>(model);
+	if(alphabet_size <= 16) return new FixedSizeModel<N, 16>(model);
+	return nullptr;
+}
+
+FixedSizeEngine* make_fixed_size_engine(const RawModel& model) {
+	if(model.silent_states_index != model.A.size()) return nullptr;
+	for(const Distribution* distribution : model.B){
+		if(distribution == nullptr || ! distribution->is_discrete()) return nullptr;
+	}
+	switch(model.A.size()){
+		case 1: return __make_fixed_size_engine<1>(model);
+		case 2: return __make_fixed_size_engine<2>(model);
+		case 3: return __make_fixed_size_engine<3>(model);
+		case 4: return __make_fixed_size_engine<4>(model);
+		case 5: return __make_fixed_size_engine<5>(model);
+		case 6: return __make_fixed_size_engine<6>(model);
+		case 7: return __make_fixed_size_engine<7>(model);
+		case 8: return __make_fixed_size_engine<8>(model);
+		default: return nullptr;
+	}
+}
@@ -0,0 +1,259 @@
+#ifndef __FIXED_SIZE_MODEL_HPP
+#define __FIXED_SIZE_MODEL_HPP
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <utility>	// std::pair
+#include <algorithm>	// std::min, std::copy
+#include <stdexcept>
+#include "distributions.hpp"
+#include "hmm_base.hpp"
+#include "utils.hpp"
+#include "instrumentation.hpp"
+
+/* Forward, backward and Viterbi on a brewed RawModel whose number of states and alphabet size are known at
+compile time. Only built for small models without silent states (see make_fixed_size_engine). Results are
+the same as the ones of the linear memory algorithms, the recursions being done in the same order. */
+class FixedSizeEngine {
+public:
+	virtual std::size_t num_states() const = 0;
+	/* Same parameters and results as the ForwardAlgorithm and BackwardAlgorithm methods. */
+	virtual std::vector<double> forward(const std::vector<std::string>& sequence, std::size_t t_max) const = 0;
+	virtual std::vector<double> backward(const std::vector<std::string>& sequence, std::size_t t_min) const = 0;
+	virtual double forward_log_likelihood(const std::vector<std::string>& sequence) const = 0;
+	virtual double backward_log_likelihood(const std::vector<std::string>& sequence) const = 0;
+	/* Same as LinearMemoryViterbiDecodingAlgorithm::decode_indices. */
+	virtual std::pair<std::vector<std::size_t>, double> decode_indices(const std::vector<std::string>& sequence, std::size_t t_max) const = 0;
+	virtual ~FixedSizeEngine() {}
+};
+
+/* N states, at most K symbols. The loops have compile-time bounds and the recursion vectors live on the
+stack so that the compiler can unroll them and keep them in registers. */
+template<std::size_t N, std::size_t K>
+class FixedSizeModel : public FixedSizeEngine {
+private:
+	/* Log probabilities. The last column of _B holds the emissions of the symbols out of the alphabet. */
+	double _A[N][N];
+	double _B[N][K + 1];
+	double _pi_begin[N];
+	double _pi_end[N];
+	bool _is_finite;
+	/* Column of each symbol in _B. */
+	std::unordered_map<std::string, std::size_t> _symbols;
+
+	std::size_t _symbol(const std::string& symbol) const;
+	/* Columns of the symbols of sequence in [begin, end), looked up once before the recursions. */
+	std::vector<std::size_t> _symbols_indices(const std::vector<std::string>& sequence, std::size_t begin, std::size_t end) const;
+	/* Fill alpha (resp. beta) with the forward (resp. backward) values at t_max (resp. t_min). */
+	void _forward(const std::vector<std::string>& sequence, std::size_t t_max, double* alpha) const;
+	void _backward(const std::vector<std::string>& sequence, std::size_t t_min, double* beta) const;
+
+public:
+	explicit FixedSizeModel(const RawModel& model);
+	std::size_t num_states() const;
+	std::vector<double> forward(const std::vector<std::string>& sequence, std::size_t t_max) const;
+	std::vector<double> backward(const std::vector<std::string>& sequence, std::size_t t_min) const;
+	double forward_log_likelihood(const std::vector<std::string>& sequence) const;
+	double backward_log_likelihood(const std::vector<std::string>& sequence) const;
+	std::pair<std::vector<std::size_t>, double> decode_indices(const std::vector<std::string>& sequence, std::size_t t_max) const;
+	~FixedSizeModel() {}
+};
+
+/* Returns the specialization matching the sizes of the given brewed model, or nullptr if there is none
+(silent states, non discrete distributions, more than 8 states or more than 16 symbols). The caller owns
+the returned engine, which does not reference the model. */
+FixedSizeEngine* make_fixed_size_engine(const RawModel& model);
+
+
+template<std::size_t N, std::size_t K>
+FixedSizeModel<N, K>::FixedSizeModel(const RawModel& model) :
+	FixedSizeEngine(), _A(), _B(), _pi_begin(), _pi_end(), _is_finite(model.is_finite), _symbols() {
+		for(std::size_t k = 0; k < model.alphabet.size(); ++k){
+			_symbols[model.alphabet[k]] = k;
+		}
+		for(std::size_t i = 0; i < N; ++i){
+			_pi_begin[i] = model.pi_begin[i];
+			_pi_end[i] = model.pi_end[i];
+			for(std::size_t j = 0; j < N; ++j){
+				_A[i][j] = model.A[i][j];
+			}
+			DiscreteDistribution* distribution = static_cast<DiscreteDistribution*>(model.B[i]);
+			for(std::size_t k = 0; k <= K; ++k){
+				_B[i][k] = (k < model.alphabet.size() && distribution->contains(model.alphabet[k])) ?
+					(*distribution)[model.alphabet[k]] : utils::kNegInf;
+			}
+		}
+	}
+
+template<std::size_t N, std::size_t K>
+std::size_t FixedSizeModel<N, K>::num_states() const { return N; }
+
+template<std::size_t N, std::size_t K>
+std::size_t FixedSizeModel<N, K>::_symbol(const std::string& symbol) const {
+	std::unordered_map<std::string, std::size_t>::const_iterator it = _symbols.find(symbol);
+	return (it == _symbols.end()) ? K : it->second;
+}
+
+template<std::size_t N, std::size_t K>
+std::vector<std::size_t> FixedSizeModel<N, K>::_symbols_indices(const std::vector<std::string>& sequence, std::size_t begin, std::size_t end) const {
+	std::vector<std::size_t> indices(end - begin);
+	for(std::size_t t = begin; t < end; ++t){
+		indices[t - begin] = _symbol(sequence[t]);
+	}
+	return indices;
+}
+
+template<std::size_t N, std::size_t K>
+void FixedSizeModel<N, K>::_forward(const std::vector<std::string>& sequence, std::size_t t_max, double* alpha) const {
+	if(t_max == 0) t_max = sequence.size();
+	if(sequence.size() == 0) throw std::logic_error("forward on empty sequence");
+	std::size_t T = std::min(sequence.size(), t_max);
+	std::vector<std::size_t> symbols = _symbols_indices(sequence, 0, T);
+	instrumentation::PhaseTimer timer(instrumentation::kForwardInit);
+	instrumentation::count(instrumentation::kCells, N * T);
+	for(std::size_t i = 0; i < N; ++i){
+		alpha[i] = _pi_begin[i] + _B[i][symbols[0]];
+	}
+	timer.next(instrumentation::kForwardStep);
+	double alpha_prev_t[N];
+	for(std::size_t t = 1; t < T; ++t){
+		std::size_t symbol = symbols[t];
+		std::copy(alpha, alpha + N, alpha_prev_t);
+		for(std::size_t i = 0; i < N; ++i){
+			double alpha_t_i = utils::kNegInf;
+			for(std::size_t j = 0; j < N; ++j){
+				alpha_t_i = utils::sum_log_prob(alpha_t_i, alpha_prev_t[j] + _A[j][i]);
+			}
+			alpha[i] = alpha_t_i + _B[i][symbol];
+		}
+	}
+}
+
+template<std::size_t N, std::size_t K>
+void FixedSizeModel<N, K>::_backward(const std::vector<std::string>& sequence, std::size_t t_min, double* beta) const {
+	if(t_min > 0) --t_min;
+	if(sequence.size() == 0) throw std::runtime_error("backward on empty sequence");
+	/* symbols[t - t_min] is the column of sequence[t]. */
+	t_min = std::min(t_min, sequence.size() - 1);
+	std::vector<std::size_t> symbols = _symbols_indices(sequence, t_min, sequence.size());
+	instrumentation::PhaseTimer timer(instrumentation::kBackwardInit);
+	instrumentation::count(instrumentation::kCells, N * (sequence.size() - t_min));
+	for(std::size_t i = 0; i < N; ++i){
+		beta[i] = (_is_finite) ? _pi_end[i] : 0.0;
+	}
+	timer.next(instrumentation::kBackwardStep);
+	double beta_previous_t[N];
+	for(std::size_t t = sequence.size() - 2; t >= t_min && t < sequence.size(); --t){
+		std::size_t symbol = symbols[t + 1 - t_min];
+		std::copy(beta, beta + N, beta_previous_t);
+		for(std::size_t i = 0; i < N; ++i){
+			double beta_t_i = utils::kNegInf;
+			for(std::size_t j = 0; j < N; ++j){
+				beta_t_i = utils::sum_log_prob(beta_t_i, beta_previous_t[j] + _A[i][j] + _B[j][symbol]);
+			}
+			beta[i] = beta_t_i;
+		}
+	}
+}
+
+template<std::size_t N, std::size_t K>
+std::vector<double> FixedSizeModel<N, K>::forward(const std::vector<std::string>& sequence, std::size_t t_max) const {
+	double alpha[N];
+	_forward(sequence, t_max, alpha);
+	return std::vector<double>(alpha, alpha + N);
+}
+
+template<std::size_t N, std::size_t K>
+std::vector<double> FixedSizeModel<N, K>::backward(const std::vector<std::string>& sequence, std::size_t t_min) const {
+	double beta[N];
+	_backward(sequence, t_min, beta);
+	return std::vector<double>(beta, beta + N);
+}
+
+template<std::size_t N, std::size_t K>
+double FixedSizeModel<N, K>::forward_log_likelihood(const std::vector<std::string>& sequence) const {
+	double alpha[N];
+	_forward(sequence, sequence.size(), alpha);
+	instrumentation::PhaseTimer timer(instrumentation::kForwardTerminate);
+	double log_prob = utils::kNegInf;
+	for(std::size_t i = 0; i < N; ++i){
+		log_prob = utils::sum_log_prob(log_prob, (_is_finite) ? alpha[i] + _pi_end[i] : alpha[i]);
+	}
+	return log_prob;
+}
+
+template<std::size_t N, std::size_t K>
+double FixedSizeModel<N, K>::backward_log_likelihood(const std::vector<std::string>& sequence) const {
+	double beta[N];
+	_backward(sequence, 0, beta);
+	instrumentation::PhaseTimer timer(instrumentation::kBackwardTerminate);
+	std::size_t symbol = _symbol(sequence[0]);
+	double log_prob = utils::kNegInf;
+	for(std::size_t i = 0; i < N; ++i){
+		log_prob = utils::sum_log_prob(log_prob, _pi_begin[i] + _B[i][symbol] + beta[i]);
+	}
+	return log_prob;
+}
+
+template<std::size_t N, std::size_t K>
+std::pair<std::vector<std::size_t>, double> FixedSizeModel<N, K>::decode_indices(const std::vector<std::string>& sequence, std::size_t t_max) const {
+	if(t_max == 0) t_max = sequence.size();
+	if(sequence.size() == 0) throw std::logic_error("viterbi on empty sequence");
+	std::size_t T = std::min(sequence.size(), t_max);
+	std::vector<std::size_t> symbols = _symbols_indices(sequence, 0, T);
+	instrumentation::PhaseTimer timer(instrumentation::kViterbiInit);
+	instrumentation::count(instrumentation::kCells, N * T);
+	/* Best predecessor of each state at each step, N being no predecessor. */
+	std::vector<unsigned char> psi(T * N, static_cast<unsigned char>(N));
+	double phi[N];
+	double phi_prev_t[N];
+	for(std::size_t i = 0; i < N; ++i){
+		phi[i] = (_pi_begin[i] != utils::kNegInf) ? _pi_begin[i] + _B[i][symbols[0]] : utils::kNegInf;
+	}
+	timer.next(instrumentation::kViterbiStep);
+	for(std::size_t t = 1; t < T; ++t){
+		std::size_t symbol = symbols[t];
+		std::copy(phi, phi + N, phi_prev_t);
+		for(std::size_t i = 0; i < N; ++i){
+			double max_phi = utils::kNegInf;
+			std::size_t max_psi = N;
+			for(std::size_t j = 0; j < N; ++j){
+				double current_phi = phi_prev_t[j] + _A[j][i];
+				if(current_phi > max_phi){
+					max_phi = current_phi;
+					max_psi = j;
+				}
+			}
+			if(max_phi != utils::kNegInf && max_psi != N){
+				phi[i] = max_phi + _B[i][symbol];
+				psi[t * N + i] = static_cast<unsigned char>(max_psi);
+			}
+			else{
+				phi[i] = utils::kNegInf;
+			}
+		}
+	}
+	timer.next(instrumentation::kViterbiTerminate);
+	double max_phi_T = utils::kNegInf;
+	std::size_t max_state_index = N;
+	for(std::size_t i = 0; i < N; ++i){
+		if(_is_finite) phi[i] = phi[i] + _pi_end[i];
+		if(phi[i] > max_phi_T){
+			max_phi_T = phi[i];
+			max_state_index = i;
+		}
+	}
+	if(max_state_index == N){
+		/* Sequence is impossible. */
+		return std::make_pair(std::vector<std::size_t>(), utils::kNegInf);
+	}
+	std::vector<std::size_t> path(T);
+	path[T - 1] = max_state_index;
+	for(std::size_t t = T - 1; t > 0; --t){
+		path[t - 1] = psi[t * N + path[t]];
+	}
+	return std::make_pair(path, max_phi_T);
+}
+
+#endif
@@ -6,8 +6,12 @@
 #include <algorithm> // std::find, std::remove, std::remove_if
 #include <vector>
 #include <queue>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional> // std::hash
 #include <string>
-#include <utility> // std::pair
+#include <utility> // std::pair, std::forward
+#include <new> // placement new
 #include "constants.hpp"
 
 /* <-------- Exceptions --------> */
@@ -67,62 +71,151 @@ public:
 
 /* <----------------------------> */
 
-template<typename VertexElementBase>
-class Edge{
-	const VertexElementBase * const _from;
-	const VertexElementBase * const _to;
-	std::string _label;
-	
-	double* _weight;
-
-public:
-	explicit Edge(const VertexElementBase& from, const VertexElementBase& to, double weight) :
-		_from(&from), _to(&to), _label(""), _weight(new double(weight)) {}
+/* Chunked storage for the graph elements. Elements are constructed in place in fixed size chunks, 
+so that their addresses and ids stay valid until they are erased. The ids of erased elements are reused. */
+template<typename T>
+class Arena{
+	static const std::size_t kChunkSize = 32;
 
-	explicit Edge(const VertexElementBase& from, const VertexElementBase& to, const std::string& label = "") :
-		_from(&from), _to(&to), _label(label), _weight(nullptr) {}
+	std::vector<T*> _chunks;
+	std::vector<bool> _live;
+	std::vector<std::size_t> _free_ids;
 
-	explicit Edge(const VertexElementBase& from, const VertexElementBase& to, const std::string& label, double weight) :
-		_from(&from), _to(&to), _label(label), _weight(new double(weight)) {}
+	void _allocate_chunks(std::size_t num_elements){
+		while(_chunks.size() * kChunkSize < num_elements){
+			_chunks.reserve(_chunks.size() + 1);
+			_chunks.push_back(static_cast<T*>(::operator new(sizeof(T) * kChunkSize)));
+		}
+	}
 
+	void _destroy(){
+		for(std::size_t id = 0; id < _live.size(); ++id){
+			if(_live[id]) at(id)->~T();
+		}
+		for(T* chunk : _chunks) ::operator delete(chunk);
+		_chunks.clear();
+		_live.clear();
+		_free_ids.clear();
+	}
 
-	Edge(const Edge<VertexElementBase>& other) : _from(other._from), _to(other._to), _label(other._label), _weight(nullptr) {
-		if(other._weight != nullptr) {
-			_weight = new double(*other._weight);
+public:
+	Arena() : _chunks(), _live(), _free_ids() {}
+
+	/* Copies the live elements at the same ids. */
+	Arena(const Arena<T>& other) : _chunks(), _live(), _free_ids(other._free_ids) {
+		_allocate_chunks(other._live.size());
+		_live.reserve(other._live.size());
+		try{
+			for(std::size_t id = 0; id < other._live.size(); ++id){
+				if(other._live[id]) new (at(id)) T(*other.at(id));
+				_live.push_back(other._live[id]);
+			}
+		}
+		catch(...){
+			_destroy();
+			throw;
 		}
 	}
 
-	Edge(Edge<VertexElementBase>&& other) : _from(other._from), _to(other._to), _label(other._label), _weight(other._weight) {
-		other._weight = nullptr;
+	Arena(Arena<T>&& other) : _chunks(std::move(other._chunks)), _live(std::move(other._live)), _free_ids(std::move(other._free_ids)) {
+		other._chunks.clear(); other._live.clear(); other._free_ids.clear();
 	}
 
-	Edge<VertexElementBase>& operator=(const Edge<VertexElementBase>& other){
+	Arena<T>& operator=(const Arena<T>& other){
 		if(this != &other){
-			if(_weight != nullptr){
-				delete _weight;
-				_weight = nullptr;
-			}
-			_from = other._from; _to = other._to;
-			_label = other._label;
-			if(other._weight != nullptr){
-				_weight = new double(*other._weight);
-			}
+			Arena<T> copy(other);
+			*this = std::move(copy);
 		}
 		return *this;
 	}
 
-	Edge<VertexElementBase>& operator=(Edge<VertexElementBase>&& other){
-		if(this != other){
-			if(_weight != nullptr){
-				delete _weight;
-			}
-			_from = other._from; _to = other._to;
-			_label = other._label; _weight = other._weight;
-			other._weight = nullptr;
+	Arena<T>& operator=(Arena<T>&& other){
+		if(this != &other){
+			_destroy();
+			_chunks = std::move(other._chunks);
+			_live = std::move(other._live);
+			_free_ids = std::move(other._free_ids);
+			other._chunks.clear(); other._live.clear(); other._free_ids.clear();
 		}
 		return *this;
 	}
 
+	/* Upper bound (exclusive) on the ids of the live elements. */
+	std::size_t capacity() const { return _live.size(); }
+	bool live(std::size_t id) const { return id < _live.size() && _live[id]; }
+	T* at(std::size_t id) const { return _chunks[id / kChunkSize] + id % kChunkSize; }
+
+	void reserve(std::size_t num_elements){
+		_allocate_chunks(num_elements);
+		_live.reserve(num_elements);
+	}
+
+	/* Constructs a new element and returns its id. */
+	template<typename... Args>
+	std::size_t emplace(Args&&... args){
+		if(! _free_ids.empty()){
+			std::size_t id = _free_ids.back();
+			new (at(id)) T(std::forward<Args>(args)...);
+			_free_ids.pop_back();
+			_live[id] = true;
+			return id;
+		}
+		std::size_t id = _live.size();
+		_allocate_chunks(id + 1);
+		_live.reserve(id + 1);
+		new (at(id)) T(std::forward<Args>(args)...);
+		_live.push_back(true);
+		return id;
+	}
+
+	void erase(std::size_t id){
+		at(id)->~T();
+		_live[id] = false;
+		_free_ids.push_back(id);
+	}
+
+	void clear(){
+		_destroy();
+	}
+
+	virtual ~Arena(){
+		_destroy();
+	}
+};
+
+template<typename VertexElementBase>
+class Graph;
+
+template<typename VertexElementBase>
+class Edge{
+	friend class Graph<VertexElementBase>;
+
+	const VertexElementBase* _from;
+	const VertexElementBase* _to;
+	std::string _label;
+	
+	/* The weight is stored inline, _weighted tells whether it was set. */
+	double _weight;
+	bool _weighted;
+
+	/* Used by the graph when the vertices are copied. */
+	void _rebind(const VertexElementBase* from, const VertexElementBase* to) { _from = from; _to = to; }
+
+public:
+	explicit Edge(const VertexElementBase& from, const VertexElementBase& to, double weight) :
+		_from(&from), _to(&to), _label(""), _weight(weight), _weighted(true) {}
+
+	explicit Edge(const VertexElementBase& from, const VertexElementBase& to, const std::string& label = "") :
+		_from(&from), _to(&to), _label(label), _weight(0), _weighted(false) {}
+
+	explicit Edge(const VertexElementBase& from, const VertexElementBase& to, const std::string& label, double weight) :
+		_from(&from), _to(&to), _label(label), _weight(weight), _weighted(true) {}
+
+	Edge(const Edge<VertexElementBase>& other) = default;
+	Edge(Edge<VertexElementBase>&& other) = default;
+	Edge<VertexElementBase>& operator=(const Edge<VertexElementBase>& other) = default;
+	Edge<VertexElementBase>& operator=(Edge<VertexElementBase>&& other) = default;
+
 	inline bool operator==(const Edge& other) const {
 		return (*_from == *(other.from())) && (*_to == *(other.to()));
 	}
@@ -142,23 +235,18 @@ public:
 	const VertexElementBase* from() const { return _from; }
 	const VertexElementBase* to() const { return _to; }
 	std::string label() const { return _label; }
-	double* weight() const { 
-		return _weight;
+	/* Returns a pointer to the weight or nullptr if the edge has no weight. */
+	const double* weight() const { 
+		return _weighted ? &_weight : nullptr;
 	}
 
 	void set_label(const std::string& label) { _label = label; }
 	void set_weight(double weight) { 
-		if(_weight == nullptr){
-			_weight = new double;
-		}
-		*(_weight) = weight;
+		_weight = weight;
+		_weighted = true;
 	}
 
-	virtual ~Edge(){
-		if(_weight != nullptr){
-			delete _weight;
-		}
-	}
+	virtual ~Edge() {}
 };
 
 template<typename VertexElementBase>
@@ -167,44 +255,141 @@ std::ostream& operator<<(std::ostream& out, const Edge<VertexElementBase>& edge)
 	return out;
 }
 
+/* The vertices and edges are stored in arenas and identified by their (stable) arena ids. The order 
+of the vertices and edges is kept apart, as well as the adjacency lists which hold edges ids. */
 template<typename VertexElementBase>
 class Graph{
-	std::vector<VertexElementBase*> _vertices;
-	std::vector<Edge<VertexElementBase>*> _edges;
+	/* Hash and equality on the pointed vertices, so that the index can be queried 
+	with the address of any vertex equal to a stored one. */
+	struct _VertexHash {
+		std::size_t operator()(const VertexElementBase* vertex) const {
+			return std::hash<VertexElementBase>()(*vertex);
+		}
+	};
+	struct _VertexEqual {
+		bool operator()(const VertexElementBase* first, const VertexElementBase* second) const {
+			return *first == *second;
+		}
+	};
+
+	Arena<VertexElementBase> _vertex_store;
+	Arena<Edge<VertexElementBase>> _edge_store;
+	/* Ids of the vertices and of the edges, in order. */
+	std::vector<std::size_t> _vertices;
+	std::vector<std::size_t> _edges;
+	/* Ids of the from and to vertices of each edge, indexed by edge id. */
+	std::vector<std::pair<std::size_t, std::size_t>> _edge_ends;
+	/* Maps each vertex to its id. */
+	std::unordered_map<const VertexElementBase*, std::size_t, _VertexHash, _VertexEqual> _ids;
+	/* Out and in edges ids of each vertex, indexed by vertex id. */
+	std::vector<std::vector<std::size_t>> _out_edges;
+	std::vector<std::vector<std::size_t>> _in_edges;
+
+	static const std::size_t npos = static_cast<std::size_t>(-1);
+
+	/* Returns the id of the given vertex or npos if it is not contained by the graph. */
+	std::size_t _id(const VertexElementBase& vertex) const {
+		typename std::unordered_map<const VertexElementBase*, std::size_t, _VertexHash, _VertexEqual>::const_iterator it;
+		if((it = _ids.find(&vertex)) != _ids.end()) return it->second;
+		return npos;
+	}
+
+	VertexElementBase* _vertex(std::size_t id) const { return _vertex_store.at(id); }
+	Edge<VertexElementBase>* _edge(std::size_t id) const { return _edge_store.at(id); }
+
+	/* Returns the id of the edge between the given vertices ids or npos if there is none. 
+	Only the shortest of the from out edges and the to in edges is scanned. */
+	std::size_t _find_edge(std::size_t from_id, std::size_t to_id) const {
+		if(_out_edges[from_id].size() <= _in_edges[to_id].size()){
+			for(std::size_t edge_id : _out_edges[from_id]){
+				if(_edge_ends[edge_id].second == to_id) return edge_id;
+			}
+		}
+		else{
+			for(std::size_t edge_id : _in_edges[to_id]){
+				if(_edge_ends[edge_id].first == from_id) return edge_id;
+			}
+		}
+		return npos;
+	}
+
+	std::size_t _find_edge(const VertexElementBase& from_vertex, const VertexElementBase& to_vertex) const {
+		std::size_t from_id = _id(from_vertex);
+		std::size_t to_id = _id(to_vertex);
+		if(from_id == npos || to_id == npos) return npos;
+		return _find_edge(from_id, to_id);
+	}
 
-	typename std::vector<VertexElementBase*>::const_iterator _find_vertex(const VertexElementBase& vertex) const {
-		return std::find_if(_vertices.begin(), _vertices.end(),
-							[&vertex](const VertexElementBase* maybe_vertex){
-								return *maybe_vertex == vertex;
-							});
+	/* Removes the given id from the given list. */
+	static void _unlink(std::vector<std::size_t>& ids, std::size_t id){
+		ids.erase(std::remove(ids.begin(), ids.end(), id), ids.end());
 	}
 
-	typename std::vector<Edge<VertexElementBase>*>::const_iterator _find_edge(const Edge<VertexElementBase>& edge) const {
-		return std::find_if(_edges.begin(), _edges.end(),
-							[&edge](const Edge<VertexElementBase>* maybe_edge){
-								return *maybe_edge == edge;
-							});
+	/* Rebuilds the vertices index. */
+	void _reindex(){
+		_ids.clear();
+		_ids.reserve(_vertices.size());
+		for(std::size_t id : _vertices){
+			_ids.emplace(_vertex(id), id);
+		}
+	}
+
+	/* Stores a copy of the given edge between the vertices with given ids. Does not check whether the edge exists. */
+	std::size_t _link(std::size_t from_id, std::size_t to_id, const Edge<VertexElementBase>& edge){
+		_edges.reserve(_edges.size() + 1);
+		_out_edges[from_id].reserve(_out_edges[from_id].size() + 1);
+		_in_edges[to_id].reserve(_in_edges[to_id].size() + 1);
+		_edge_ends.reserve(_edge_store.capacity() + 1);
+		std::size_t edge_id = _edge_store.emplace(edge);
+		_edge(edge_id)->_rebind(_vertex(from_id), _vertex(to_id));
+		if(edge_id == _edge_ends.size()) _edge_ends.push_back(std::make_pair(from_id, to_id));
+		else _edge_ends[edge_id] = std::make_pair(from_id, to_id);
+		_edges.push_back(edge_id);
+		_out_edges[from_id].push_back(edge_id);
+		_in_edges[to_id].push_back(edge_id);
+		return edge_id;
 	}
 
 	bool _adjacent(const VertexElementBase& first, const VertexElementBase& second) const {
-		return has_edge(Edge<VertexElementBase>(first, second)) || has_edge(Edge<VertexElementBase>(second, first));
+		return has_edge(first, second) || has_edge(second, first);
 	}
 
 	std::vector<VertexElementBase*> _all_vertices() const {
-		return _vertices;
+		std::vector<VertexElementBase*> vertices;
+		vertices.reserve(_vertices.size());
+		for(std::size_t id : _vertices) vertices.push_back(_vertex(id));
+		return vertices;
+	}
+
+	std::vector<Edge<VertexElementBase>*> _to_edges(const std::vector<std::size_t>& edges_ids) const {
+		std::vector<Edge<VertexElementBase>*> edges;
+		edges.reserve(edges_ids.size());
+		for(std::size_t id : edges_ids) edges.push_back(_edge(id));
+		return edges;
 	}
 
 	std::vector<Edge<VertexElementBase>*> _all_edges() const {
-		return _edges;
+		return _to_edges(_edges);
 	}
 
 	/* Adds a vertex if it is not contained by the graph,
-	else throws an exception. */
+	else throws an exception. The vertex is stored as a VertexElementBase. */
 	template<typename VertexElementDerived>
-	void _add_vertex(const VertexElementDerived& vertex){
+	std::size_t _add_vertex(const VertexElementDerived& vertex){
 		if(! has_vertex(vertex)){
-			_vertices.reserve(_vertices.size() + 1); // Avoid memory leak if push_back throws an exception
-			_vertices.push_back(new VertexElementDerived(vertex));
+			// Avoid memory leak if push_back throws an exception
+			_vertices.reserve(_vertices.size() + 1);
+			_out_edges.reserve(_vertex_store.capacity() + 1);
+			_in_edges.reserve(_vertex_store.capacity() + 1);
+			_ids.reserve(_ids.size() + 1);
+			std::size_t id = _vertex_store.emplace(static_cast<const VertexElementBase&>(vertex));
+			_ids.emplace(_vertex(id), id);
+			_vertices.push_back(id);
+			if(id == _out_edges.size()){
+				_out_edges.emplace_back();
+				_in_edges.emplace_back();
+			}
+			return id;
 		}
 		
 		else{
@@ -213,48 +398,49 @@ class Graph{
 	}
 
 	/* Removes a vertex if it is contained by the graph,
-	else throws an exception. */
+	else throws an exception. The order of the remaining vertices is kept. */
 	void _remove_vertex(const VertexElementBase& vertex){
-		if(has_vertex(vertex)){
-			_remove_all_edges(vertex);
-			_vertices.erase(std::remove_if(_vertices.begin(), _vertices.end(), 
-						[&vertex](const VertexElementBase* maybe_vertex){
-							if(vertex == *maybe_vertex){
-								delete maybe_vertex;
-								return true;
-							}
-							return false;
-						}), _vertices.end());
+		std::size_t id = _id(vertex);
+		if(id != npos){
+			_remove_all_edges(id);
+			_ids.erase(_vertex(id));
+			_unlink(_vertices, id);
+			_vertex_store.erase(id);
 		}
 		else{
 			throw VertexNotFoundException<VertexElementBase>(vertex, error_message::kRemoveVertexNotFound);
 		}
 	}
 
-	/* Removes the edges that are incident to the given vertex. */
-	void _remove_all_edges(const VertexElementBase& vertex){
+	/* Removes the edges that are incident to the vertex with given id. */
+	void _remove_all_edges(std::size_t id){
+		std::unordered_set<std::size_t> removed;
+		for(std::size_t edge_id : _out_edges[id]){
+			removed.insert(edge_id);
+			_unlink(_in_edges[_edge_ends[edge_id].second], edge_id);
+		}
+		for(std::size_t edge_id : _in_edges[id]){
+			removed.insert(edge_id);
+			_unlink(_out_edges[_edge_ends[edge_id].first], edge_id);
+		}
+		_out_edges[id].clear();
+		_in_edges[id].clear();
 		_edges.erase(std::remove_if(_edges.begin(), _edges.end(),
-									[&vertex](const Edge<VertexElementBase>* edge){
-										if(edge->incidents(vertex)){
-											delete edge;
-											return true;
-										}
-										return false;
+									[&removed](std::size_t edge_id){
+										return removed.count(edge_id) > 0;
 									}), _edges.end());	
+		for(std::size_t edge_id : removed) _edge_store.erase(edge_id);
 	}
 
 	/* Removes an edge if it is contained by the graph,
 	else throws an exception. */
 	void _remove_edge(const Edge<VertexElementBase>& edge){
-		if(has_edge(edge)){
-			_edges.erase(std::remove_if(_edges.begin(), _edges.end(), 
-						[&edge](const Edge<VertexElementBase>* maybe_edge){
-							if(edge == *maybe_edge){
-								delete maybe_edge;
-								return true;
-							}
-							return false;
-						}), _edges.end());
+		std::size_t edge_id = _find_edge(*(edge.from()), *(edge.to()));
+		if(edge_id != npos){
+			_unlink(_out_edges[_edge_ends[edge_id].first], edge_id);
+			_unlink(_in_edges[_edge_ends[edge_id].second], edge_id);
+			_unlink(_edges, edge_id);
+			_edge_store.erase(edge_id);
 		}
 		else{
 			throw EdgeNotFoundException<Edge<VertexElementBase>>(edge, error_message::kRemoveEdgeNotFound);
@@ -266,15 +452,13 @@ class Graph{
 	If an incident vertex is not contained by the graph, 
 	throws en exception. */
 	void _add_edge(const Edge<VertexElementBase>& edge){
-		typename std::vector<VertexElementBase*>::const_iterator it_from;
-		typename std::vector<VertexElementBase*>::const_iterator it_to;
-		if((it_from = _find_vertex(*(edge.from()))) == _vertices.end()) throw IncidentVertexNotFoundException<VertexElementBase>(*(edge.from()), error_message::kIncidentVertexNotFound);
-		if((it_to = _find_vertex(*(edge.to()))) == _vertices.end()) throw IncidentVertexNotFoundException<VertexElementBase>(*(edge.to()), error_message::kIncidentVertexNotFound);
+		std::size_t from_id = _id(*(edge.from()));
+		std::size_t to_id = _id(*(edge.to()));
+		if(from_id == npos) throw IncidentVertexNotFoundException<VertexElementBase>(*(edge.from()), error_message::kIncidentVertexNotFound);
+		if(to_id == npos) throw IncidentVertexNotFoundException<VertexElementBase>(*(edge.to()), error_message::kIncidentVertexNotFound);
 		
-		if(! has_edge(edge)){
-			_edges.reserve(_edges.size() + 1);
-			(edge.weight() != nullptr) ? _edges.push_back(new Edge<VertexElementBase>(**it_from, **it_to, *edge.weight())) : 
-										 _edges.push_back(new Edge<VertexElementBase>(**it_from, **it_to));
+		if(_find_edge(from_id, to_id) == npos){
+			_link(from_id, to_id, edge);
 		}
 		else{
 			throw EdgeExistsException<Edge<VertexElementBase>>(edge, error_message::kAddedEdgeExists);
@@ -284,14 +468,13 @@ class Graph{
 	/* Returns the successors of the given vertex. Throws an exception if the 
 	given vertex is not contained by the graph. */
 	std::vector<VertexElementBase*> _get_out_vertices(const VertexElementBase& vertex) const {
-		if(has_vertex(vertex)){
+		std::size_t id = _id(vertex);
+		if(id != npos){
 			std::vector<VertexElementBase*> out_vertices;
-			std::for_each(_edges.begin(), _edges.end(),
-							[&vertex, &out_vertices](const Edge<VertexElementBase>* edge){
-								if(edge->incidents_from(vertex)){
-									out_vertices.push_back(const_cast<VertexElementBase*>(edge->to()));
-								}
-							});
+			out_vertices.reserve(_out_edges[id].size());
+			for(std::size_t edge_id : _out_edges[id]){
+				out_vertices.push_back(_vertex(_edge_ends[edge_id].second));
+			}
 			return out_vertices;	
 		}
 		else{
@@ -302,14 +485,13 @@ class Graph{
 	/* Returns the predecessors of the given vertex. Throws an exception if the 
 	given vertex is not contained by the graph. */
 	std::vector<VertexElementBase*> _get_in_vertices(const VertexElementBase& vertex) const {
-		if(has_vertex(vertex)){
+		std::size_t id = _id(vertex);
+		if(id != npos){
 			std::vector<VertexElementBase*> in_vertices;
-			std::for_each(_edges.begin(), _edges.end(),
-							[&vertex, &in_vertices](const Edge<VertexElementBase>* edge){
-								if(edge->incidents_to(vertex)){
-									in_vertices.push_back(const_cast<VertexElementBase*>(edge->from()));
-								}
-							});
+			in_vertices.reserve(_in_edges[id].size());
+			for(std::size_t edge_id : _in_edges[id]){
+				in_vertices.push_back(_vertex(_edge_ends[edge_id].first));
+			}
 			return in_vertices;
 		}
 		else{
@@ -322,30 +504,21 @@ class Graph{
 	std::vector<VertexElementBase*> _get_neighbours(const VertexElementBase& vertex) const {
 		std::vector<VertexElementBase*> out = _get_out_vertices(vertex);
 		std::vector<VertexElementBase*> in = _get_in_vertices(vertex);
+		std::unordered_set<const VertexElementBase*> seen(out.begin(), out.end());
 		out.reserve(out.size() + in.size());
-		std::for_each(in.begin(), in.end(),
-						[&out](VertexElementBase* in_vertex){
-							if(std::find_if(out.begin(), out.end(),
-								[in_vertex](VertexElementBase* out_vertex) {
-									return *in_vertex == *out_vertex;
-								}) == out.end()) {
-									out.push_back(in_vertex);
-							}
-						});
+		for(VertexElementBase* in_vertex : in){
+			if(seen.insert(in_vertex).second){
+				out.push_back(in_vertex);
+			}
+		}
 		out.shrink_to_fit();
 		return out;
 	}
 
 	std::vector<Edge<VertexElementBase>*> _get_out_edges(const VertexElementBase& vertex) const {
-		if(has_vertex(vertex)){
-			std::vector<Edge<VertexElementBase>*> out_edges;
-			std::for_each(_edges.begin(), _edges.end(),
-							[&vertex, &out_edges](Edge<VertexElementBase>* edge){
-								if(edge->incidents_from(vertex)){
-									out_edges.push_back(edge);
-								}
-							});
-			return out_edges;
+		std::size_t id = _id(vertex);
+		if(id != npos){
+			return _to_edges(_out_edges[id]);
 		}
 		else{
 			throw VertexNotFoundException<VertexElementBase>(vertex, error_message::kGetOutEdgesVertexNotFound);
@@ -353,15 +526,9 @@ class Graph{
 	}
 
 	std::vector<Edge<VertexElementBase>*> _get_in_edges(const VertexElementBase& vertex) const {
-		if(has_vertex(vertex)){
-			std::vector<Edge<VertexElementBase>*> in_edges;
-			std::for_each(_edges.begin(), _edges.end(),
-							[&vertex, &in_edges](Edge<VertexElementBase>* edge){
-								if(edge->incidents_to(vertex)){
-									in_edges.push_back(edge);
-								}
-							});
-			return in_edges;
+		std::size_t id = _id(vertex);
+		if(id != npos){
+			return _to_edges(_in_edges[id]);
 		}
 		else{
 			throw VertexNotFoundException<VertexElementBase>(vertex, error_message::kGetInEdgesVertexNotFound);
@@ -370,105 +537,114 @@ class Graph{
 
 	Graph<VertexElementBase> _sub_graph(const std::vector<VertexElementBase>& vertices) const {
 		Graph<VertexElementBase> sub;
+		sub.reserve(vertices.size(), 0);
 		/* Add vertices. */
 		for(const VertexElementBase& vertex : vertices){
 			sub.add_vertex(vertex);
 		}
-		/* Add edges. */
-		for(const VertexElementBase& vertex_from : vertices){
-			for(const VertexElementBase& vertex_to : vertices){
-				typename std::vector<Edge<VertexElementBase>*>::const_iterator it;
-				if((it = _find_edge(Edge<VertexElementBase>(vertex_from, vertex_to))) != _edges.end()) {
-					sub._add_edge(**it);
+		/* Add edges, ordered by source then by target as given in vertices. */
+		std::vector<std::pair<std::size_t, std::size_t>> sub_out_edges;
+		for(std::size_t sub_from_id = 0; sub_from_id < vertices.size(); ++sub_from_id){
+			std::size_t from_id = _id(vertices[sub_from_id]);
+			if(from_id == npos) continue;
+			sub_out_edges.clear();
+			for(std::size_t edge_id : _out_edges[from_id]){
+				std::size_t sub_to_id = sub._id(*_vertex(_edge_ends[edge_id].second));
+				if(sub_to_id != npos){
+					sub_out_edges.push_back(std::make_pair(sub_to_id, edge_id));
 				}
 			}
+			std::sort(sub_out_edges.begin(), sub_out_edges.end());
+			for(const std::pair<std::size_t, std::size_t>& sub_out_edge : sub_out_edges){
+				sub._link(sub_from_id, sub_out_edge.first, *_edge(sub_out_edge.second));
+			}
 		}
 		return sub;
 	}
 
 	void _topological_sort() {
-		std::map<VertexElementBase*, std::size_t> pred;
-		std::vector<VertexElementBase*> L;
-		std::queue<VertexElementBase*> Q;
-		for(VertexElementBase* vertex : _vertices){
-			std::size_t num_preds = get_in_edges(*vertex).size(); 
-			pred[vertex] = num_preds;
-			if(num_preds == 0) Q.push(vertex);
+		std::vector<std::size_t> pred(_vertex_store.capacity());
+		std::vector<std::size_t> L;
+		std::queue<std::size_t> Q;
+		L.reserve(_vertices.size());
+		for(std::size_t id : _vertices){
+			pred[id] = _in_edges[id].size();
+			if(pred[id] == 0) Q.push(id);
 		}
 		while(! Q.empty()){
-			VertexElementBase* vertex = Q.front();
+			std::size_t id = Q.front();
 			Q.pop();
-			L.push_back(vertex);
-			for(Edge<VertexElementBase>* edge : get_out_edges(*vertex)){
-				VertexElementBase* to_vertex = const_cast<VertexElementBase*>(edge->to()); 
-				std::size_t& num_preds = pred[to_vertex];
+			L.push_back(id);
+			for(std::size_t edge_id : _out_edges[id]){
+				std::size_t to_id = _edge_ends[edge_id].second;
+				std::size_t& num_preds = pred[to_id];
 				--num_preds;
 
-				if(num_preds == 0) Q.push(to_vertex);
+				if(num_preds == 0) Q.push(to_id);
 			}
 		}
 		if(_vertices.size() != L.size()) throw std::logic_error("fail toposort");
-		else _vertices = L;
+		else _vertices = std::move(L);
 	}
 
-	/* Removes all the edges. Deletes the dynamically allocated edges before
-	calling the standard clear on the vector. */
+	/* Removes all the edges. */
 	void _clear_all_edges() {
-		std::for_each(_edges.begin(), _edges.end(), 
-						[](const Edge<VertexElementBase>* edge){
-							delete edge;
-						});
+		_edge_store.clear();
 		_edges.clear();
+		_edge_ends.clear();
+		for(std::vector<std::size_t>& out_edges : _out_edges) out_edges.clear();
+		for(std::vector<std::size_t>& in_edges : _in_edges) in_edges.clear();
 	}
 
-	/* Removes all the vertices. Deletes the dynamically allocated vertices before
-	calling the standard clear on the vector. */
+	/* Removes all the vertices. */
 	void _clear_all_vertices() {
 		_clear_all_edges();
-		std::for_each(_vertices.begin(), _vertices.end(), 
-						[](const VertexElementBase* vertex){
-							delete vertex;
-						});
+		_ids.clear();
+		_out_edges.clear();
+		_in_edges.clear();
+		_vertex_store.clear();
 		_vertices.clear();
 	}
 
 public:
 	/* Graph interface */
-	Graph() : _vertices(), _edges() {}
+	Graph() : _vertex_store(), _edge_store(), _vertices(), _edges(), _edge_ends(), _ids(), _out_edges(), _in_edges() {}
 
+	/* The arenas are copied as a whole, then the index and the edges are pointed to the copied vertices. */
 	Graph(const Graph<VertexElementBase>& other) : 
-		_vertices(), _edges() {
-			for(std::size_t i = 0; i < other._vertices.size(); ++i){
-				_add_vertex(*(other._vertices[i]));
-			}
-			for(std::size_t i = 0; i < other._edges.size(); ++i){
-				_add_edge(*(other._edges[i]));
+		_vertex_store(other._vertex_store), _edge_store(other._edge_store), 
+		_vertices(other._vertices), _edges(other._edges), _edge_ends(other._edge_ends), _ids(), 
+		_out_edges(other._out_edges), _in_edges(other._in_edges) {
+			_reindex();
+			for(std::size_t edge_id : _edges){
+				_edge(edge_id)->_rebind(_vertex(_edge_ends[edge_id].first), _vertex(_edge_ends[edge_id].second));
 			}
 	}
 
 	Graph(Graph<VertexElementBase>&& other) :
-		_vertices(std::move(other._vertices)), _edges(std::move(other._edges)) {}
+		_vertex_store(std::move(other._vertex_store)), _edge_store(std::move(other._edge_store)),
+		_vertices(std::move(other._vertices)), _edges(std::move(other._edges)), _edge_ends(std::move(other._edge_ends)), 
+		_ids(std::move(other._ids)), _out_edges(std::move(other._out_edges)), _in_edges(std::move(other._in_edges)) {}
 
 	Graph<VertexElementBase>& operator=(const Graph<VertexElementBase>& other){
 		if(this != &other){
-			_clear_all_edges();
-			_clear_all_vertices();
-			for(std::size_t i = 0; i < other._vertices.size(); ++i){
-				_add_vertex(*(other._vertices[i]));
-			}
-			for(std::size_t i = 0; i < other._edges.size(); ++i){
-				_add_edge(*(other._edges[i]));
-			}
+			Graph<VertexElementBase> copy(other);
+			*this = std::move(copy);
 		}
 		return *this;
 	}
 
 	Graph<VertexElementBase>& operator=(Graph<VertexElementBase>&& other){
 		if(this != &other){
-			_clear_all_edges();
 			_clear_all_vertices();
+			_vertex_store = std::move(other._vertex_store);
+			_edge_store = std::move(other._edge_store);
 			_vertices = std::move(other._vertices);
 			_edges = std::move(other._edges);
+			_edge_ends = std::move(other._edge_ends);
+			_ids = std::move(other._ids);
+			_out_edges = std::move(other._out_edges);
+			_in_edges = std::move(other._in_edges);
 		}
 		return *this;
 	}
@@ -485,15 +661,15 @@ public:
 	}
 
 	bool has_vertex(const VertexElementBase& vertex) const {
-		return _find_vertex(vertex) != _vertices.end();
+		return _id(vertex) != npos;
 	}
 
 	bool has_edge(const Edge<VertexElementBase>& edge) const {
-		return _find_edge(edge) != _edges.end();
+		return _find_edge(*(edge.from()), *(edge.to())) != npos;
 	}
 
 	bool has_edge(const VertexElementBase& from_vertex, const VertexElementBase& to_vertex) const {
-		return has_edge(Edge<VertexElementBase>(from_vertex, to_vertex));
+		return _find_edge(from_vertex, to_vertex) != npos;
 	}
 
 	bool adjacent(const VertexElementBase& first, const VertexElementBase& second) const {
@@ -501,9 +677,9 @@ public:
 	}
 
 	VertexElementBase* get_vertex(const VertexElementBase& vertex) const {
-		typename std::vector<VertexElementBase*>::const_iterator it;
-		if((it = _find_vertex(vertex)) != _vertices.end()) {
-			return *it;
+		std::size_t id;
+		if((id = _id(vertex)) != npos) {
+			return _vertex(id);
 		}
 		else{
 			throw VertexNotFoundException<VertexElementBase>(vertex, error_message::kGetVertexNotFound);
@@ -511,9 +687,9 @@ public:
 	}
 
 	Edge<VertexElementBase>* get_edge(const VertexElementBase& vertex_from, const VertexElementBase& vertex_to){
-		typename std::vector<Edge<VertexElementBase>*>::const_iterator it;
-		if((it = _find_edge(Edge<VertexElementBase>(vertex_from, vertex_to))) != _edges.end()) {
-			return *it;
+		std::size_t edge_id;
+		if((edge_id = _find_edge(vertex_from, vertex_to)) != npos) {
+			return _edge(edge_id);
 		}
 		else{
 			throw EdgeNotFoundException<Edge<VertexElementBase>>(Edge<VertexElementBase>(vertex_from, vertex_to), error_message::kGetEdgeNotFound);
@@ -533,6 +709,61 @@ public:
 		_remove_vertex(vertex);
 	}
 
+	/* Must be called after a vertex contained by the graph was modified in a way 
+	that changes its hash (e.g. a renamed state). */
+	void reindex(){
+		_reindex();
+	}
+
+	/* Bulk construction. Reserves room for the given number of vertices and edges. */
+	void reserve(std::size_t num_vertices, std::size_t num_edges){
+		_vertex_store.reserve(num_vertices);
+		_vertices.reserve(num_vertices);
+		_ids.reserve(num_vertices);
+		_out_edges.reserve(num_vertices);
+		_in_edges.reserve(num_vertices);
+		_edge_store.reserve(num_edges);
+		_edges.reserve(num_edges);
+		_edge_ends.reserve(num_edges);
+	}
+
+	/* Returns the id of the given vertex. Ids are stable : they do not change until the vertex is removed.
+	Throws an exception if the vertex is not contained by the graph. */
+	std::size_t vertex_id(const VertexElementBase& vertex) const {
+		std::size_t id;
+		if((id = _id(vertex)) != npos) {
+			return id;
+		}
+		else{
+			throw VertexNotFoundException<VertexElementBase>(vertex, error_message::kGetVertexNotFound);
+		}
+	}
+
+	/* Access by id. The ids have to be ids of vertices (resp. edges) contained by the graph. */
+	VertexElementBase* vertex_at(std::size_t id) const { return _vertex(id); }
+	Edge<VertexElementBase>* edge_at(std::size_t id) const { return _edge(id); }
+
+	/* Returns the ids of the out edges of the given vertex. Throws an exception if the 
+	given vertex is not contained by the graph. */
+	const std::vector<std::size_t>& out_edges_ids(const VertexElementBase& vertex) const {
+		std::size_t id;
+		if((id = _id(vertex)) != npos) {
+			return _out_edges[id];
+		}
+		else{
+			throw VertexNotFoundException<VertexElementBase>(vertex, error_message::kGetOutEdgesVertexNotFound);
+		}
+	}
+
+	/* Bulk construction. Adds an edge between the vertices with given ids without checking 
+	whether it already exists : the caller has to guarantee that each edge is added only once. */
+	void add_edge_at(std::size_t from_id, std::size_t to_id, double weight){
+		if(! _vertex_store.live(from_id) || ! _vertex_store.live(to_id)) {
+			throw std::out_of_range("add_edge_at: no vertex with such id");
+		}
+		_link(from_id, to_id, Edge<VertexElementBase>(*_vertex(from_id), *_vertex(to_id), weight));
+	}
+
 	void add_edge(const VertexElementBase& from, const VertexElementBase& to){
 		_add_edge(Edge<VertexElementBase>(from, to));
 	}
@@ -589,10 +820,7 @@ public:
 		_clear_all_vertices();
 	}
 	
-	virtual ~Graph() { 
-		_clear_all_edges();
-		_clear_all_vertices();
-	}
+	virtual ~Graph() {}
 };
 
 #endif
\ No newline at end of file
@@ -11,6 +11,7 @@
 #include <memory> // std::shared_ptr
 #include <iomanip> // std::setprecision
 #include <tuple>
+#include <set>
 #include <fstream>
 #include "constants.hpp"
 #include "state.hpp"
@@ -19,6 +20,7 @@
 #include "hmm_algorithms.hpp"
 #include "hmm_base.hpp"
 #include "hmm.hpp"
+#include "instrumentation.hpp"
 
 #define CYAN "\033[36m"
 #define RESET "\033[0m"
@@ -36,74 +38,209 @@ HiddenMarkovModel::HiddenMarkovModel(
 	const std::string& name, 
 	const ForwardAlgorithm& forward, const BackwardAlgorithm& backward, 
 	const DecodingAlgorithm& decode, const TrainingAlgorithm& train) :
-		_name(name), _begin(nullptr), _end(nullptr), _graph(), _model(new RawModel()),
+		_name(name), _begin(nullptr), _end(nullptr), _graph(std::make_shared<Graph<State>>()), _model(std::make_shared<RawModel>()),
 		_forward_algorithm(forward.clone()), _backward_algorithm(backward.clone()),
-		_decoding_algorithm(decode.clone()), _training_algorithm(train.clone())
+		_decoding_algorithm(decode.clone()), _training_algorithm(train.clone()), _fixed_engine(),
+		_topology_dirty(true), _dirty_pi_begin(false), _dirty_rows(), _dirty_emissions(),
+		_brewed_normalize(true), _brewed_begin_free_transition(false), _brewed_free_emissions(), _brewed_free_transitions(),
+		_free_pi_begin_edges(), _free_transitions_edges(), _free_pi_end_edges(), _raw_states_ids(), _exposed_states(), 
+		_indexed_renames(State::renames())
 			{	
-				_graph.add_vertex(hmm_config::kDefaultStartStateLabel);
-				_begin = _graph.get_vertex(hmm_config::kDefaultStartStateLabel);
-				_graph.add_vertex(hmm_config::kDefaultEndStateLabel);
-				_end = _graph.get_vertex(hmm_config::kDefaultEndStateLabel);
-				_forward_algorithm->set_model(_model); _backward_algorithm->set_model(_model);
-				_decoding_algorithm->set_model(_model); _training_algorithm->set_model(_model);
+				_graph->add_vertex(hmm_config::kDefaultStartStateLabel);
+				_begin = _graph->get_vertex(hmm_config::kDefaultStartStateLabel);
+				_graph->add_vertex(hmm_config::kDefaultEndStateLabel);
+				_end = _graph->get_vertex(hmm_config::kDefaultEndStateLabel);
+				_set_algorithms_model();
 			}
 
+/* The graph and the raw model are shared with other until one of the copies modifies them (see _detach_graph
+and _detach_model). Only the algorithms are cloned. The graph of other is copied right away if states were handed 
+out by other, since they may be modified at any time. */
 HiddenMarkovModel::HiddenMarkovModel(const HiddenMarkovModel& other) :
-	_name(other._name), _begin(), _end(), _graph(other._graph), _model(new RawModel(*(other._model))),
+	_name(other._name), _begin(other._begin), _end(other._end), _graph(other._graph), _model(other._model),
 	_forward_algorithm(other._forward_algorithm->clone()), _backward_algorithm(other._backward_algorithm->clone()),
-	_decoding_algorithm(other._decoding_algorithm->clone()), _training_algorithm(other._training_algorithm->clone())
+	_decoding_algorithm(other._decoding_algorithm->clone()), _training_algorithm(other._training_algorithm->clone()),
+	_fixed_engine(other._fixed_engine),
+	_topology_dirty(other._topology_dirty), _dirty_pi_begin(other._dirty_pi_begin), 
+	_dirty_rows(other._dirty_rows), _dirty_emissions(other._dirty_emissions),
+	_brewed_normalize(other._brewed_normalize), _brewed_begin_free_transition(other._brewed_begin_free_transition), 
+	_brewed_free_emissions(other._brewed_free_emissions), _brewed_free_transitions(other._brewed_free_transitions),
+	_free_pi_begin_edges(other._free_pi_begin_edges), _free_transitions_edges(other._free_transitions_edges), 
+	_free_pi_end_edges(other._free_pi_end_edges), _raw_states_ids(other._raw_states_ids), _exposed_states(),
+	_indexed_renames(State::renames())
 		{
-			_begin = _graph.get_vertex(*other._begin); _end = _graph.get_vertex(*other._end);
-			_forward_algorithm->set_model(_model); _backward_algorithm->set_model(_model);
-			_decoding_algorithm->set_model(_model); _training_algorithm->set_model(_model);
+			other._reindex_renamed_states();
+			/* The states of other may have been modified since its last brew. */
+			_mark_modified_states(other._exposed_states);
+			if(! other._exposed_states.empty()) _detach_graph();
+			_set_algorithms_model();
 		}
 
 HiddenMarkovModel::HiddenMarkovModel(HiddenMarkovModel&& other) : 
-	_name(std::move(other._name)), _begin(std::move(other._begin)), _end(std::move(other._end)), 
-	_graph(std::move(other._graph)),  _model(std::move(other._model)), _forward_algorithm(std::move(other._forward_algorithm)), 
-	_backward_algorithm(std::move(other._backward_algorithm)), _decoding_algorithm(std::move(other._decoding_algorithm)), 
-	_training_algorithm(std::move(other._training_algorithm)) 
+	_name(std::move(other._name)), _begin(other._begin), _end(other._end), 
+	_graph(std::move(other._graph)),  _model(std::move(other._model)), _forward_algorithm(other._forward_algorithm), 
+	_backward_algorithm(other._backward_algorithm), _decoding_algorithm(other._decoding_algorithm), 
+	_training_algorithm(other._training_algorithm), _fixed_engine(std::move(other._fixed_engine)),
+	_topology_dirty(other._topology_dirty), _dirty_pi_begin(other._dirty_pi_begin), 
+	_dirty_rows(std::move(other._dirty_rows)), _dirty_emissions(std::move(other._dirty_emissions)),
+	_brewed_normalize(other._brewed_normalize), _brewed_begin_free_transition(other._brewed_begin_free_transition), 
+	_brewed_free_emissions(std::move(other._brewed_free_emissions)), _brewed_free_transitions(std::move(other._brewed_free_transitions)),
+	_free_pi_begin_edges(std::move(other._free_pi_begin_edges)), _free_transitions_edges(std::move(other._free_transitions_edges)), 
+	_free_pi_end_edges(std::move(other._free_pi_end_edges)), _raw_states_ids(std::move(other._raw_states_ids)),
+	_exposed_states(std::move(other._exposed_states)), _indexed_renames(other._indexed_renames)
 		{
-			_forward_algorithm->set_model(_model); _backward_algorithm->set_model(_model);
-			_decoding_algorithm->set_model(_model); _training_algorithm->set_model(_model);
+			other._begin = nullptr; other._end = nullptr;
+			other._forward_algorithm = nullptr; other._backward_algorithm = nullptr;
+			other._decoding_algorithm = nullptr; other._training_algorithm = nullptr;
 		}	
 
 HiddenMarkovModel& HiddenMarkovModel::operator=(const HiddenMarkovModel& other){
 	if(this != &other){
+		other._reindex_renamed_states();
 		_name = other._name;
 		_graph = other._graph;
-		_begin = _graph.get_vertex(*other._begin);
-		_end = _graph.get_vertex(*other._end);
+		_begin = other._begin;
+		_end = other._end;
+		_model = other._model;
 		delete _forward_algorithm; delete _backward_algorithm; delete _decoding_algorithm; delete _training_algorithm;
 		_forward_algorithm = other._forward_algorithm->clone();
 		_backward_algorithm = other._backward_algorithm->clone();
 		_decoding_algorithm = other._decoding_algorithm->clone();
 		_training_algorithm = other._training_algorithm->clone();
-		*_model = *other._model;
-		_forward_algorithm->set_model(_model); _backward_algorithm->set_model(_model);
-		_decoding_algorithm->set_model(_model); _training_algorithm->set_model(_model);
+		_fixed_engine = other._fixed_engine;
+		_topology_dirty = other._topology_dirty;
+		_dirty_pi_begin = other._dirty_pi_begin;
+		_dirty_rows = other._dirty_rows;
+		_dirty_emissions = other._dirty_emissions;
+		_brewed_normalize = other._brewed_normalize;
+		_brewed_begin_free_transition = other._brewed_begin_free_transition;
+		_brewed_free_emissions = other._brewed_free_emissions;
+		_brewed_free_transitions = other._brewed_free_transitions;
+		_free_pi_begin_edges = other._free_pi_begin_edges;
+		_free_transitions_edges = other._free_transitions_edges;
+		_free_pi_end_edges = other._free_pi_end_edges;
+		_raw_states_ids = other._raw_states_ids;
+		_exposed_states.clear();
+		_mark_modified_states(other._exposed_states);
+		if(! other._exposed_states.empty()) _detach_graph();
+		_set_algorithms_model();
 	}
 	return *this;
 }
 
 HiddenMarkovModel& HiddenMarkovModel::operator=(HiddenMarkovModel&& other){
 	if(this != &other){
-		_model->clean();
 		_name = std::move(other._name);
-		_begin = std::move(other._begin);
-		_end = std::move(other._end);
+		_begin = other._begin; other._begin = nullptr;
+		_end = other._end; other._end = nullptr;
 		_graph = std::move(other._graph);
-		_forward_algorithm = std::move(other._forward_algorithm);
-		_backward_algorithm = std::move(other._backward_algorithm);
-		_decoding_algorithm = std::move(other._decoding_algorithm);
-		_training_algorithm = std::move(other._training_algorithm);
 		_model = std::move(other._model);
-		_forward_algorithm->set_model(_model); _backward_algorithm->set_model(_model);
-		_decoding_algorithm->set_model(_model); _training_algorithm->set_model(_model);
+		delete _forward_algorithm; delete _backward_algorithm; delete _decoding_algorithm; delete _training_algorithm;
+		_forward_algorithm = other._forward_algorithm; other._forward_algorithm = nullptr;
+		_backward_algorithm = other._backward_algorithm; other._backward_algorithm = nullptr;
+		_decoding_algorithm = other._decoding_algorithm; other._decoding_algorithm = nullptr;
+		_training_algorithm = other._training_algorithm; other._training_algorithm = nullptr;
+		_fixed_engine = std::move(other._fixed_engine);
+		_topology_dirty = other._topology_dirty;
+		_dirty_pi_begin = other._dirty_pi_begin;
+		_dirty_rows = std::move(other._dirty_rows);
+		_dirty_emissions = std::move(other._dirty_emissions);
+		_brewed_normalize = other._brewed_normalize;
+		_brewed_begin_free_transition = other._brewed_begin_free_transition;
+		_brewed_free_emissions = std::move(other._brewed_free_emissions);
+		_brewed_free_transitions = std::move(other._brewed_free_transitions);
+		_free_pi_begin_edges = std::move(other._free_pi_begin_edges);
+		_free_transitions_edges = std::move(other._free_transitions_edges);
+		_free_pi_end_edges = std::move(other._free_pi_end_edges);
+		_raw_states_ids = std::move(other._raw_states_ids);
+		_exposed_states = std::move(other._exposed_states);
+		_indexed_renames = other._indexed_renames;
 	}
 	return *this;
 }
 
+void HiddenMarkovModel::_detach_graph(){
+	if(_graph.use_count() > 1){
+		/* Vertices keep their ids in the copied graph. */
+		std::size_t begin_id = (_begin != nullptr) ? _graph->vertex_id(*_begin) : 0;
+		std::size_t end_id = (_end != nullptr) ? _graph->vertex_id(*_end) : 0;
+		_graph = std::make_shared<Graph<State>>(*_graph);
+		if(_begin != nullptr) _begin = _graph->vertex_at(begin_id);
+		if(_end != nullptr) _end = _graph->vertex_at(end_id);
+		/* The states handed out belong to the previous graph. */
+		_exposed_states.clear();
+	}
+}
+
+void HiddenMarkovModel::_reindex_renamed_states() const {
+	/* Only the states handed out can be renamed, and their graph is not shared. */
+	if(_exposed_states.empty() || _indexed_renames == State::renames()) { return; }
+	_graph->reindex();
+	_indexed_renames = State::renames();
+}
+
+void HiddenMarkovModel::_set_algorithms_model(){
+	_forward_algorithm->set_model(_model.get()); _backward_algorithm->set_model(_model.get());
+	_decoding_algorithm->set_model(_model.get()); _training_algorithm->set_model(_model.get());
+}
+
+void HiddenMarkovModel::_detach_model(){
+	if(_model.use_count() > 1){
+		_model = std::make_shared<RawModel>(*_model);
+		_set_algorithms_model();
+	}
+}
+
+HiddenMarkovModel HiddenMarkovModel::from_matrices(
+	const std::vector<std::string>& names, const Matrix& A,
+	const std::vector<double>& pi_begin, const std::vector<double>& pi_end,
+	const std::vector<DiscreteDistribution>& emissions, const std::vector<bool>& silent_mask,
+	const std::string& name) {
+	std::size_t num_states = names.size();
+	/* Validate the dimensions and probabilities before touching the graph. */
+	if(A.size() != num_states) throw ModelDimensionException("A", error_message::kHMMMatricesDimensionMismatch);
+	if(pi_begin.size() != num_states) throw ModelDimensionException("pi_begin", error_message::kHMMMatricesDimensionMismatch);
+	if(pi_end.size() != num_states) throw ModelDimensionException("pi_end", error_message::kHMMMatricesDimensionMismatch);
+	if(emissions.size() != num_states) throw ModelDimensionException("emissions", error_message::kHMMMatricesDimensionMismatch);
+	if(silent_mask.size() != num_states) throw ModelDimensionException("silent_mask", error_message::kHMMMatricesDimensionMismatch);
+	std::size_t num_transitions = 0;
+	for(std::size_t i = 0; i < num_states; ++i){
+		if(A[i].size() != num_states) throw ModelDimensionException("A[" + std::to_string(i) + "]", error_message::kHMMMatricesDimensionMismatch);
+		if(names[i] == hmm_config::kDefaultStartStateLabel || names[i] == hmm_config::kDefaultEndStateLabel) {
+			throw StateExistsException(names[i], error_message::kHMMMatricesReservedStateName);
+		}
+		if(pi_begin[i] < 0) throw TransitionLogicException(hmm_config::kDefaultStartStateLabel + " -> " + names[i], error_message::kHMMTransitionNegativeProbability);
+		if(pi_end[i] < 0) throw TransitionLogicException(names[i] + " -> " + hmm_config::kDefaultEndStateLabel, error_message::kHMMTransitionNegativeProbability);
+		if(pi_begin[i] > 0) ++num_transitions;
+		if(pi_end[i] > 0) ++num_transitions;
+		for(std::size_t j = 0; j < num_states; ++j){
+			if(A[i][j] < 0) throw TransitionLogicException(names[i] + " -> " + names[j], error_message::kHMMTransitionNegativeProbability);
+			if(A[i][j] > 0) ++num_transitions;
+		}
+	}
+	HiddenMarkovModel hmm(name);
+	/* The begin and end states hold the two first ids of the graph, the states are added right after. */
+	std::size_t begin_id = hmm._graph->vertex_id(hmm._begin_state());
+	std::size_t end_id = hmm._graph->vertex_id(hmm._end_state());
+	std::size_t first_id = hmm._graph->num_vertices();
+	hmm._graph->reserve(first_id + num_states, num_transitions);
+	for(std::size_t i = 0; i < num_states; ++i){
+		if(silent_mask[i]) hmm.add_state(State(names[i]));
+		else hmm.add_state(State(names[i], emissions[i]));
+	}
+	for(std::size_t i = 0; i < num_states; ++i){
+		if(pi_begin[i] > 0) hmm._graph->add_edge_at(begin_id, first_id + i, pi_begin[i]);
+	}
+	for(std::size_t i = 0; i < num_states; ++i){
+		for(std::size_t j = 0; j < num_states; ++j){
+			if(A[i][j] > 0) hmm._graph->add_edge_at(first_id + i, first_id + j, A[i][j]);
+		}
+		if(pi_end[i] > 0) hmm._graph->add_edge_at(first_id + i, end_id, pi_end[i]);
+	}
+	hmm.brew();
+	return hmm;
+}
+
 void HiddenMarkovModel::print_transitions(bool log_prob){
 	__print_transitions(_model->A, _model->states_indices, log_prob);
 }
@@ -122,20 +259,34 @@ void HiddenMarkovModel::print_pi_end(bool log_prob){
 
 std::string HiddenMarkovModel::name() const { return _name; }
 void HiddenMarkovModel::set_name(const std::string& name) { _name = name; } 
-std::size_t HiddenMarkovModel::num_states() const { return _graph.num_vertices(); }
-std::size_t HiddenMarkovModel::num_transitions() const { return _graph.num_edges(); }	
+std::size_t HiddenMarkovModel::num_states() const { return _graph->num_vertices(); }
+std::size_t HiddenMarkovModel::num_transitions() const { return _graph->num_edges(); }	
 
-Graph<State> HiddenMarkovModel::get_graph() { return _graph; }
+Graph<State> HiddenMarkovModel::get_graph() { return *_graph; }
 
 bool HiddenMarkovModel::has_state(const State& state) const {
-	return _graph.has_vertex(state);
+	_reindex_renamed_states();
+	return _graph->has_vertex(state);
 }
 
 bool HiddenMarkovModel::has_transition(const State& from_state, const State& to_state) const {
-	return _graph.has_edge(from_state, to_state);
+	_reindex_renamed_states();
+	return _graph->has_edge(from_state, to_state);
 }
 
 State& HiddenMarkovModel::begin() { 
+	_detach_graph();
+	_exposed_states.insert(&_begin_state());
+	return _begin_state();
+}
+
+State& HiddenMarkovModel::end() {
+	_detach_graph();
+	_exposed_states.insert(&_end_state());
+	return _end_state();
+}
+
+State& HiddenMarkovModel::_begin_state() const { 
 	if(_begin != nullptr){
 		return *_begin;
 	}
@@ -144,7 +295,7 @@ State& HiddenMarkovModel::begin() {
 	}
 }
 
-State& HiddenMarkovModel::end() {
+State& HiddenMarkovModel::_end_state() const {
 	if(_end != nullptr){
 		return *_end;
 	}
@@ -153,9 +304,19 @@ State& HiddenMarkovModel::end() {
 	}
 }
 
+std::size_t HiddenMarkovModel::_raw_index(const State& state) const {
+	std::map<std::string, std::size_t>::const_iterator it = _model->states_indices.find(state.name());
+	return (it == _model->states_indices.end()) ? _model->states_names.size() : it->second;
+}
+
 State& HiddenMarkovModel::get_state(const State& state) {
+	_reindex_renamed_states();
+	_detach_graph();
 	try{
-		return *_graph.get_vertex(state);
+		State& found = *_graph->get_vertex(state);
+		/* The state may be modified through the returned reference, which brew() checks. */
+		_exposed_states.insert(&found);
+		return found;
 	}
 	catch(const VertexNotFoundException<State>& e){
 		throw StateNotFoundException(e.trigger(), error_message::kHMMGetStateNotFound);
@@ -163,8 +324,11 @@ State& HiddenMarkovModel::get_state(const State& state) {
 }
 
 void HiddenMarkovModel::add_state(const State& state){
+	_reindex_renamed_states();
+	_detach_graph();
 	try{
-		_graph.add_vertex(state);	
+		_graph->add_vertex(state);	
+		_topology_dirty = true;
 	}
 	catch(const VertexExistsException<State>& e){
 		throw StateExistsException(e.trigger(), error_message::kHMMAddStateExists);
@@ -172,10 +336,14 @@ void HiddenMarkovModel::add_state(const State& state){
 }
 
 void HiddenMarkovModel::remove_state(const State& state){
+	_reindex_renamed_states();
+	_detach_graph();
 	if(state == *_begin) _begin = nullptr;
 	else if(state == *_end) _end = nullptr;
 	try{
-		_graph.remove_vertex(state);	
+		if(_graph->has_vertex(state)) _exposed_states.erase(_graph->get_vertex(state));
+		_graph->remove_vertex(state);	
+		_topology_dirty = true;
 	}
 	catch(const VertexNotFoundException<State>& e){
 		throw StateNotFoundException(e.trigger(), error_message::kHMMRemoveStateNotFound);
@@ -187,11 +355,14 @@ std::string HiddenMarkovModel::transition_string(const State& from, const State&
 }
 
 void HiddenMarkovModel::add_transition(const State& from, const State& to, double probability){
-	if(from == end()) throw TransitionLogicException(transition_string(from, to), error_message::kHMMAddedTransitionFromEndState);
-	if(to == begin()) throw TransitionLogicException(transition_string(from, to), error_message::kHMMAddedTransitionToBeginState);
+	_reindex_renamed_states();
+	if(from == _end_state()) throw TransitionLogicException(transition_string(from, to), error_message::kHMMAddedTransitionFromEndState);
+	if(to == _begin_state()) throw TransitionLogicException(transition_string(from, to), error_message::kHMMAddedTransitionToBeginState);
 	if(probability < 0) throw TransitionLogicException(transition_string(from, to), error_message::kHMMTransitionNegativeProbability);
+	_detach_graph();
 	try{
-		_graph.add_edge(from, to, probability);	
+		_graph->add_edge(from, to, probability);	
+		_topology_dirty = true;
 	} 
 	catch(const EdgeExistsException<Edge<State>>& e){
 		throw TransitionExistsException(transition_string(*(e.trigger().from()), *(e.trigger().to())), error_message::kHMMAddTransitionExists);
@@ -202,9 +373,10 @@ void HiddenMarkovModel::add_transition(const State& from, const State& to, doubl
 }
 
 double HiddenMarkovModel::get_transition(const State& from, const State& to){
+	_reindex_renamed_states();
 	try{
-		Edge<State>* edge = _graph.get_edge(from, to);
-		double* weight = edge->weight();
+		Edge<State>* edge = _graph->get_edge(from, to);
+		const double* weight = edge->weight();
 		if(weight == nullptr) { 
 			throw TransitionLogicException(transition_string(*(edge->from()), *(edge->to())), error_message::kHMMGetTransitionNullWeight);
 		}
@@ -216,9 +388,17 @@ double HiddenMarkovModel::get_transition(const State& from, const State& to){
 }
 
 void HiddenMarkovModel::set_transition(const State& from, const State& to, double probability){
+	_reindex_renamed_states();
 	if(probability < 0) throw TransitionLogicException(transition_string(from, to), error_message::kHMMTransitionNegativeProbability);
+	_detach_graph();
 	try{
-		_graph.set_weight(from, to, probability);	
+		_graph->set_weight(from, to, probability);	
+		if(from == _begin_state()) { _dirty_pi_begin = true; }
+		else{
+			std::size_t raw_index = _raw_index(from);
+			if(raw_index < _model->states_names.size()) _dirty_rows.insert(raw_index);
+			else _topology_dirty = true;
+		}
 	}
 	catch(const IncidentVertexNotFoundException<State>& e){
 		throw StateNotFoundException(e.trigger(), error_message::kHMMGetTransitionNotFound);
@@ -226,16 +406,19 @@ void HiddenMarkovModel::set_transition(const State& from, const State& to, doubl
 }
 
 void HiddenMarkovModel::begin_transition(const State& state, double probability) {
-	add_transition(begin(), state, probability);
+	add_transition(_begin_state(), state, probability);
 }
 
 void HiddenMarkovModel::end_transition(const State& state, double probability) {
-	add_transition(state, end(), probability);
+	add_transition(state, _end_state(), probability);
 }
 
 void HiddenMarkovModel::remove_transition(const State& from, const State& to){
+	_reindex_renamed_states();
+	_detach_graph();
 	try{
-		_graph.remove_edge(from, to);	
+		_graph->remove_edge(from, to);	
+		_topology_dirty = true;
 	}
 	catch(const EdgeNotFoundException<Edge<State>>& e){
 		throw TransitionNotFoundException(transition_string(*(e.trigger().from()), *(e.trigger().to())), error_message::kHMMRemoveTransitionNotFound);
@@ -245,14 +428,158 @@ void HiddenMarkovModel::remove_transition(const State& from, const State& to){
 
 
 void HiddenMarkovModel::brew(bool normalize) {
+	_reindex_renamed_states();
+	_mark_modified_states(_exposed_states);
+	/* Nothing changed since the last brew : keep sharing the raw model. */
+	if(! _topology_dirty && normalize == _brewed_normalize && ! _dirty_pi_begin && _dirty_rows.empty() && _dirty_emissions.empty()
+		&& _begin_state().has_free_transition() == _brewed_begin_free_transition) { return; }
+	_detach_model();
+	if(_topology_dirty || normalize != _brewed_normalize || ! _incremental_brew()){
+		_full_brew(normalize);
+	}
+	_model->compute_envelope();
+	_model->compute_silent_closure();
+	_clear_dirty();
+	/* The raw model was modified in place : let the algorithms know (e.g. compiled algorithms have to recompile). */
+	_set_algorithms_model();
+	_refresh_fixed_engine();
+}
+
+void HiddenMarkovModel::_mark_modified_states(const std::set<State*>& states) {
+	for(State* p_state : states){
+		if(p_state == _begin || p_state == _end) { continue; }
+		std::size_t raw_index = _raw_index(*p_state);
+		if(raw_index >= _model->states_names.size()) { _topology_dirty = true; }
+		else if(_modified_since_brew(*p_state, raw_index)) { _dirty_emissions.insert(raw_index); }
+	}
+}
+
+bool HiddenMarkovModel::_modified_since_brew(const State& state, std::size_t raw_index) const {
+	if(state.is_silent() != (_model->B[raw_index] == nullptr)) { return true; }
+	if(raw_index >= _brewed_free_emissions.size() || state.has_free_emission() != _brewed_free_emissions[raw_index]
+		|| state.has_free_transition() != _brewed_free_transitions[raw_index]) { return true; }
+	if(state.is_silent()) { return false; }
+	/* Compared as brewed, i.e. with log probabilities. */
+	std::unique_ptr<Distribution> distribution(state.distribution().clone());
+	distribution->log_probabilities(true);
+	if(_brewed_normalize){
+		distribution->log_normalize();
+	}
+	return *distribution != *_model->B[raw_index];
+}
+
+void HiddenMarkovModel::_clear_dirty() {
+	_topology_dirty = false;
+	_dirty_pi_begin = false;
+	_dirty_rows.clear();
+	_dirty_emissions.clear();
+}
+
+void HiddenMarkovModel::_refresh_fixed_engine() {
+	if(_forward_algorithm->type() == hmm_config::kLinearMemoryForwardAlgorithmName
+		&& _backward_algorithm->type() == hmm_config::kLinearMemoryBackwardAlgorithmName
+		&& _decoding_algorithm->type() == hmm_config::kLinearMemoryViterbiDecodeAlgorithmName){
+		_fixed_engine.reset(make_fixed_size_engine(*_model));
+	}
+	else{
+		_fixed_engine.reset();
+	}
+}
+
+double HiddenMarkovModel::_fill_transitions(const std::vector<Edge<State>*>& edges, std::vector<double>& row, std::vector<double>& pi_end, 
+	const std::map<std::string, std::size_t>& states_indices, bool normalize) {
+	std::vector<double> vec_to_normalize;
+	vec_to_normalize.reserve(edges.size());
+	double prob_sum = 0;
+	double prob;
+	for(Edge<State>* edge : edges){ 
+		prob = (edge->weight() == nullptr) ? 0 : *(edge->weight());
+		prob_sum += prob;
+		vec_to_normalize.push_back(log(prob));
+	}
+	if(prob_sum != 1.0 && normalize){
+		std::vector<double>::iterator it = vec_to_normalize.begin();
+		while(it != vec_to_normalize.end()){
+			*it = utils::log_normalize(*it, log(prob_sum));
+			++it;
+		}
+	}
+	std::size_t i = 0;
+	for(double& log_prob : vec_to_normalize){
+		if(*(edges[i]->to()) == _end_state()){
+			pi_end[states_indices.at(edges[i]->from()->name())] = log_prob;
+		}
+		else{
+			row[states_indices.at(edges[i]->to()->name())] = log_prob;
+		}
+		i++;
+	}
+	return prob_sum;
+}
+
+bool HiddenMarkovModel::_incremental_brew() {
+	if(_begin_state().has_free_transition() != _brewed_begin_free_transition) { return false; }
+	/* Check that the modified states did not change in a way that requires a full brew. */
+	std::vector<State*> dirty_states;
+	dirty_states.reserve(_dirty_emissions.size());
+	for(std::size_t raw_index : _dirty_emissions){
+		/* Not found if the state was renamed. */
+		if(! _graph->has_vertex(State(_model->states_names[raw_index]))) { return false; }
+		State* p_state = _graph->get_vertex(State(_model->states_names[raw_index]));
+		if(p_state->name() != _model->states_names[raw_index]) { return false; }
+		if(p_state->is_silent() != (_model->B[raw_index] == nullptr)) { return false; }
+		if(p_state->has_free_emission() != _brewed_free_emissions[raw_index]) { return false; }
+		if(p_state->has_free_transition() != _brewed_free_transitions[raw_index]) { return false; }
+		/* The alphabet only depends on the symbols of the distributions. Only discrete ! */
+		if(! p_state->is_silent() && p_state->distribution().is_discrete() != _model->B[raw_index]->is_discrete()) { return false; }
+		if(! p_state->is_silent() && p_state->distribution().is_discrete() 
+			&& static_cast<DiscreteDistribution*>(&p_state->distribution())->symbols() 
+			!= static_cast<DiscreteDistribution*>(_model->B[raw_index])->symbols()) { return false; }
+		dirty_states.push_back(p_state);
+	}
+	/* Update the emissions. */
+	for(State* p_state : dirty_states){
+		std::size_t raw_index = _model->states_indices.at(p_state->name());
+		if(p_state->is_silent()) { continue; }
+		Distribution* distribution = p_state->distribution().clone();
+		distribution->log_probabilities(true);
+		if(_brewed_normalize){
+			distribution->log_normalize();	
+		}
+		delete _model->B[raw_index];
+		_model->B[raw_index] = distribution;
+	}
+	/* Update the transitions rows. */
+	std::size_t num_states = _model->A.size();
+	if(_dirty_pi_begin){
+		std::fill(_model->pi_begin.begin(), _model->pi_begin.end(), utils::kNegInf);
+		double prob_sum = _fill_transitions(_graph->get_out_edges(_begin_state()), _model->pi_begin, _model->pi_end, _model->states_indices, _brewed_normalize);
+		if(prob_sum == 0.0) { throw std::logic_error("hmm has no begin transition"); }
+	}
+	for(std::size_t raw_index : _dirty_rows){
+		std::vector<double>& row = _model->A[raw_index];
+		std::fill(row.begin(), row.end(), utils::kNegInf);
+		_model->pi_end[raw_index] = utils::kNegInf;
+		State* p_state = _graph->get_vertex(State(_model->states_names[raw_index]));
+		double prob_sum = _fill_transitions(_graph->get_out_edges(*p_state), row, _model->pi_end, _model->states_indices, _brewed_normalize);
+		if(prob_sum == 0.0) { throw std::logic_error("hmm has no transition from " + p_state->to_string()); }
+	}
+	/* Determine whether the hmm is finite by summing the end state in transitions probabilities. */
+	double prob_sum_to_end = 0;
+	for(std::size_t i = 0; i < num_states; ++i) { prob_sum_to_end += exp(_model->pi_end[i]); }
+	_model->is_finite = prob_sum_to_end > 0.0;
+	return true;
+}
+
+void HiddenMarkovModel::_full_brew(bool normalize) {
 	/* Get rid of previous data. */
 	_model->clean();
 
 	/* Get the states from graph. */
-	std::vector<State*> states = _graph.get_vertices();
+	std::vector<State*> states = _graph->get_vertices();
 
 	/* Remove begin and end states. */
-	states.erase(std::remove_if(states.begin(), states.end(), [this](State* p_state){ return (*p_state) == begin() || (*p_state) == end(); }), states.end());
+	states.erase(std::remove_if(states.begin(), states.end(), [this](State* p_state){ return (*p_state) == _begin_state() || (*p_state) == _end_state(); }), states.end());
 	std::vector<State*> silent_states;
 	std::size_t num_states = states.size();
 
@@ -269,8 +596,8 @@ void HiddenMarkovModel::brew(bool normalize) {
 	bool finite = false;
 
 	/* Check if silent/end states are indeed silent. */
-	if(!begin().is_silent()) { throw std::logic_error("begin state has to be silent."); }
-	if(!end().is_silent()) { throw std::logic_error("end state has to be silent."); }
+	if(!_begin_state().is_silent()) { throw std::logic_error("begin state has to be silent."); }
+	if(!_end_state().is_silent()) { throw std::logic_error("end state has to be silent."); }
 
 	std::size_t normal_states_index = 0;
 	for(State* p_state : states){
@@ -295,7 +622,7 @@ void HiddenMarkovModel::brew(bool normalize) {
 	std::vector<State> silent_states_values;
 	silent_states_values.reserve(num_silent_states);
 	for(State* p_state : silent_states) { silent_states_values.push_back(*p_state); }
-	Graph<State> subgraph = _graph.sub_graph(silent_states_values);
+	Graph<State> subgraph = _graph->sub_graph(silent_states_values);
 	subgraph.topological_sort();
 	/* Get toposorted silent states. */
 	silent_states = subgraph.get_vertices();
@@ -307,53 +634,22 @@ void HiddenMarkovModel::brew(bool normalize) {
 		++silent_states_index;
 	}
 
-	/* Fill transitions with log probabilities and check whether a normalization is needed. */
-	auto fill_normalize = [this, &pi_end, &states_indices] (const std::vector<Edge<State>*>& edges, std::vector<double>& prob_vec_to_fill, bool normalize) {
-		std::vector<double> vec_to_normalize;
-		vec_to_normalize.reserve(edges.size());
-		double prob_sum = 0;
-		double prob;
-		for(Edge<State>* edge : edges){ 
-			prob = (edge->weight() == nullptr) ? 0 : *(edge->weight());
-			prob_sum += prob;
-			vec_to_normalize.push_back(log(prob));
-		}
-		if(prob_sum != 1.0 && normalize){
-			std::vector<double>::iterator it = vec_to_normalize.begin();
-			while(it != vec_to_normalize.end()){
-				*it = utils::log_normalize(*it, log(prob_sum));
-				++it;
-			}
-		}
-		std::size_t i = 0;
-		for(double& log_prob : vec_to_normalize){
-			if(*(edges[i]->to()) == end()){
-				pi_end[states_indices[edges[i]->from()->name()]] = log_prob;
-			}
-			else{
-				prob_vec_to_fill[states_indices[edges[i]->to()->name()]] = log_prob;
-			}
-			i++;
-		}
-		return prob_sum;
-	};
-
 	/* Add the begin state transitions. */
-	State& begin_state = begin();
-	if(_graph.get_in_edges(begin_state).size() > 0) { throw std::logic_error("begin state cannot have predecessors"); }
-	std::vector<Edge<State>*> out_edges = _graph.get_out_edges(begin_state);
-	double prob_sum = fill_normalize(out_edges, pi_begin, normalize);
+	State& begin_state = _begin_state();
+	if(_graph->get_in_edges(begin_state).size() > 0) { throw std::logic_error("begin state cannot have predecessors"); }
+	std::vector<Edge<State>*> out_edges = _graph->get_out_edges(begin_state);
+	double prob_sum = _fill_transitions(out_edges, pi_begin, pi_end, states_indices, normalize);
 	if(prob_sum == 0.0) { throw std::logic_error("hmm has no begin transition"); }
 	
 	/* Check if end state has out edges. */
-	State& end_state = end();
-	if(_graph.get_out_edges(end_state).size() > 0) { throw std::logic_error("end state cannot have successors"); }
+	State& end_state = _end_state();
+	if(_graph->get_out_edges(end_state).size() > 0) { throw std::logic_error("end state cannot have successors"); }
 
 	/* Iterate through all the other states and add them to the matrix. */
 	for(State* p_state : states){
 		/* Fill normal transitions aka matrix A. */
-		std::vector<Edge<State>*> out_edges = _graph.get_out_edges(*p_state);
-		double prob_sum = fill_normalize(out_edges, A[states_indices[p_state->name()]], normalize);
+		std::vector<Edge<State>*> out_edges = _graph->get_out_edges(*p_state);
+		double prob_sum = _fill_transitions(out_edges, A[states_indices[p_state->name()]], pi_end, states_indices, normalize);
 		if(prob_sum == 0.0) { throw std::logic_error("hmm has no transition from " + p_state->to_string()); }
 	}
 
@@ -379,7 +675,7 @@ void HiddenMarkovModel::brew(bool normalize) {
 	/* Get alphabet. Only discrete ! */
 	std::vector<std::string> alphabet;
 	for(const State* p_state : states){
-		if(! p_state->is_silent()){
+		if(! p_state->is_silent() && p_state->distribution().is_discrete()){
 			std::vector<std::string> dist_symbols = static_cast<DiscreteDistribution*>(&p_state->distribution())->symbols();
 			for(const std::string& symbol : dist_symbols){
 				if(std::find(alphabet.begin(), alphabet.end(), symbol) == alphabet.end()){
@@ -389,37 +685,55 @@ void HiddenMarkovModel::brew(bool normalize) {
 		}
 	}
 
-	/* Set free emissions. Only discrete ! */
+	/* Set free emissions, per symbol for the discrete distributions and per state for the continuous ones. */
 	std::vector<std::pair<std::size_t, std::string>> free_emissions;
+	std::vector<std::size_t> free_continuous_emissions;
 	for(const State* p_state : states){
-		if((! p_state->is_silent()) && p_state->has_free_emission()){
+		if((! p_state->is_silent()) && p_state->has_free_emission() && p_state->distribution().is_discrete()){
 			std::size_t state_id = states_indices[p_state->name()];
 			for(const std::string& symbol : alphabet){
 				free_emissions.push_back(std::make_pair(state_id, symbol));	
 			}
 		}
+		else if((! p_state->is_silent()) && p_state->has_free_emission() && p_state->distribution().is_continuous()){
+			free_continuous_emissions.push_back(states_indices[p_state->name()]);
+		}
 	}
+	std::sort(free_continuous_emissions.begin(), free_continuous_emissions.end());
 	
-	/* Set free transitions. */
+	/* Set free transitions. Keep the graph ids of the corresponding edges for the write-back. */
 	std::vector<std::pair<std::size_t, std::size_t>> free_transitions;
 	std::vector<std::size_t> free_pi_begin;
 	std::vector<std::size_t> free_pi_end;
+	_free_pi_begin_edges.clear();
+	_free_transitions_edges.clear();
+	_free_pi_end_edges.clear();
 	for(const State* p_state : states){
 		if(p_state->has_free_transition()){
 			std::size_t state_id = states_indices[p_state->name()];
-			auto out_edges = _graph.get_out_edges(*p_state);
-			for(auto& edge: out_edges){
-				if(*(edge->to()) == end()){ free_pi_end.push_back(state_id); }
-				else { free_transitions.push_back(std::make_pair(state_id, states_indices[edge->to()->name()])); }
+			for(std::size_t edge_id : _graph->out_edges_ids(*p_state)){
+				Edge<State>* edge = _graph->edge_at(edge_id);
+				if(*(edge->to()) == _end_state()){ 
+					free_pi_end.push_back(state_id); 
+					_free_pi_end_edges.push_back(edge_id);
+				}
+				else { 
+					free_transitions.push_back(std::make_pair(state_id, states_indices[edge->to()->name()])); 
+					_free_transitions_edges.push_back(edge_id);
+				}
 			}
 		}
 	}
-	if(begin().has_free_transition()){
-		auto begin_out_edges = _graph.get_out_edges(begin());
-		for(auto edge: begin_out_edges){
-			free_pi_begin.push_back(states_indices[edge->to()->name()]);
+	if(_begin_state().has_free_transition()){
+		for(std::size_t edge_id : _graph->out_edges_ids(_begin_state())){
+			free_pi_begin.push_back(states_indices[_graph->edge_at(edge_id)->to()->name()]);
+			_free_pi_begin_edges.push_back(edge_id);
 		}	
 	}
+	_raw_states_ids.assign(num_states, 0);
+	for(const State* p_state : states){
+		_raw_states_ids[states_indices[p_state->name()]] = _graph->vertex_id(*p_state);
+	}
 	
 	/* Set fields for the hmm raw values. */
 	_model->A = std::move(A);
@@ -432,9 +746,21 @@ void HiddenMarkovModel::brew(bool normalize) {
 	_model->silent_states_index = normal_states_index;
 	_model->alphabet = std::move(alphabet); // DISCRETE ONLY !!
 	_model->free_emissions = std::move(free_emissions);
+	_model->free_continuous_emissions = std::move(free_continuous_emissions);
 	_model->free_transitions = std::move(free_transitions);
 	_model->free_pi_begin = std::move(free_pi_begin);
 	_model->free_pi_end = std::move(free_pi_end);
+
+	/* Keep the values that require a full brew when changed. */
+	_brewed_normalize = normalize;
+	_brewed_begin_free_transition = _begin_state().has_free_transition();
+	_brewed_free_emissions.assign(num_states, false);
+	_brewed_free_transitions.assign(num_states, false);
+	for(const State* p_state : states){
+		std::size_t state_id = _model->states_indices[p_state->name()];
+		_brewed_free_emissions[state_id] = p_state->has_free_emission();
+		_brewed_free_transitions[state_id] = p_state->has_free_transition();
+	}
 }
 
 Matrix HiddenMarkovModel::raw_transitions() { return _model->A; }
@@ -447,25 +773,28 @@ std::vector<std::string> HiddenMarkovModel::states_names() { return _model->stat
 void HiddenMarkovModel::set_forward(const ForwardAlgorithm& forward) {
 	delete _forward_algorithm; 
 	_forward_algorithm = forward.clone();
-	_forward_algorithm->set_model(_model);
+	_forward_algorithm->set_model(_model.get());
+	_refresh_fixed_engine();
 }
 
 void HiddenMarkovModel::set_backward(const BackwardAlgorithm& backward) {
 	delete _backward_algorithm; 
 	_backward_algorithm = backward.clone();
-	_backward_algorithm->set_model(_model);
+	_backward_algorithm->set_model(_model.get());
+	_refresh_fixed_engine();
 }
 
 void HiddenMarkovModel::set_decoding(const DecodingAlgorithm& decode) {
 	delete _decoding_algorithm; 
 	_decoding_algorithm = decode.clone();
-	_decoding_algorithm->set_model(_model);
+	_decoding_algorithm->set_model(_model.get());
+	_refresh_fixed_engine();
 }
 
 void HiddenMarkovModel::set_training(const TrainingAlgorithm& training) {
 	delete _training_algorithm; 
 	_training_algorithm = training.clone();
-	_training_algorithm->set_model(_model);
+	_training_algorithm->set_model(_model.get());
 }
 
 std::string HiddenMarkovModel::forward_type() const 	{ return _forward_algorithm->type(); }
@@ -473,15 +802,35 @@ std::string HiddenMarkovModel::backward_type() const 	{ return _backward_algorit
 std::string HiddenMarkovModel::decoding_type() const 	{ return _decoding_algorithm->type(); }
 std::string HiddenMarkovModel::training_type() const 	{ return _training_algorithm->type(); }
 
+const ForwardAlgorithm& HiddenMarkovModel::forward_algorithm() const { return *_forward_algorithm; }
+const TrainingAlgorithm& HiddenMarkovModel::training_algorithm() const { return *_training_algorithm; }
+
+void HiddenMarkovModel::set_tracer(std::shared_ptr<instrumentation::Tracer> tracer) { _training_algorithm->set_tracer(tracer); }
+void HiddenMarkovModel::set_training_callback(const TrainingCallback& callback) { _training_algorithm->set_callback(callback); }
+void HiddenMarkovModel::set_checkpoint(const std::string& filename, unsigned int interval) { 
+	_training_algorithm->set_checkpoint(filename, interval); 
+}
+
+instrumentation::Statistics HiddenMarkovModel::statistics() { return instrumentation::statistics(); }
+void HiddenMarkovModel::reset_statistics() { instrumentation::reset(); }
+
 std::vector<double> HiddenMarkovModel::forward(const std::vector<std::string>& sequence, std::size_t t_max){
+	instrumentation::count(instrumentation::kSequences);
+	if(_fixed_engine) return _fixed_engine->forward(sequence, t_max);
 	return _forward_algorithm->forward(sequence, t_max);
 }
 
 std::vector<double> HiddenMarkovModel::backward(const std::vector<std::string>& sequence, std::size_t t_min){
+	instrumentation::count(instrumentation::kSequences);
+	if(_fixed_engine) return _fixed_engine->backward(sequence, t_min);
 	return _backward_algorithm->backward(sequence, t_min);
 }
 
 double HiddenMarkovModel::log_likelihood(const std::vector<std::string>& sequence, bool do_fwd){
+	instrumentation::count(instrumentation::kSequences);
+	if(_fixed_engine){
+		return (do_fwd) ? _fixed_engine->forward_log_likelihood(sequence) : _fixed_engine->backward_log_likelihood(sequence);
+	}
 	if(do_fwd){
 		return _forward_algorithm->log_likelihood(sequence);
 	}
@@ -491,6 +840,14 @@ double HiddenMarkovModel::log_likelihood(const std::vector<std::string>& sequenc
 }
 
 double HiddenMarkovModel::log_likelihood(const std::vector<std::vector<std::string>>& sequences, bool do_fwd){
+	if(_fixed_engine){
+		double likelihood = 0;
+		for(const std::vector<std::string>& sequence : sequences){
+			likelihood += log_likelihood(sequence, do_fwd);
+		}
+		return likelihood;
+	}
+	instrumentation::count(instrumentation::kSequences, sequences.size());
 	if(do_fwd){
 		return _forward_algorithm->log_likelihood(sequences);
 	}
@@ -507,7 +864,60 @@ double HiddenMarkovModel::likelihood(const std::vector<std::vector<std::string>>
 	return exp(log_likelihood(sequences, do_fwd));
 }
 
+std::vector<double> HiddenMarkovModel::forward(const std::vector<double>& sequence, std::size_t t_max){
+	return forward(FrameMatrix(sequence), t_max);
+}
+
+std::vector<double> HiddenMarkovModel::backward(const std::vector<double>& sequence, std::size_t t_min){
+	return backward(FrameMatrix(sequence), t_min);
+}
+
+double HiddenMarkovModel::log_likelihood(const std::vector<double>& sequence, bool do_fwd){
+	return log_likelihood(FrameMatrix(sequence), do_fwd);
+}
+
+std::pair<std::vector<std::string>, double> HiddenMarkovModel::decode(const std::vector<double>& sequence, std::size_t t_max){
+	return decode(FrameMatrix(sequence), t_max);
+}
+
+std::vector<double> HiddenMarkovModel::forward(const FrameMatrix& frames, std::size_t t_max){
+	instrumentation::count(instrumentation::kSequences);
+	return _forward_algorithm->forward(frames, t_max);
+}
+
+std::vector<double> HiddenMarkovModel::backward(const FrameMatrix& frames, std::size_t t_min){
+	instrumentation::count(instrumentation::kSequences);
+	return _backward_algorithm->backward(frames, t_min);
+}
+
+double HiddenMarkovModel::log_likelihood(const FrameMatrix& frames, bool do_fwd){
+	instrumentation::count(instrumentation::kSequences);
+	if(do_fwd){
+		return _forward_algorithm->log_likelihood(frames);
+	}
+	else{
+		return _backward_algorithm->log_likelihood(frames);
+	}
+}
+
+std::pair<std::vector<std::string>, double> HiddenMarkovModel::decode(const FrameMatrix& frames, std::size_t t_max){
+	instrumentation::count(instrumentation::kSequences);
+	return _decoding_algorithm->decode(frames, t_max);
+}
+
 std::pair<std::vector<std::string>, double> HiddenMarkovModel::decode(const std::vector<std::string>& sequence, std::size_t t_max){
+	instrumentation::count(instrumentation::kSequences);
+	if(_fixed_engine){
+		std::vector<std::size_t> path_indices;
+		double max_phi_T;
+		std::tie(path_indices, max_phi_T) = _fixed_engine->decode_indices(sequence, t_max);
+		std::vector<std::string> path;
+		path.reserve(path_indices.size());
+		for(std::size_t path_index : path_indices){
+			path.push_back(_model->states_names[path_index]);
+		}
+		return std::make_pair(path, max_phi_T);
+	}
 	return _decoding_algorithm->decode(sequence, t_max);
 }
 
@@ -515,12 +925,97 @@ double HiddenMarkovModel::train(const std::vector<std::vector<std::string>>& seq
 	double transition_pseudocount, double convergence_threshold,
 	unsigned int min_iterations, unsigned int max_iterations){
 
+		_detach_model();
+		_detach_graph();
 		double improvement = _training_algorithm->train(sequences, transition_pseudocount, convergence_threshold, min_iterations, max_iterations);
 		_update_from_raw();
+		_set_algorithms_model();
+		_refresh_fixed_engine();
 		return improvement;
 }
 
+double HiddenMarkovModel::train(const std::vector<std::vector<std::string>>& sequences, const std::vector<double>& weights,
+	double transition_pseudocount, double convergence_threshold,
+	unsigned int min_iterations, unsigned int max_iterations){
+
+		_detach_model();
+		_detach_graph();
+		double improvement = _training_algorithm->train(sequences, weights, transition_pseudocount, convergence_threshold, min_iterations, max_iterations);
+		_update_from_raw();
+		_set_algorithms_model();
+		_refresh_fixed_engine();
+		return improvement;
+}
+
+double HiddenMarkovModel::train(const std::vector<FrameMatrix>& sequences,
+	double transition_pseudocount, double convergence_threshold,
+	unsigned int min_iterations, unsigned int max_iterations){
+
+		_detach_model();
+		_detach_graph();
+		double improvement = _training_algorithm->train(sequences, transition_pseudocount, convergence_threshold, min_iterations, max_iterations);
+		_update_from_raw();
+		_set_algorithms_model();
+		_refresh_fixed_engine();
+		return improvement;
+}
+
+SufficientStatistics HiddenMarkovModel::expected_statistics(const std::vector<std::vector<std::string>>& sequences){
+	return expected_statistics(sequences, std::vector<double>(sequences.size(), 1.0));
+}
+
+SufficientStatistics HiddenMarkovModel::expected_statistics(const std::vector<std::vector<std::string>>& sequences, 
+	const std::vector<double>& weights){
+	return _training_algorithm->expected_statistics(sequences, weights);
+}
+
+void HiddenMarkovModel::maximize(const SufficientStatistics& statistics, double transition_pseudocount){
+	_detach_model();
+	_detach_graph();
+	_training_algorithm->maximize(statistics, transition_pseudocount);
+	_update_from_raw();
+	_set_algorithms_model();
+	_refresh_fixed_engine();
+}
+
 void HiddenMarkovModel::_update_from_raw(){
+	if(_topology_dirty || _free_pi_begin_edges.size() != _model->free_pi_begin.size() 
+		|| _free_transitions_edges.size() != _model->free_transitions.size() 
+		|| _free_pi_end_edges.size() != _model->free_pi_end.size()
+		|| _raw_states_ids.size() != _model->states_names.size()){
+		_update_from_raw_by_name();
+		return;
+	}
+	/* The i-th free parameter of the raw model is held by the i-th edge (or by the state) recorded at brew time. */
+	for(std::size_t begin_transition_id = 0; begin_transition_id < _model->free_pi_begin.size(); ++begin_transition_id){
+		_graph->edge_at(_free_pi_begin_edges[begin_transition_id])->set_weight(
+			exp(_model->pi_begin[_model->free_pi_begin[begin_transition_id]]));
+	}
+	for(std::size_t transition_id = 0; transition_id < _model->free_transitions.size(); ++transition_id){
+		const std::pair<std::size_t, std::size_t>& transition = _model->free_transitions[transition_id];
+		_graph->edge_at(_free_transitions_edges[transition_id])->set_weight(exp(_model->A[transition.first][transition.second]));
+	}
+	for(std::size_t end_transition_id = 0; end_transition_id < _model->free_pi_end.size(); ++end_transition_id){
+		_graph->edge_at(_free_pi_end_edges[end_transition_id])->set_weight(
+			exp(_model->pi_end[_model->free_pi_end[end_transition_id]]));
+	}
+	for(const std::pair<std::size_t, std::string>& emission : _model->free_emissions){
+		_graph->vertex_at(_raw_states_ids[emission.first])->distribution()[emission.second] = exp((*_model->B[emission.first])[emission.second]);
+	}
+	for(std::size_t state_id : _model->free_continuous_emissions){
+		_graph->vertex_at(_raw_states_ids[state_id])->set_distribution(*_continuous_distribution_from_raw(state_id));
+	}
+}
+
+std::unique_ptr<Distribution> HiddenMarkovModel::_continuous_distribution_from_raw(std::size_t state_id) const {
+	/* The raw distributions use log probabilities, the ones of the graph don't. */
+	std::unique_ptr<Distribution> distribution(_model->B[state_id]->clone());
+	distribution->log_probabilities(false);
+	return distribution;
+}
+
+void HiddenMarkovModel::_update_from_raw_by_name(){
+	_reindex_renamed_states();
 	/* Update transitions. Since we use log probabilities in the raw data, don't forget to exp() the log prob. */
 	std::string from_state_name, to_state_name;
 	std::size_t from_state_id, to_state_id;
@@ -530,7 +1025,7 @@ void HiddenMarkovModel::_update_from_raw(){
 		to_state_id = _model->free_pi_begin[begin_transition_id];
 		log_probability = _model->pi_begin[to_state_id];
 		to_state_name = _model->states_names[to_state_id];
-		_graph.set_weight(begin(), State(to_state_name), exp(log_probability));
+		_graph->set_weight(_begin_state(), State(to_state_name), exp(log_probability));
 	}
 	/* Update mid transitions. */
 	for(std::size_t transition_id = 0; transition_id < _model->free_transitions.size(); ++transition_id){
@@ -539,14 +1034,14 @@ void HiddenMarkovModel::_update_from_raw(){
 		log_probability = _model->A[from_state_id][to_state_id];
 		from_state_name = _model->states_names[from_state_id];
 		to_state_name = _model->states_names[to_state_id];
-		_graph.set_weight(State(from_state_name), State(to_state_name), exp(log_probability));
+		_graph->set_weight(State(from_state_name), State(to_state_name), exp(log_probability));
 	}
 	/* Update end transitions. */
 	for(std::size_t end_transition_id = 0; end_transition_id < _model->free_pi_end.size(); ++end_transition_id){
 		from_state_id = _model->free_pi_end[end_transition_id];
 		log_probability = _model->pi_end[from_state_id];
 		from_state_name = _model->states_names[from_state_id];
-		_graph.set_weight(State(from_state_name), end(), exp(log_probability));
+		_graph->set_weight(State(from_state_name), _end_state(), exp(log_probability));
 	}
 
 	/* Update emissions. */
@@ -558,7 +1053,11 @@ void HiddenMarkovModel::_update_from_raw(){
 		state_id = _model->free_emissions[emission_id].first;
 		state_name = _model->states_names[state_id];
 		symbol = _model->free_emissions[emission_id].second;
-		_graph.get_vertex(State(state_name))->distribution()[symbol] = exp((*_model->B[state_id])[symbol]);
+		_graph->get_vertex(State(state_name))->distribution()[symbol] = exp((*_model->B[state_id])[symbol]);
+	}
+	for(std::size_t continuous_state_id : _model->free_continuous_emissions){
+		_graph->get_vertex(State(_model->states_names[continuous_state_id]))->set_distribution(
+			*_continuous_distribution_from_raw(continuous_state_id));
 	}
 }
 
@@ -568,10 +1067,11 @@ void HiddenMarkovModel::save() {
 }
 
 void HiddenMarkovModel::save(const std::string& filename, const std::string& extension){
+	_reindex_renamed_states();
 	std::ofstream savefile(filename + "." + extension);
 	if(savefile.is_open()){
-		std::vector<State*> states = _graph.get_vertices();
-		states.erase(std::remove_if(states.begin(), states.end(), [this](State* p_state){ return (*p_state) == begin() || (*p_state) == end(); }), states.end());
+		std::vector<State*> states = _graph->get_vertices();
+		states.erase(std::remove_if(states.begin(), states.end(), [this](State* p_state){ return (*p_state) == _begin_state() || (*p_state) == _end_state(); }), states.end());
 		std::vector<Edge<State>*> edges;
 		/* Name */
 		savefile << _name << std::endl;
@@ -579,18 +1079,23 @@ void HiddenMarkovModel::save(const std::string& filename, const std::string& ext
 		savefile << _forward_algorithm->type() << std::endl;
 		savefile << _backward_algorithm->type() << std::endl;
 		savefile << _decoding_algorithm->type() << std::endl;
-		savefile << _training_algorithm->type() << std::endl;
+		savefile << _training_algorithm->type();
+		if(_training_algorithm->type() == hmm_config::kPathCountingViterbiTrainingAlgorithmName){
+			savefile << global_config::kProbabilitySeparator 
+				<< static_cast<const PathCountingViterbiTraining*>(_training_algorithm)->max_path_length();
+		}
+		savefile << std::endl;
 		/* Begin / end states names */
-		savefile << begin().name() << std::endl;
-		savefile << end().name() << std::endl;
+		savefile << _begin_state().name() << std::endl;
+		savefile << _end_state().name() << std::endl;
 		/* Number of non begin/end states */
 		savefile << states.size() << std::endl;
 		for(std::size_t i = 0; i < states.size(); ++i){
 			savefile << states[i]->name() << std::endl;
 		}
 		/* Begin transitions */
-		edges = _graph.get_out_edges(begin());
-		savefile << begin().name() << std::endl;
+		edges = _graph->get_out_edges(_begin_state());
+		savefile << _begin_state().name() << std::endl;
 		savefile << edges.size() << std::endl;
 		for(std::size_t j = 0; j < edges.size(); ++j){
 			Edge<State>& edge = *(edges[j]);
@@ -600,7 +1105,7 @@ void HiddenMarkovModel::save(const std::string& filename, const std::string& ext
 		for(std::size_t i = 0; i < states.size(); ++i){
 			State& s = *(states[i]);
 			savefile << s.name() << std::endl;
-			edges = _graph.get_out_edges(s);
+			edges = _graph->get_out_edges(s);
 			savefile << edges.size() << std::endl;
 			for(std::size_t j = 0; j < edges.size(); ++j){
 				Edge<State>& edge = *(edges[j]);
@@ -633,44 +1138,66 @@ void HiddenMarkovModel::load(const std::string& filename, const std::string& ext
 		std::string algo_type;
 		std::getline(loadfile, algo_type);
 		if(algo_type == hmm_config::kLinearMemoryForwardAlgorithmName){
-			set_forward(LinearMemoryForwardAlgorithm(_model));
+			set_forward(LinearMemoryForwardAlgorithm(_model.get()));
+		}
+		else if(algo_type == hmm_config::kCompiledForwardAlgorithmName){
+			set_forward(CompiledForwardAlgorithm(_model.get()));
+		}
+		else if(algo_type == hmm_config::kSinglePrecisionForwardAlgorithmName){
+			set_forward(SinglePrecisionForwardAlgorithm(_model.get()));
 		}
 		else{
 			std::cout << "Warning : unknown forward algorithm type. Defaults to linear memory forward." << std::endl;
-			set_forward(LinearMemoryForwardAlgorithm(_model));
+			set_forward(LinearMemoryForwardAlgorithm(_model.get()));
 		}
 		std::getline(loadfile, algo_type);
 		if(algo_type == hmm_config::kLinearMemoryBackwardAlgorithmName){
-			set_backward(LinearMemoryBackwardAlgorithm(_model));
+			set_backward(LinearMemoryBackwardAlgorithm(_model.get()));
 		}
 		else{
 			std::cout << "Warning : unknown backward algorithm type. Defaults to linear memory backward." << std::endl;
-			set_backward(LinearMemoryBackwardAlgorithm(_model));
+			set_backward(LinearMemoryBackwardAlgorithm(_model.get()));
 		}
 		std::getline(loadfile, algo_type);
 		if(algo_type == hmm_config::kLinearMemoryViterbiDecodeAlgorithmName){
-			set_decoding(LinearMemoryViterbiDecodingAlgorithm(_model));
+			set_decoding(LinearMemoryViterbiDecodingAlgorithm(_model.get()));
+		}
+		else if(algo_type == hmm_config::kCompiledViterbiDecodeAlgorithmName){
+			set_decoding(CompiledViterbiDecodingAlgorithm(_model.get()));
+		}
+		else if(algo_type == hmm_config::kSinglePrecisionViterbiDecodeAlgorithmName){
+			set_decoding(SinglePrecisionViterbiDecodingAlgorithm(_model.get()));
 		}
 		else{
 			std::cout << "Warning : unknown decoding algorithm type. Defaults to linear memory viterbi." << std::endl;
-			set_decoding(LinearMemoryViterbiDecodingAlgorithm(_model));
+			set_decoding(LinearMemoryViterbiDecodingAlgorithm(_model.get()));
 		}
-		std::getline(loadfile, algo_type);
+		/* Followed by the max path length of a path counting training, if any. */
+		std::string algo_parameter;
+		std::getline(loadfile, line);
+		std::tie(algo_type, algo_parameter) = utils::split_first(line, global_config::kProbabilitySeparator);
 		if(algo_type == hmm_config::kLinearMemoryViterbiTrainingAlgorithmName){
-			set_training(LinearMemoryViterbiTraining(_model));
+			set_training(LinearMemoryViterbiTraining(_model.get()));
 		}
 		else if(algo_type == hmm_config::kLinearMemoryBaumWelchTrainingAlgorithmName){
-			set_training(LinearMemoryBaumWelchTraining(_model));
+			set_training(LinearMemoryBaumWelchTraining(_model.get()));
+		}
+		else if(algo_type == hmm_config::kPathCountingViterbiTrainingAlgorithmName){
+			set_training(PathCountingViterbiTraining(_model.get(), (algo_parameter.empty()) ? 
+				hmm_config::kDefaultPathCountingMaxLength : (std::size_t) std::stoull(algo_parameter)));
 		}
 		else{
 			std::cout << "Warning : unknown decoding algorithm type. Defaults to linear memory viterbi." << std::endl;
-			set_training(LinearMemoryViterbiTraining(_model));
+			set_training(LinearMemoryViterbiTraining(_model.get()));
 		}
 		/* Begin / end states names */
 		std::getline(loadfile, line);
-		begin().set_name(line);
+		_detach_graph();
+		_begin_state().set_name(line);
 		std::getline(loadfile, line);
-		end().set_name(line);
+		_end_state().set_name(line);
+		/* Begin and end states were renamed in place. */
+		_graph->reindex();
 		/* Number of non begin/end states */
 		std::size_t num_states;
 		std::getline(loadfile, line);
@@ -694,7 +1221,7 @@ void HiddenMarkovModel::load(const std::string& filename, const std::string& ext
 			std::getline(loadfile, line);
 			std::tie(state_name, prob_str) = utils::split_first(line, global_config::kProbabilitySeparator);
 			if(prob_str != global_config::kNullValue && ! prob_str.empty()){
-				add_transition(begin(), state_name, std::stod(prob_str));
+				add_transition(_begin_state(), state_name, std::stod(prob_str));
 			}
 		}
 		
@@ -718,7 +1245,22 @@ void HiddenMarkovModel::load(const std::string& filename, const std::string& ext
 			else if(dist_name == distribution_config::kDiscreteDistributionName){
 				DiscreteDistribution dist = DiscreteDistribution();
 				dist.load(loadfile);
-				get_state(from_state).set_distribution(dist);
+				_graph->get_vertex(State(from_state))->set_distribution(dist);
+			}
+			else if(dist_name == distribution_config::kNormalDistributionName){
+				NormalDistribution dist = NormalDistribution();
+				dist.load(loadfile);
+				_graph->get_vertex(State(from_state))->set_distribution(dist);
+			}
+			else if(dist_name == distribution_config::kUniformDistributionName){
+				UniformDistribution dist = UniformDistribution();
+				dist.load(loadfile);
+				_graph->get_vertex(State(from_state))->set_distribution(dist);
+			}
+			else if(dist_name == distribution_config::kGaussianMixtureDistributionName){
+				GaussianMixtureDistribution dist = GaussianMixtureDistribution();
+				dist.load(loadfile);
+				_graph->get_vertex(State(from_state))->set_distribution(dist);
 			}
 		}
 		loadfile.close();
@@ -731,7 +1273,6 @@ void HiddenMarkovModel::load(const std::string& filename, const std::string& ext
 HiddenMarkovModel::~HiddenMarkovModel(){
 	delete _forward_algorithm; delete _backward_algorithm; 
 	delete _decoding_algorithm; delete _training_algorithm;
-	delete _model;
 }
 
 
@@ -14,6 +14,7 @@
 #include <memory> // std::shared_ptr
 #include <iomanip> // std::setprecision
 #include <tuple>
+#include <set>
 #include <fstream>
 #include "constants.hpp"
 #include "state.hpp"
@@ -21,6 +22,11 @@
 #include "utils.hpp"
 #include "hmm_algorithms.hpp"
 #include "hmm_base.hpp"
+#include "fixed_size_model.hpp"
+#include "compiled_model.hpp"
+#include "scalar_model.hpp"
+#include "instrumentation.hpp"
+#include "cpu_dispatch.hpp"
 
 #define CYAN "\033[36m"
 #define RESET "\033[0m"
@@ -74,6 +80,13 @@ public:
 		HMMException(error_message::format("TransitionLogicException: " + msg, t)) {}
 };
 
+class ModelDimensionException : public HMMException {
+public:
+	template<typename T>
+	ModelDimensionException(const T& t, const std::string& msg) : 
+		HMMException(error_message::format("ModelDimensionException: " + msg, t)) {}
+};
+
 /* <----------------------------> */
 
 class HiddenMarkovModel {
@@ -84,11 +97,11 @@ class HiddenMarkovModel {
 	State* _begin;
 	State* _end;
 
-	/* Holds the states and the transitions when building the hmm. */
-	Graph<State> _graph;	
+	/* Holds the states and the transitions when building the hmm. Shared between copies until modified. */
+	std::shared_ptr<Graph<State>> _graph;	
 
-	/* Generated via brew() */
-	RawModel* _model;
+	/* Generated via brew(). Shared between copies until modified. */
+	std::shared_ptr<RawModel> _model;
 
 	/* Algorithms */
 	ForwardAlgorithm* _forward_algorithm;
@@ -96,8 +109,71 @@ class HiddenMarkovModel {
 	DecodingAlgorithm* _decoding_algorithm;
 	TrainingAlgorithm* _training_algorithm;
 
+	/* Compile-time sized forward, backward and decode used in place of the default algorithms when the 
+	brewed model is small enough (see make_fixed_size_engine). Immutable, hence shared between copies. */
+	std::shared_ptr<const FixedSizeEngine> _fixed_engine;
+
+	/* Dirty state since the last brew, used by brew() to only update the affected parts of the RawModel. 
+	Rows and emissions are identified by their raw index. */
+	bool _topology_dirty;
+	bool _dirty_pi_begin;
+	std::set<std::size_t> _dirty_rows;
+	std::set<std::size_t> _dirty_emissions;
+	/* Values at the last brew that, when changed, require a full brew. */
+	bool _brewed_normalize;
+	bool _brewed_begin_free_transition;
+	std::vector<bool> _brewed_free_emissions;
+	std::vector<bool> _brewed_free_transitions;
+
+	/* Graph ids of the free parameters at the last full brew, parallel to the RawModel free lists, and graph 
+	ids of the states by raw index. Used by train() to write the trained values back in a linear pass. */
+	std::vector<std::size_t> _free_pi_begin_edges;
+	std::vector<std::size_t> _free_transitions_edges;
+	std::vector<std::size_t> _free_pi_end_edges;
+	std::vector<std::size_t> _raw_states_ids;
+
+	/* States handed out by begin, end and get_state, which may be modified through the returned references at any 
+	time. A graph holding such states is not shared : the copies of this hmm get their own graph right away. */
+	std::set<State*> _exposed_states;
+	/* State::renames() when the graph was last reindexed for the states handed out. */
+	mutable std::size_t _indexed_renames;
+
 	/* Helper method. Used by train() to update the HMM values (i.e. its graph and PDFs) from the RawModel. */
 	void _update_from_raw();
+	/* Same as above but looks the states and transitions up by name. Used when the topology changed since the last brew. */
+	void _update_from_raw_by_name();
+	/* Copy, without log probabilities, of the raw distribution of a state with free continuous emissions. */
+	std::unique_ptr<Distribution> _continuous_distribution_from_raw(std::size_t state_id) const;
+
+	/* Copy-on-write. Give this hmm its own copy of the graph (resp. raw model) if it is shared with another hmm. 
+	Must be called before any modification. */
+	void _detach_graph();
+	void _detach_model();
+	/* Reindexes the graph if one of the states handed out may have been renamed. Must be called before looking 
+	states up in the graph. */
+	void _reindex_renamed_states() const;
+	/* Points the algorithms to _model, e.g. after it was detached or modified in place. */
+	void _set_algorithms_model();
+
+	/* Begin and end states without detaching the graph. For read only use. */
+	State& _begin_state() const;
+	State& _end_state() const;
+
+	/* Helper methods used by brew(). */
+	void _full_brew(bool normalize);
+	bool _incremental_brew();
+	void _clear_dirty();
+	/* Marks dirty the given states (handed out by begin, end or get_state) that were modified since the last brew. */
+	void _mark_modified_states(const std::set<State*>& states);
+	bool _modified_since_brew(const State& state, std::size_t raw_index) const;
+	/* Rebuilds _fixed_engine from the RawModel. Only keeps one if the algorithms in use are the default ones. */
+	void _refresh_fixed_engine();
+	/* Fills the given transitions row (and the pi_end entries) with the log probabilities of the given edges. 
+	Returns the sum of the edges probabilities. */
+	double _fill_transitions(const std::vector<Edge<State>*>& edges, std::vector<double>& row, std::vector<double>& pi_end, 
+		const std::map<std::string, std::size_t>& states_indices, bool normalize);
+	/* Returns the raw index of the given state or the number of raw states if it was not brewed. */
+	std::size_t _raw_index(const State& state) const;
 
 public:
 	/* Constructors */
@@ -112,6 +188,19 @@ public:
 	HiddenMarkovModel& operator=(const HiddenMarkovModel& other);
 	HiddenMarkovModel& operator=(HiddenMarkovModel&& other);
 
+	/* Builds a brewed hmm from its matrices in a single pass, without the per transition checks of 
+	add_transition. The i-th state is named names[i]. A[i][j] is the probability of the transition from 
+	the i-th to the j-th state, pi_begin[i] (resp. pi_end[i]) the probability of the transition from the 
+	begin state to the i-th state (resp. from the i-th state to the end state). Null probabilities mean
+	that there is no transition. The i-th state is silent if silent_mask[i] is true, else it emits 
+	following emissions[i]. Throws an exception if the dimensions do not match, if a name is duplicated 
+	or reserved for the begin/end states or if a probability is negative. */
+	static HiddenMarkovModel from_matrices(
+		const std::vector<std::string>& names, const Matrix& A,
+		const std::vector<double>& pi_begin, const std::vector<double>& pi_end,
+		const std::vector<DiscreteDistribution>& emissions, const std::vector<bool>& silent_mask,
+		const std::string& name = hmm_config::kDefaultHMMName);
+
 	/* Name getter / setter */
 	std::string name() const;
 	void set_name(const std::string& name);
@@ -129,6 +218,8 @@ public:
 	/* True if the hmm contains a transition from from_state to to_state*/
 	bool has_transition(const State& from_state, const State& to_state) const;
 
+	/* The begin, end and get_state methods return a modifiable state, which detaches a graph shared with copies. The
+	returned state stays attached to this hmm : the copies made afterwards do not see its modifications. */
 	/* Returns the begin state of the hmm. Throws an exception if it is null (when removed). */
 	State& begin();
 	/* Returns the end state of the hmm. Throws an exception if it is null (when removed). */
@@ -166,7 +257,11 @@ public:
 	/* Prepares the hmm before calling algorithms on it. This method MUST always be called before any
 	algorithm is called. This is because all the hmm algorithms use the RawModel attribute that is initialized
 	by this method. If normalize is true then the probabilies will be normalized, ex if State s has 2 out transitions
-	witch each a probability of 2, each is set to have a probability of 0.5. */
+	witch each a probability of 2, each is set to have a probability of 0.5. 
+	The RawModel is only rebuilt when the topology changed since the last brew (states or transitions added or 
+	removed, silent or free status, names or alphabet changed, different normalize). Otherwise only the rows 
+	of the transitions set with set_transition and the emissions of the states obtained with get_state that 
+	were modified (at any time, through any reference) are updated. */
 	void brew(bool normalize = true);
 
 	/* RawModel getters */
@@ -189,6 +284,31 @@ public:
 	std::string decoding_type() const;
 	std::string training_type() const;
 
+	/* The forward algorithm in use, e.g. to read the statistics of a PrefixCachedForwardAlgorithm. */
+	const ForwardAlgorithm& forward_algorithm() const;
+	/* The training algorithm in use, e.g. to read the max path length of a PathCountingViterbiTraining. */
+	const TrainingAlgorithm& training_algorithm() const;
+
+	/* Records the timeline of the next trainings in tracer (see instrumentation::Tracer), or stops recording if null. 
+	Attached to the training algorithm in use : a later set_training keeps the tracer of the given algorithm. */
+	void set_tracer(std::shared_ptr<instrumentation::Tracer> tracer);
+	/* Called after each iteration of the next trainings with their progress (see TrainingProgress), e.g. to save the 
+	model or to stop a training which diverges or exceeds its time budget by returning false. Attached to the training 
+	algorithm in use, as the tracer. */
+	void set_training_callback(const TrainingCallback& callback);
+	/* Checkpoints of the next trainings on symbols, saved in filename every interval iterations and when the callback
+	stops them, and removed when they complete : a training of the same initial model started again with the same 
+	sequences after an interruption resumes from the checkpoint and gives the same model as an uninterrupted one. 
+	Attached to the training algorithm in use, as the tracer. */
+	void set_checkpoint(const std::string& filename, unsigned int interval = hmm_config::kDefaultCheckpointInterval);
+
+	/* Counters (cells computed, sum_log_prob calls, traceback nodes, sequences) and time of the phases of the algorithms
+	(init, step and terminate of the recursions, E-step, M-step and likelihood of the trainings), summed over all the
+	hmms of the process since the last reset. Only collected when the library is built with HMM_INSTRUMENTATION 
+	("make INSTRUMENT=1"), else all null. */
+	static instrumentation::Statistics statistics();
+	static void reset_statistics();
+
 	/* Interface calling the algorithms */
 	
 	/* Calls the forward algorithm on given sequence. t_max is the t at which the forward 
@@ -213,17 +333,56 @@ public:
 	Retunrs the optimal state path and its likelihood. */
 	std::pair<std::vector<std::string>, double> decode(const std::vector<std::string>& sequence, std::size_t t_max = 0);
 
+	/* Same as above for sequences of numeric observations, emitted by states with continuous distributions (e.g. 
+	NormalDistribution or UniformDistribution). The emissions of all the states are evaluated with their batched 
+	log_pdf. Only supported by the linear memory algorithms. */
+	std::vector<double> forward(const std::vector<double>& sequence, std::size_t t_max = 0);
+	std::vector<double> backward(const std::vector<double>& sequence, std::size_t t_min = 0);
+	double log_likelihood(const std::vector<double>& sequence, bool do_fwd = true);
+	std::pair<std::vector<std::string>, double> decode(const std::vector<double>& sequence, std::size_t t_max = 0);
+
+	/* Same as above for sequences of multivariate observations (e.g. feature frames), emitted by states with 
+	distributions of the dimension of the frames (e.g. GaussianMixtureDistribution). */
+	std::vector<double> forward(const FrameMatrix& frames, std::size_t t_max = 0);
+	std::vector<double> backward(const FrameMatrix& frames, std::size_t t_min = 0);
+	double log_likelihood(const FrameMatrix& frames, bool do_fwd = true);
+	std::pair<std::vector<std::string>, double> decode(const FrameMatrix& frames, std::size_t t_max = 0);
+
 	/* Calls the training algorithm on the given set of training sequences. Return the obtained improvement. */
 	double train(const std::vector<std::vector<std::string>>& sequences,
 		double transition_pseudocount = hmm_config::kDefaultTransitionPseudocount,
 		double convergence_threshold = hmm_config::kDefaultConvergenceThreshold,
 		unsigned int min_iterations = hmm_config::kDefaultMinIterations, 
 		unsigned int max_iterations = hmm_config::kDefaultMaxIterations);
+	/* Same as above, each sequence counting as many times as its weight (e.g. its number of occurrences). The weights 
+	must be non negative, one per sequence. Identical sequences are counted once per iteration with the sum of their 
+	weights, which is also done by the unweighted training. */
+	double train(const std::vector<std::vector<std::string>>& sequences, const std::vector<double>& weights,
+		double transition_pseudocount = hmm_config::kDefaultTransitionPseudocount,
+		double convergence_threshold = hmm_config::kDefaultConvergenceThreshold,
+		unsigned int min_iterations = hmm_config::kDefaultMinIterations, 
+		unsigned int max_iterations = hmm_config::kDefaultMaxIterations);
+	/* One E-step of the training algorithm on the given sequences (e.g. a shard of the corpus) with the current model :
+	the expected counts of the free parameters and the log likelihood of the sequences, which can be saved, sent to 
+	another process and merged with the statistics of the other shards (see SufficientStatistics). */
+	SufficientStatistics expected_statistics(const std::vector<std::vector<std::string>>& sequences);
+	SufficientStatistics expected_statistics(const std::vector<std::vector<std::string>>& sequences, const std::vector<double>& weights);
+	/* M-step : re-estimates the free parameters from statistics computed on this model, usually merged from all the 
+	shards. An iteration of sharded training is expected_statistics on each shard, merge, then maximize. */
+	void maximize(const SufficientStatistics& statistics, double transition_pseudocount = hmm_config::kDefaultTransitionPseudocount);
+	/* Same as above for numeric sequences. Only supported by the Baum-Welch training, which re-estimates the free 
+	normal and Gaussian mixture emissions (uniform emissions stay fixed). */
+	double train(const std::vector<FrameMatrix>& sequences,
+		double transition_pseudocount = hmm_config::kDefaultTransitionPseudocount,
+		double convergence_threshold = hmm_config::kDefaultConvergenceThreshold,
+		unsigned int min_iterations = hmm_config::kDefaultMinIterations, 
+		unsigned int max_iterations = hmm_config::kDefaultMaxIterations);
 
 	/* IO operations */
 	/* Save the hmm. The file name is the HMM name with the default hmm extension. */
 	void save();
-	/* Saves the hmm in the given filename with given extension. */
+	/* Saves the hmm in the given filename with given extension. The max path length of a PathCountingViterbiTraining is
+	saved next to its name. */
 	void save(const std::string& filename, const std::string& extension = global_config::kDefaultFileExtension);
 	/* Sets this HMM to the values of the HMM contained in the given filegit . */
 	void load(const std::string& filename, const std::string& extension = global_config::kDefaultFileExtension);
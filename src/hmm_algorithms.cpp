@@ -10,12 +10,18 @@
 #include <memory> // std::shared_ptr
 #include <iomanip> // std::setprecision
 #include <tuple>
+#include <map>
 #include <iostream>
 #include <ctime>
+#include <cstdlib> // std::strtod
+#include <cstdio> // std::rename
+#include <fstream>
+#include <limits>
 #include "utils.hpp"
 #include "constants.hpp"
 #include "hmm_algorithms.hpp"
 #include "hmm_base.hpp"
+#include "instrumentation.hpp"
 
 
 /* ===================== BASE CLASSES ===================== */
@@ -28,43 +34,601 @@ void HMMAlgorithm::set_model(RawModel* model) { _model = model; }
 HMMAlgorithm::~HMMAlgorithm() {}
 
 ForwardAlgorithm::ForwardAlgorithm(const std::string& name, RawModel* model) : HMMAlgorithm(name, model) {}
+std::vector<double> ForwardAlgorithm::forward(const FrameMatrix&, std::size_t) {
+	throw std::logic_error(error_message::format(error_message::kAlgorithmNumericSequenceNotSupported, name()));
+}
+double ForwardAlgorithm::log_likelihood(const FrameMatrix&) {
+	throw std::logic_error(error_message::format(error_message::kAlgorithmNumericSequenceNotSupported, name()));
+}
 ForwardAlgorithm::~ForwardAlgorithm() {}
 
 BackwardAlgorithm::BackwardAlgorithm(const std::string& name, RawModel* model) : HMMAlgorithm(name, model) {}
+std::vector<double> BackwardAlgorithm::backward(const FrameMatrix&, std::size_t) {
+	throw std::logic_error(error_message::format(error_message::kAlgorithmNumericSequenceNotSupported, name()));
+}
+double BackwardAlgorithm::log_likelihood(const FrameMatrix&) {
+	throw std::logic_error(error_message::format(error_message::kAlgorithmNumericSequenceNotSupported, name()));
+}
 BackwardAlgorithm::~BackwardAlgorithm() {}
 
 DecodingAlgorithm::DecodingAlgorithm(const std::string& name, RawModel* model) : HMMAlgorithm(name, model) {}
+std::pair<std::vector<std::string>, double> DecodingAlgorithm::decode(const FrameMatrix&, std::size_t) {
+	throw std::logic_error(error_message::format(error_message::kAlgorithmNumericSequenceNotSupported, name()));
+}
 DecodingAlgorithm::~DecodingAlgorithm() {}
 
-TrainingAlgorithm::TrainingAlgorithm(const std::string& name, RawModel* model) : HMMAlgorithm(name, model) {}
+TrainingAlgorithm::TrainingAlgorithm(const std::string& name, RawModel* model) : HMMAlgorithm(name, model), _tracer(), _callback(),
+	_checkpoint_filename(), _checkpoint_interval(hmm_config::kDefaultCheckpointInterval) {}
+void TrainingAlgorithm::set_tracer(std::shared_ptr<instrumentation::Tracer> tracer) { _tracer = tracer; }
+std::shared_ptr<instrumentation::Tracer> TrainingAlgorithm::tracer() const { return _tracer; }
+void TrainingAlgorithm::set_callback(const TrainingCallback& callback) { _callback = callback; }
+bool TrainingAlgorithm::_keep_training(unsigned int iteration, double log_likelihood, double delta, 
+	std::chrono::steady_clock::time_point start) const {
+	if(! _callback) return true;
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return _callback(TrainingProgress{iteration, log_likelihood, delta, elapsed, _model});
+}
+void TrainingAlgorithm::set_checkpoint(const std::string& filename, unsigned int interval) {
+	_checkpoint_filename = filename;
+	_checkpoint_interval = interval;
+}
+
+/* FNV-1a, the same on every run and platform. */
+static const std::uint64_t __kHashOffset = 14695981039346656037ULL;
+
+static std::uint64_t __hash(std::uint64_t hash, const void* data, std::size_t size){
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for(std::size_t i = 0; i < size; ++i){
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static std::uint64_t __hash(std::uint64_t hash, std::uint64_t value){
+	return __hash(hash, &value, sizeof(value));
+}
+
+static std::uint64_t __hash(std::uint64_t hash, const std::string& value){
+	return __hash(__hash(hash, (std::uint64_t) value.size()), value.data(), value.size());
+}
+
+std::uint64_t TrainingAlgorithm::_corpus_hash(const std::vector<std::vector<std::string>>& sequences, const std::vector<double>& weights){
+	std::uint64_t hash = __hash(__kHashOffset, (std::uint64_t) sequences.size());
+	for(std::size_t s = 0; s < sequences.size(); ++s){
+		hash = __hash(hash, (std::uint64_t) sequences[s].size());
+		for(const std::string& symbol : sequences[s]){
+			hash = __hash(hash, symbol);
+		}
+		if(s < weights.size()) hash = __hash(hash, &weights[s], sizeof(double));
+	}
+	return hash;
+}
+
+std::uint64_t TrainingAlgorithm::_model_hash() const {
+	std::uint64_t hash = __hash(__hash(__kHashOffset, (std::uint64_t) _model->A.size()), (std::uint64_t) _model->silent_states_index);
+	for(std::size_t state_id : _model->free_pi_begin){
+		hash = __hash(hash, (std::uint64_t) state_id);
+	}
+	for(const std::pair<std::size_t, std::size_t>& transition : _model->free_transitions){
+		hash = __hash(__hash(hash, (std::uint64_t) transition.first), (std::uint64_t) transition.second);
+	}
+	for(std::size_t state_id : _model->free_pi_end){
+		hash = __hash(hash, (std::uint64_t) state_id);
+	}
+	for(const std::pair<std::size_t, std::string>& emission : _model->free_emissions){
+		hash = __hash(__hash(hash, (std::uint64_t) emission.first), emission.second);
+	}
+	return hash;
+}
+
+std::uint64_t TrainingAlgorithm::_parameters_hash() const {
+	TrainingCheckpoint parameters;
+	_save_parameters(parameters);
+	std::uint64_t hash = __kHashOffset;
+	for(const std::vector<double>* values : {&parameters.begin_parameters, &parameters.transition_parameters, 
+		&parameters.end_parameters, &parameters.emission_parameters}){
+		hash = __hash(__hash(hash, (std::uint64_t) values->size()), values->data(), values->size() * sizeof(double));
+	}
+	return hash;
+}
+
+void TrainingAlgorithm::_save_parameters(TrainingCheckpoint& checkpoint) const {
+	checkpoint.begin_parameters.clear();
+	checkpoint.transition_parameters.clear();
+	checkpoint.end_parameters.clear();
+	checkpoint.emission_parameters.clear();
+	for(std::size_t state_id : _model->free_pi_begin){
+		checkpoint.begin_parameters.push_back(_model->pi_begin[state_id]);
+	}
+	for(const std::pair<std::size_t, std::size_t>& transition : _model->free_transitions){
+		checkpoint.transition_parameters.push_back(_model->A[transition.first][transition.second]);
+	}
+	for(std::size_t state_id : _model->free_pi_end){
+		checkpoint.end_parameters.push_back(_model->pi_end[state_id]);
+	}
+	for(const std::pair<std::size_t, std::string>& emission : _model->free_emissions){
+		checkpoint.emission_parameters.push_back((*(_model->B[emission.first]))[emission.second]);
+	}
+}
+
+bool TrainingAlgorithm::_resume(std::uint64_t corpus_hash, std::uint64_t& parameters_hash, unsigned int& iteration, 
+	double& initial_likelihood, double& log_likelihood, double& delta){
+	if(_checkpoint_filename.empty() || ! std::ifstream(_checkpoint_filename, std::ios::binary).is_open()) { return false; }
+	TrainingCheckpoint checkpoint = TrainingCheckpoint::load(_checkpoint_filename);
+	if(checkpoint.model_hash != _model_hash() || checkpoint.corpus_hash != corpus_hash 
+		|| checkpoint.begin_parameters.size() != _model->free_pi_begin.size() 
+		|| checkpoint.transition_parameters.size() != _model->free_transitions.size() 
+		|| checkpoint.end_parameters.size() != _model->free_pi_end.size() 
+		|| checkpoint.emission_parameters.size() != _model->free_emissions.size()){
+		throw std::invalid_argument(error_message::format(error_message::kCheckpointMismatch, _checkpoint_filename));
+	}
+	if(checkpoint.parameters_hash != parameters_hash){
+		/* Not the initial model, nor the model saved by the checkpoint : a stale checkpoint of another training. */
+		TrainingCheckpoint current;
+		_save_parameters(current);
+		if(current.begin_parameters != checkpoint.begin_parameters 
+			|| current.transition_parameters != checkpoint.transition_parameters 
+			|| current.end_parameters != checkpoint.end_parameters 
+			|| current.emission_parameters != checkpoint.emission_parameters){
+			throw std::invalid_argument(error_message::format(error_message::kCheckpointMismatch, _checkpoint_filename));
+		}
+	}
+	for(std::size_t id = 0; id < _model->free_pi_begin.size(); ++id){
+		_model->pi_begin[_model->free_pi_begin[id]] = checkpoint.begin_parameters[id];
+	}
+	for(std::size_t id = 0; id < _model->free_transitions.size(); ++id){
+		_model->A[_model->free_transitions[id].first][_model->free_transitions[id].second] = checkpoint.transition_parameters[id];
+	}
+	for(std::size_t id = 0; id < _model->free_pi_end.size(); ++id){
+		_model->pi_end[_model->free_pi_end[id]] = checkpoint.end_parameters[id];
+	}
+	for(std::size_t id = 0; id < _model->free_emissions.size(); ++id){
+		(*(_model->B[_model->free_emissions[id].first]))[_model->free_emissions[id].second] = checkpoint.emission_parameters[id];
+	}
+	/* As after the M-step of the checkpointed iteration. */
+	_model->compute_envelope();
+	_model->compute_silent_closure();
+	parameters_hash = checkpoint.parameters_hash;
+	iteration = checkpoint.iteration;
+	initial_likelihood = checkpoint.initial_likelihood;
+	log_likelihood = checkpoint.log_likelihood;
+	delta = checkpoint.delta;
+	return true;
+}
+
+void TrainingAlgorithm::_checkpoint(std::uint64_t corpus_hash, std::uint64_t parameters_hash, unsigned int iteration, 
+	double initial_likelihood, double log_likelihood, double delta, bool last) const {
+	if(_checkpoint_filename.empty()) { return; }
+	bool periodic = _checkpoint_interval > 0 && iteration % _checkpoint_interval == 0;
+	if(periodic == last) { return; }
+	TrainingCheckpoint checkpoint;
+	checkpoint.model_hash = _model_hash();
+	checkpoint.corpus_hash = corpus_hash;
+	checkpoint.parameters_hash = parameters_hash;
+	checkpoint.iteration = iteration;
+	checkpoint.initial_likelihood = initial_likelihood;
+	checkpoint.log_likelihood = log_likelihood;
+	checkpoint.delta = delta;
+	_save_parameters(checkpoint);
+	checkpoint.save(_checkpoint_filename);
+}
+
+void TrainingAlgorithm::_remove_checkpoint() const {
+	if(_checkpoint_filename.empty()) { return; }
+	std::remove(_checkpoint_filename.c_str());
+	std::remove((_checkpoint_filename + ".tmp").c_str());
+}
+
+SufficientStatistics TrainingAlgorithm::expected_statistics(const std::vector<std::vector<std::string>>&, const std::vector<double>&) {
+	throw std::logic_error(error_message::format(error_message::kAlgorithmSufficientStatisticsNotSupported, name()));
+}
+void TrainingAlgorithm::maximize(const SufficientStatistics&, double) {
+	throw std::logic_error(error_message::format(error_message::kAlgorithmSufficientStatisticsNotSupported, name()));
+}
+double TrainingAlgorithm::train(const std::vector<std::vector<std::string>>& sequences, double transition_pseudocount, 
+	double convergence_threshold, unsigned int min_iterations, unsigned int max_iterations) {
+	return train(sequences, std::vector<double>(sequences.size(), 1.0), transition_pseudocount, convergence_threshold, 
+		min_iterations, max_iterations);
+}
+double TrainingAlgorithm::train(const std::vector<FrameMatrix>&, double, double, unsigned int, unsigned int) {
+	throw std::logic_error(error_message::format(error_message::kAlgorithmNumericSequenceNotSupported, name()));
+}
 TrainingAlgorithm::~TrainingAlgorithm() {}
 
 
+/* ===================== SUFFICIENT STATISTICS ===================== */
+
+SufficientStatistics::SufficientStatistics() : log_counts(false), total_weight(0.0), log_likelihood(0.0), 
+	begin_counts(), transition_counts(), end_counts(), emission_counts() {}
+
+static void __merge_counts(std::vector<double>& counts, const std::vector<double>& other_counts, bool log_counts){
+	for(std::size_t i = 0; i < counts.size(); ++i){
+		counts[i] = (log_counts) ? utils::sum_log_prob(counts[i], other_counts[i]) : counts[i] + other_counts[i];
+	}
+}
+
+void SufficientStatistics::merge(const SufficientStatistics& other){
+	if(log_counts != other.log_counts || begin_counts.size() != other.begin_counts.size() 
+		|| transition_counts.size() != other.transition_counts.size() || end_counts.size() != other.end_counts.size() 
+		|| emission_counts.size() != other.emission_counts.size()){
+		throw std::invalid_argument(error_message::kSufficientStatisticsMismatch);
+	}
+	total_weight += other.total_weight;
+	log_likelihood += other.log_likelihood;
+	__merge_counts(begin_counts, other.begin_counts, log_counts);
+	__merge_counts(transition_counts, other.transition_counts, log_counts);
+	__merge_counts(end_counts, other.end_counts, log_counts);
+	__merge_counts(emission_counts, other.emission_counts, log_counts);
+}
+
+static void __save_counts(std::ostream& out, const std::string& label, const std::vector<double>& counts){
+	out << label << " " << counts.size();
+	for(double count : counts){
+		out << " " << count;
+	}
+	out << std::endl;
+}
+
+/* Reads the infinite log counts as well, which operator>> does not. */
+static double __load_value(std::istream& in){
+	std::string token;
+	if(! (in >> token)) throw std::invalid_argument(error_message::kSufficientStatisticsMalformed);
+	char* end = nullptr;
+	double value = std::strtod(token.c_str(), &end);
+	if(end == token.c_str() || *end != '\0') throw std::invalid_argument(error_message::kSufficientStatisticsMalformed);
+	return value;
+}
+
+static void __expect(std::istream& in, const std::string& label){
+	std::string token;
+	if(! (in >> token) || token != label) throw std::invalid_argument(error_message::kSufficientStatisticsMalformed);
+}
+
+static std::vector<double> __load_counts(std::istream& in, const std::string& label){
+	__expect(in, label);
+	std::size_t size;
+	if(! (in >> size)) throw std::invalid_argument(error_message::kSufficientStatisticsMalformed);
+	std::vector<double> counts;
+	for(std::size_t i = 0; i < size; ++i){
+		counts.push_back(__load_value(in));
+	}
+	return counts;
+}
+
+void SufficientStatistics::save(std::ostream& out) const {
+	std::streamsize precision = out.precision(std::numeric_limits<double>::max_digits10);
+	out << "sufficient_statistics" << std::endl;
+	out << "log_counts " << log_counts << std::endl;
+	out << "total_weight " << total_weight << std::endl;
+	out << "log_likelihood " << log_likelihood << std::endl;
+	__save_counts(out, "begin", begin_counts);
+	__save_counts(out, "transitions", transition_counts);
+	__save_counts(out, "end", end_counts);
+	__save_counts(out, "emissions", emission_counts);
+	out.precision(precision);
+}
+
+SufficientStatistics SufficientStatistics::load(std::istream& in){
+	SufficientStatistics statistics;
+	__expect(in, "sufficient_statistics");
+	__expect(in, "log_counts");
+	if(! (in >> statistics.log_counts)) throw std::invalid_argument(error_message::kSufficientStatisticsMalformed);
+	__expect(in, "total_weight");
+	statistics.total_weight = __load_value(in);
+	__expect(in, "log_likelihood");
+	statistics.log_likelihood = __load_value(in);
+	statistics.begin_counts = __load_counts(in, "begin");
+	statistics.transition_counts = __load_counts(in, "transitions");
+	statistics.end_counts = __load_counts(in, "end");
+	statistics.emission_counts = __load_counts(in, "emissions");
+	return statistics;
+}
+
+std::string SufficientStatistics::to_string() const {
+	std::ostringstream out;
+	save(out);
+	return out.str();
+}
+
+SufficientStatistics SufficientStatistics::from_string(const std::string& s){
+	std::istringstream in(s);
+	return load(in);
+}
+
+/* ===================== TRAINING CHECKPOINT ===================== */
+
+/* Format and version of the checkpoint files. */
+static const char __kCheckpointMagic[8] = {'H', 'M', 'M', 'C', 'K', 'P', 'T', '1'};
+
+TrainingCheckpoint::TrainingCheckpoint() : model_hash(0), corpus_hash(0), parameters_hash(0), iteration(0), initial_likelihood(0.0), 
+	log_likelihood(0.0), delta(0.0), begin_parameters(), transition_parameters(), end_parameters(), emission_parameters() {}
+
+template<typename T>
+static void __write_binary(std::ostream& out, const T& value){
+	out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static T __read_binary(std::istream& in){
+	T value;
+	if(! in.read(reinterpret_cast<char*>(&value), sizeof(T))) { throw std::invalid_argument(error_message::kCheckpointMalformed); }
+	return value;
+}
+
+static void __write_parameters(std::ostream& out, const std::vector<double>& parameters){
+	__write_binary<std::uint64_t>(out, parameters.size());
+	out.write(reinterpret_cast<const char*>(parameters.data()), (std::streamsize) (parameters.size() * sizeof(double)));
+}
+
+static std::vector<double> __read_parameters(std::istream& in){
+	std::uint64_t size = __read_binary<std::uint64_t>(in);
+	std::vector<double> parameters;
+	/* One by one, so that the size of a corrupted file fails at its end instead of allocating. */
+	for(std::uint64_t i = 0; i < size; ++i){
+		parameters.push_back(__read_binary<double>(in));
+	}
+	return parameters;
+}
+
+void TrainingCheckpoint::save(const std::string& filename) const {
+	std::string temporary_filename = filename + ".tmp";
+	{
+		std::ofstream out(temporary_filename, std::ios::binary | std::ios::trunc);
+		if(! out.is_open()) { throw std::runtime_error(error_message::format(error_message::kCheckpointWriteFailed, filename)); }
+		out.write(__kCheckpointMagic, sizeof(__kCheckpointMagic));
+		__write_binary(out, model_hash);
+		__write_binary(out, corpus_hash);
+		__write_binary(out, parameters_hash);
+		__write_binary<std::uint32_t>(out, iteration);
+		__write_binary(out, initial_likelihood);
+		__write_binary(out, log_likelihood);
+		__write_binary(out, delta);
+		__write_parameters(out, begin_parameters);
+		__write_parameters(out, transition_parameters);
+		__write_parameters(out, end_parameters);
+		__write_parameters(out, emission_parameters);
+		out.flush();
+		if(! out.good()) { throw std::runtime_error(error_message::format(error_message::kCheckpointWriteFailed, filename)); }
+	}
+	if(std::rename(temporary_filename.c_str(), filename.c_str()) != 0){
+		throw std::runtime_error(error_message::format(error_message::kCheckpointWriteFailed, filename));
+	}
+}
+
+TrainingCheckpoint TrainingCheckpoint::load(const std::string& filename){
+	std::ifstream in(filename, std::ios::binary);
+	char magic[sizeof(__kCheckpointMagic)];
+	if(! in.read(magic, sizeof(magic)) || ! std::equal(magic, magic + sizeof(magic), __kCheckpointMagic)){
+		throw std::invalid_argument(error_message::format(error_message::kCheckpointMalformed, filename));
+	}
+	TrainingCheckpoint checkpoint;
+	checkpoint.model_hash = __read_binary<std::uint64_t>(in);
+	checkpoint.corpus_hash = __read_binary<std::uint64_t>(in);
+	checkpoint.parameters_hash = __read_binary<std::uint64_t>(in);
+	checkpoint.iteration = __read_binary<std::uint32_t>(in);
+	checkpoint.initial_likelihood = __read_binary<double>(in);
+	checkpoint.log_likelihood = __read_binary<double>(in);
+	checkpoint.delta = __read_binary<double>(in);
+	checkpoint.begin_parameters = __read_parameters(in);
+	checkpoint.transition_parameters = __read_parameters(in);
+	checkpoint.end_parameters = __read_parameters(in);
+	checkpoint.emission_parameters = __read_parameters(in);
+	return checkpoint;
+}
+
+/* ===================== EMISSIONS ===================== */
+
+Emissions::~Emissions() {}
+
+SymbolEmissions::SymbolEmissions(RawModel* model, const std::vector<std::string>& sequence) : 
+	Emissions(), _model(model), _sequence(sequence), _emissions(model->silent_states_index) {}
+
+std::size_t SymbolEmissions::size() const { return _sequence.size(); }
+
+const double* SymbolEmissions::at(std::size_t t) {
+	for(std::size_t i = 0; i < _emissions.size(); ++i){
+		_emissions[i] = (*_model->B[i])[_sequence[t]];
+	}
+	return _emissions.data();
+}
+
+NumericEmissions::NumericEmissions(RawModel* model, const FrameMatrix& sequence, std::size_t block_size) : 
+	Emissions(), _model(model), _sequence(sequence), _block_size(std::max(block_size, (std::size_t) 1)), 
+	_block_begin(0), _block_end(0), _block(model->silent_states_index * _block_size), 
+	_emissions(model->silent_states_index) {
+		for(std::size_t i = 0; i < model->silent_states_index; ++i){
+			if(! model->B[i]->is_continuous()) throw std::invalid_argument(error_message::kNumericSequenceNotContinuous);
+			if(static_cast<const ContinuousDistribution*>(model->B[i])->dimension() != sequence.dimension()){
+				throw std::invalid_argument(error_message::kFrameDimensionMismatch);
+			}
+		}
+	}
+
+std::size_t NumericEmissions::size() const { return _sequence.length(); }
+
+const double* NumericEmissions::at(std::size_t t) {
+	if(t < _block_begin || t >= _block_end){
+		/* Evaluate the block of steps containing t, one state at a time. */
+		_block_begin = t - t % _block_size;
+		_block_end = std::min(_block_begin + _block_size, _sequence.length());
+		for(std::size_t i = 0; i < _emissions.size(); ++i){
+			static_cast<const ContinuousDistribution*>(_model->B[i])->log_pdf(
+				_sequence.frame(_block_begin), _block_end - _block_begin, _block.data() + i * _block_size);
+		}
+	}
+	for(std::size_t i = 0; i < _emissions.size(); ++i){
+		_emissions[i] = _block[i * _block_size + t - _block_begin];
+	}
+	return _emissions.data();
+}
+
+/* ===================== EMISSION STATISTICS ===================== */
+
+EmissionStatistics::~EmissionStatistics() {}
+
+SymbolStatistics::SymbolStatistics(const std::vector<std::pair<std::size_t, std::string>>& free_emissions, const std::vector<std::string>& sequence) : 
+	EmissionStatistics(), _free_emissions(free_emissions), _sequence(sequence), _statistics(free_emissions.size()) {}
+
+std::size_t SymbolStatistics::size() const { return _sequence.size(); }
+
+const double* SymbolStatistics::at(std::size_t t) {
+	for(std::size_t free_emission_id = 0; free_emission_id < _free_emissions.size(); ++free_emission_id){
+		_statistics[free_emission_id] = (_sequence[t] == _free_emissions[free_emission_id].second) ? 0 : utils::kNegInf;
+	}
+	return _statistics.data();
+}
+
+/* Number of components, dimension and covariance type of a continuous distribution with statistics. Returns false 
+for the other distributions. */
+static bool __mixture_shape(const Distribution* distribution, std::size_t& num_components, std::size_t& dimension, bool& full_covariance) {
+	const ContinuousDistribution* continuous = static_cast<const ContinuousDistribution*>(distribution);
+	if(continuous->is_normal()){
+		num_components = 1;
+		dimension = 1;
+		full_covariance = false;
+		return true;
+	}
+	if(continuous->is_gaussian_mixture()){
+		const GaussianMixtureDistribution* mixture = static_cast<const GaussianMixtureDistribution*>(continuous);
+		num_components = mixture->num_components();
+		dimension = mixture->dimension();
+		full_covariance = mixture->has_full_covariance();
+		return true;
+	}
+	return false;
+}
+
+FrameStatistics::FrameStatistics(RawModel* model, const FrameMatrix& sequence, const std::vector<double>& origin, std::size_t block_size) : 
+	EmissionStatistics(), _model(model), _sequence(sequence), _origin(origin), _block_size(std::max(block_size, (std::size_t) 1)), 
+	_block_begin(0), _block_end(0), _components(model->free_continuous_emissions.size()), _log_y(sequence.dimension()), 
+	_statistics(free_statistics(model).size()) {}
+
+std::vector<std::pair<std::size_t, std::string>> FrameStatistics::free_statistics(const RawModel* model) {
+	std::vector<std::pair<std::size_t, std::string>> statistics;
+	std::size_t num_components, dimension;
+	bool full_covariance;
+	for(std::size_t state_id : model->free_continuous_emissions){
+		if(! __mixture_shape(model->B[state_id], num_components, dimension, full_covariance)) { continue; }
+		for(std::size_t k = 0; k < num_components; ++k){
+			std::string r = "r" + std::to_string(k);
+			statistics.push_back(std::make_pair(state_id, r));
+			for(std::size_t d = 0; d < dimension; ++d){
+				statistics.push_back(std::make_pair(state_id, r + "*y" + std::to_string(d)));
+			}
+			for(std::size_t d = 0; d < dimension; ++d){
+				for(std::size_t e = (full_covariance) ? 0 : d; e <= d; ++e){
+					statistics.push_back(std::make_pair(state_id, r + "*y" + std::to_string(d) + "*y" + std::to_string(e)));
+				}
+			}
+		}
+	}
+	return statistics;
+}
+
+std::size_t FrameStatistics::size() const { return _sequence.length(); }
+
+const double* FrameStatistics::at(std::size_t t) {
+	const std::vector<std::size_t>& free_states = _model->free_continuous_emissions;
+	if(t < _block_begin || t >= _block_end){
+		/* Evaluate the components of the mixtures on the block of steps containing t. */
+		_block_begin = t - t % _block_size;
+		_block_end = std::min(_block_begin + _block_size, _sequence.length());
+		for(std::size_t f = 0; f < free_states.size(); ++f){
+			const ContinuousDistribution* continuous = static_cast<const ContinuousDistribution*>(_model->B[free_states[f]]);
+			if(continuous->is_gaussian_mixture()){
+				const GaussianMixtureDistribution* mixture = static_cast<const GaussianMixtureDistribution*>(continuous);
+				_components[f].resize((_block_end - _block_begin) * mixture->num_components());
+				mixture->log_component_pdf(_sequence.frame(_block_begin), _block_end - _block_begin, _components[f].data());
+			}
+		}
+	}
+	const double* frame = _sequence.frame(t);
+	for(std::size_t d = 0; d < _log_y.size(); ++d){
+		_log_y[d] = log(std::max(frame[d] - _origin[d], 0.0));
+	}
+	std::size_t statistic_id = 0;
+	std::size_t num_components, dimension;
+	bool full_covariance;
+	for(std::size_t f = 0; f < free_states.size(); ++f){
+		if(! __mixture_shape(_model->B[free_states[f]], num_components, dimension, full_covariance)) { continue; }
+		/* Log density of the mixture at the frame, the responsibilities being relative to it. A normal distribution 
+		has no components, its responsibility is 1. */
+		const double* components = (_components[f].empty()) ? nullptr : _components[f].data() + (t - _block_begin) * num_components;
+		double log_density = utils::kNegInf;
+		if(components != nullptr){
+			for(std::size_t k = 0; k < num_components; ++k){
+				log_density = utils::sum_log_prob(log_density, components[k]);
+			}
+		}
+		for(std::size_t k = 0; k < num_components; ++k){
+			double log_r = 0;
+			if(components != nullptr){
+				log_r = (log_density == utils::kNegInf) ? utils::kNegInf : components[k] - log_density;
+			}
+			_statistics[statistic_id++] = log_r;
+			for(std::size_t d = 0; d < dimension; ++d){
+				_statistics[statistic_id++] = log_r + _log_y[d];
+			}
+			for(std::size_t d = 0; d < dimension; ++d){
+				for(std::size_t e = (full_covariance) ? 0 : d; e <= d; ++e){
+					_statistics[statistic_id++] = log_r + _log_y[d] + _log_y[e];
+				}
+			}
+		}
+	}
+	return _statistics.data();
+}
+
 /* ===================== LINEAR MEMORY FORWARD ===================== */
 
 LinearMemoryForwardAlgorithm::LinearMemoryForwardAlgorithm(RawModel* model) : ForwardAlgorithm(hmm_config::kLinearMemoryForwardAlgorithmName, model) {}
+LinearMemoryForwardAlgorithm::LinearMemoryForwardAlgorithm(const std::string& name, RawModel* model) : ForwardAlgorithm(name, model) {}
 LinearMemoryForwardAlgorithm* LinearMemoryForwardAlgorithm::clone() const { return new LinearMemoryForwardAlgorithm(*this); }
 LinearMemoryForwardAlgorithm::~LinearMemoryForwardAlgorithm() {}
 
 std::vector<double> LinearMemoryForwardAlgorithm::forward(const std::vector<std::string>& sequence, std::size_t t_max) {
-	if(t_max == 0) t_max = sequence.size();
-	if(sequence.size() == 0) throw std::logic_error("forward on empty sequence");
+	SymbolEmissions emissions(_model, sequence);
+	return _forward(emissions, t_max);
+}
+
+std::vector<double> LinearMemoryForwardAlgorithm::forward(const FrameMatrix& sequence, std::size_t t_max) {
+	NumericEmissions emissions(_model, sequence);
+	return _forward(emissions, t_max);
+}
+
+std::vector<double> LinearMemoryForwardAlgorithm::_forward(Emissions& emissions, std::size_t t_max) {
+	if(t_max == 0) t_max = emissions.size();
+	if(emissions.size() == 0) throw std::logic_error("forward on empty sequence");
+	else if(_model->has_silent_closure()){
+		std::vector<double> alpha = _closure_forward(emissions, std::min(emissions.size(), t_max));
+		alpha.resize(_model->A.size(), utils::kNegInf);
+		_forward_silent(alpha);
+		return alpha;
+	}
 	else{
-		std::vector<double> alpha = forward_init(sequence);
-		for(std::size_t t = 1; t < std::min(sequence.size(), t_max); ++t) {
-			alpha = forward_step(sequence, alpha, t);
+		std::vector<double> alpha = _forward_init(emissions.at(0));
+		for(std::size_t t = 1; t < std::min(emissions.size(), t_max); ++t) {
+			alpha = _forward_step(emissions.at(t), alpha);
 		}
 			return alpha;
 	}
 }
 
 std::vector<double> LinearMemoryForwardAlgorithm::forward_init(const std::vector<std::string>& sequence){
+	return _forward_init(SymbolEmissions(_model, sequence).at(0));
+}
+
+std::vector<double> LinearMemoryForwardAlgorithm::_forward_init(const double* emissions_0){
+	instrumentation::PhaseTimer timer(instrumentation::kForwardInit);
+	instrumentation::count(instrumentation::kCells, _model->A.size());
 	std::vector<double> alpha_0(_model->A.size(), utils::kNegInf);
 	/* First iterate over the silent states to compute the probability of
 	passing through silent states before emitting the first symbol. */
 	for(std::size_t i = _model->silent_states_index; i < _model->A.size(); ++i){
+		RawModel::Envelope from = _model->predecessors_of(i);
 		alpha_0[i] = _model->pi_begin[i];
-		for(std::size_t j = _model->silent_states_index; j < i; ++j){
+		for(std::size_t j = from.silent_begin; j < std::min(i, from.silent_end); ++j){
 			alpha_0[i] = utils::sum_log_prob(alpha_0[i], _model->A[j][i] + alpha_0[j]);
 		}
 	}
@@ -73,8 +637,9 @@ std::vector<double> LinearMemoryForwardAlgorithm::forward_init(const std::vector
 	with the probabilities to transit from all the silent states which
 	have a begin probability > 0 to non-silent state i. */
 	for(std::size_t i = 0; i < _model->silent_states_index; ++i){
+		RawModel::Envelope from = _model->predecessors_of(i);
 		alpha_0[i] = _model->pi_begin[i];
-		for(std::size_t j = _model->silent_states_index; j < _model->A.size(); ++j){
+		for(std::size_t j = from.silent_begin; j < from.silent_end; ++j){
 			alpha_0[i] = utils::sum_log_prob(alpha_0[i], _model->A[j][i] + alpha_0[j]);
 		}
 		
@@ -83,39 +648,79 @@ std::vector<double> LinearMemoryForwardAlgorithm::forward_init(const std::vector
 	std::vector<double> alpha_1(_model->A.size(), utils::kNegInf);
 	/* First iterate over non-silent states. */
 	for(std::size_t i = 0; i < _model->silent_states_index; ++i){
-		alpha_1[i] = alpha_0[i] + (*_model->B[i])[sequence[0]];
+		alpha_1[i] = alpha_0[i] + emissions_0[i];
 	}
 	/* Then silent states, in toporder. */
-	for(std::size_t i = _model->silent_states_index; i < _model->A.size(); ++i){
-		alpha_1[i] = utils::kNegInf;
-		for(std::size_t j = 0; j < i; ++j){
-			alpha_1[i] = utils::sum_log_prob(alpha_1[i], _model->A[j][i] + alpha_1[j]);
-		}
-	}
+	_forward_silent(alpha_1);
 	return alpha_1;
 }
 
 std::vector<double> LinearMemoryForwardAlgorithm::forward_step(const std::vector<std::string>& sequence, const std::vector<double>& alpha_prev_t, std::size_t t) {
+	return _forward_step(SymbolEmissions(_model, sequence).at(t), alpha_prev_t);
+}
+
+std::vector<double> LinearMemoryForwardAlgorithm::_forward_step(const double* emissions_t, const std::vector<double>& alpha_prev_t) {
+	instrumentation::PhaseTimer timer(instrumentation::kForwardStep);
+	instrumentation::count(instrumentation::kCells, _model->A.size());
 	std::vector<double> alpha_t(_model->A.size(), utils::kNegInf);
 	/* Normal states. */
 	for(std::size_t i = 0; i < _model->silent_states_index; ++i){
+		RawModel::Envelope from = _model->predecessors_of(i);
 		alpha_t[i] = utils::kNegInf;
-		for(std::size_t j = 0; j < _model->A.size(); ++j){
+		for(std::size_t j = from.emitting_begin; j < from.emitting_end; ++j){
 			alpha_t[i] = utils::sum_log_prob(alpha_t[i], alpha_prev_t[j] + _model->A[j][i]);
 		}
-		alpha_t[i] = alpha_t[i] + (*_model->B[i])[sequence[t]];
+		for(std::size_t j = from.silent_begin; j < from.silent_end; ++j){
+			alpha_t[i] = utils::sum_log_prob(alpha_t[i], alpha_prev_t[j] + _model->A[j][i]);
+		}
+		alpha_t[i] = alpha_t[i] + emissions_t[i];
 	}
 	/* Silent states. */
+	_forward_silent(alpha_t);
+	return alpha_t;
+}
+
+void LinearMemoryForwardAlgorithm::_forward_silent(std::vector<double>& alpha_t) {
 	for(std::size_t i = _model->silent_states_index; i < _model->A.size(); ++i){
+		RawModel::Envelope from = _model->predecessors_of(i);
 		alpha_t[i] = utils::kNegInf;
-		for(std::size_t j = 0; j < i; ++j){
+		for(std::size_t j = from.emitting_begin; j < from.emitting_end; ++j){
+			alpha_t[i] = utils::sum_log_prob(alpha_t[i], alpha_t[j] + _model->A[j][i]);
+		}
+		for(std::size_t j = from.silent_begin; j < std::min(i, from.silent_end); ++j){
 			alpha_t[i] = utils::sum_log_prob(alpha_t[i], alpha_t[j] + _model->A[j][i]);
 		}
 	}
-	return alpha_t;
+}
+
+std::vector<double> LinearMemoryForwardAlgorithm::_closure_forward(Emissions& emissions, std::size_t t_max) {
+	instrumentation::PhaseTimer timer(instrumentation::kForwardInit);
+	const RawModel::SilentClosure& closure = _model->silent_closure;
+	std::size_t num_emitting = _model->silent_states_index;
+	std::vector<double> alpha(num_emitting);
+	const double* emissions_t = emissions.at(0);
+	for(std::size_t i = 0; i < num_emitting; ++i){
+		alpha[i] = closure.begin_log_sum[i] + emissions_t[i];
+	}
+	timer.next(instrumentation::kForwardStep);
+	instrumentation::count(instrumentation::kCells, num_emitting * std::max(t_max, (std::size_t) 1));
+	std::vector<double> alpha_prev_t(num_emitting);
+	for(std::size_t t = 1; t < t_max; ++t){
+		std::swap(alpha, alpha_prev_t);
+		emissions_t = emissions.at(t);
+		for(std::size_t i = 0; i < num_emitting; ++i){
+			alpha[i] = utils::kNegInf;
+			for(std::size_t k = closure.offsets[i]; k < closure.offsets[i + 1]; ++k){
+				alpha[i] = utils::sum_log_prob(alpha[i], alpha_prev_t[closure.from[k]] + closure.log_sum[k]);
+			}
+			alpha[i] = alpha[i] + emissions_t[i];
+		}
+	}
+	return alpha;
 }
 
 std::pair<std::vector<double>, double> LinearMemoryForwardAlgorithm::forward_terminate(const std::vector<double>& alpha_T){
+	instrumentation::PhaseTimer timer(instrumentation::kForwardTerminate);
 	double log_prob = utils::kNegInf;
 	std::vector<double> alpha_end(_model->A.size(), utils::kNegInf);
 	//utils::mem_info();
@@ -140,7 +745,27 @@ std::pair<std::vector<double>, double> LinearMemoryForwardAlgorithm::forward_ter
 }
 
 double LinearMemoryForwardAlgorithm::log_likelihood(const std::vector<std::string>& sequence){
-	return forward_terminate(forward(sequence, sequence.size())).second;	
+	SymbolEmissions emissions(_model, sequence);
+	return _log_likelihood(emissions);
+}
+
+double LinearMemoryForwardAlgorithm::log_likelihood(const FrameMatrix& sequence){
+	NumericEmissions emissions(_model, sequence);
+	return _log_likelihood(emissions);
+}
+
+double LinearMemoryForwardAlgorithm::_log_likelihood(Emissions& emissions){
+	if(_model->has_silent_closure() && emissions.size() > 0){
+		std::vector<double> alpha_T = _closure_forward(emissions, emissions.size());
+		instrumentation::PhaseTimer timer(instrumentation::kForwardTerminate);
+		double log_prob = utils::kNegInf;
+		for(std::size_t i = 0; i < alpha_T.size(); ++i){
+			double alpha_end = _model->is_finite ? alpha_T[i] + _model->silent_closure.end_log_sum[i] : alpha_T[i];
+			log_prob = utils::sum_log_prob(log_prob, alpha_end);
+		}
+		return log_prob;
+	}
+	return forward_terminate(_forward(emissions, emissions.size())).second;	
 }
 
 double LinearMemoryForwardAlgorithm::log_likelihood(const std::vector<std::vector<std::string>>& sequences){
@@ -152,6 +777,161 @@ double LinearMemoryForwardAlgorithm::log_likelihood(const std::vector<std::vecto
 }
 
 
+/* ===================== PREFIX CACHED FORWARD ===================== */
+
+PrefixCachedForwardAlgorithm::PrefixCachedForwardAlgorithm(RawModel* model, std::size_t capacity, std::size_t checkpoint_interval) : 
+	LinearMemoryForwardAlgorithm(hmm_config::kPrefixCachedForwardAlgorithmName, model), _capacity(capacity), 
+	_checkpoint_interval(std::max<std::size_t>(checkpoint_interval, 1)), _codes(), _nodes(), _free_nodes(), _lru(), 
+	_clock(0), _statistics() {
+	clear_cache();
+}
+PrefixCachedForwardAlgorithm* PrefixCachedForwardAlgorithm::clone() const { return new PrefixCachedForwardAlgorithm(*this); }
+PrefixCachedForwardAlgorithm::~PrefixCachedForwardAlgorithm() {}
+
+void PrefixCachedForwardAlgorithm::set_model(RawModel* model) {
+	HMMAlgorithm::set_model(model);
+	clear_cache();
+}
+
+std::size_t PrefixCachedForwardAlgorithm::capacity() const { return _capacity; }
+std::size_t PrefixCachedForwardAlgorithm::checkpoint_interval() const { return _checkpoint_interval; }
+
+PrefixCachedForwardAlgorithm::CacheStatistics PrefixCachedForwardAlgorithm::cache_statistics() const {
+	CacheStatistics statistics = _statistics;
+	statistics.entries = _lru.size();
+	statistics.memory = 0;
+	for(const std::pair<const std::size_t, std::size_t>& entry : _lru){
+		const Node& node = _nodes[entry.second];
+		statistics.memory += sizeof(Node) + node.alpha.capacity() * sizeof(double) + 
+			node.symbols.capacity() * sizeof(std::size_t) * 2; /* Symbols and key in the parent's children. */
+	}
+	for(const std::pair<const std::string, std::size_t>& code : _codes){
+		statistics.memory += sizeof(code) + code.first.capacity();
+	}
+	return statistics;
+}
+
+void PrefixCachedForwardAlgorithm::clear_cache() {
+	_codes.clear();
+	_nodes.assign(1, Node{0, {}, {}, {}, 0});
+	_free_nodes.clear();
+	_lru.clear();
+	_clock = 0;
+	_statistics = CacheStatistics{0, 0, 0, 0, 0, 0};
+}
+
+std::vector<std::size_t> PrefixCachedForwardAlgorithm::_encode(const std::vector<std::string>& sequence, std::size_t begin, std::size_t end) {
+	std::vector<std::size_t> codes;
+	codes.reserve(end - begin);
+	for(std::size_t t = begin; t < end; ++t){
+		codes.push_back(_codes.emplace(sequence[t], _codes.size()).first->second);
+	}
+	return codes;
+}
+
+bool PrefixCachedForwardAlgorithm::_find_codes(const std::vector<std::string>& sequence, std::size_t begin, std::size_t end, 
+	std::vector<std::size_t>& codes) const {
+	codes.clear();
+	for(std::size_t t = begin; t < end; ++t){
+		std::unordered_map<std::string, std::size_t>::const_iterator code = _codes.find(sequence[t]);
+		if(code == _codes.end()) return false;
+		codes.push_back(code->second);
+	}
+	return true;
+}
+
+std::size_t PrefixCachedForwardAlgorithm::_add_node(std::size_t parent, std::vector<std::size_t>&& symbols, const std::vector<double>& alpha) {
+	std::size_t id;
+	if(_free_nodes.empty()){
+		id = _nodes.size();
+		_nodes.push_back(Node{parent, {}, {}, {}, 0});
+	}
+	else{
+		id = _free_nodes.back();
+		_free_nodes.pop_back();
+		_nodes[id].parent = parent;
+	}
+	_nodes[id].symbols = std::move(symbols);
+	_nodes[id].alpha = alpha;
+	_nodes[id].last_use = ++_clock;
+	_lru[_nodes[id].last_use] = id;
+	_nodes[parent].children[_nodes[id].symbols] = id;
+	return id;
+}
+
+/* Marks node and its ancestors as used, the node first, so that each ancestor is used more recently than it. */
+void PrefixCachedForwardAlgorithm::_touch(std::size_t node) {
+	while(node != 0){
+		_lru.erase(_nodes[node].last_use);
+		_nodes[node].last_use = ++_clock;
+		_lru[_nodes[node].last_use] = node;
+		node = _nodes[node].parent;
+	}
+}
+
+void PrefixCachedForwardAlgorithm::_evict() {
+	while(_lru.size() > _capacity){
+		std::size_t victim = _lru.begin()->second;
+		_lru.erase(_lru.begin());
+		Node& node = _nodes[victim];
+		_nodes[node.parent].children.erase(node.symbols);
+		node.symbols = std::vector<std::size_t>();
+		node.alpha = std::vector<double>();
+		_free_nodes.push_back(victim);
+		++_statistics.evictions;
+	}
+}
+
+std::vector<double> PrefixCachedForwardAlgorithm::_cached_forward(const std::vector<std::string>& sequence, std::size_t t_max) {
+	if(t_max == 0) t_max = sequence.size();
+	if(sequence.empty()) throw std::logic_error("forward on empty sequence");
+	std::size_t steps = std::min(sequence.size(), t_max);
+	std::size_t interval = _checkpoint_interval;
+	/* Deepest cached prefix. */
+	std::size_t node = 0;
+	std::size_t t = 0;
+	std::vector<std::size_t> codes;
+	codes.reserve(interval);
+	while(t + interval <= steps){
+		/* A symbol without code is in none of the cached prefixes. */
+		if(! _find_codes(sequence, t, t + interval, codes)) break;
+		std::map<std::vector<std::size_t>, std::size_t>::const_iterator child = _nodes[node].children.find(codes);
+		if(child == _nodes[node].children.end()) break;
+		node = child->second;
+		t += interval;
+	}
+	if(t > 0){
+		++_statistics.hits;
+		_statistics.resumed_steps += t;
+	}
+	else ++_statistics.misses;
+	/* Resume from it, checkpointing the new prefixes. */
+	SymbolEmissions emissions(_model, sequence);
+	std::size_t cached = t;
+	std::vector<double> alpha = (t == 0) ? _forward_init(emissions.at(0)) : _nodes[node].alpha;
+	if(t == 0) t = 1;
+	/* alpha is now the forward vector after t symbols. */
+	while(true){
+		if(t > cached && t % interval == 0 && _capacity > 0){
+			node = _add_node(node, _encode(sequence, t - interval, t), alpha);
+		}
+		if(t == steps) break;
+		alpha = _forward_step(emissions.at(t), alpha);
+		++t;
+	}
+	_touch(node);
+	_evict();
+	return alpha;
+}
+
+std::vector<double> PrefixCachedForwardAlgorithm::forward(const std::vector<std::string>& sequence, std::size_t t_max) {
+	return _cached_forward(sequence, t_max);
+}
+
+double PrefixCachedForwardAlgorithm::log_likelihood(const std::vector<std::string>& sequence) {
+	return forward_terminate(_cached_forward(sequence, sequence.size())).second;
+}
+
 /* ===================== LINEAR MEMORY BACKWARD ===================== */
 
 
@@ -161,29 +941,49 @@ LinearMemoryBackwardAlgorithm::~LinearMemoryBackwardAlgorithm() {}
 
 
 std::vector<double> LinearMemoryBackwardAlgorithm::backward(const std::vector<std::string>& sequence, std::size_t t_min) {
+	SymbolEmissions emissions(_model, sequence);
+	return _backward(emissions, t_min);
+}
+
+std::vector<double> LinearMemoryBackwardAlgorithm::backward(const FrameMatrix& sequence, std::size_t t_min) {
+	NumericEmissions emissions(_model, sequence);
+	return _backward(emissions, t_min);
+}
+
+std::vector<double> LinearMemoryBackwardAlgorithm::_backward(Emissions& emissions, std::size_t t_min) {
 	if(t_min > 0) --t_min;
-	if(sequence.size() == 0) throw std::runtime_error("backward on empty sequence");
+	if(emissions.size() == 0) throw std::runtime_error("backward on empty sequence");
+	else if(_model->has_silent_closure() && t_min + 1 < emissions.size()){
+		/* The betas of the silent states are only needed for the last step. */
+		std::vector<double> beta = _closure_backward(emissions, t_min + 1);
+		beta.resize(_model->A.size(), utils::kNegInf);
+		return _backward_step(beta, emissions.at(t_min + 1));
+	}
 	else{
 		std::vector<double> beta = backward_init();
-		for(std::size_t t = sequence.size() - 2; t >= t_min && t < sequence.size(); --t){
-			beta = backward_step(beta, sequence, t);
+		for(std::size_t t = emissions.size() - 2; t >= t_min && t < emissions.size(); --t){
+			beta = _backward_step(beta, emissions.at(t + 1));
 		}
 		return beta;
 	}
 }
 
 std::vector<double> LinearMemoryBackwardAlgorithm::backward_init() {
+	instrumentation::PhaseTimer timer(instrumentation::kBackwardInit);
+	instrumentation::count(instrumentation::kCells, _model->A.size());
 	std::vector<double> beta_T(_model->A.size());
 	if(_model->is_finite){
 		for(std::size_t i = _model->A.size() - 1; i >= _model->silent_states_index; --i){
+			RawModel::Envelope to = _model->successors_of(i);
 			beta_T[i] = _model->pi_end[i];
-			for(std::size_t j = _model->A.size() - 1; j > i; --j){
+			for(std::size_t j = to.silent_end; j-- > std::max(i + 1, to.silent_begin);){
 				beta_T[i] = utils::sum_log_prob(beta_T[i], _model->A[i][j] + beta_T[j]);
 			}
 		}
 		for(std::size_t i = 0; i < _model->silent_states_index; ++i){
+			RawModel::Envelope to = _model->successors_of(i);
 			beta_T[i] = _model->pi_end[i];
-			for(std::size_t j = _model->silent_states_index; j < _model->A.size(); ++j){
+			for(std::size_t j = to.silent_begin; j < to.silent_end; ++j){
 				beta_T[i] = utils::sum_log_prob(beta_T[i], _model->A[i][j] + beta_T[j]); 
 			}
 		}
@@ -200,40 +1000,79 @@ std::vector<double> LinearMemoryBackwardAlgorithm::backward_init() {
 };
 
 std::vector<double> LinearMemoryBackwardAlgorithm::backward_step(const std::vector<double>& beta_previous_t, const std::vector<std::string>& sequence, std::size_t t) {
+	return _backward_step(beta_previous_t, SymbolEmissions(_model, sequence).at(t + 1));
+}
+
+std::vector<double> LinearMemoryBackwardAlgorithm::_backward_step(const std::vector<double>& beta_previous_t, const double* emissions_next) {
+	instrumentation::PhaseTimer timer(instrumentation::kBackwardStep);
+	instrumentation::count(instrumentation::kCells, _model->A.size());
 	std::vector<double> beta_t(_model->A.size());
 	for(std::size_t i = _model->A.size(); i-- > 0;){
+		RawModel::Envelope to = _model->successors_of(i);
 		beta_t[i] = utils::kNegInf;
 		/* Consider previous step non-silent states. */
-		for(std::size_t j = 0; j < _model->silent_states_index; j++){
-			beta_t[i] = utils::sum_log_prob(beta_t[i], beta_previous_t[j] + _model->A[i][j] + (*_model->B[j])[sequence[t + 1]]);
+		for(std::size_t j = to.emitting_begin; j < to.emitting_end; j++){
+			beta_t[i] = utils::sum_log_prob(beta_t[i], beta_previous_t[j] + _model->A[i][j] + emissions_next[j]);
 		}
 		/* Consider current step silent states. 
 		If i is a silent state (i.e. i > _silent_state_index), only iterate for each j > i (topological order !). 
 		Else if i is a non-silent state, iterate over all the silent states. */
-		for(std::size_t j = std::max(i + 1, _model->silent_states_index); j < _model->A.size(); j++){
+		for(std::size_t j = std::max(i + 1, to.silent_begin); j < to.silent_end; j++){
 			beta_t[i] = utils::sum_log_prob(beta_t[i], beta_t[j] + _model->A[i][j]);
 		}
 	}
 	return beta_t;
 };
 
+std::vector<double> LinearMemoryBackwardAlgorithm::_closure_backward(Emissions& emissions, std::size_t t_min) {
+	instrumentation::PhaseTimer timer(instrumentation::kBackwardInit);
+	const RawModel::SilentClosure& closure = _model->silent_closure;
+	std::size_t num_emitting = _model->silent_states_index;
+	std::vector<double> beta(num_emitting);
+	for(std::size_t i = 0; i < num_emitting; ++i){
+		beta[i] = _model->is_finite ? closure.end_log_sum[i] : 0.0;
+	}
+	timer.next(instrumentation::kBackwardStep);
+	instrumentation::count(instrumentation::kCells, num_emitting * (emissions.size() - t_min));
+	std::vector<double> beta_previous_t(num_emitting);
+	for(std::size_t t = emissions.size() - 1; t-- > t_min;){
+		std::swap(beta, beta_previous_t);
+		beta.assign(num_emitting, utils::kNegInf);
+		const double* emissions_next = emissions.at(t + 1);
+		/* Scatter the paths to each emitting state i back to their origins. */
+		for(std::size_t i = 0; i < num_emitting; ++i){
+			double beta_emission = emissions_next[i] + beta_previous_t[i];
+			for(std::size_t k = closure.offsets[i]; k < closure.offsets[i + 1]; ++k){
+				beta[closure.from[k]] = utils::sum_log_prob(beta[closure.from[k]], closure.log_sum[k] + beta_emission);
+			}
+		}
+	}
+	return beta;
+}
+
 std::tuple<std::vector<double>, std::vector<double>, double> LinearMemoryBackwardAlgorithm::backward_terminate(const std::vector<double>& beta_1, const std::vector<std::string>& sequence){
+	return _backward_terminate(beta_1, SymbolEmissions(_model, sequence).at(0));
+}
+
+std::tuple<std::vector<double>, std::vector<double>, double> LinearMemoryBackwardAlgorithm::_backward_terminate(const std::vector<double>& beta_1, const double* emissions_0){
+	instrumentation::PhaseTimer timer(instrumentation::kBackwardTerminate);
 	std::vector<double> beta_0(_model->A.size());
 	for(std::size_t i = _model->A.size() - 1; i >= _model->silent_states_index; --i){
+		RawModel::Envelope to = _model->successors_of(i);
 		beta_0[i] = utils::kNegInf;
 		/* Consider previous step non-silent states. */
-		for(std::size_t j = 0; j < _model->silent_states_index; j++){
-			beta_0[i] = utils::sum_log_prob(beta_0[i], beta_1[j] + _model->A[i][j] + (*_model->B[j])[sequence[0]]);
+		for(std::size_t j = to.emitting_begin; j < to.emitting_end; j++){
+			beta_0[i] = utils::sum_log_prob(beta_0[i], beta_1[j] + _model->A[i][j] + emissions_0[j]);
 		}
 		/* Consider current step silent states. */
-		for(std::size_t j = i + 1; j < _model->A.size(); j++){
+		for(std::size_t j = std::max(i + 1, to.silent_begin); j < to.silent_end; j++){
 			beta_0[i] = utils::sum_log_prob(beta_0[i], beta_0[j] + _model->A[i][j]);
 		}
 	}
 	std::vector<double> beta_end(_model->A.size());
 	double log_prob = utils::kNegInf;
 	for(std::size_t i = 0; i < _model->silent_states_index; ++i){
-		beta_end[i] = _model->pi_begin[i] + (*_model->B[i])[sequence[0]] + beta_1[i];
+		beta_end[i] = _model->pi_begin[i] + emissions_0[i] + beta_1[i];
 		log_prob = utils::sum_log_prob(log_prob, beta_end[i]);
 	}
 	for(std::size_t i = _model->silent_states_index; i < _model->A.size(); ++i){
@@ -245,7 +1084,28 @@ std::tuple<std::vector<double>, std::vector<double>, double> LinearMemoryBackwar
 }
 
 double LinearMemoryBackwardAlgorithm::log_likelihood(const std::vector<std::string>& sequence){
-	return std::get<2>(backward_terminate(backward(sequence, 0), sequence));
+	SymbolEmissions emissions(_model, sequence);
+	return _log_likelihood(emissions);
+}
+
+double LinearMemoryBackwardAlgorithm::log_likelihood(const FrameMatrix& sequence){
+	NumericEmissions emissions(_model, sequence);
+	return _log_likelihood(emissions);
+}
+
+double LinearMemoryBackwardAlgorithm::_log_likelihood(Emissions& emissions){
+	if(_model->has_silent_closure() && emissions.size() > 0){
+		std::vector<double> beta_1 = _closure_backward(emissions, 0);
+		instrumentation::PhaseTimer timer(instrumentation::kBackwardTerminate);
+		const double* emissions_0 = emissions.at(0);
+		double log_prob = utils::kNegInf;
+		for(std::size_t i = 0; i < beta_1.size(); ++i){
+			log_prob = utils::sum_log_prob(log_prob, _model->silent_closure.begin_log_sum[i] + emissions_0[i] + beta_1[i]);
+		}
+		return log_prob;
+	}
+	std::vector<double> beta_1 = _backward(emissions, 0);
+	return std::get<2>(_backward_terminate(beta_1, emissions.at(0)));
 }
 
 double LinearMemoryBackwardAlgorithm::log_likelihood(const std::vector<std::vector<std::string>>& sequences){
@@ -326,6 +1186,12 @@ LinearMemoryViterbiDecodingAlgorithm* LinearMemoryViterbiDecodingAlgorithm::clon
 LinearMemoryViterbiDecodingAlgorithm::~LinearMemoryViterbiDecodingAlgorithm() {}
 
 std::vector<double> LinearMemoryViterbiDecodingAlgorithm::viterbi_init(Traceback& psi, const std::vector<std::string>& sequence) {
+	return _viterbi_init(psi, SymbolEmissions(_model, sequence).at(0));
+}
+
+std::vector<double> LinearMemoryViterbiDecodingAlgorithm::_viterbi_init(Traceback& psi, const double* emissions_0) {
+	instrumentation::PhaseTimer timer(instrumentation::kViterbiInit);
+	instrumentation::count(instrumentation::kCells, _model->A.size());
 	std::vector<double> phi_0(_model->A.size(), utils::kNegInf);
 	/* First iterate over the silent states to compute the max probability of
 	passing through silent states before emitting the first symbol. */
@@ -333,9 +1199,10 @@ std::vector<double> LinearMemoryViterbiDecodingAlgorithm::viterbi_init(Traceback
 	double current_phi;
 	std::size_t max_psi;
 	for(std::size_t i = _model->silent_states_index; i < _model->A.size(); ++i){
+		RawModel::Envelope from = _model->predecessors_of(i);
 		max_phi = _model->pi_begin[i];
 		max_psi = _model->A.size();
-		for(std::size_t j = _model->silent_states_index; j < i; ++j){
+		for(std::size_t j = from.silent_begin; j < std::min(i, from.silent_end); ++j){
 			current_phi = _model->A[j][i] + phi_0[j];
 			if(current_phi > max_phi){
 				max_phi = current_phi;
@@ -353,9 +1220,10 @@ std::vector<double> LinearMemoryViterbiDecodingAlgorithm::viterbi_init(Traceback
 	std::vector<double> phi_1(_model->A.size(), utils::kNegInf);
 	/* Fill phi_1 for non-silent states. */
 	for(std::size_t i = 0; i < _model->silent_states_index; ++i){
+		RawModel::Envelope from = _model->predecessors_of(i);
 		max_phi = _model->pi_begin[i];
 		max_psi = _model->A.size();
-		for(std::size_t j = _model->silent_states_index; j < _model->A.size(); ++j){
+		for(std::size_t j = from.silent_begin; j < from.silent_end; ++j){
 			current_phi = _model->A[j][i] + phi_0[j];
 			if(current_phi > max_phi){
 				max_phi = current_phi;
@@ -363,7 +1231,7 @@ std::vector<double> LinearMemoryViterbiDecodingAlgorithm::viterbi_init(Traceback
 			}
 		}
 		if(max_phi != utils::kNegInf){
-			phi_1[i] = max_phi + (*_model->B[i])[sequence[0]];
+			phi_1[i] = max_phi + emissions_0[i];
 		}
 		if(max_psi < _model->A.size()){
 			psi.add_link(max_psi, i);
@@ -371,9 +1239,17 @@ std::vector<double> LinearMemoryViterbiDecodingAlgorithm::viterbi_init(Traceback
 	}
 	/* Then silent states, in toporder. */
 	for(std::size_t i = _model->silent_states_index; i < _model->A.size(); ++i){
+		RawModel::Envelope from = _model->predecessors_of(i);
 		max_phi = utils::kNegInf;
 		max_psi = _model->A.size();
-		for(std::size_t j = 0; j < i; ++j){
+		for(std::size_t j = from.emitting_begin; j < from.emitting_end; ++j){
+			current_phi = _model->A[j][i] + phi_1[j];
+			if(current_phi > max_phi){
+				max_phi = current_phi;
+				max_psi = j;
+			}
+		}
+		for(std::size_t j = from.silent_begin; j < std::min(i, from.silent_end); ++j){
 			current_phi = _model->A[j][i] + phi_1[j];
 			if(current_phi > max_phi){
 				max_phi = current_phi;
@@ -390,15 +1266,29 @@ std::vector<double> LinearMemoryViterbiDecodingAlgorithm::viterbi_init(Traceback
 }
 
 std::vector<double> LinearMemoryViterbiDecodingAlgorithm::viterbi_step(const std::vector<double>& phi_prev_t, Traceback& psi, std::size_t t, const std::vector<std::string>& sequence) {
+	return _viterbi_step(phi_prev_t, psi, SymbolEmissions(_model, sequence).at(t));
+}
+
+std::vector<double> LinearMemoryViterbiDecodingAlgorithm::_viterbi_step(const std::vector<double>& phi_prev_t, Traceback& psi, const double* emissions_t) {
+	instrumentation::PhaseTimer timer(instrumentation::kViterbiStep);
+	instrumentation::count(instrumentation::kCells, _model->A.size());
 	std::vector<double> phi_t(_model->A.size(), utils::kNegInf);
 		double max_phi;
 		double current_phi;
 		std::size_t max_psi;
 		/* Normal states. */
 		for(std::size_t i = 0; i < _model->silent_states_index; ++i){
+			RawModel::Envelope from = _model->predecessors_of(i);
 			max_phi = utils::kNegInf;
 			max_psi = _model->A.size();
-			for(std::size_t j = 0; j < _model->A.size(); ++j){
+			for(std::size_t j = from.emitting_begin; j < from.emitting_end; ++j){
+				current_phi = phi_prev_t[j] + _model->A[j][i];
+				if(current_phi > max_phi){
+					max_phi = current_phi;
+					max_psi = j;
+				}
+			}
+			for(std::size_t j = from.silent_begin; j < from.silent_end; ++j){
 				current_phi = phi_prev_t[j] + _model->A[j][i];
 				if(current_phi > max_phi){
 					max_phi = current_phi;
@@ -406,15 +1296,23 @@ std::vector<double> LinearMemoryViterbiDecodingAlgorithm::viterbi_step(const std
 				}
 			}
 			if(max_phi != utils::kNegInf && max_psi != _model->A.size()){
-				phi_t[i] = max_phi + (*_model->B[i])[sequence[t]];
+				phi_t[i] = max_phi + emissions_t[i];
 				psi.add_link(max_psi, i);
 			}
 		}
 		/* Silent states. */
 		for(std::size_t i = _model->silent_states_index; i < _model->A.size(); ++i){
+			RawModel::Envelope from = _model->predecessors_of(i);
 			max_phi = utils::kNegInf;
 			max_psi = _model->A.size();
-			for(std::size_t j = 0; j < i; ++j){
+			for(std::size_t j = from.emitting_begin; j < from.emitting_end; ++j){
+				current_phi = phi_t[j] + _model->A[j][i];
+				if(current_phi > max_phi){
+					max_phi = current_phi;
+					max_psi = j;
+				}
+			}
+			for(std::size_t j = from.silent_begin; j < std::min(i, from.silent_end); ++j){
 				current_phi = phi_t[j] + _model->A[j][i];
 				if(current_phi > max_phi){
 					max_phi = current_phi;
@@ -431,6 +1329,7 @@ std::vector<double> LinearMemoryViterbiDecodingAlgorithm::viterbi_step(const std
 }
 
 std::size_t LinearMemoryViterbiDecodingAlgorithm::viterbi_terminate(std::vector<double>& phi_T){
+	instrumentation::PhaseTimer timer(instrumentation::kViterbiTerminate);
 	double max_phi_T = utils::kNegInf;
 	std::size_t max_state_index = _model->A.size();
 	if(_model->is_finite){
@@ -456,38 +1355,207 @@ std::size_t LinearMemoryViterbiDecodingAlgorithm::viterbi_terminate(std::vector<
 }
 
 std::pair<std::vector<std::string>, double> LinearMemoryViterbiDecodingAlgorithm::decode(const std::vector<std::string>& sequence, std::size_t t_max) {
-	if(t_max == 0) t_max = sequence.size();
-	if(sequence.size() == 0) throw std::logic_error("viterbi on empty sequence");
+	SymbolEmissions emissions(_model, sequence);
+	return _decode(emissions, t_max);
+}
+
+std::pair<std::vector<std::string>, double> LinearMemoryViterbiDecodingAlgorithm::decode(const FrameMatrix& sequence, std::size_t t_max) {
+	NumericEmissions emissions(_model, sequence);
+	return _decode(emissions, t_max);
+}
+
+std::pair<std::vector<std::string>, double> LinearMemoryViterbiDecodingAlgorithm::_decode(Emissions& emissions, std::size_t t_max) {
+	std::vector<std::size_t> path_indices;
+	double max_phi_T;
+	std::tie(path_indices, max_phi_T) = _decode_indices(emissions, t_max);
+	std::vector<std::string> path;
+	path.reserve(path_indices.size());
+	for(std::size_t path_index : path_indices){
+		path.push_back(_model->states_names[path_index]);
+	}
+	return std::make_pair(path, max_phi_T);
+}
+
+std::pair<std::vector<std::size_t>, double> LinearMemoryViterbiDecodingAlgorithm::decode_indices(const std::vector<std::string>& sequence, std::size_t t_max) {
+	SymbolEmissions emissions(_model, sequence);
+	return _decode_indices(emissions, t_max);
+}
+
+std::pair<std::vector<std::size_t>, double> LinearMemoryViterbiDecodingAlgorithm::_decode_indices(Emissions& emissions, std::size_t t_max) {
+	if(t_max == 0) t_max = emissions.size();
+	if(emissions.size() == 0) throw std::logic_error("viterbi on empty sequence");
+	else if(_model->has_silent_closure()){
+		return _closure_decode_indices(emissions, std::min(emissions.size(), t_max));
+	}
 	else{
 		Traceback psi(_model->A.size());
-		std::vector<double> phi = viterbi_init(psi, sequence);
-		for(std::size_t t = 1; t < std::min(sequence.size(), t_max); ++t) {
-			phi = viterbi_step(phi, psi, t, sequence);
+		std::vector<double> phi = _viterbi_init(psi, emissions.at(0));
+		for(std::size_t t = 1; t < std::min(emissions.size(), t_max); ++t) {
+			phi = _viterbi_step(phi, psi, emissions.at(t));
 		}
 		std::size_t max_state_index = viterbi_terminate(phi);
 		//utils::mem_info();
-		double max_phi_T = phi[max_state_index];
-		if(max_phi_T != utils::kNegInf && max_state_index < _model->A.size()){
-			std::vector<std::size_t> path_indices = psi.from(max_state_index);
-			std::vector<std::string> path;
-			path.reserve(path_indices.size());
-			for(std::size_t path_index : path_indices){
-				path.push_back(_model->states_names[path_index]);
-			}
-			return std::make_pair(path, max_phi_T);
+		if(max_state_index < _model->A.size() && phi[max_state_index] != utils::kNegInf){
+			return std::make_pair(psi.from(max_state_index), phi[max_state_index]);
 		}
 		else{
 			/* Sequence is impossible. */
-			return std::make_pair(std::vector<std::string>(), utils::kNegInf);
+			return std::make_pair(std::vector<std::size_t>(), utils::kNegInf);
 		}
 	}
 }
 
+std::pair<std::vector<std::size_t>, double> LinearMemoryViterbiDecodingAlgorithm::_closure_decode_indices(Emissions& emissions, std::size_t t_max) {
+	const RawModel::SilentClosure& closure = _model->silent_closure;
+	std::size_t num_states = _model->A.size();
+	std::size_t num_emitting = _model->silent_states_index;
+	instrumentation::PhaseTimer timer(instrumentation::kViterbiInit);
+	Traceback psi(num_emitting);
+	std::vector<double> phi(num_emitting);
+	const double* emissions_t = emissions.at(0);
+	for(std::size_t i = 0; i < num_emitting; ++i){
+		phi[i] = closure.begin_log_max[i] + emissions_t[i];
+	}
+	psi.next_column();
+	timer.next(instrumentation::kViterbiStep);
+	instrumentation::count(instrumentation::kCells, num_emitting * t_max);
+	std::vector<double> phi_prev_t(num_emitting);
+	for(std::size_t t = 1; t < t_max; ++t){
+		std::swap(phi, phi_prev_t);
+		emissions_t = emissions.at(t);
+		for(std::size_t i = 0; i < num_emitting; ++i){
+			double max_phi = utils::kNegInf;
+			std::size_t max_psi = num_emitting;
+			std::size_t max_length = 0;
+			for(std::size_t k = closure.offsets[i]; k < closure.offsets[i + 1]; ++k){
+				double current_phi = phi_prev_t[closure.from[k]] + closure.log_max[k];
+				if(current_phi > max_phi || (current_phi == max_phi && closure.max_length[k] < max_length)){
+					max_phi = current_phi;
+					max_psi = closure.from[k];
+					max_length = closure.max_length[k];
+				}
+			}
+			phi[i] = max_phi + emissions_t[i];
+			if(max_psi < num_emitting) psi.add_link(max_psi, i);
+		}
+		psi.next_column();
+	}
+	timer.next(instrumentation::kViterbiTerminate);
+	double max_phi_T = utils::kNegInf;
+	std::size_t max_state_index = num_emitting;
+	std::size_t max_length = 0;
+	for(std::size_t i = 0; i < num_emitting; ++i){
+		double phi_T = _model->is_finite ? phi[i] + closure.end_log_max[i] : phi[i];
+		std::size_t length = _model->is_finite ? closure.end_max_length[i] : 0;
+		if(phi_T > max_phi_T || (phi_T == max_phi_T && length < max_length)){
+			max_phi_T = phi_T;
+			max_state_index = i;
+			max_length = length;
+		}
+	}
+	if(max_state_index == num_emitting){
+		/* Sequence is impossible. */
+		return std::make_pair(std::vector<std::size_t>(), utils::kNegInf);
+	}
+	/* Put back the silent states between the emitting ones. */
+	std::vector<std::size_t> emitting_path = psi.from(max_state_index);
+	std::vector<std::size_t> path = _model->best_silent_chain(num_states, emitting_path.front());
+	for(std::size_t t = 0; t < emitting_path.size(); ++t){
+		path.push_back(emitting_path[t]);
+		std::vector<std::size_t> chain = (t + 1 < emitting_path.size()) ? 
+			_model->best_silent_chain(emitting_path[t], emitting_path[t + 1]) : 
+			(_model->is_finite ? _model->best_silent_chain(emitting_path[t], num_states) : std::vector<std::size_t>());
+		path.insert(path.end(), chain.begin(), chain.end());
+	}
+	return std::make_pair(path, max_phi_T);
+}
+
 /* ===================== LINEAR MEMORY TRAINING ===================== */
 
 LinearMemoryTrainingAlgorithm::LinearMemoryTrainingAlgorithm(const std::string& name, RawModel* model) : TrainingAlgorithm(name, model) {}
 LinearMemoryTrainingAlgorithm::~LinearMemoryTrainingAlgorithm() {}
 
+struct __EncodedSequenceHash {
+	std::size_t operator()(const std::vector<std::size_t>& codes) const {
+		std::size_t hash = codes.size();
+		for(std::size_t code : codes){
+			hash ^= code + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+		}
+		return hash;
+	}
+};
+
+LinearMemoryTrainingAlgorithm::SequenceBatch LinearMemoryTrainingAlgorithm::collapse(
+	const std::vector<std::vector<std::string>>& sequences, const std::vector<double>& weights){
+	if(weights.size() != sequences.size()) { throw std::invalid_argument(error_message::kTrainingWeightsMismatch); }
+	SequenceBatch batch{std::vector<const std::vector<std::string>*>(), std::vector<double>()};
+	std::unordered_map<std::string, std::size_t> symbols_codes;
+	std::unordered_map<std::vector<std::size_t>, std::size_t, __EncodedSequenceHash> batch_ids;
+	std::vector<std::size_t> codes;
+	for(std::size_t s = 0; s < sequences.size(); ++s){
+		if(! (weights[s] >= 0)) { throw std::invalid_argument(error_message::kTrainingWeightsMismatch); }
+		if(sequences[s].empty() || weights[s] == 0) { continue; }
+		codes.clear();
+		for(const std::string& symbol : sequences[s]){
+			codes.push_back(symbols_codes.emplace(symbol, symbols_codes.size()).first->second);
+		}
+		std::pair<std::unordered_map<std::vector<std::size_t>, std::size_t, __EncodedSequenceHash>::iterator, bool> inserted = 
+			batch_ids.emplace(codes, batch.sequences.size());
+		if(inserted.second){
+			batch.sequences.push_back(&sequences[s]);
+			batch.weights.push_back(weights[s]);
+		}
+		else{
+			batch.weights[inserted.first->second] += weights[s];
+		}
+	}
+	return batch;
+}
+
+SufficientStatistics LinearMemoryTrainingAlgorithm::to_statistics(const TransitionScore& transitions_scores, 
+	const EmissionScore& emissions_scores, bool log_counts){
+	SufficientStatistics statistics;
+	statistics.log_counts = log_counts;
+	for(std::size_t id = 0; id < transitions_scores.num_free_begin_transitions(); ++id){
+		statistics.begin_counts.push_back(transitions_scores.score_begin(0, id));
+	}
+	for(std::size_t id = 0; id < transitions_scores.num_free_transitions(); ++id){
+		statistics.transition_counts.push_back(transitions_scores.score(0, id));
+	}
+	for(std::size_t id = 0; id < transitions_scores.num_free_end_transitions(); ++id){
+		statistics.end_counts.push_back(transitions_scores.score_end(0, id));
+	}
+	for(std::size_t id = 0; id < emissions_scores.num_free_emissions(); ++id){
+		statistics.emission_counts.push_back(emissions_scores.score(0, id));
+	}
+	return statistics;
+}
+
+void LinearMemoryTrainingAlgorithm::from_statistics(const SufficientStatistics& statistics, 
+	TransitionScore& transitions_scores, EmissionScore& emissions_scores){
+	for(std::size_t id = 0; id < statistics.begin_counts.size(); ++id){
+		transitions_scores.set_begin_score(0, id, statistics.begin_counts[id]);
+	}
+	for(std::size_t id = 0; id < statistics.transition_counts.size(); ++id){
+		transitions_scores.set_score(0, id, statistics.transition_counts[id]);
+	}
+	for(std::size_t id = 0; id < statistics.end_counts.size(); ++id){
+		transitions_scores.set_end_score(0, id, statistics.end_counts[id]);
+	}
+	for(std::size_t id = 0; id < statistics.emission_counts.size(); ++id){
+		emissions_scores.set_score(0, id, statistics.emission_counts[id]);
+	}
+}
+
+void LinearMemoryTrainingAlgorithm::check_statistics(const SufficientStatistics& statistics, bool log_counts) const {
+	if(statistics.log_counts != log_counts || statistics.begin_counts.size() != _model->free_pi_begin.size() 
+		|| statistics.transition_counts.size() != _model->free_transitions.size() 
+		|| statistics.end_counts.size() != _model->free_pi_end.size() 
+		|| statistics.emission_counts.size() != _model->free_emissions.size()){
+		throw std::invalid_argument(error_message::kSufficientStatisticsMismatch);
+	}
+}
+
 unsigned int LinearMemoryTrainingAlgorithm::delta(std::size_t i, std::size_t j){
 	return (unsigned int)(i == j);
 }
@@ -574,15 +1642,15 @@ LinearMemoryTrainingAlgorithm::TransitionScore& LinearMemoryTrainingAlgorithm::T
 	return *this;
 }
 
-void LinearMemoryTrainingAlgorithm::TransitionScore::add(const TransitionScore& other, std::size_t m, std::size_t l){
+void LinearMemoryTrainingAlgorithm::TransitionScore::add(const TransitionScore& other, std::size_t m, std::size_t l, double weight){
 	for(std::size_t id = 0; id < _transitions_scores[m].size(); ++id){
-		_transitions_scores[m][id] += other._transitions_scores[l][id];
+		_transitions_scores[m][id] += weight * other._transitions_scores[l][id];
 	}
 	for(std::size_t id = 0; id < _pi_begin_scores[m].size(); ++id){
-		_pi_begin_scores[m][id] += other._pi_begin_scores[l][id];
+		_pi_begin_scores[m][id] += weight * other._pi_begin_scores[l][id];
 	}
 	for(std::size_t id = 0; id < _pi_end_scores[m].size(); ++id){
-		_pi_end_scores[m][id] += other._pi_end_scores[l][id];
+		_pi_end_scores[m][id] += weight * other._pi_end_scores[l][id];
 	}
 }
 
@@ -717,9 +1785,9 @@ std::size_t LinearMemoryTrainingAlgorithm::EmissionScore::num_free_emissions() c
 	return _free_emissions->size();
 }
 
-void LinearMemoryTrainingAlgorithm::EmissionScore::add(const EmissionScore& other, std::size_t m, std::size_t l){
+void LinearMemoryTrainingAlgorithm::EmissionScore::add(const EmissionScore& other, std::size_t m, std::size_t l, double weight){
 	for(std::size_t id = 0; id < _emissions_scores[m].size(); ++id){
-		_emissions_scores[m][id] += other._emissions_scores[l][id];
+		_emissions_scores[m][id] += weight * other._emissions_scores[l][id];
 	}	
 }
 
@@ -817,7 +1885,9 @@ void LinearMemoryTrainingAlgorithm::update_end(TransitionScore& counts, std::siz
 /* ===================== LINEAR MEMORY VITERBI TRAINING ===================== */
 
 LinearMemoryViterbiTraining::LinearMemoryViterbiTraining(RawModel* model) : 
-	LinearMemoryTrainingAlgorithm(hmm_config::kLinearMemoryViterbiTrainingAlgorithmName, model), 
+	LinearMemoryViterbiTraining(hmm_config::kLinearMemoryViterbiTrainingAlgorithmName, model) {}
+LinearMemoryViterbiTraining::LinearMemoryViterbiTraining(const std::string& name, RawModel* model) : 
+	LinearMemoryTrainingAlgorithm(name, model), 
 	_decoding_algorithm(model), _forward_algorithm(model) {}
 LinearMemoryViterbiTraining* LinearMemoryViterbiTraining::clone() const { return new LinearMemoryViterbiTraining(*this); }
 void LinearMemoryViterbiTraining::set_model(RawModel* model) { 
@@ -828,9 +1898,11 @@ void LinearMemoryViterbiTraining::set_model(RawModel* model) {
 
 LinearMemoryViterbiTraining::~LinearMemoryViterbiTraining() {}
 
-double LinearMemoryViterbiTraining::train(const std::vector<std::vector<std::string>>& sequences, 
+double LinearMemoryViterbiTraining::train(const std::vector<std::vector<std::string>>& sequences, const std::vector<double>& weights, 
 	double transition_pseudocount, double convergence_threshold, unsigned int min_iterations, unsigned int max_iterations){
 
+	SequenceBatch batch = collapse(sequences, weights);
+
 	/* This holds all the counts for the batch of sequences. */
 	TransitionScore total_transition_count(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, 1);
 	EmissionScore total_emission_count(_model->free_emissions, 1);
@@ -842,70 +1914,161 @@ double LinearMemoryViterbiTraining::train(const std::vector<std::vector<std::str
 	unsigned int iteration = 0;
 	/* Use likelihood to determine convergence. */
 	double delta = utils::kInf;
-	double initial_likelihood = _forward_algorithm.log_likelihood(sequences);
-	double previous_likelihood = initial_likelihood;
-	double current_likelihood;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	instrumentation::Tracer::Span training_span(_tracer.get(), "training");
+	training_span.argument("sequences", (double) batch.sequences.size());
+	instrumentation::PhaseTimer timer(instrumentation::kLikelihood);
+	double initial_likelihood = 0;
+	double current_likelihood = 0;
+	std::uint64_t corpus_hash = (_checkpoint_filename.empty()) ? 0 : _corpus_hash(sequences, weights);
+	std::uint64_t parameters_hash = (_checkpoint_filename.empty()) ? 0 : _parameters_hash();
+	if(! _resume(corpus_hash, parameters_hash, iteration, initial_likelihood, current_likelihood, delta)){
+		instrumentation::Tracer::Span initial_span(_tracer.get(), "convergence check");
+		for(std::size_t s = 0; s < batch.sequences.size(); ++s){
+			initial_likelihood += batch.weights[s] * _forward_algorithm.log_likelihood(*batch.sequences[s]);
+		}
+		initial_span.argument("log_likelihood", initial_likelihood);
+		current_likelihood = initial_likelihood;
+	}
+	if(_tracer) _tracer->counter("log_likelihood", current_likelihood);
+	double previous_likelihood = current_likelihood;
 	while((iteration < min_iterations || delta > convergence_threshold) 
 		&& iteration < max_iterations) {
-		/* Iterate over each sequence and compute the counts. */
-		for(const std::vector<std::string>& sequence : sequences){
-			/* If sequence is empty, go to next sequence. */
-			if(sequence.size() == 0) { continue; }
-			LinearMemoryViterbiDecodingAlgorithm::Traceback psi(_model->A.size());
-			/* The initial step is a special case, since we use initial transition probabilities which
-			are not stored in the raw A matrix. */
-			std::vector<double> phi = _decoding_algorithm.viterbi_init(psi, sequence);
-			/* First iterate only on normal states since emission count are only needed for such states. */
-			for(std::size_t m = 0; m < _model->A.size(); ++m){
-				std::vector<std::size_t> traceback_m = psi.from(m);
-				update_begin(current_transition_count, traceback_m);
-				update_emissions(previous_emission_count, current_emission_count, traceback_m, sequence[0]);
-			}
-			previous_transition_count = current_transition_count;
-			previous_emission_count = current_emission_count;
-			/* Resetting the traceback since we only need the traceback of current viterbi step. */
-			psi.reset();
-			/* Main loop for current sequence. */
-			for(std::size_t k = 1; k < sequence.size(); ++k){
-				phi = _decoding_algorithm.viterbi_step(phi, psi, k, sequence);
-				for(std::size_t m = 0; m < _model->A.size(); ++m){
-					std::vector<std::size_t> traceback_m = psi.from(m);
-					update(previous_transition_count, current_transition_count, traceback_m);
-					update_emissions(previous_emission_count, current_emission_count, traceback_m, sequence[k]);
-				}
-				psi.reset();
-				previous_transition_count = current_transition_count;
-				previous_emission_count = current_emission_count;
-			}
-			std::size_t max_state_index = _decoding_algorithm.viterbi_terminate(phi);
-			/* Test wether the sequence is possible. */
-			if(max_state_index < _model->A.size()){
-				/* Add 1 to the end transition count of the max state index if model has end state. */
-				if(_model->is_finite){
-					update_end(current_transition_count, max_state_index);
-				}
-				/* Update the total counts. */
-				total_transition_count.add(current_transition_count, 0, max_state_index);
-				total_emission_count.add(current_emission_count, 0, max_state_index);
-			}
-			/* Reset counts. */
-			current_transition_count.reset();
-			previous_transition_count.reset();
-			current_emission_count.reset();
-			previous_emission_count.reset();
-		}
+		instrumentation::Tracer::Span iteration_span(_tracer.get(), "iteration");
+		iteration_span.argument("iteration", iteration);
+		timer.next(instrumentation::kEStep);
+		instrumentation::Tracer::Span e_step_span(_tracer.get(), "E-step");
+		/* Iterate over each distinct sequence and compute the counts. */
+		for(std::size_t s = 0; s < batch.sequences.size(); ++s){
+			instrumentation::Tracer::Span sequence_span(_tracer.get(), "sequence");
+			sequence_span.argument("sequence", (double) s);
+			sequence_span.argument("length", (double) batch.sequences[s]->size());
+			sequence_span.argument("weight", batch.weights[s]);
+			count(*batch.sequences[s], batch.weights[s], previous_transition_count, current_transition_count, 
+				previous_emission_count, current_emission_count, total_transition_count, total_emission_count);
+		}
+		e_step_span.end();
+		instrumentation::count(instrumentation::kSequences, batch.sequences.size());
+		timer.next(instrumentation::kMStep);
+		instrumentation::Tracer::Span m_step_span(_tracer.get(), "M-step");
 		update_model_from_scores(total_transition_count, total_emission_count, transition_pseudocount);
 		total_transition_count.reset();
 		total_emission_count.reset();
-		current_likelihood = _forward_algorithm.log_likelihood(sequences);
+		m_step_span.end();
+		timer.next(instrumentation::kLikelihood);
+		instrumentation::Tracer::Span check_span(_tracer.get(), "convergence check");
+		current_likelihood = 0;
+		for(std::size_t s = 0; s < batch.sequences.size(); ++s){
+			current_likelihood += batch.weights[s] * _forward_algorithm.log_likelihood(*batch.sequences[s]);
+		}
 		delta = current_likelihood - previous_likelihood;
+		check_span.argument("log_likelihood", current_likelihood);
+		check_span.argument("delta", delta);
+		check_span.end();
+		if(_tracer) _tracer->counter("log_likelihood", current_likelihood);
 		previous_likelihood = current_likelihood;
 		++iteration;
+		_checkpoint(corpus_hash, parameters_hash, iteration, initial_likelihood, current_likelihood, delta, false);
+		if(! _keep_training(iteration, current_likelihood, delta, start)) break;
+	}
+	if((iteration < min_iterations || delta > convergence_threshold) && iteration < max_iterations){
+		_checkpoint(corpus_hash, parameters_hash, iteration, initial_likelihood, current_likelihood, delta, true);
+	}
+	else{
+		_remove_checkpoint();
 	}
 	/* Return total improvement. */
 	return current_likelihood - initial_likelihood;
 }
 
+SufficientStatistics LinearMemoryViterbiTraining::expected_statistics(const std::vector<std::vector<std::string>>& sequences, 
+	const std::vector<double>& weights){
+	SequenceBatch batch = collapse(sequences, weights);
+	TransitionScore total_transition_count(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, 1);
+	EmissionScore total_emission_count(_model->free_emissions, 1);
+	TransitionScore previous_transition_count(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, _model->A.size());
+	TransitionScore current_transition_count(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, _model->A.size());
+	EmissionScore previous_emission_count(_model->free_emissions, _model->A.size());
+	EmissionScore current_emission_count(_model->free_emissions, _model->A.size());
+	double total_weight = 0;
+	double log_likelihood = 0;
+	for(std::size_t s = 0; s < batch.sequences.size(); ++s){
+		count(*batch.sequences[s], batch.weights[s], previous_transition_count, current_transition_count, 
+			previous_emission_count, current_emission_count, total_transition_count, total_emission_count);
+		total_weight += batch.weights[s];
+		log_likelihood += batch.weights[s] * _forward_algorithm.log_likelihood(*batch.sequences[s]);
+	}
+	instrumentation::count(instrumentation::kSequences, batch.sequences.size());
+	SufficientStatistics statistics = to_statistics(total_transition_count, total_emission_count, false);
+	statistics.total_weight = total_weight;
+	statistics.log_likelihood = log_likelihood;
+	return statistics;
+}
+
+void LinearMemoryViterbiTraining::maximize(const SufficientStatistics& statistics, double transition_pseudocount){
+	check_statistics(statistics, false);
+	TransitionScore transition_count(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, 1);
+	EmissionScore emission_count(_model->free_emissions, 1);
+	from_statistics(statistics, transition_count, emission_count);
+	update_model_from_scores(transition_count, emission_count, transition_pseudocount);
+}
+
+void LinearMemoryViterbiTraining::count(const std::vector<std::string>& sequence, double weight, 
+	TransitionScore& previous_transition_count, TransitionScore& current_transition_count,
+	EmissionScore& previous_emission_count, EmissionScore& current_emission_count,
+	TransitionScore& total_transition_count, EmissionScore& total_emission_count){
+		linear_memory_count(sequence, weight, previous_transition_count, current_transition_count, 
+			previous_emission_count, current_emission_count, total_transition_count, total_emission_count);
+}
+
+void LinearMemoryViterbiTraining::linear_memory_count(const std::vector<std::string>& sequence, double weight, 
+	TransitionScore& previous_transition_count, TransitionScore& current_transition_count,
+	EmissionScore& previous_emission_count, EmissionScore& current_emission_count,
+	TransitionScore& total_transition_count, EmissionScore& total_emission_count){
+	LinearMemoryViterbiDecodingAlgorithm::Traceback psi(_model->A.size());
+	/* The initial step is a special case, since we use initial transition probabilities which
+	are not stored in the raw A matrix. */
+	std::vector<double> phi = _decoding_algorithm.viterbi_init(psi, sequence);
+	/* First iterate only on normal states since emission count are only needed for such states. */
+	for(std::size_t m = 0; m < _model->A.size(); ++m){
+		std::vector<std::size_t> traceback_m = psi.from(m);
+		update_begin(current_transition_count, traceback_m);
+		update_emissions(previous_emission_count, current_emission_count, traceback_m, sequence[0]);
+	}
+	previous_transition_count = current_transition_count;
+	previous_emission_count = current_emission_count;
+	/* Resetting the traceback since we only need the traceback of current viterbi step. */
+	psi.reset();
+	/* Main loop for current sequence. */
+	for(std::size_t k = 1; k < sequence.size(); ++k){
+		phi = _decoding_algorithm.viterbi_step(phi, psi, k, sequence);
+		for(std::size_t m = 0; m < _model->A.size(); ++m){
+			std::vector<std::size_t> traceback_m = psi.from(m);
+			update(previous_transition_count, current_transition_count, traceback_m);
+			update_emissions(previous_emission_count, current_emission_count, traceback_m, sequence[k]);
+		}
+		psi.reset();
+		previous_transition_count = current_transition_count;
+		previous_emission_count = current_emission_count;
+	}
+	std::size_t max_state_index = _decoding_algorithm.viterbi_terminate(phi);
+	/* Test wether the sequence is possible. */
+	if(max_state_index < _model->A.size()){
+		/* Add 1 to the end transition count of the max state index if model has end state. */
+		if(_model->is_finite){
+			update_end(current_transition_count, max_state_index);
+		}
+		/* Update the total counts. */
+		total_transition_count.add(current_transition_count, 0, max_state_index, weight);
+		total_emission_count.add(current_emission_count, 0, max_state_index, weight);
+	}
+	/* Reset counts. */
+	current_transition_count.reset();
+	previous_transition_count.reset();
+	current_emission_count.reset();
+	previous_emission_count.reset();
+}
+
 void LinearMemoryViterbiTraining::update_model_from_scores(const TransitionScore& transitions_scores, 
 	const EmissionScore& emissions_scores, double transition_pseudocount){
 		update_model_transitions_from_scores(transitions_scores, transition_pseudocount);
@@ -962,6 +2125,9 @@ void LinearMemoryViterbiTraining::update_model_transitions_from_scores(const Tra
 			_model->pi_end[state_id] = log((transitions_counts.score_end(0, end_transition_id) + transition_pseudocount) / out_transitions_counts[state_id]);
 		}
 	}
+	/* Transitions that were null may have gained mass, and the paths through the silent states changed. */
+	_model->compute_envelope();
+	_model->compute_silent_closure();
 }
 
 void LinearMemoryViterbiTraining::update_model_emissions_from_scores(const EmissionScore& emissions_counts){
@@ -984,6 +2150,95 @@ void LinearMemoryViterbiTraining::update_model_emissions_from_scores(const Emiss
 	}
 }
 
+/* ===================== PATH COUNTING VITERBI TRAINING ===================== */
+
+PathCountingViterbiTraining::PathCountingViterbiTraining(RawModel* model, std::size_t max_path_length) : 
+	LinearMemoryViterbiTraining(hmm_config::kPathCountingViterbiTrainingAlgorithmName, model),
+	_max_path_length(max_path_length), _begin_ids(), _end_ids(), _transition_ids(), _emission_ids() {}
+PathCountingViterbiTraining* PathCountingViterbiTraining::clone() const { return new PathCountingViterbiTraining(*this); }
+PathCountingViterbiTraining::~PathCountingViterbiTraining() {}
+
+std::size_t PathCountingViterbiTraining::max_path_length() const { return _max_path_length; }
+void PathCountingViterbiTraining::set_max_path_length(std::size_t max_path_length) { _max_path_length = max_path_length; }
+
+double PathCountingViterbiTraining::train(const std::vector<std::vector<std::string>>& sequences, const std::vector<double>& weights, 
+	double transition_pseudocount, double convergence_threshold, unsigned int min_iterations, unsigned int max_iterations){
+	_index_free_parameters();
+	return LinearMemoryViterbiTraining::train(sequences, weights, transition_pseudocount, convergence_threshold, min_iterations, max_iterations);
+}
+
+SufficientStatistics PathCountingViterbiTraining::expected_statistics(const std::vector<std::vector<std::string>>& sequences, 
+	const std::vector<double>& weights){
+	_index_free_parameters();
+	return LinearMemoryViterbiTraining::expected_statistics(sequences, weights);
+}
+
+void PathCountingViterbiTraining::_index_free_parameters(){
+	std::size_t num_states = _model->A.size();
+	_begin_ids.clear();
+	_end_ids.clear();
+	_transition_ids.clear();
+	_emission_ids.assign(num_states, std::unordered_map<std::string, std::size_t>());
+	for(std::size_t id = 0; id < _model->free_pi_begin.size(); ++id){
+		_begin_ids[_model->free_pi_begin[id]] = id;
+	}
+	for(std::size_t id = 0; id < _model->free_pi_end.size(); ++id){
+		_end_ids[_model->free_pi_end[id]] = id;
+	}
+	for(std::size_t id = 0; id < _model->free_transitions.size(); ++id){
+		_transition_ids[_model->free_transitions[id].first * num_states + _model->free_transitions[id].second] = id;
+	}
+	for(std::size_t id = 0; id < _model->free_emissions.size(); ++id){
+		_emission_ids[_model->free_emissions[id].first][_model->free_emissions[id].second] = id;
+	}
+}
+
+void PathCountingViterbiTraining::count(const std::vector<std::string>& sequence, double weight, 
+	TransitionScore& previous_transition_count, TransitionScore& current_transition_count,
+	EmissionScore& previous_emission_count, EmissionScore& current_emission_count,
+	TransitionScore& total_transition_count, EmissionScore& total_emission_count){
+	if(sequence.size() > _max_path_length){
+		linear_memory_count(sequence, weight, previous_transition_count, current_transition_count, 
+			previous_emission_count, current_emission_count, total_transition_count, total_emission_count);
+	}
+	else{
+		_path_count(_decoding_algorithm.decode_indices(sequence, sequence.size()).first, sequence, weight, total_transition_count, total_emission_count);
+	}
+}
+
+void PathCountingViterbiTraining::_path_count(const std::vector<std::size_t>& path, const std::vector<std::string>& sequence,
+	double weight, TransitionScore& total_transition_count, EmissionScore& total_emission_count){
+	/* Sequence is impossible. */
+	if(path.empty()) { return; }
+	std::size_t num_states = _model->A.size();
+	std::unordered_map<std::size_t, std::size_t>::const_iterator it;
+	/* Begin transition. */
+	if((it = _begin_ids.find(path[0])) != _begin_ids.end()){
+		total_transition_count.set_begin_score(0, it->second, total_transition_count.score_begin(0, it->second) + weight);
+	}
+	/* Transitions along the path. */
+	for(std::size_t k = 0; k + 1 < path.size(); ++k){
+		if((it = _transition_ids.find(path[k] * num_states + path[k + 1])) != _transition_ids.end()){
+			total_transition_count.set_score(0, it->second, total_transition_count.score(0, it->second) + weight);
+		}
+	}
+	/* End transition. */
+	if(_model->is_finite && (it = _end_ids.find(path[path.size() - 1])) != _end_ids.end()){
+		total_transition_count.set_end_score(0, it->second, total_transition_count.score_end(0, it->second) + weight);
+	}
+	/* Emissions : each non-silent state of the path emits the next symbol of the sequence. */
+	std::size_t t = 0;
+	std::unordered_map<std::string, std::size_t>::const_iterator emission_it;
+	for(std::size_t state_id : path){
+		if(state_id >= _model->silent_states_index) { continue; }
+		const std::unordered_map<std::string, std::size_t>& state_emission_ids = _emission_ids[state_id];
+		if((emission_it = state_emission_ids.find(sequence[t])) != state_emission_ids.end()){
+			total_emission_count.set_score(0, emission_it->second, total_emission_count.score(0, emission_it->second) + weight);
+		}
+		++t;
+	}
+}
+
 /* ===================== LINEAR MEMORY BAUM WELCH TRAINING ===================== */
 
 LinearMemoryBaumWelchTraining::LinearMemoryBaumWelchTraining(RawModel* model) : 
@@ -1050,6 +2305,9 @@ void LinearMemoryBaumWelchTraining::update_model_transitions_from_log_scores(con
 			_model->pi_end[state_id] = transitions_scores.score_end(0, end_transition_id) - out_transitions_scores[state_id];
 		}
 	}
+	/* Transitions that were null may have gained mass, and the paths through the silent states changed. */
+	_model->compute_envelope();
+	_model->compute_silent_closure();
 }
 
 void LinearMemoryBaumWelchTraining::update_model_emissions_from_log_scores(const EmissionScore& emissions_scores){
@@ -1072,11 +2330,210 @@ void LinearMemoryBaumWelchTraining::update_model_emissions_from_log_scores(const
 	}
 }
 
-double LinearMemoryBaumWelchTraining::train(const std::vector<std::vector<std::string>>& sequences, 
+void LinearMemoryBaumWelchTraining::_count(Emissions& emissions, EmissionStatistics& statistics, double seq_log_likelihood, double weight,
+	TransitionScore& previous_transition_score, TransitionScore& current_transition_score, 
+	EmissionScore& previous_emission_score, EmissionScore& current_emission_score, 
+	TransitionScore& total_transition_score, EmissionScore& total_emission_score){
+	std::vector<double> previous_beta, beta, beta_end;
+	std::vector<double> emissions_first;
+	const double* emissions_next;
+	const double* statistics_t;
+	std::size_t i, j, state_id;
+	double score;
+	/* Initialization. */
+	beta = _backward_algorithm.backward_init();
+	statistics_t = statistics.at(emissions.size() - 1);
+	for(std::size_t m = _model->A.size(); m-- > 0;){
+		for(std::size_t free_emission_id = 0; free_emission_id < current_emission_score.num_free_emissions(); ++free_emission_id){
+			state_id = current_emission_score.get_state_id(free_emission_id);
+			score = beta[state_id] + statistics_t[free_emission_id] + log_delta(state_id, m);
+			current_emission_score.set_score(m, free_emission_id, score);	
+		}
+
+		/* Compute the transitions scores for silent states paths to the end state. Same behavior as in backward_init. */
+		for(std::size_t free_end_transition_id = 0; free_end_transition_id < current_transition_score.num_free_end_transitions(); ++free_end_transition_id){
+			state_id = current_transition_score.get_state_id_to_end(free_end_transition_id);
+			score = _model->pi_end[state_id] + log_delta(m, state_id);
+			for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
+				score = utils::sum_log_prob(score, current_transition_score.score_end(n, free_end_transition_id) + _model->A[m][n]);
+			}
+			current_transition_score.set_end_score(m, free_end_transition_id, score);
+		}
+
+		for(std::size_t free_transition_id = 0; free_transition_id < current_transition_score.num_free_transitions(); ++free_transition_id){
+			i = current_transition_score.get_from_state_id(free_transition_id);
+			j = current_transition_score.get_to_state_id(free_transition_id);
+			if(j >= _model->silent_states_index){
+				score = beta[j] + log_delta(i, m) + _model->A[m][j];
+				for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
+					score = utils::sum_log_prob(score, current_transition_score.score(n, free_transition_id) + _model->A[m][n]);
+				}
+				current_transition_score.set_score(m, free_transition_id, score);
+			}
+		}
+	}
+	previous_beta = beta;
+	previous_transition_score = current_transition_score; 
+	previous_emission_score = current_emission_score;
+	current_transition_score.reset();
+	current_emission_score.reset();
+	/* Recurrence. */
+	for(std::size_t t = emissions.size() - 1; t-- > 0;){
+		emissions_next = emissions.at(t + 1);
+		statistics_t = statistics.at(t);
+		beta = _backward_algorithm._backward_step(previous_beta, emissions_next);
+		for(std::size_t m = _model->A.size(); m-- > 0;){
+			/* Compute transitions scores for current step. */
+			for(std::size_t free_transition_id = 0; free_transition_id < current_transition_score.num_free_transitions(); ++free_transition_id){
+				i = current_transition_score.get_from_state_id(free_transition_id);
+				j = current_transition_score.get_to_state_id(free_transition_id);
+				score = (j < _model->silent_states_index) ? previous_beta[j] + _model->A[m][j] + emissions_next[j] + log_delta(i, m) : beta[j] + _model->A[m][j] + log_delta(i, m);
+				/* Consider previous step non-silent states. */
+				for(std::size_t n = 0; n < _model->silent_states_index; ++n){
+					score = utils::sum_log_prob(score, previous_transition_score.score(n, free_transition_id) + _model->A[m][n] + emissions_next[n]);
+				}
+				/* Consider current step silent states. */
+				for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
+					score = utils::sum_log_prob(score,  current_transition_score.score(n, free_transition_id) + _model->A[m][n]);
+				}
+				current_transition_score.set_score(m, free_transition_id, score);
+			}
+			/* Compute end transitions scores. */
+			for(std::size_t free_end_transition_id = 0; free_end_transition_id < current_transition_score.num_free_end_transitions(); ++free_end_transition_id){
+				state_id = current_transition_score.get_state_id_to_end(free_end_transition_id);
+				score = utils::kNegInf;
+				/* Consider previous step non-silent states. */
+				for(std::size_t n = 0; n < _model->silent_states_index; ++n){
+					score = utils::sum_log_prob(score, previous_transition_score.score_end(n, free_end_transition_id) + _model->A[m][n] + emissions_next[n]);
+				}
+				/* Consider current step silent states. */
+				for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
+					score = utils::sum_log_prob(score,  current_transition_score.score_end(n, free_end_transition_id) + _model->A[m][n]);
+				}
+				current_transition_score.set_end_score(m, free_end_transition_id, score);
+			}
+			/* Compute emissions score for current step. */
+			for(std::size_t free_emission_id = 0; free_emission_id < current_emission_score.num_free_emissions(); ++free_emission_id){
+				state_id = current_emission_score.get_state_id(free_emission_id);
+					score = beta[m] + statistics_t[free_emission_id] + log_delta(m, state_id);
+				/* Consider previous step non-silent states. */
+				for(std::size_t n = 0; n < _model->silent_states_index; ++n){
+					score = utils::sum_log_prob(score, previous_emission_score.score(n, free_emission_id) + _model->A[m][n] + emissions_next[n]);
+				}
+				/* Consider current step silent states. */
+				for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
+					score = utils::sum_log_prob(score,  current_emission_score.score(n, free_emission_id) + _model->A[m][n]);
+				}
+				current_emission_score.set_score(m, free_emission_id, score);
+			}
+		}
+		previous_beta = beta;
+		previous_transition_score = current_transition_score;
+		previous_emission_score = current_emission_score;
+		current_transition_score.reset();
+		current_emission_score.reset();
+	}
+	/* Termination. */
+	emissions_next = emissions.at(0);
+	emissions_first.assign(emissions_next, emissions_next + _model->silent_states_index);
+	std::tie(beta, beta_end, std::ignore) = _backward_algorithm._backward_terminate(beta, emissions_first.data());
+
+	/* Compute the transitions scores for silent states paths to the begin state. 
+	This essentially uses the same loop as the first loop in backward_terminate. */
+	for(std::size_t m = _model->A.size(); m-- > _model->silent_states_index;){
+		for(std::size_t free_transition_id = 0; free_transition_id < current_transition_score.num_free_transitions(); ++free_transition_id){
+			i = current_transition_score.get_from_state_id(free_transition_id);
+			j = current_transition_score.get_to_state_id(free_transition_id);
+			score = (j < _model->silent_states_index) ? previous_beta[j] + _model->A[m][j] + emissions_first[j] + log_delta(i, m) : beta[j] + _model->A[m][j] + log_delta(i, m);
+			/* Consider previous step non-silent states. */
+			for(std::size_t n = 0; n < _model->silent_states_index; ++n){
+				score = utils::sum_log_prob(score, previous_transition_score.score(n, free_transition_id) + _model->A[m][n] + emissions_first[n]);
+			}
+			/* Consider current step silent states. */
+			for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
+				score = utils::sum_log_prob(score,  current_transition_score.score(n, free_transition_id) + _model->A[m][n]);
+			}
+			current_transition_score.set_score(m, free_transition_id, score);
+		}
+		for(std::size_t free_end_transition_id = 0; free_end_transition_id < current_transition_score.num_free_end_transitions(); ++free_end_transition_id){
+			state_id = current_transition_score.get_state_id_to_end(free_end_transition_id);
+			score = utils::kNegInf;
+			/* Consider previous step non-silent states. */
+			for(std::size_t n = 0; n < _model->silent_states_index; ++n){
+				score = utils::sum_log_prob(score, previous_transition_score.score_end(n, free_end_transition_id) + _model->A[m][n] + emissions_first[n]);
+			}
+			/* Consider current step silent states. */
+			for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
+				score = utils::sum_log_prob(score,  current_transition_score.score_end(n, free_end_transition_id) + _model->A[m][n]);
+			}
+			current_transition_score.set_end_score(m, free_end_transition_id, score);
+		}
+		for(std::size_t free_emission_id = 0; free_emission_id < current_emission_score.num_free_emissions(); ++free_emission_id){
+			state_id = current_emission_score.get_state_id(free_emission_id);
+			score = utils::kNegInf;
+			/* Consider previous step non-silent states. */
+			for(std::size_t n = 0; n < _model->silent_states_index; ++n){
+				score = utils::sum_log_prob(score, previous_emission_score.score(n, free_emission_id) + _model->A[m][n] + emissions_first[n]);
+			}
+			/* Consider current step silent states. */
+			for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
+				score = utils::sum_log_prob(score,  current_emission_score.score(n, free_emission_id) + _model->A[m][n]);
+			}
+			current_emission_score.set_score(m, free_emission_id, score);
+		}
+
+	}
+	for(std::size_t m = 0; m < _model->silent_states_index; ++m){
+		for(std::size_t free_transition_id = 0; free_transition_id < current_transition_score.num_free_transitions(); ++free_transition_id){
+			current_transition_score.set_score(m, free_transition_id, previous_transition_score.score(m, free_transition_id));
+		}
+		for(std::size_t free_end_transition_id = 0; free_end_transition_id < current_transition_score.num_free_end_transitions(); ++free_end_transition_id){
+			current_transition_score.set_end_score(m, free_end_transition_id, previous_transition_score.score_end(m, free_end_transition_id));
+		}
+		for(std::size_t free_emission_id = 0; free_emission_id < previous_emission_score.num_free_emissions(); ++free_emission_id){
+			current_emission_score.set_score(m, free_emission_id, previous_emission_score.score(m, free_emission_id));
+		}
+	}
+
+	/* Begin transitions. */
+	for(std::size_t free_begin_transition_id = 0; free_begin_transition_id < previous_transition_score.num_free_begin_transitions(); ++free_begin_transition_id){
+		state_id = previous_transition_score.get_state_id_from_begin(free_begin_transition_id);
+		current_transition_score.set_begin_score(0, free_begin_transition_id, beta_end[state_id]);
+	}
+
+	for(std::size_t m = 0; m < _model->A.size(); ++m){
+		score = (m < _model->silent_states_index) ? _model->pi_begin[m] + emissions_first[m] :  _model->pi_begin[m];
+		for(std::size_t free_transition_id = 0; free_transition_id < current_transition_score.num_free_transitions(); ++free_transition_id){
+			current_transition_score.set_score(m, free_transition_id, current_transition_score.score(m, free_transition_id) + score);
+		}
+		for(std::size_t free_end_transition_id = 0; free_end_transition_id < previous_transition_score.num_free_end_transitions(); ++free_end_transition_id){
+			current_transition_score.set_end_score(m, free_end_transition_id, current_transition_score.score_end(m, free_end_transition_id) + score);
+		}
+		for(std::size_t free_emission_id = 0; free_emission_id < previous_emission_score.num_free_emissions(); ++free_emission_id){
+			current_emission_score.set_score(m, free_emission_id, current_emission_score.score(m, free_emission_id) + score);
+		}
+	}
+
+	/* Update total scores, the posterior of the sequence being scaled by its weight. */
+	/* Transitions. */
+	log_update_transition_score(current_transition_score, total_transition_score, seq_log_likelihood - log(weight));
+
+	/* Emissions. */
+	log_update_emission_score(current_emission_score, total_emission_score, seq_log_likelihood - log(weight));
+
+	current_transition_score.reset();
+	previous_transition_score.reset();
+	current_emission_score.reset();
+	previous_emission_score.reset();
+}
+
+double LinearMemoryBaumWelchTraining::train(const std::vector<std::vector<std::string>>& sequences, const std::vector<double>& weights, 
 	double transition_pseudocount, double convergence_threshold, unsigned int min_iterations, unsigned int max_iterations){
 
 	if(transition_pseudocount > 0) { std::cout << "Warning : baum-welch algorithm does not add pseudocounts ! "; }
 
+	SequenceBatch batch = collapse(sequences, weights);
+
 	TransitionScore total_transition_score(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, 1, utils::kNegInf);
 	EmissionScore total_emission_score(_model->free_emissions, 1, utils::kNegInf);
 
@@ -1087,218 +2544,278 @@ double LinearMemoryBaumWelchTraining::train(const std::vector<std::vector<std::s
 	
 	unsigned int iteration = 0;
 	double delta = utils::kInf;
-	double initial_likelihood = _backward_algorithm.log_likelihood(sequences);
-	double previous_likelihood = initial_likelihood;
-	double current_likelihood;
-	std::vector<double> previous_beta, beta, beta_end;
-	std::size_t i, j, state_id;
-	double score;
-	std::string gamma;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	/* The log likelihood of each distinct sequence, computed once per iteration. */
+	std::vector<double> log_likelihoods(batch.sequences.size());
+	instrumentation::Tracer::Span training_span(_tracer.get(), "training");
+	training_span.argument("sequences", (double) batch.sequences.size());
+	instrumentation::PhaseTimer timer(instrumentation::kLikelihood);
+	double initial_likelihood = 0;
+	double current_likelihood = 0;
+	std::uint64_t corpus_hash = (_checkpoint_filename.empty()) ? 0 : _corpus_hash(sequences, weights);
+	std::uint64_t parameters_hash = (_checkpoint_filename.empty()) ? 0 : _parameters_hash();
+	bool resumed = _resume(corpus_hash, parameters_hash, iteration, initial_likelihood, current_likelihood, delta);
+	instrumentation::Tracer::Span initial_span(_tracer.get(), "convergence check");
+	for(std::size_t s = 0; s < batch.sequences.size(); ++s){
+		log_likelihoods[s] = _backward_algorithm.log_likelihood(*batch.sequences[s]);
+		if(! resumed) initial_likelihood += batch.weights[s] * log_likelihoods[s];
+	}
+	if(! resumed) current_likelihood = initial_likelihood;
+	initial_span.argument("log_likelihood", current_likelihood);
+	initial_span.end();
+	if(_tracer) _tracer->counter("log_likelihood", current_likelihood);
+	double previous_likelihood = current_likelihood;
 	while((iteration < min_iterations || delta > convergence_threshold) 
 		&& iteration < max_iterations) {
-			/* Iterate over each sequence and compute the counts. */
-		for(const std::vector<std::string>& sequence : sequences){
-			/* If sequence is empty, go to current sequence. */
-			if(sequence.size() == 0) { continue; }
-
-			/* Initialization. */
-			beta = _backward_algorithm.backward_init();
-			for(std::size_t m = _model->A.size(); m-- > 0;){
-				for(std::size_t free_emission_id = 0; free_emission_id < current_emission_score.num_free_emissions(); ++free_emission_id){
-					state_id = current_emission_score.get_state_id(free_emission_id);
-					gamma = current_emission_score.get_symbol(free_emission_id);
-					score = beta[state_id] + log_score(sequence[sequence.size() - 1], gamma) + log_delta(state_id, m);
-					current_emission_score.set_score(m, free_emission_id, score);	
-				}
-
-				/* Compute the transitions scores for silent states paths to the end state. Same behavior as in backward_init. */
-				for(std::size_t free_end_transition_id = 0; free_end_transition_id < current_transition_score.num_free_end_transitions(); ++free_end_transition_id){
-					state_id = current_transition_score.get_state_id_to_end(free_end_transition_id);
-					score = _model->pi_end[state_id] + log_delta(m, state_id);
-					for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
-						score = utils::sum_log_prob(score, current_transition_score.score_end(n, free_end_transition_id) + _model->A[m][n]);
-					}
-					current_transition_score.set_end_score(m, free_end_transition_id, score);
-				}
+		instrumentation::Tracer::Span iteration_span(_tracer.get(), "iteration");
+		iteration_span.argument("iteration", iteration);
+		timer.next(instrumentation::kEStep);
+		instrumentation::Tracer::Span e_step_span(_tracer.get(), "E-step");
+		/* Iterate over each distinct sequence and compute the counts. */
+		for(std::size_t s = 0; s < batch.sequences.size(); ++s){
+			instrumentation::Tracer::Span sequence_span(_tracer.get(), "sequence");
+			sequence_span.argument("sequence", (double) s);
+			sequence_span.argument("length", (double) batch.sequences[s]->size());
+			sequence_span.argument("weight", batch.weights[s]);
+			SymbolEmissions emissions(_model, *batch.sequences[s]);
+			SymbolStatistics statistics(_model->free_emissions, *batch.sequences[s]);
+			_count(emissions, statistics, log_likelihoods[s], batch.weights[s], 
+				previous_transition_score, current_transition_score, previous_emission_score, current_emission_score, 
+				total_transition_score, total_emission_score);
+		}
+		e_step_span.end();
+
+		instrumentation::count(instrumentation::kSequences, batch.sequences.size());
+		timer.next(instrumentation::kMStep);
+		instrumentation::Tracer::Span m_step_span(_tracer.get(), "M-step");
+		/* No pseudocount for b-w training ! */
+		update_model_from_log_scores(total_transition_score, total_emission_score);
+		total_transition_score.reset();
+		total_emission_score.reset();
+		m_step_span.end();
+		timer.next(instrumentation::kLikelihood);
+		instrumentation::Tracer::Span check_span(_tracer.get(), "convergence check");
+		current_likelihood = 0;
+		for(std::size_t s = 0; s < batch.sequences.size(); ++s){
+			log_likelihoods[s] = _backward_algorithm.log_likelihood(*batch.sequences[s]);
+			current_likelihood += batch.weights[s] * log_likelihoods[s];
+		}
+		delta = current_likelihood - previous_likelihood;
+		check_span.argument("log_likelihood", current_likelihood);
+		check_span.argument("delta", delta);
+		check_span.end();
+		if(_tracer) _tracer->counter("log_likelihood", current_likelihood);
+		previous_likelihood = current_likelihood;
+		++iteration;
+		_checkpoint(corpus_hash, parameters_hash, iteration, initial_likelihood, current_likelihood, delta, false);
+		if(! _keep_training(iteration, current_likelihood, delta, start)) break;
+	}
+	if((iteration < min_iterations || delta > convergence_threshold) && iteration < max_iterations){
+		_checkpoint(corpus_hash, parameters_hash, iteration, initial_likelihood, current_likelihood, delta, true);
+	}
+	else{
+		_remove_checkpoint();
+	}
+	return current_likelihood - initial_likelihood;
+}
 
-				for(std::size_t free_transition_id = 0; free_transition_id < current_transition_score.num_free_transitions(); ++free_transition_id){
-					i = current_transition_score.get_from_state_id(free_transition_id);
-					j = current_transition_score.get_to_state_id(free_transition_id);
-					if(j >= _model->silent_states_index){
-						score = beta[j] + log_delta(i, m) + _model->A[m][j];
-						for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
-							score = utils::sum_log_prob(score, current_transition_score.score(n, free_transition_id) + _model->A[m][n]);
-						}
-						current_transition_score.set_score(m, free_transition_id, score);
-					}
-				}
-			}
-			previous_beta = beta;
-			previous_transition_score = current_transition_score; 
-			previous_emission_score = current_emission_score;
-			current_transition_score.reset();
-			current_emission_score.reset();
-			/* Recurrence. */
-			for(std::size_t t = sequence.size() - 1; t-- > 0;){
-				beta = _backward_algorithm.backward_step(previous_beta, sequence, t);
-				for(std::size_t m = _model->A.size(); m-- > 0;){
-					/* Compute transitions scores for current step. */
-					for(std::size_t free_transition_id = 0; free_transition_id < current_transition_score.num_free_transitions(); ++free_transition_id){
-						i = current_transition_score.get_from_state_id(free_transition_id);
-						j = current_transition_score.get_to_state_id(free_transition_id);
-						score = (j < _model->silent_states_index) ? previous_beta[j] + _model->A[m][j] + (*_model->B[j])[sequence[t + 1]] + log_delta(i, m) : beta[j] + _model->A[m][j] + log_delta(i, m);
-						/* Consider previous step non-silent states. */
-						for(std::size_t n = 0; n < _model->silent_states_index; ++n){
-							score = utils::sum_log_prob(score, previous_transition_score.score(n, free_transition_id) + _model->A[m][n] + (*_model->B[n])[sequence[t + 1]]);
-						}
-						/* Consider current step silent states. */
-						for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
-							score = utils::sum_log_prob(score,  current_transition_score.score(n, free_transition_id) + _model->A[m][n]);
-						}
-						current_transition_score.set_score(m, free_transition_id, score);
-					}
-					/* Compute end transitions scores. */
-					for(std::size_t free_end_transition_id = 0; free_end_transition_id < current_transition_score.num_free_end_transitions(); ++free_end_transition_id){
-						state_id = current_transition_score.get_state_id_to_end(free_end_transition_id);
-						score = utils::kNegInf;
-						/* Consider previous step non-silent states. */
-						for(std::size_t n = 0; n < _model->silent_states_index; ++n){
-							score = utils::sum_log_prob(score, previous_transition_score.score_end(n, free_end_transition_id) + _model->A[m][n] + (*_model->B[n])[sequence[t + 1]]);
-						}
-						/* Consider current step silent states. */
-						for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
-							score = utils::sum_log_prob(score,  current_transition_score.score_end(n, free_end_transition_id) + _model->A[m][n]);
-						}
-						current_transition_score.set_end_score(m, free_end_transition_id, score);
-					}
-					/* Compute emissions score for current step. */
-					for(std::size_t free_emission_id = 0; free_emission_id < current_emission_score.num_free_emissions(); ++free_emission_id){
-						state_id = current_emission_score.get_state_id(free_emission_id);
-						gamma = current_emission_score.get_symbol(free_emission_id);
-						score = beta[m] + log_score(sequence[t], gamma) + log_delta(m, state_id);
-						/* Consider previous step non-silent states. */
-						for(std::size_t n = 0; n < _model->silent_states_index; ++n){
-							score = utils::sum_log_prob(score, previous_emission_score.score(n, free_emission_id) + _model->A[m][n] + (*_model->B[n])[sequence[t + 1]]);
-						}
-						/* Consider current step silent states. */
-						for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
-							score = utils::sum_log_prob(score,  current_emission_score.score(n, free_emission_id) + _model->A[m][n]);
-						}
-						current_emission_score.set_score(m, free_emission_id, score);
-					}
-				}
-				previous_beta = beta;
-				previous_transition_score = current_transition_score;
-				previous_emission_score = current_emission_score;
-				current_transition_score.reset();
-				current_emission_score.reset();
-			}
-			/* Termination. */
-			std::tie(beta, beta_end, std::ignore) = _backward_algorithm.backward_terminate(beta, sequence);
-
-			/* Compute the transitions scores for silent states paths to the begin state. 
-			This essentially uses the same loop as the first loop in backward_terminate. */
-			for(std::size_t m = _model->A.size(); m-- > _model->silent_states_index;){
-				for(std::size_t free_transition_id = 0; free_transition_id < current_transition_score.num_free_transitions(); ++free_transition_id){
-					i = current_transition_score.get_from_state_id(free_transition_id);
-					j = current_transition_score.get_to_state_id(free_transition_id);
-					score = (j < _model->silent_states_index) ? previous_beta[j] + _model->A[m][j] + (*_model->B[j])[sequence[0]] + log_delta(i, m) : beta[j] + _model->A[m][j] + log_delta(i, m);
-					/* Consider previous step non-silent states. */
-					for(std::size_t n = 0; n < _model->silent_states_index; ++n){
-						score = utils::sum_log_prob(score, previous_transition_score.score(n, free_transition_id) + _model->A[m][n] + (*_model->B[n])[sequence[0]]);
-					}
-					/* Consider current step silent states. */
-					for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
-						score = utils::sum_log_prob(score,  current_transition_score.score(n, free_transition_id) + _model->A[m][n]);
-					}
-					current_transition_score.set_score(m, free_transition_id, score);
-				}
-				for(std::size_t free_end_transition_id = 0; free_end_transition_id < current_transition_score.num_free_end_transitions(); ++free_end_transition_id){
-					state_id = current_transition_score.get_state_id_to_end(free_end_transition_id);
-					score = utils::kNegInf;
-					/* Consider previous step non-silent states. */
-					for(std::size_t n = 0; n < _model->silent_states_index; ++n){
-						score = utils::sum_log_prob(score, previous_transition_score.score_end(n, free_end_transition_id) + _model->A[m][n] + (*_model->B[n])[sequence[0]]);
-					}
-					/* Consider current step silent states. */
-					for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
-						score = utils::sum_log_prob(score,  current_transition_score.score_end(n, free_end_transition_id) + _model->A[m][n]);
-					}
-					current_transition_score.set_end_score(m, free_end_transition_id, score);
-				}
-				for(std::size_t free_emission_id = 0; free_emission_id < current_emission_score.num_free_emissions(); ++free_emission_id){
-					state_id = current_emission_score.get_state_id(free_emission_id);
-					gamma = current_emission_score.get_symbol(free_emission_id);
-					score = utils::kNegInf;
-					/* Consider previous step non-silent states. */
-					for(std::size_t n = 0; n < _model->silent_states_index; ++n){
-						score = utils::sum_log_prob(score, previous_emission_score.score(n, free_emission_id) + _model->A[m][n] + (*_model->B[n])[sequence[0]]);
-					}
-					/* Consider current step silent states. */
-					for(std::size_t n = std::max(m + 1, _model->silent_states_index); n < _model->A.size(); ++n){
-						score = utils::sum_log_prob(score,  current_emission_score.score(n, free_emission_id) + _model->A[m][n]);
-					}
-					current_emission_score.set_score(m, free_emission_id, score);
-				}
+SufficientStatistics LinearMemoryBaumWelchTraining::expected_statistics(const std::vector<std::vector<std::string>>& sequences, 
+	const std::vector<double>& weights){
+	SequenceBatch batch = collapse(sequences, weights);
+	TransitionScore total_transition_score(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, 1, utils::kNegInf);
+	EmissionScore total_emission_score(_model->free_emissions, 1, utils::kNegInf);
+	TransitionScore previous_transition_score(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, _model->A.size(), utils::kNegInf);
+	TransitionScore current_transition_score(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, _model->A.size(), utils::kNegInf);
+	EmissionScore previous_emission_score(_model->free_emissions, _model->A.size(), utils::kNegInf);
+	EmissionScore current_emission_score(_model->free_emissions, _model->A.size(), utils::kNegInf);
+	double total_weight = 0;
+	double log_likelihood = 0;
+	for(std::size_t s = 0; s < batch.sequences.size(); ++s){
+		double sequence_log_likelihood = _backward_algorithm.log_likelihood(*batch.sequences[s]);
+		SymbolEmissions emissions(_model, *batch.sequences[s]);
+		SymbolStatistics statistics(_model->free_emissions, *batch.sequences[s]);
+		_count(emissions, statistics, sequence_log_likelihood, batch.weights[s], 
+			previous_transition_score, current_transition_score, previous_emission_score, current_emission_score, 
+			total_transition_score, total_emission_score);
+		total_weight += batch.weights[s];
+		log_likelihood += batch.weights[s] * sequence_log_likelihood;
+	}
+	instrumentation::count(instrumentation::kSequences, batch.sequences.size());
+	SufficientStatistics statistics = to_statistics(total_transition_score, total_emission_score, true);
+	statistics.total_weight = total_weight;
+	statistics.log_likelihood = log_likelihood;
+	return statistics;
+}
+
+void LinearMemoryBaumWelchTraining::maximize(const SufficientStatistics& statistics, double transition_pseudocount){
+	if(transition_pseudocount > 0) { std::cout << "Warning : baum-welch algorithm does not add pseudocounts ! "; }
+	check_statistics(statistics, true);
+	TransitionScore transition_score(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, 1, utils::kNegInf);
+	EmissionScore emission_score(_model->free_emissions, 1, utils::kNegInf);
+	from_statistics(statistics, transition_score, emission_score);
+	update_model_from_log_scores(transition_score, emission_score);
+}
 
-			}
-			for(std::size_t m = 0; m < _model->silent_states_index; ++m){
-				for(std::size_t free_transition_id = 0; free_transition_id < current_transition_score.num_free_transitions(); ++free_transition_id){
-					current_transition_score.set_score(m, free_transition_id, previous_transition_score.score(m, free_transition_id));
-				}
-				for(std::size_t free_end_transition_id = 0; free_end_transition_id < current_transition_score.num_free_end_transitions(); ++free_end_transition_id){
-					current_transition_score.set_end_score(m, free_end_transition_id, previous_transition_score.score_end(m, free_end_transition_id));
-				}
-				for(std::size_t free_emission_id = 0; free_emission_id < previous_emission_score.num_free_emissions(); ++free_emission_id){
-					current_emission_score.set_score(m, free_emission_id, previous_emission_score.score(m, free_emission_id));
-				}
-			}
+double LinearMemoryBaumWelchTraining::train(const std::vector<FrameMatrix>& sequences, 
+	double transition_pseudocount, double convergence_threshold, unsigned int min_iterations, unsigned int max_iterations){
 
-			/* Begin transitions. */
-			for(std::size_t free_begin_transition_id = 0; free_begin_transition_id < previous_transition_score.num_free_begin_transitions(); ++free_begin_transition_id){
-				state_id = previous_transition_score.get_state_id_from_begin(free_begin_transition_id);
-				current_transition_score.set_begin_score(0, free_begin_transition_id, beta_end[state_id]);
-			}
+	if(transition_pseudocount > 0) { std::cout << "Warning : baum-welch algorithm does not add pseudocounts ! "; }
+	if(! _checkpoint_filename.empty()){
+		throw std::logic_error(error_message::format(error_message::kCheckpointNumericSequenceNotSupported, name()));
+	}
 
-			for(std::size_t m = 0; m < _model->A.size(); ++m){
-				score = (m < _model->silent_states_index) ? _model->pi_begin[m] + (*_model->B[m])[sequence[0]] :  _model->pi_begin[m];
-				for(std::size_t free_transition_id = 0; free_transition_id < current_transition_score.num_free_transitions(); ++free_transition_id){
-					current_transition_score.set_score(m, free_transition_id, current_transition_score.score(m, free_transition_id) + score);
-				}
-				for(std::size_t free_end_transition_id = 0; free_end_transition_id < previous_transition_score.num_free_end_transitions(); ++free_end_transition_id){
-					current_transition_score.set_end_score(m, free_end_transition_id, current_transition_score.score_end(m, free_end_transition_id) + score);
-				}
-				for(std::size_t free_emission_id = 0; free_emission_id < previous_emission_score.num_free_emissions(); ++free_emission_id){
-					current_emission_score.set_score(m, free_emission_id, current_emission_score.score(m, free_emission_id) + score);
-				}
+	/* The statistics are taken relative to the minimum of the frames, which keeps them non negative. */
+	std::vector<double> origin;
+	for(const FrameMatrix& sequence : sequences){
+		if(origin.empty()) { origin.assign(sequence.dimension(), utils::kInf); }
+		for(std::size_t t = 0; t < sequence.length(); ++t){
+			for(std::size_t d = 0; d < std::min(origin.size(), sequence.dimension()); ++d){
+				origin[d] = std::min(origin[d], sequence.frame(t)[d]);
 			}
+		}
+	}
+	std::vector<std::pair<std::size_t, std::string>> free_statistics = FrameStatistics::free_statistics(_model);
 
-			/* Update total scores. */
-			double seq_log_likelihood = _backward_algorithm.log_likelihood(sequence);
-			/* Transitions. */
-			log_update_transition_score(current_transition_score, total_transition_score, seq_log_likelihood);
-
-			/* Emissions. */
-			log_update_emission_score(current_emission_score, total_emission_score, seq_log_likelihood);
+	TransitionScore total_transition_score(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, 1, utils::kNegInf);
+	EmissionScore total_emission_score(free_statistics, 1, utils::kNegInf);
 
-			current_transition_score.reset();
-			previous_transition_score.reset();
-			current_emission_score.reset();
-			previous_emission_score.reset();
-		}
+	TransitionScore previous_transition_score(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, _model->A.size(), utils::kNegInf);
+	TransitionScore current_transition_score(_model->free_transitions, _model->free_pi_begin, _model->free_pi_end, _model->A.size(), utils::kNegInf);
+	EmissionScore previous_emission_score(free_statistics, _model->A.size(), utils::kNegInf);
+	EmissionScore current_emission_score(free_statistics, _model->A.size(), utils::kNegInf);
 
-		/* No pseudocount for b-w training ! */
-		update_model_from_log_scores(total_transition_score, total_emission_score);
+	unsigned int iteration = 0;
+	double delta = utils::kInf;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	instrumentation::Tracer::Span training_span(_tracer.get(), "training");
+	training_span.argument("sequences", (double) sequences.size());
+	instrumentation::PhaseTimer timer(instrumentation::kLikelihood);
+	instrumentation::Tracer::Span initial_span(_tracer.get(), "convergence check");
+	double initial_likelihood = 0;
+	for(const FrameMatrix& sequence : sequences){
+		initial_likelihood += _backward_algorithm.log_likelihood(sequence);
+	}
+	initial_span.argument("log_likelihood", initial_likelihood);
+	initial_span.end();
+	if(_tracer) _tracer->counter("log_likelihood", initial_likelihood);
+	double previous_likelihood = initial_likelihood;
+	double current_likelihood = initial_likelihood;
+	while((iteration < min_iterations || delta > convergence_threshold) 
+		&& iteration < max_iterations) {
+		instrumentation::Tracer::Span iteration_span(_tracer.get(), "iteration");
+		iteration_span.argument("iteration", iteration);
+		timer.next(instrumentation::kEStep);
+		instrumentation::Tracer::Span e_step_span(_tracer.get(), "E-step");
+		for(std::size_t s = 0; s < sequences.size(); ++s){
+			const FrameMatrix& sequence = sequences[s];
+			if(sequence.empty()) { continue; }
+			instrumentation::Tracer::Span sequence_span(_tracer.get(), "sequence");
+			sequence_span.argument("sequence", (double) s);
+			sequence_span.argument("length", (double) sequence.length());
+			instrumentation::count(instrumentation::kSequences);
+			NumericEmissions emissions(_model, sequence);
+			FrameStatistics statistics(_model, sequence, origin);
+			_count(emissions, statistics, _backward_algorithm.log_likelihood(sequence), 1.0, 
+				previous_transition_score, current_transition_score, previous_emission_score, current_emission_score, 
+				total_transition_score, total_emission_score);
+		}
+		e_step_span.end();
+
+		timer.next(instrumentation::kMStep);
+		instrumentation::Tracer::Span m_step_span(_tracer.get(), "M-step");
+		update_model_transitions_from_log_scores(total_transition_score);
+		update_model_continuous_emissions_from_log_scores(total_emission_score, origin);
 		total_transition_score.reset();
 		total_emission_score.reset();
-		current_likelihood = _backward_algorithm.log_likelihood(sequences);
+		m_step_span.end();
+		timer.next(instrumentation::kLikelihood);
+		instrumentation::Tracer::Span check_span(_tracer.get(), "convergence check");
+		current_likelihood = 0;
+		for(const FrameMatrix& sequence : sequences){
+			current_likelihood += _backward_algorithm.log_likelihood(sequence);
+		}
 		delta = current_likelihood - previous_likelihood;
+		check_span.argument("log_likelihood", current_likelihood);
+		check_span.argument("delta", delta);
+		check_span.end();
+		if(_tracer) _tracer->counter("log_likelihood", current_likelihood);
 		previous_likelihood = current_likelihood;
 		++iteration;
+		if(! _keep_training(iteration, current_likelihood, delta, start)) break;
 	}
 	return current_likelihood - initial_likelihood;
 }
 
+void LinearMemoryBaumWelchTraining::update_model_continuous_emissions_from_log_scores(const EmissionScore& emissions_scores, 
+	const std::vector<double>& origin){
+	std::size_t statistic_id = 0;
+	std::size_t num_components, dimension;
+	bool full_covariance;
+	for(std::size_t state_id : _model->free_continuous_emissions){
+		Distribution* distribution = _model->B[state_id];
+		if(! __mixture_shape(distribution, num_components, dimension, full_covariance)) { continue; }
+		std::vector<double> weights(num_components);
+		std::vector<double> means(num_components * dimension);
+		std::vector<double> covariances(num_components * ((full_covariance) ? dimension * dimension : dimension));
+		if(static_cast<ContinuousDistribution*>(distribution)->is_normal()){
+			const NormalDistribution* normal = static_cast<const NormalDistribution*>(distribution);
+			weights[0] = 1;
+			means[0] = normal->mean();
+			covariances[0] = normal->standard_deviation() * normal->standard_deviation();
+		}
+		else{
+			const GaussianMixtureDistribution* mixture = static_cast<const GaussianMixtureDistribution*>(distribution);
+			weights = mixture->weights();
+			means = mixture->means();
+			covariances = mixture->covariances();
+		}
+		/* Responsibilities of the components, normalized over the mixture. */
+		double log_total = utils::kNegInf;
+		std::size_t component_size = 1 + dimension + ((full_covariance) ? dimension * (dimension + 1) / 2 : dimension);
+		for(std::size_t k = 0; k < num_components; ++k){
+			log_total = utils::sum_log_prob(log_total, emissions_scores.score(0, statistic_id + k * component_size));
+		}
+		for(std::size_t k = 0; k < num_components; ++k){
+			double log_r = emissions_scores.score(0, statistic_id++);
+			if(log_r == utils::kNegInf){
+				/* No frame was emitted by the component, keep it as is. */
+				statistic_id += component_size - 1;
+				continue;
+			}
+			weights[k] = exp(log_r - log_total);
+			/* Means of y, the frames relative to the origin. */
+			std::vector<double> mean_y(dimension);
+			for(std::size_t d = 0; d < dimension; ++d){
+				mean_y[d] = exp(emissions_scores.score(0, statistic_id++) - log_r);
+				means[k * dimension + d] = origin[d] + mean_y[d];
+			}
+			for(std::size_t d = 0; d < dimension; ++d){
+				for(std::size_t e = (full_covariance) ? 0 : d; e <= d; ++e){
+					double covariance = exp(emissions_scores.score(0, statistic_id++) - log_r) - mean_y[d] * mean_y[e];
+					if(e == d) { covariance = std::max(covariance, hmm_config::kMinimumVariance); }
+					if(full_covariance){
+						covariances[k * dimension * dimension + d * dimension + e] = covariance;
+						covariances[k * dimension * dimension + e * dimension + d] = covariance;
+					}
+					else{
+						covariances[k * dimension + d] = covariance;
+					}
+				}
+			}
+		}
+		Distribution* updated;
+		if(static_cast<ContinuousDistribution*>(distribution)->is_normal()){
+			updated = new NormalDistribution(means[0], sqrt(covariances[0]));
+		}
+		else{
+			updated = new GaussianMixtureDistribution(dimension, weights, means, covariances, full_covariance);
+		}
+		updated->log_probabilities(distribution->uses_log_probabilities());
+		delete distribution;
+		_model->B[state_id] = updated;
+	}
+}
+
 void LinearMemoryBaumWelchTraining::log_update_transition_score(const TransitionScore& current_transition_score, TransitionScore& total_transition_score, double seq_log_likelihood){
 	double score;
 	/* Begin transitions. */
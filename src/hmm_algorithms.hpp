@@ -4,6 +4,17 @@
 #include <vector>
 #include <string>
 #include <utility>
+#include <unordered_map>
+#include <tuple>
+#include <map>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <istream>
+#include <ostream>
+#include <cstdint>
+#include "constants.hpp"
+#include "instrumentation.hpp"
 #include "state.hpp"
 #include "distributions.hpp"
 #include "hmm_base.hpp"
@@ -31,6 +42,9 @@ public:
 	virtual std::vector<double> forward(const std::vector<std::string>&, std::size_t) = 0;
 	virtual double log_likelihood(const std::vector<std::string>&) = 0;
 	virtual double log_likelihood(const std::vector<std::vector<std::string>>&) = 0;
+	/* Numeric sequences, for the models with continuous distributions. Throw if not supported by the algorithm. */
+	virtual std::vector<double> forward(const FrameMatrix&, std::size_t);
+	virtual double log_likelihood(const FrameMatrix&);
 
 	virtual ~ForwardAlgorithm();
 };
@@ -43,6 +57,9 @@ public:
 	virtual std::vector<double> backward(const std::vector<std::string>&, std::size_t) = 0;
 	virtual double log_likelihood(const std::vector<std::string>&) = 0;
 	virtual double log_likelihood(const std::vector<std::vector<std::string>>&) = 0;
+	/* Numeric sequences, for the models with continuous distributions. Throw if not supported by the algorithm. */
+	virtual std::vector<double> backward(const FrameMatrix&, std::size_t);
+	virtual double log_likelihood(const FrameMatrix&);
 	virtual ~BackwardAlgorithm();
 };
 
@@ -52,28 +69,259 @@ protected:
 public:
 	virtual DecodingAlgorithm* clone() const = 0;
 	virtual std::pair<std::vector<std::string>, double> decode(const std::vector<std::string>&, std::size_t) = 0;
+	/* Numeric sequences, for the models with continuous distributions. Throws if not supported by the algorithm. */
+	virtual std::pair<std::vector<std::string>, double> decode(const FrameMatrix&, std::size_t);
 	virtual ~DecodingAlgorithm();
 };
 
+/* State of a training at the end of an iteration, i.e. after its M-step and the log likelihood of the updated model. */
+struct TrainingProgress {
+	/* Number of iterations done, from 1. */
+	unsigned int iteration;
+	double log_likelihood;
+	/* Improvement of the log likelihood over the iteration. */
+	double delta;
+	/* Since the training started. */
+	double elapsed_seconds;
+	/* The updated model, which can be copied as a checkpoint. Only valid during the call. */
+	const RawModel* model;
+};
+
+/* Called at the end of each iteration of a training. Returning false stops the training there, even before its 
+minimum number of iterations. */
+typedef std::function<bool(const TrainingProgress&)> TrainingCallback;
+
+/* Result of the E-step of a training over a set of sequences : the expected counts of the free parameters of the model
+(Viterbi counts, or log expected counts for the Baum-Welch training), with the weighted log likelihood of the sequences
+under the model they were computed on. The statistics of the shards of a corpus, computed separately (e.g. by worker 
+processes) on the same model, merge into those of the whole corpus, from which the M-step re-estimates the model (see 
+TrainingAlgorithm::expected_statistics and maximize). save and load exchange them as text, through files or sockets. */
+struct SufficientStatistics {
+	/* The counts are log counts, merged by log sum instead of sum. */
+	bool log_counts;
+	/* Sum of the weights of the sequences (their number if unweighted). */
+	double total_weight;
+	double log_likelihood;
+	/* Indexed as the free_pi_begin, free_transitions, free_pi_end and free_emissions of the RawModel. */
+	std::vector<double> begin_counts;
+	std::vector<double> transition_counts;
+	std::vector<double> end_counts;
+	std::vector<double> emission_counts;
+
+	SufficientStatistics();
+	/* Adds the statistics of other. Throws if they do not have the same kind of counts of the same parameters. */
+	void merge(const SufficientStatistics& other);
+	/* Lossless : the counts are written with all their digits. */
+	void save(std::ostream&) const;
+	/* Throws if the input is not saved statistics. */
+	static SufficientStatistics load(std::istream&);
+	std::string to_string() const;
+	static SufficientStatistics from_string(const std::string&);
+};
+
+/* State of a training saved by its checkpoints : the number of iterations done, the log likelihoods of the initial and
+of the current model, the improvement of the last iteration, and the free parameters of the current model (log
+probabilities, indexed as the free_pi_begin, free_transitions, free_pi_end and free_emissions of the RawModel). Saved
+in a compact binary file, in the byte order of the machine, with hashes of the structure of the model, of the training
+sequences and of the free parameters of the initial model, which a resumed training must match. */
+struct TrainingCheckpoint {
+	std::uint64_t model_hash;
+	std::uint64_t corpus_hash;
+	std::uint64_t parameters_hash;
+	unsigned int iteration;
+	double initial_likelihood;
+	double log_likelihood;
+	double delta;
+	std::vector<double> begin_parameters;
+	std::vector<double> transition_parameters;
+	std::vector<double> end_parameters;
+	std::vector<double> emission_parameters;
+
+	TrainingCheckpoint();
+	/* Written in filename.tmp, then renamed, so that an interruption during the save keeps the previous checkpoint. 
+	Throws if the file cannot be written. */
+	void save(const std::string& filename) const;
+	/* Throws if the file is not a checkpoint. */
+	static TrainingCheckpoint load(const std::string& filename);
+};
+
 class TrainingAlgorithm : public HMMAlgorithm {
 protected:
+	/* Null unless a timeline of the trainings was asked for. Shared by the clones. */
+	std::shared_ptr<instrumentation::Tracer> _tracer;
+	TrainingCallback _callback;
+	/* No checkpoints if empty. */
+	std::string _checkpoint_filename;
+	unsigned int _checkpoint_interval;
 	TrainingAlgorithm(const std::string&, RawModel*);
+	/* Gives the progress of the training to the callback, if any, and returns wether to go on. */
+	bool _keep_training(unsigned int, double, double, std::chrono::steady_clock::time_point) const;
+	static std::uint64_t _corpus_hash(const std::vector<std::vector<std::string>>&, const std::vector<double>&);
+	std::uint64_t _model_hash() const;
+	std::uint64_t _parameters_hash() const;
+	/* Copies the current free parameters of the model in the checkpoint. */
+	void _save_parameters(TrainingCheckpoint&) const;
+	/* If a checkpoint of the training of the corpus (given by its hash) was saved, restores its model and sets the 
+	hash of the initial parameters, the iteration, the initial and current log likelihoods and the delta to its own. 
+	Returns false if there is none, throws if it was saved for another model or corpus, or from other initial 
+	parameters (unless the model is the one it saved, as after a training stopped by the callback). */
+	bool _resume(std::uint64_t, std::uint64_t&, unsigned int&, double&, double&, double&);
+	/* Saves the model and the state of the training at the end of an iteration if it is a multiple of the checkpoint
+	interval or, at the end of a training stopped by the callback (last), if it is not. */
+	void _checkpoint(std::uint64_t, std::uint64_t, unsigned int, double, double, double, bool) const;
+	/* At the end of a training which converged or reached its maximum number of iterations, so that a next training
+	starts from its own model. */
+	void _remove_checkpoint() const;
 public:
 	virtual TrainingAlgorithm* clone() const = 0;
-	virtual double train(const std::vector<std::vector<std::string>>&, double, double, unsigned int, unsigned int) = 0;
+	/* The next trainings record their spans in tracer (none if null). */
+	void set_tracer(std::shared_ptr<instrumentation::Tracer>);
+	std::shared_ptr<instrumentation::Tracer> tracer() const;
+	/* Called after each iteration of the next trainings (none if empty). */
+	void set_callback(const TrainingCallback&);
+	/* The next trainings on symbols save their state in filename every interval iterations and when the callback stops
+	them, and start from it if it exists : running the same training again after an interruption resumes it where it 
+	was saved, with the same results as if it had not been interrupted. The file is removed once a training completes. 
+	An empty filename disables the checkpoints. */
+	void set_checkpoint(const std::string& filename, unsigned int interval = hmm_config::kDefaultCheckpointInterval);
+	/* E-step of an iteration of the training on the given weighted sequences, with the current model. Throws by default,
+	sufficient statistics being only supported by some of the training algorithms. */
+	virtual SufficientStatistics expected_statistics(const std::vector<std::vector<std::string>>&, const std::vector<double>&);
+	/* M-step : re-estimates the free parameters of the model from statistics (usually merged) computed on it, with the 
+	given transition pseudocount. Throws by default, or if the statistics do not match the algorithm or the model. */
+	virtual void maximize(const SufficientStatistics&, double);
+	/* Same as the weighted training with a weight of 1 for each sequence. */
+	virtual double train(const std::vector<std::vector<std::string>>&, double, double, unsigned int, unsigned int);
+	/* Each sequence counts as many times as its weight (e.g. its number of occurrences in the corpus), in the expected
+	counts as well as in the log likelihood. The weights must be non negative, one per sequence. */
+	virtual double train(const std::vector<std::vector<std::string>>&, const std::vector<double>&, double, double, unsigned int, unsigned int) = 0;
+	/* Throws by default, numeric sequences being only supported by some of the training algorithms. */
+	virtual double train(const std::vector<FrameMatrix>&, double, double, unsigned int, unsigned int);
 	virtual ~TrainingAlgorithm();
 };
 
+/* ===================== EMISSIONS ===================== */
+
+/* Log probabilities of the emissions of a sequence by the emitting states of a model, for all the states at once
+at each step. Lets the linear memory algorithms run on symbols as well as on numeric observations. */
+class Emissions {
+public:
+	virtual std::size_t size() const = 0;
+	/* The silent_states_index emission log probabilities of step t. Only valid until the next call. */
+	virtual const double* at(std::size_t t) = 0;
+	virtual ~Emissions();
+};
+
+class SymbolEmissions : public Emissions {
+private:
+	RawModel* _model;
+	const std::vector<std::string>& _sequence;
+	std::vector<double> _emissions;
+public:
+	SymbolEmissions(RawModel*, const std::vector<std::string>&);
+	SymbolEmissions(const SymbolEmissions&) = delete;
+	SymbolEmissions& operator=(const SymbolEmissions&) = delete;
+	std::size_t size() const;
+	const double* at(std::size_t);
+};
+
+/* The distributions of the emitting states must be continuous and of the dimension of the frames. Their log densities 
+are evaluated with the batched log_pdf over blocks of block_size steps, hence in forward as well as backward order, 
+each block of frames staying in cache while all the states are evaluated on it. */
+class NumericEmissions : public Emissions {
+private:
+	RawModel* _model;
+	const FrameMatrix& _sequence;
+	std::size_t _block_size;
+	std::size_t _block_begin;
+	std::size_t _block_end;
+	/* _block[i * _block_size + t - _block_begin] is the log density of step t for state i. */
+	std::vector<double> _block;
+	std::vector<double> _emissions;
+public:
+	NumericEmissions(RawModel*, const FrameMatrix&, std::size_t block_size = hmm_config::kDefaultEmissionsBlockSize);
+	/* The sequence is referenced, not copied. */
+	NumericEmissions(RawModel*, FrameMatrix&&, std::size_t = hmm_config::kDefaultEmissionsBlockSize) = delete;
+	NumericEmissions(const NumericEmissions&) = delete;
+	NumericEmissions& operator=(const NumericEmissions&) = delete;
+	std::size_t size() const;
+	const double* at(std::size_t);
+};
+
+/* ===================== EMISSION STATISTICS ===================== */
+
+/* Log values, at each step of a sequence, of the statistics of its observations accumulated by the Baum-Welch training 
+for the free emissions of a model, one per free emission of its EmissionScore. */
+class EmissionStatistics {
+public:
+	virtual std::size_t size() const = 0;
+	/* The statistics of step t. Only valid until the next call. */
+	virtual const double* at(std::size_t t) = 0;
+	virtual ~EmissionStatistics();
+};
+
+/* Indicators of the symbols of the free discrete emissions. */
+class SymbolStatistics : public EmissionStatistics {
+private:
+	const std::vector<std::pair<std::size_t, std::string>>& _free_emissions;
+	const std::vector<std::string>& _sequence;
+	std::vector<double> _statistics;
+public:
+	SymbolStatistics(const std::vector<std::pair<std::size_t, std::string>>&, const std::vector<std::string>&);
+	std::size_t size() const;
+	const double* at(std::size_t);
+};
+
+/* For each free continuous emission of a model with a normal or Gaussian mixture distribution and each of its 
+components (a normal distribution being a single component) : the responsibility r of the component for the frame, 
+then r * y[d] for each value and r * y[d] * y[e] for each pair of values (e == d for diagonal covariances, e <= d for 
+full ones), y being the frame minus the given origin. The origin is expected to bound the frames from below, so that 
+the statistics are non negative and can be summed in log space. The free uniform emissions have no statistics. */
+class FrameStatistics : public EmissionStatistics {
+private:
+	RawModel* _model;
+	const FrameMatrix& _sequence;
+	const std::vector<double>& _origin;
+	std::size_t _block_size;
+	std::size_t _block_begin;
+	std::size_t _block_end;
+	/* Log weighted densities of the components of each free mixture at the steps of the block, as given by 
+	GaussianMixtureDistribution::log_component_pdf. */
+	std::vector<std::vector<double>> _components;
+	std::vector<double> _log_y;
+	std::vector<double> _statistics;
+public:
+	FrameStatistics(RawModel*, const FrameMatrix&, const std::vector<double>& origin, std::size_t block_size = hmm_config::kDefaultEmissionsBlockSize);
+	FrameStatistics(const FrameStatistics&) = delete;
+	FrameStatistics& operator=(const FrameStatistics&) = delete;
+	/* Free emissions of the statistics of the model, i.e. their state and a label, as used by the EmissionScore. */
+	static std::vector<std::pair<std::size_t, std::string>> free_statistics(const RawModel*);
+	std::size_t size() const;
+	const double* at(std::size_t);
+};
+
 /* ===================== LINEAR MEMORY FORWARD ===================== */
 
 class LinearMemoryForwardAlgorithm : public ForwardAlgorithm {
+protected:
+	LinearMemoryForwardAlgorithm(const std::string&, RawModel*);
+	std::vector<double> _forward(Emissions&, std::size_t);
+	std::vector<double> _forward_init(const double*);
+	std::vector<double> _forward_step(const double*, const std::vector<double>&);
+	double _log_likelihood(Emissions&);
+	/* Alphas of the emitting states only, through the silent closure of the model. */
+	std::vector<double> _closure_forward(Emissions&, std::size_t);
+	/* Fills the alphas of the silent states from the ones of the emitting states, in topological order. */
+	void _forward_silent(std::vector<double>&);
 public:
 	LinearMemoryForwardAlgorithm(RawModel*);
 	LinearMemoryForwardAlgorithm* clone() const;
 
 	std::vector<double> forward(const std::vector<std::string>&, std::size_t);
+	std::vector<double> forward(const FrameMatrix&, std::size_t);
 	double log_likelihood(const std::vector<std::string>&);
 	double log_likelihood(const std::vector<std::vector<std::string>>&);
+	double log_likelihood(const FrameMatrix&);
 
 	std::vector<double> forward_init(const std::vector<std::string>&);
 	std::vector<double> forward_step(const std::vector<std::string>&, const std::vector<double>&, std::size_t t);
@@ -82,16 +330,100 @@ public:
 	virtual ~LinearMemoryForwardAlgorithm();
 };
 
+/* ===================== PREFIX CACHED FORWARD ===================== */
+
+/* Linear memory forward algorithm keeping the alphas of the prefixes of the sequences it is called on in a bounded LRU
+cache, so that a call resumes from the alphas of its longest cached prefix instead of the first step (e.g. queries 
+sharing a header, or forward(sequence, t_max) on a growing sequence). The alphas are stored every checkpoint_interval 
+steps, in a trie whose edges are the checkpoint_interval symbols (encoded as integers) between two checkpoints. At most 
+capacity alphas are kept, the least recently used prefixes being evicted first. The cache is cleared by set_model 
+(called by the hmm after each brew and training). Numeric sequences are not cached. */
+class PrefixCachedForwardAlgorithm : public LinearMemoryForwardAlgorithm {
+public:
+	struct CacheStatistics {
+		/* Calls resumed from a cached prefix, and calls starting from the first step. */
+		std::size_t hits;
+		std::size_t misses;
+		/* Forward steps skipped thanks to the cache. */
+		std::size_t resumed_steps;
+		std::size_t evictions;
+		/* Cached alphas, and the bytes they take with their prefixes and the codes of their symbols. */
+		std::size_t entries;
+		std::size_t memory;
+	};
+private:
+	struct Node {
+		std::size_t parent;
+		/* Codes of the symbols from the parent checkpoint to this one. */
+		std::vector<std::size_t> symbols;
+		std::map<std::vector<std::size_t>, std::size_t> children;
+		std::vector<double> alpha;
+		/* Last use, key of the node in _lru. */
+		std::size_t last_use;
+	};
+	std::size_t _capacity;
+	std::size_t _checkpoint_interval;
+	std::unordered_map<std::string, std::size_t> _codes;
+	/* _nodes[0] is the root, i.e. the empty prefix. Ids of removed nodes are reused. */
+	std::vector<Node> _nodes;
+	std::vector<std::size_t> _free_nodes;
+	/* Nodes by last use. A node is always used more recently than its descendants, so the least recently used 
+	node is a leaf. */
+	std::map<std::size_t, std::size_t> _lru;
+	std::size_t _clock;
+	CacheStatistics _statistics;
+
+	/* Codes of the symbols of sequence in [begin, end), the new symbols getting a new code. Only for the added nodes,
+	so that the codes stay bounded by the symbols of the cached prefixes. */
+	std::vector<std::size_t> _encode(const std::vector<std::string>& sequence, std::size_t begin, std::size_t end);
+	/* Same without adding codes : false if a symbol has none. */
+	bool _find_codes(const std::vector<std::string>& sequence, std::size_t begin, std::size_t end, std::vector<std::size_t>& codes) const;
+	std::size_t _add_node(std::size_t, std::vector<std::size_t>&&, const std::vector<double>&);
+	void _touch(std::size_t);
+	void _evict();
+	/* Alphas at step t_max, from the longest cached prefix. */
+	std::vector<double> _cached_forward(const std::vector<std::string>&, std::size_t);
+public:
+	PrefixCachedForwardAlgorithm(RawModel*, std::size_t capacity = hmm_config::kDefaultPrefixCacheCapacity, 
+		std::size_t checkpoint_interval = hmm_config::kDefaultPrefixCacheCheckpointInterval);
+	PrefixCachedForwardAlgorithm* clone() const;
+	void set_model(RawModel*);
+
+	using LinearMemoryForwardAlgorithm::forward;
+	using LinearMemoryForwardAlgorithm::log_likelihood;
+	std::vector<double> forward(const std::vector<std::string>&, std::size_t);
+	double log_likelihood(const std::vector<std::string>&);
+
+	std::size_t capacity() const;
+	std::size_t checkpoint_interval() const;
+	CacheStatistics cache_statistics() const;
+	void clear_cache();
+
+	virtual ~PrefixCachedForwardAlgorithm();
+};
+
 /* ===================== LINEAR MEMORY BACKWARD ===================== */
 
 class LinearMemoryBackwardAlgorithm : public BackwardAlgorithm {
+private:
+	/* Steps through the emission rows of numeric sequences. */
+	friend class LinearMemoryBaumWelchTraining;
+
+	std::vector<double> _backward(Emissions&, std::size_t);
+	std::vector<double> _backward_step(const std::vector<double>&, const double*);
+	std::tuple<std::vector<double>, std::vector<double>, double> _backward_terminate(const std::vector<double>&, const double*);
+	double _log_likelihood(Emissions&);
+	/* Betas of the emitting states only at the given step, through the silent closure of the model. */
+	std::vector<double> _closure_backward(Emissions&, std::size_t);
 public:
 	LinearMemoryBackwardAlgorithm(RawModel*);
 	LinearMemoryBackwardAlgorithm* clone() const;
 
 	std::vector<double> backward(const std::vector<std::string>& sequence, std::size_t);
+	std::vector<double> backward(const FrameMatrix&, std::size_t);
 	double log_likelihood(const std::vector<std::string>&);
 	double log_likelihood(const std::vector<std::vector<std::string>>&);
+	double log_likelihood(const FrameMatrix&);
 
 	std::vector<double> backward_init();
 	std::vector<double> backward_step(const std::vector<double>&, const std::vector<std::string>&, std::size_t);
@@ -110,8 +442,9 @@ public:
 		struct Node{
 			NodePtr previous;
 			std::size_t value;
-			Node(std::size_t v) : previous(), value(v) {}
-			Node(std::size_t v, NodePtr p) : previous(p), value(v) {}
+			Node(std::size_t v) : previous(), value(v) { instrumentation::count(instrumentation::kTracebackNodesAllocated); }
+			Node(std::size_t v, NodePtr p) : previous(p), value(v) { instrumentation::count(instrumentation::kTracebackNodesAllocated); }
+			~Node() { instrumentation::count(instrumentation::kTracebackNodesFreed); }
 			void set_previous(const NodePtr& p){ previous = p; }
 		};
 		std::size_t _nodes;
@@ -131,10 +464,22 @@ public:
 
 	};
 
+private:
+	/* Best path over the emitting states through the silent closure of the model, the silent states being put back 
+	in the path afterwards. */
+	std::pair<std::vector<std::size_t>, double> _closure_decode_indices(Emissions&, std::size_t);
+	std::pair<std::vector<std::string>, double> _decode(Emissions&, std::size_t);
+	std::pair<std::vector<std::size_t>, double> _decode_indices(Emissions&, std::size_t);
+	std::vector<double> _viterbi_init(Traceback&, const double*);
+	std::vector<double> _viterbi_step(const std::vector<double>&, Traceback&, const double*);
+public:
 	LinearMemoryViterbiDecodingAlgorithm(RawModel*);
 	LinearMemoryViterbiDecodingAlgorithm* clone() const;
 
 	std::pair<std::vector<std::string>, double> decode(const std::vector<std::string>&, std::size_t);
+	std::pair<std::vector<std::string>, double> decode(const FrameMatrix&, std::size_t);
+	/* Same as decode but returns the raw indices of the states in the optimal path. */
+	std::pair<std::vector<std::size_t>, double> decode_indices(const std::vector<std::string>&, std::size_t);
 
 	std::vector<double> viterbi_init(Traceback&, const std::vector<std::string>&);
 	std::vector<double> viterbi_step(const std::vector<double>&, Traceback&, std::size_t, const std::vector<std::string>&);
@@ -169,7 +514,7 @@ protected:
 		
 		TransitionScore& operator=(const TransitionScore&);
 
-		void add(const TransitionScore&, std::size_t, std::size_t);
+		void add(const TransitionScore&, std::size_t, std::size_t, double = 1.0);
 		/* Returns the transitions score of given transition for a path finishing at state m. */
 		double score(std::size_t, std::size_t) const;
 		double score_begin(std::size_t, std::size_t) const;
@@ -207,14 +552,28 @@ protected:
 		std::size_t num_free_emissions() const;
 
 		/* Adds the scores for arriving at state m of other EmissionScore to the scores of arriving 
-		at state 0 of this EmissionScore. Both scores should have the same sizes. */
-		void add(const EmissionScore&, std::size_t, std::size_t);
+		at state 0 of this EmissionScore, times the given weight. Both scores should have the same sizes. */
+		void add(const EmissionScore&, std::size_t, std::size_t, double = 1.0);
 		void reset(double reset_score);
 		void reset();
 
 		std::string to_string(std::size_t, const std::vector<std::string>&, const std::string& = "", bool = true) const;
 	};
 
+	/* The distinct non empty sequences of a weighted batch, each with the sum of the weights of its copies, so that the 
+	counts of the copies are computed once and scaled. The sequences are hashed once, on their symbols encoded as integers. */
+	struct SequenceBatch {
+		std::vector<const std::vector<std::string>*> sequences;
+		std::vector<double> weights;
+	};
+	static SequenceBatch collapse(const std::vector<std::vector<std::string>>&, const std::vector<double>&);
+
+	/* Row 0 of total scores as sufficient statistics, and back. */
+	static SufficientStatistics to_statistics(const TransitionScore&, const EmissionScore&, bool);
+	static void from_statistics(const SufficientStatistics&, TransitionScore&, EmissionScore&);
+	/* Throws if the statistics do not have the given kind of counts of the free parameters of the model. */
+	void check_statistics(const SufficientStatistics&, bool) const;
+
 	static unsigned int delta(std::size_t, std::size_t);
 	static unsigned int delta(std::string, std::string);
 	static double log_score(std::string, std::string);
@@ -245,14 +604,32 @@ public:
 /* ===================== LINEAR MEMORY VITERBI TRAINING ===================== */
 
 class LinearMemoryViterbiTraining : public LinearMemoryTrainingAlgorithm{
+protected:
 	LinearMemoryViterbiDecodingAlgorithm _decoding_algorithm;
 	LinearMemoryForwardAlgorithm _forward_algorithm;
+
+	LinearMemoryViterbiTraining(const std::string&, RawModel*);
+
+	/* Adds the Viterbi counts of the given sequence, times the given weight, to the total counts. The previous/current 
+	tables are scratch tables of N rows, they are expected to be reset when passed and are reset before returning. */
+	virtual void count(const std::vector<std::string>&, double, 
+		TransitionScore&, TransitionScore&, EmissionScore&, EmissionScore&,
+		TransitionScore&, EmissionScore&);
+	/* Counts by carrying the N x F tables through the viterbi recursion (linear memory). */
+	void linear_memory_count(const std::vector<std::string>&, double, 
+		TransitionScore&, TransitionScore&, EmissionScore&, EmissionScore&,
+		TransitionScore&, EmissionScore&);
 public:
 	LinearMemoryViterbiTraining(RawModel*);
 	LinearMemoryViterbiTraining* clone() const;
 	virtual void set_model(RawModel*);
-	double train(const std::vector<std::vector<std::string>>& sequences, double transition_pseudocount,
-		double convergence_threshold, unsigned int min_iterations, unsigned int max_iterations);
+	using TrainingAlgorithm::train;
+	double train(const std::vector<std::vector<std::string>>& sequences, const std::vector<double>& weights, 
+		double transition_pseudocount, double convergence_threshold, unsigned int min_iterations, unsigned int max_iterations);
+	/* Viterbi counts, and the forward log likelihood of the sequences. */
+	virtual SufficientStatistics expected_statistics(const std::vector<std::vector<std::string>>& sequences, 
+		const std::vector<double>& weights);
+	void maximize(const SufficientStatistics& statistics, double transition_pseudocount);
 
 	void update_model_from_scores(const TransitionScore&, const EmissionScore&, double);
 	void update_model_transitions_from_scores(const TransitionScore&, double);
@@ -261,10 +638,53 @@ public:
 	virtual ~LinearMemoryViterbiTraining();
 };
 
+/* ===================== PATH COUNTING VITERBI TRAINING ===================== */
+
+/* Classic Viterbi training : decodes each sequence once and counts the transitions and emissions 
+along the optimal path, in O(T*N^2) instead of O(T*N*F). The path is kept in memory, so sequences
+longer than the given max length fall back to the linear memory counting. */
+class PathCountingViterbiTraining : public LinearMemoryViterbiTraining{
+	std::size_t _max_path_length;
+	/* Free parameters ids, indexed by raw state ids. Built at the beginning of each training. */
+	std::unordered_map<std::size_t, std::size_t> _begin_ids;
+	std::unordered_map<std::size_t, std::size_t> _end_ids;
+	std::unordered_map<std::size_t, std::size_t> _transition_ids;
+	std::vector<std::unordered_map<std::string, std::size_t>> _emission_ids;
+
+	void _index_free_parameters();
+	void _path_count(const std::vector<std::size_t>&, const std::vector<std::string>&, double, TransitionScore&, EmissionScore&);
+
+protected:
+	void count(const std::vector<std::string>&, double, 
+		TransitionScore&, TransitionScore&, EmissionScore&, EmissionScore&,
+		TransitionScore&, EmissionScore&);
+
+public:
+	PathCountingViterbiTraining(RawModel*, std::size_t = hmm_config::kDefaultPathCountingMaxLength);
+	PathCountingViterbiTraining* clone() const;
+	std::size_t max_path_length() const;
+	void set_max_path_length(std::size_t);
+	using TrainingAlgorithm::train;
+	double train(const std::vector<std::vector<std::string>>& sequences, const std::vector<double>& weights, 
+		double transition_pseudocount, double convergence_threshold, unsigned int min_iterations, unsigned int max_iterations);
+	SufficientStatistics expected_statistics(const std::vector<std::vector<std::string>>& sequences, 
+		const std::vector<double>& weights);
+
+	virtual ~PathCountingViterbiTraining();
+};
+
 /* ===================== LINEAR MEMORY BAUM-WELCH TRAINING ===================== */
 
 class LinearMemoryBaumWelchTraining : public LinearMemoryTrainingAlgorithm{
 	LinearMemoryBackwardAlgorithm _backward_algorithm;
+
+	/* Adds the scores of a sequence, given by its emissions, the statistics of its observations for the free emissions 
+	of the emission scores, its log likelihood and its weight, to the total scores by carrying the N x F tables through 
+	the backward recursion (linear memory). The previous/current tables are scratch tables of N rows, they are expected to be reset 
+	when passed and are reset before returning. */
+	void _count(Emissions&, EmissionStatistics&, double, double, 
+		TransitionScore&, TransitionScore&, EmissionScore&, EmissionScore&, 
+		TransitionScore&, EmissionScore&);
 public:
 	LinearMemoryBaumWelchTraining(RawModel*);
 	LinearMemoryBaumWelchTraining* clone() const;
@@ -273,9 +693,21 @@ public:
 	void update_model_from_log_scores(const TransitionScore&, const EmissionScore&);
 	void update_model_transitions_from_log_scores(const TransitionScore&);
 	void update_model_emissions_from_log_scores(const EmissionScore&);
-
-	double train(const std::vector<std::vector<std::string>>& sequences, double transition_pseudocount, 
+	/* Re-estimates the weights, means and covariances of the free normal and Gaussian mixtures from the scores of their 
+	FrameStatistics, computed with the given origin. The variances are floored to hmm_config::kMinimumVariance. */
+	void update_model_continuous_emissions_from_log_scores(const EmissionScore&, const std::vector<double>&);
+
+	using TrainingAlgorithm::train;
+	double train(const std::vector<std::vector<std::string>>& sequences, const std::vector<double>& weights, 
+		double transition_pseudocount, double convergence_threshold, unsigned int min_iterations, unsigned int max_iterations);
+	/* Same for numeric sequences, the frames of which must all have the dimension of the distributions. */
+	double train(const std::vector<FrameMatrix>& sequences, double transition_pseudocount, 
 		double convergence_threshold, unsigned int min_iterations, unsigned int max_iterations);
+	/* Log expected counts, and the backward log likelihood of the sequences. Symbols only. */
+	SufficientStatistics expected_statistics(const std::vector<std::vector<std::string>>& sequences, 
+		const std::vector<double>& weights);
+	/* No pseudocount, as for train. */
+	void maximize(const SufficientStatistics& statistics, double transition_pseudocount);
 
 	void log_update_transition_score(const TransitionScore&, TransitionScore&, double);
 	void log_update_emission_score(const EmissionScore&, EmissionScore&, double);
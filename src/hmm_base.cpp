@@ -1,11 +1,39 @@
 #include <vector>
 #include <string>
 #include <utility>
+#include <algorithm> // std::min, std::max
+#include <stdexcept>
 
+#include "utils.hpp"
 #include "distributions.hpp"
 #include "hmm_base.hpp"
 
-RawModel::RawModel() {}
+FrameMatrix::FrameMatrix(std::size_t dimension) : _dimension(dimension), _data() {
+	if(dimension == 0) throw std::invalid_argument(error_message::kFrameMatrixDimension);
+}
+
+FrameMatrix::FrameMatrix(const std::vector<double>& data, std::size_t dimension) : _dimension(dimension), _data(data) {
+	if(dimension == 0 || data.size() % dimension != 0) throw std::invalid_argument(error_message::kFrameMatrixDimension);
+}
+
+FrameMatrix::FrameMatrix(std::vector<double>&& data, std::size_t dimension) : _dimension(dimension), _data(std::move(data)) {
+	if(dimension == 0 || _data.size() % dimension != 0) throw std::invalid_argument(error_message::kFrameMatrixDimension);
+}
+
+std::size_t FrameMatrix::dimension() const { return _dimension; }
+std::size_t FrameMatrix::length() const { return _data.size() / _dimension; }
+bool FrameMatrix::empty() const { return _data.empty(); }
+const double* FrameMatrix::data() const { return _data.data(); }
+const double* FrameMatrix::frame(std::size_t t) const { return _data.data() + t * _dimension; }
+
+void FrameMatrix::push_back(const double* frame) {
+	_data.insert(_data.end(), frame, frame + _dimension);
+}
+
+RawModel::RawModel() : free_continuous_emissions(), predecessors(), successors(), silent_closure() {}
+
+RawModel::SilentClosure::SilentClosure() : offsets(), from(), log_sum(), log_max(), max_length(), begin_log_sum(), 
+	begin_log_max(), begin_max_length(), end_log_sum(), end_log_max(), end_max_length() {}
 
 RawModel::RawModel(const RawModel& other) : 
 	states_indices(other.states_indices), states_names(other.states_names),
@@ -13,7 +41,8 @@ RawModel::RawModel(const RawModel& other) :
 	is_finite(other.is_finite), silent_states_index(other.silent_states_index),
 	alphabet(other.alphabet), free_pi_begin(other.free_pi_begin), 
 	free_pi_end(other.free_pi_end), free_transitions(other.free_transitions),
-	free_emissions(other.free_emissions) {
+	free_emissions(other.free_emissions), free_continuous_emissions(other.free_continuous_emissions), 
+	predecessors(other.predecessors), successors(other.successors), silent_closure(other.silent_closure) {
 		for(std::size_t i = 0; i < other.B.size(); ++i){
 			B[i] = (other.B[i] == nullptr) ? nullptr : other.B[i]->clone();
 		}
@@ -26,7 +55,9 @@ RawModel::RawModel(RawModel&& other) :
 	silent_states_index(std::move(other.silent_states_index)), 
 	alphabet(std::move(other.alphabet)), free_pi_begin(std::move(other.free_pi_begin)), 
 	free_pi_end(std::move(other.free_pi_end)), free_transitions(std::move(other.free_transitions)),
-	free_emissions(std::move(other.free_emissions)) {}
+	free_emissions(std::move(other.free_emissions)), free_continuous_emissions(std::move(other.free_continuous_emissions)), 
+	predecessors(std::move(other.predecessors)), 
+	successors(std::move(other.successors)), silent_closure(std::move(other.silent_closure)) {}
 
 RawModel& RawModel::operator=(const RawModel& other) {
 	if(this != &other){
@@ -47,6 +78,10 @@ RawModel& RawModel::operator=(const RawModel& other) {
 		free_pi_end = other.free_pi_end;
 		free_transitions = other.free_transitions;
 		free_emissions = other.free_emissions;
+		free_continuous_emissions = other.free_continuous_emissions;
+		predecessors = other.predecessors;
+		successors = other.successors;
+		silent_closure = other.silent_closure;
 	}
 	return *this;
 }
@@ -66,6 +101,10 @@ RawModel& RawModel::operator=(RawModel&& other){
 		free_pi_end = std::move(other.free_pi_end);
 		free_transitions = std::move(other.free_transitions);
 		free_emissions = std::move(other.free_emissions);
+		free_continuous_emissions = std::move(other.free_continuous_emissions);
+		predecessors = std::move(other.predecessors);
+		successors = std::move(other.successors);
+		silent_closure = std::move(other.silent_closure);
 	}
 	return *this;
 }
@@ -87,10 +126,200 @@ void RawModel::clean() {
 	free_pi_end.clear();
 	free_transitions.clear();
 	free_emissions.clear();	
+	free_continuous_emissions.clear();
+	predecessors.clear();
+	successors.clear();
+	silent_closure = SilentClosure();
+}
+
+void RawModel::compute_envelope() {
+	std::size_t num_states = A.size();
+	/* Empty ranges until a transition is found. */
+	Envelope empty = {silent_states_index, 0, num_states, silent_states_index};
+	predecessors.assign(num_states, empty);
+	successors.assign(num_states, empty);
+	for(std::size_t i = 0; i < num_states; ++i){
+		for(std::size_t j = 0; j < num_states; ++j){
+			if(A[i][j] == utils::kNegInf) continue;
+			Envelope& from_i = successors[i];
+			Envelope& to_j = predecessors[j];
+			if(j < silent_states_index){
+				from_i.emitting_begin = std::min(from_i.emitting_begin, j);
+				from_i.emitting_end = std::max(from_i.emitting_end, j + 1);
+			}
+			else{
+				from_i.silent_begin = std::min(from_i.silent_begin, j);
+				from_i.silent_end = std::max(from_i.silent_end, j + 1);
+			}
+			if(i < silent_states_index){
+				to_j.emitting_begin = std::min(to_j.emitting_begin, i);
+				to_j.emitting_end = std::max(to_j.emitting_end, i + 1);
+			}
+			else{
+				to_j.silent_begin = std::min(to_j.silent_begin, i);
+				to_j.silent_end = std::max(to_j.silent_end, i + 1);
+			}
+		}
+	}
+	/* Give the empty ranges a null length. */
+	for(std::vector<Envelope>* envelopes : {&predecessors, &successors}){
+		for(Envelope& envelope : *envelopes){
+			if(envelope.emitting_begin >= envelope.emitting_end) envelope.emitting_begin = envelope.emitting_end = 0;
+			if(envelope.silent_begin >= envelope.silent_end) envelope.silent_begin = envelope.silent_end = silent_states_index;
+		}
+	}
 }
 
 RawModel::~RawModel() {
 	for(Distribution* dist : B){
 		if(dist != nullptr) delete dist;
 	}
+}
+
+/* Log sum (resp. best log probability, its number of silent states and best predecessor) of the paths from the given 
+emitting state (or the begin state) to each silent state, through silent states only. Ties between best paths go to the 
+shortest one, as in the step by step propagation which looks at the emitting states first. Indexed by silent state minus 
+silent_states_index. */
+static void __silent_paths(const RawModel& model, std::size_t from, std::vector<double>& log_sum, 
+	std::vector<double>& log_max, std::vector<std::size_t>& max_length, std::vector<std::size_t>& best_previous) {
+	std::size_t num_states = model.A.size();
+	std::size_t silent = model.silent_states_index;
+	log_sum.assign(num_states - silent, utils::kNegInf);
+	log_max.assign(num_states - silent, utils::kNegInf);
+	max_length.assign(num_states - silent, 1);
+	best_previous.assign(num_states - silent, from);
+	for(std::size_t i = silent; i < num_states; ++i){
+		RawModel::Envelope to_i = model.predecessors_of(i);
+		double sum = (from == num_states) ? model.pi_begin[i] : model.A[from][i];
+		double max = sum;
+		for(std::size_t j = to_i.silent_begin; j < std::min(i, to_i.silent_end); ++j){
+			sum = utils::sum_log_prob(sum, model.A[j][i] + log_sum[j - silent]);
+			double current = model.A[j][i] + log_max[j - silent];
+			if(current > max || (current == max && max_length[j - silent] + 1 < max_length[i - silent])){
+				max = current;
+				max_length[i - silent] = max_length[j - silent] + 1;
+				best_previous[i - silent] = j;
+			}
+		}
+		log_sum[i - silent] = sum;
+		log_max[i - silent] = max;
+	}
+}
+
+/* Log sum and best path of the paths from source (the begin state if it is the number of states) to target (the end 
+state if it is the number of states) with silent states only in between, given the paths of __silent_paths from source. 
+last is the last silent state of the best path, or the number of states for the direct transition. */
+static void __silent_entry(const RawModel& model, std::size_t source, std::size_t target, const std::vector<double>& paths_sum, 
+	const std::vector<double>& paths_max, const std::vector<std::size_t>& paths_length, double& sum, double& max, 
+	std::size_t& length, std::size_t& last) {
+	std::size_t num_states = model.A.size();
+	std::size_t silent = model.silent_states_index;
+	std::size_t begin = silent;
+	std::size_t end = num_states;
+	if(target == num_states){
+		sum = model.pi_end[source];
+	}
+	else{
+		sum = (source == num_states) ? model.pi_begin[target] : model.A[source][target];
+		RawModel::Envelope to_target = model.predecessors_of(target);
+		begin = to_target.silent_begin;
+		end = to_target.silent_end;
+	}
+	max = sum;
+	length = 0;
+	last = num_states;
+	for(std::size_t j = begin; j < end; ++j){
+		double transition = (target == num_states) ? model.pi_end[j] : model.A[j][target];
+		sum = utils::sum_log_prob(sum, transition + paths_sum[j - silent]);
+		double current = transition + paths_max[j - silent];
+		if(current > max || (current == max && paths_length[j - silent] < length)){
+			max = current;
+			length = paths_length[j - silent];
+			last = j;
+		}
+	}
+}
+
+void RawModel::compute_silent_closure(bool always) {
+	silent_closure = SilentClosure();
+	std::size_t num_states = A.size();
+	std::size_t silent = silent_states_index;
+	if(silent == num_states) return;
+	SilentClosure closure;
+	std::vector<std::vector<std::size_t>> from(silent);
+	std::vector<std::vector<double>> log_sum(silent);
+	std::vector<std::vector<double>> log_max(silent);
+	std::vector<std::vector<std::size_t>> max_length(silent);
+	closure.begin_log_sum.assign(silent, utils::kNegInf);
+	closure.begin_log_max.assign(silent, utils::kNegInf);
+	closure.begin_max_length.assign(silent, 0);
+	closure.end_log_sum.assign(silent, utils::kNegInf);
+	closure.end_log_max.assign(silent, utils::kNegInf);
+	closure.end_max_length.assign(silent, 0);
+	std::vector<double> paths_sum;
+	std::vector<double> paths_max;
+	std::vector<std::size_t> paths_length;
+	std::vector<std::size_t> best_previous;
+	double sum, max;
+	std::size_t length, last;
+	/* From each emitting state then from the begin state (k == silent). */
+	for(std::size_t k = 0; k <= silent; ++k){
+		std::size_t source = (k == silent) ? num_states : k;
+		__silent_paths(*this, source, paths_sum, paths_max, paths_length, best_previous);
+		for(std::size_t i = 0; i < silent; ++i){
+			__silent_entry(*this, source, i, paths_sum, paths_max, paths_length, sum, max, length, last);
+			if(source == num_states){
+				closure.begin_log_sum[i] = sum;
+				closure.begin_log_max[i] = max;
+				closure.begin_max_length[i] = length;
+			}
+			else if(sum != utils::kNegInf){
+				from[i].push_back(source);
+				log_sum[i].push_back(sum);
+				log_max[i].push_back(max);
+				max_length[i].push_back(length);
+			}
+		}
+		if(source != num_states && is_finite){
+			__silent_entry(*this, source, num_states, paths_sum, paths_max, paths_length, sum, max, length, last);
+			closure.end_log_sum[source] = sum;
+			closure.end_log_max[source] = max;
+			closure.end_max_length[source] = length;
+		}
+	}
+	/* Flatten, and compare the number of entries with the number of transitions visited by a step without the closure. */
+	std::size_t envelope_size = 0;
+	for(std::size_t i = 0; i < num_states; ++i){
+		Envelope to_i = predecessors_of(i);
+		envelope_size += (to_i.emitting_end - to_i.emitting_begin) + (to_i.silent_end - to_i.silent_begin);
+	}
+	closure.offsets.assign(1, 0);
+	for(std::size_t i = 0; i < silent; ++i){
+		closure.from.insert(closure.from.end(), from[i].begin(), from[i].end());
+		closure.log_sum.insert(closure.log_sum.end(), log_sum[i].begin(), log_sum[i].end());
+		closure.log_max.insert(closure.log_max.end(), log_max[i].begin(), log_max[i].end());
+		closure.max_length.insert(closure.max_length.end(), max_length[i].begin(), max_length[i].end());
+		closure.offsets.push_back(closure.from.size());
+	}
+	if(always || closure.from.size() < envelope_size){
+		silent_closure = std::move(closure);
+	}
+}
+
+std::vector<std::size_t> RawModel::best_silent_chain(std::size_t from, std::size_t to) const {
+	std::vector<std::size_t> chain;
+	if(silent_states_index == A.size()) return chain;
+	std::vector<double> paths_sum;
+	std::vector<double> paths_max;
+	std::vector<std::size_t> paths_length;
+	std::vector<std::size_t> best_previous;
+	__silent_paths(*this, from, paths_sum, paths_max, paths_length, best_previous);
+	double sum, max;
+	std::size_t length, last;
+	__silent_entry(*this, from, to, paths_sum, paths_max, paths_length, sum, max, length, last);
+	for(std::size_t j = last; j != from && j != A.size(); j = best_previous[j - silent_states_index]){
+		chain.push_back(j);
+	}
+	std::reverse(chain.begin(), chain.end());
+	return chain;
 }
\ No newline at end of file
@@ -8,6 +8,28 @@
 
 typedef std::vector<std::vector<double>> Matrix;
 
+/* Numeric sequence of length() observations of dimension() values each (e.g. the feature frames of a signal), stored 
+contiguously in row-major order : the observation of step t starts at data() + t * dimension(). A sequence of scalar 
+observations is a frame matrix of dimension 1. */
+class FrameMatrix {
+private:
+	std::size_t _dimension;
+	std::vector<double> _data;
+public:
+	FrameMatrix(std::size_t dimension = 1);
+	/* The size of data must be a multiple of dimension. */
+	FrameMatrix(const std::vector<double>& data, std::size_t dimension = 1);
+	FrameMatrix(std::vector<double>&& data, std::size_t dimension = 1);
+
+	std::size_t dimension() const;
+	std::size_t length() const;
+	bool empty() const;
+	const double* data() const;
+	const double* frame(std::size_t t) const;
+	/* Appends the dimension() values starting at frame. */
+	void push_back(const double* frame);
+};
+
 struct RawModel{
 	std::map<std::string, std::size_t> states_indices;
 	std::vector<std::string> states_names;
@@ -23,14 +45,74 @@ struct RawModel{
 	std::vector<std::pair<std::size_t, std::size_t>> free_transitions;
 	/* Only discrete ! */
 	std::vector<std::pair<std::size_t, std::string>> free_emissions; //TODO : For now, free/fixed parameters PER state, do it for every parameter. 
+	/* Emitting states whose continuous distributions are free. */
+	std::vector<std::size_t> free_continuous_emissions;
+
+	/* Ranges of the emitting and silent states a state transits from (resp. to), i.e. the envelope of the non null 
+	entries of its column (resp. row) of A. Set by compute_envelope() and used by the algorithms to skip the null 
+	transitions, which for banded (e.g. left-to-right or profile) models leaves O(bandwidth) transitions per state. */
+	struct Envelope {
+		std::size_t emitting_begin;
+		std::size_t emitting_end;
+		std::size_t silent_begin;
+		std::size_t silent_end;
+	};
+	std::vector<Envelope> predecessors;
+	std::vector<Envelope> successors;
+
+	/* Transitions between emitting states through chains of silent states, as a sparse matrix by target : the paths 
+	to emitting state i come from the emitting states from[k] for k in [offsets[i], offsets[i + 1]), log_sum[k] being 
+	the log sum of their probabilities, log_max[k] the log probability of the best one and max_length[k] its number of 
+	silent states (ties go to the shortest path). Same for the paths from the begin state and to the end state. Lets 
+	the algorithms go from one emission to the next in a single sparse product instead of propagating through the 
+	silent states in topological order at each step. */
+	struct SilentClosure {
+		std::vector<std::size_t> offsets;
+		std::vector<std::size_t> from;
+		std::vector<double> log_sum;
+		std::vector<double> log_max;
+		std::vector<std::size_t> max_length;
+		std::vector<double> begin_log_sum;
+		std::vector<double> begin_log_max;
+		std::vector<std::size_t> begin_max_length;
+		std::vector<double> end_log_sum;
+		std::vector<double> end_log_max;
+		std::vector<std::size_t> end_max_length;
+		SilentClosure();
+	};
+	SilentClosure silent_closure;
 
 	RawModel();
 	RawModel(const RawModel&);
 	RawModel(RawModel&&);
 	RawModel& operator=(const RawModel&);
 	RawModel& operator=(RawModel&&);
+	/* Must be called after A is modified, unless the modified transitions stay within the envelope. */
+	void compute_envelope();
+	/* Same as predecessors[i] (resp. successors[i]), or the full ranges if the envelope was not computed. */
+	Envelope predecessors_of(std::size_t i) const;
+	Envelope successors_of(std::size_t i) const;
+	/* Sets the silent closure if the model has silent states and the closure has less entries than the envelope 
+	(long silent chains make it dense), else clears it. Must be called after A is modified. */
+	void compute_silent_closure(bool always = false);
+	bool has_silent_closure() const;
+	/* Silent states on the best path from emitting state from (the begin state if from is the number of states)
+	to emitting state to (the end state if to is the number of states), in order. */
+	std::vector<std::size_t> best_silent_chain(std::size_t from, std::size_t to) const;
 	virtual void clean();
 	virtual ~RawModel();
 };
 
+inline RawModel::Envelope RawModel::predecessors_of(std::size_t i) const {
+	if(predecessors.size() == A.size()) return predecessors[i];
+	return Envelope{0, silent_states_index, silent_states_index, A.size()};
+}
+
+inline bool RawModel::has_silent_closure() const { return ! silent_closure.offsets.empty(); }
+
+inline RawModel::Envelope RawModel::successors_of(std::size_t i) const {
+	if(successors.size() == A.size()) return successors[i];
+	return Envelope{0, silent_states_index, silent_states_index, A.size()};
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <exception>
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <chrono>
+#include "utils.hpp"
+#include "hmm.hpp" // benchmarked hmm library
+
+/* Scaling benchmarks of the hmm algorithms on random models (the studies of the report : time against the number
+of states and against the length of the sequences, for the decoding and the trainings). Built with optimizations by
+"make hmm_bench". Prints one record per measure, as CSV (default) or JSON :
+
+	./hmm_bench [--json] [--quick] [--seed=N] [--repeat=N]
+
+The throughput is in cells (states x steps) per second, the peak memory is the peak resident set size of the process
+during the measure, in bytes (0 if it could not be measured). */
+
+struct BenchConfig {
+	std::size_t num_states;
+	std::size_t length;
+	std::size_t num_sequences;
+	std::size_t alphabet_size;
+	/* Fraction of the states each state transits to (at least one). */
+	double density;
+	/* Fraction of the states which are silent. */
+	double silent_ratio;
+	/* Number of states whose transitions and emissions are free, the others being fixed. */
+	std::size_t free_states;
+};
+
+struct BenchModel {
+	HiddenMarkovModel hmm;
+	std::size_t silent_states;
+	std::size_t free_parameters;
+};
+
+struct BenchRecord {
+	std::string series;
+	std::string algorithm;
+	BenchConfig config;
+	std::size_t silent_states;
+	std::size_t transitions;
+	std::size_t free_parameters;
+	double seconds;
+	double cells_per_second;
+	std::size_t peak_memory;
+};
+
+std::vector<std::string> generate_alphabet(std::size_t alphabet_size){
+	std::vector<std::string> alphabet;
+	alphabet.reserve(alphabet_size);
+	for(std::size_t i = 0; i < alphabet_size; ++i){
+		alphabet.push_back("s" + std::to_string(i));
+	}
+	return alphabet;
+}
+
+/* Random hmm of config.num_states states, the last silent_ratio of which are silent. Each state transits to
+density * num_states states (a silent state only to the emitting states and to the silent states after it, so that
+there is no silent cycle) and each emitting state emits all the symbols. */
+BenchModel generate_random(const BenchConfig& config, std::mt19937& generator){
+	std::size_t num_states = config.num_states;
+	std::size_t num_silent = std::min(num_states - 1, (std::size_t) (config.silent_ratio * (double) num_states));
+	std::size_t num_emitting = num_states - num_silent;
+	std::size_t out_degree = std::max((std::size_t) 1, (std::size_t) (config.density * (double) num_states));
+	std::vector<std::string> alphabet = generate_alphabet(config.alphabet_size);
+	std::uniform_real_distribution<double> weight(0.01, 1.0);
+
+	std::vector<std::string> names;
+	Matrix A(num_states, std::vector<double>(num_states, 0.0));
+	std::vector<double> pi_begin(num_states, 0.0);
+	std::vector<double> pi_end(num_states, 0.0);
+	std::vector<DiscreteDistribution> emissions(num_states);
+	std::vector<bool> silent_mask(num_states, false);
+	std::vector<std::size_t> targets;
+	for(std::size_t i = 0; i < num_states; ++i){
+		names.push_back("state_" + std::to_string(i));
+		silent_mask[i] = i >= num_emitting;
+		targets.clear();
+		for(std::size_t j = 0; j < num_states; ++j){
+			if(! silent_mask[i] || j < num_emitting || j > i) targets.push_back(j);
+		}
+		std::shuffle(targets.begin(), targets.end(), generator);
+		targets.resize(std::min(targets.size(), out_degree));
+		for(std::size_t j : targets){
+			A[i][j] = weight(generator);
+		}
+		if(! silent_mask[i]){
+			for(const std::string& symbol : alphabet){
+				emissions[i][symbol] = weight(generator);
+			}
+		}
+		pi_begin[i] = weight(generator);
+	}
+	HiddenMarkovModel hmm = HiddenMarkovModel::from_matrices(names, A, pi_begin, pi_end, emissions, silent_mask, "bench");
+	std::size_t free_parameters = 0;
+	for(std::size_t i = 0; i < num_states; ++i){
+		State& state = hmm.get_state(names[i]);
+		if(i < config.free_states){
+			free_parameters += (std::size_t) std::count_if(A[i].begin(), A[i].end(), [](double p){ return p > 0; });
+			if(! silent_mask[i]) free_parameters += alphabet.size();
+		}
+		else{
+			state.fix_transition();
+			if(! silent_mask[i]) state.fix_emission();
+		}
+	}
+	hmm.begin().fix_transition();
+	hmm.brew();
+	return BenchModel{hmm, num_silent, free_parameters};
+}
+
+std::vector<std::vector<std::string>> generate_sequences(const BenchConfig& config, std::mt19937& generator){
+	std::vector<std::string> alphabet = generate_alphabet(config.alphabet_size);
+	std::uniform_int_distribution<std::size_t> symbol(0, alphabet.size() - 1);
+	std::vector<std::vector<std::string>> sequences(config.num_sequences);
+	for(std::vector<std::string>& sequence : sequences){
+		sequence.reserve(config.length);
+		for(std::size_t t = 0; t < config.length; ++t){
+			sequence.push_back(alphabet[symbol(generator)]);
+		}
+	}
+	return sequences;
+}
+
+/* Best of repeat runs of measured, each one given a fresh copy of the hmm. */
+BenchRecord measure(const std::string& series, const std::string& algorithm, const BenchConfig& config,
+	const BenchModel& model, unsigned int repeat, const std::function<void(HiddenMarkovModel&)>& measured){
+	BenchRecord record{series, algorithm, config, model.silent_states, model.hmm.num_transitions(), 
+		model.free_parameters, 0.0, 0.0, 0};
+	double best = -1;
+	bool peak_reset = utils::reset_peak_memory();
+	for(unsigned int run = 0; run < std::max(repeat, 1u); ++run){
+		HiddenMarkovModel copy = model.hmm;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		measured(copy);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if(best < 0 || seconds < best) best = seconds;
+	}
+	record.seconds = best;
+	double cells = (double) config.num_states * (double) config.length * (double) config.num_sequences;
+	record.cells_per_second = (best > 0) ? cells / best : 0.0;
+	record.peak_memory = (peak_reset) ? utils::peak_memory() : 0;
+	return record;
+}
+
+void run_benchmarks(const std::string& series, const BenchConfig& config, unsigned int repeat, std::mt19937& generator,
+	std::vector<BenchRecord>& records){
+	BenchModel model = generate_random(config, generator);
+	std::vector<std::vector<std::string>> sequences = generate_sequences(config, generator);
+	records.push_back(measure(series, "forward", config, model, repeat, [&](HiddenMarkovModel& hmm){
+		for(const std::vector<std::string>& sequence : sequences) hmm.log_likelihood(sequence, true);
+	}));
+	records.push_back(measure(series, "backward", config, model, repeat, [&](HiddenMarkovModel& hmm){
+		for(const std::vector<std::string>& sequence : sequences) hmm.log_likelihood(sequence, false);
+	}));
+	records.push_back(measure(series, "decode", config, model, repeat, [&](HiddenMarkovModel& hmm){
+		for(const std::vector<std::string>& sequence : sequences) hmm.decode(sequence);
+	}));
+	records.push_back(measure(series, "viterbi_training", config, model, repeat, [&](HiddenMarkovModel& hmm){
+		hmm.set_training(LinearMemoryViterbiTraining(nullptr));
+		hmm.train(sequences, 0.0, 0.0, 1, 1);
+	}));
+	records.push_back(measure(series, "baum_welch_training", config, model, repeat, [&](HiddenMarkovModel& hmm){
+		hmm.set_training(LinearMemoryBaumWelchTraining(nullptr));
+		hmm.train(sequences, 0.0, 0.0, 1, 1);
+	}));
+}
+
+void print_csv(const std::vector<BenchRecord>& records, std::ostream& out){
+	out << "series,algorithm,states,silent_states,transitions,length,sequences,alphabet,density,free_parameters,"
+		<< "seconds,cells_per_second,peak_memory_bytes" << std::endl;
+	for(const BenchRecord& record : records){
+		out << record.series << "," << record.algorithm << "," << record.config.num_states << "," << record.silent_states
+			<< "," << record.transitions << "," << record.config.length << "," << record.config.num_sequences << ","
+			<< record.config.alphabet_size << "," << record.config.density << "," << record.free_parameters << ","
+			<< record.seconds << "," << record.cells_per_second << "," << record.peak_memory << std::endl;
+	}
+}
+
+void print_json(const std::vector<BenchRecord>& records, std::ostream& out){
+	out << "[" << std::endl;
+	for(std::size_t r = 0; r < records.size(); ++r){
+		const BenchRecord& record = records[r];
+		out << "\t{\"series\": \"" << record.series << "\", \"algorithm\": \"" << record.algorithm
+			<< "\", \"states\": " << record.config.num_states << ", \"silent_states\": " << record.silent_states
+			<< ", \"transitions\": " << record.transitions << ", \"length\": " << record.config.length
+			<< ", \"sequences\": " << record.config.num_sequences << ", \"alphabet\": " << record.config.alphabet_size
+			<< ", \"density\": " << record.config.density << ", \"free_parameters\": " << record.free_parameters
+			<< ", \"seconds\": " << record.seconds << ", \"cells_per_second\": " << record.cells_per_second
+			<< ", \"peak_memory_bytes\": " << record.peak_memory << "}" << ((r + 1 < records.size()) ? "," : "") << std::endl;
+	}
+	out << "]" << std::endl;
+}
+
+int main(int argc, char* argv[]){
+	bool json = false;
+	bool quick = false;
+	unsigned int seed = 42;
+	unsigned int repeat = 3;
+	for(int i = 1; i < argc; ++i){
+		std::string arg(argv[i]);
+		if(arg == "--json") json = true;
+		else if(arg == "--quick") quick = true;
+		else if(arg.compare(0, 7, "--seed=") == 0) seed = (unsigned int) std::stoul(arg.substr(7));
+		else if(arg.compare(0, 9, "--repeat=") == 0) repeat = (unsigned int) std::stoul(arg.substr(9));
+		else{
+			std::cerr << "usage : " << argv[0] << " [--json] [--quick] [--seed=N] [--repeat=N]" << std::endl;
+			return 1;
+		}
+	}
+	try{
+		std::mt19937 generator(seed);
+		std::vector<BenchRecord> records;
+		/* Time against the number of states, at a fixed length. */
+		std::vector<std::size_t> states_sweep = (quick) ? std::vector<std::size_t>({10, 40}) : std::vector<std::size_t>({10, 25, 50, 100, 200});
+		for(std::size_t num_states : states_sweep){
+			BenchConfig config{num_states, (quick) ? 100u : 1000u, 1, 10, 0.2, 0.1, 2};
+			run_benchmarks("states", config, repeat, generator, records);
+		}
+		/* Time against the length of the sequences, at a fixed number of states. */
+		std::vector<std::size_t> length_sweep = (quick) ? std::vector<std::size_t>({100, 400}) : std::vector<std::size_t>({250, 500, 1000, 2000, 4000});
+		for(std::size_t length : length_sweep){
+			BenchConfig config{(quick) ? 20u : 50u, length, 1, 10, 0.2, 0.1, 2};
+			run_benchmarks("length", config, repeat, generator, records);
+		}
+		if(json) print_json(records, std::cout);
+		else print_csv(records, std::cout);
+	}
+	catch(const std::exception& e){
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
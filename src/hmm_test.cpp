@@ -130,6 +130,25 @@ void exp_all(std::vector<DiscreteDistribution>& dists){
 	for(auto& dist : dists){ dist.log_probabilities(false); }
 }
 
+/* Raw model of the brewed hmm (taken by value, its raw accessors not being const) : the pdfs are cloned, silent 
+states keeping a nullptr. The alphabet is left empty. */
+RawModel raw_model_of(HiddenMarkovModel hmm){
+	RawModel raw;
+	raw.A = hmm.raw_transitions();
+	raw.silent_states_index = 0;
+	for(Distribution* pdf : hmm.raw_pdfs()) {
+		raw.B.push_back((pdf == nullptr) ? nullptr : pdf->clone());
+		if(pdf != nullptr) ++raw.silent_states_index;
+	}
+	raw.pi_begin = hmm.raw_pi_begin();
+	raw.pi_end = hmm.raw_pi_end();
+	raw.states_indices = hmm.states_indices();
+	raw.states_names = hmm.states_names();
+	/* Same as the brew : finite if the end state can be reached. */
+	raw.is_finite = std::any_of(raw.pi_end.begin(), raw.pi_end.end(), [](double log_prob){ return log_prob != utils::kNegInf; });
+	return raw;
+}
+
 HiddenMarkovModel generate_random(std::size_t num_states, std::vector<std::string> alphabet,
 	std::size_t n_trans, std::size_t n_emi){
 		std::size_t params = 0;
@@ -590,6 +609,24 @@ int main(){
 			ASSERT(!subgraph.has_vertex("A"));
 			ASSERT(!subgraph.has_vertex("B"));
 			ASSERT(!subgraph.has_vertex("D"));
+			/* Adjacency is kept consistent on removal. */
+			g.remove_vertex("C");
+			ASSERT(g.num_vertices() == 4 && g.num_edges() == 3);
+			ASSERT(!g.has_edge("B", "C") && !g.has_edge("C", "E"));
+			ASSERT(g.get_out_edges("B").empty() && g.get_in_edges("E").size() == 1);
+			g.remove_edge("A", "D");
+			ASSERT(g.get_out_vertices("A").size() == 1 && g.get_in_vertices("D").empty());
+			ASSERT(*g.get_vertices()[2] == "D" && *g.get_vertex("D") == "D");
+			ASSERT(g.get_edge("D", "E")->to() == g.get_vertex("E"));
+			/* Copies point to their own vertices and keep the ids. */
+			std::size_t e_id = g.vertex_id("E");
+			g.add_vertex("F");
+			g.add_edge("E", "F", 0.5);
+			Graph<std::string> copy = g;
+			ASSERT(copy.num_vertices() == 5 && copy.num_edges() == 3);
+			ASSERT(copy.vertex_id("E") == e_id && copy.get_vertex("E") != g.get_vertex("E"));
+			ASSERT(copy.get_edge("E", "F")->from() == copy.get_vertex("E") && *copy.get_edge("E", "F")->weight() == 0.5);
+			ASSERT(copy.get_edge("D", "E")->weight() == nullptr);
 		)
 
 
@@ -769,6 +806,14 @@ int main(){
 			ASSERT(loaded_hmm.get_transition(loaded_hmm.begin(), save_s1) == save_s1_begin);
 			ASSERT(loaded_hmm.get_transition(save_s2, loaded_hmm.end()) == save_s2_end);
 			ASSERT_EXCEPT(loaded_hmm.get_transition(save_s2, save_s1), TransitionNotFoundException);
+			/* The max path length of a path counting training is kept. */
+			hmm.set_training(PathCountingViterbiTraining(nullptr, 64));
+			hmm.save(tmp_filename, extension);
+			HiddenMarkovModel path_counting_hmm;
+			path_counting_hmm.load(tmp_filename, extension);
+			std::remove(std::string(tmp_filename + "." + extension).c_str());
+			ASSERT(path_counting_hmm.training_type() == hmm_config::kPathCountingViterbiTrainingAlgorithmName);
+			ASSERT(static_cast<const PathCountingViterbiTraining&>(path_counting_hmm.training_algorithm()).max_path_length() == 64);
 		)
 
 		TEST_UNIT(
@@ -1051,6 +1096,81 @@ int main(){
 			ASSERT(viterbi_trained_distributions == profile_precomputed_viterbi_trained_distributions_pc);
 		)
 
+		TEST_UNIT(
+			"path counting viterbi training (batch of sequences) basic (casino)",
+			HiddenMarkovModel hmm = casino_hmm;
+			hmm.set_training(PathCountingViterbiTraining(nullptr));
+			double viterbi_improvement = utils::round_double(hmm.train(casino_training_sequences_2), 4);
+			std::vector<std::vector<double>> viterbi_trained_transitions = hmm.raw_transitions();
+			exp_all(viterbi_trained_transitions);
+			round_all(viterbi_trained_transitions, 4);
+			std::vector<double> viterbi_trained_pi_begin = hmm.raw_pi_begin();
+			exp_all(viterbi_trained_pi_begin);
+			round_all(viterbi_trained_pi_begin, 4);
+			std::vector<DiscreteDistribution> viterbi_trained_distributions;
+			for(auto dist_p : hmm.raw_pdfs()){
+				if(dist_p != nullptr){
+					viterbi_trained_distributions.push_back(*((DiscreteDistribution*)dist_p));
+				}
+			}
+			exp_all(viterbi_trained_distributions);
+			round_all(viterbi_trained_distributions, 4);
+			ASSERT(viterbi_improvement == casino_precomputed_viterbi_improvement);
+			ASSERT(viterbi_trained_transitions == casino_precomputed_viterbi_trained_transitions);
+			ASSERT(viterbi_trained_pi_begin == casino_precomputed_viterbi_trained_pi_begin);
+			ASSERT(viterbi_trained_distributions == casino_precomputed_viterbi_trained_distributions);
+		)
+
+		TEST_UNIT(
+			"path counting viterbi training falls back to linear memory counting on long sequences (casino)",
+			HiddenMarkovModel hmm = casino_hmm;
+			hmm.set_training(PathCountingViterbiTraining(nullptr, 1));
+			double viterbi_improvement = utils::round_double(hmm.train(casino_training_sequences_2), 4);
+			std::vector<std::vector<double>> viterbi_trained_transitions = hmm.raw_transitions();
+			exp_all(viterbi_trained_transitions);
+			round_all(viterbi_trained_transitions, 4);
+			std::vector<double> viterbi_trained_pi_begin = hmm.raw_pi_begin();
+			exp_all(viterbi_trained_pi_begin);
+			round_all(viterbi_trained_pi_begin, 4);
+			std::vector<DiscreteDistribution> viterbi_trained_distributions;
+			for(auto dist_p : hmm.raw_pdfs()){
+				if(dist_p != nullptr){
+					viterbi_trained_distributions.push_back(*((DiscreteDistribution*)dist_p));
+				}
+			}
+			exp_all(viterbi_trained_distributions);
+			round_all(viterbi_trained_distributions, 4);
+			ASSERT(viterbi_improvement == casino_precomputed_viterbi_improvement);
+			ASSERT(viterbi_trained_transitions == casino_precomputed_viterbi_trained_transitions);
+			ASSERT(viterbi_trained_pi_begin == casino_precomputed_viterbi_trained_pi_begin);
+			ASSERT(viterbi_trained_distributions == casino_precomputed_viterbi_trained_distributions);
+		)
+
+		TEST_UNIT(
+			"path counting viterbi training (batch of sequences) with pseudocounts and with silent states (profile)",
+			HiddenMarkovModel hmm = profile_10_states_hmm;
+			hmm.set_training(PathCountingViterbiTraining(nullptr));
+			double viterbi_improvement = utils::round_double(hmm.train(profile_training_sequences_1, 1.0), 4);
+			std::vector<std::vector<double>> viterbi_trained_transitions = hmm.raw_transitions();
+			exp_all(viterbi_trained_transitions);
+			round_all(viterbi_trained_transitions, 4);
+			std::vector<double> viterbi_trained_pi_begin = hmm.raw_pi_begin();
+			exp_all(viterbi_trained_pi_begin);
+			round_all(viterbi_trained_pi_begin, 4);
+			std::vector<DiscreteDistribution> viterbi_trained_distributions;
+			for(auto dist_p : hmm.raw_pdfs()){
+				if(dist_p != nullptr){
+					viterbi_trained_distributions.push_back(*((DiscreteDistribution*)dist_p));
+				}
+			}
+			exp_all(viterbi_trained_distributions);
+			round_all(viterbi_trained_distributions, 4);
+			ASSERT(viterbi_improvement == profile_precomputed_viterbi_improvement_pc);
+			ASSERT(viterbi_trained_transitions == profile_precomputed_viterbi_trained_transitions_pc);
+			ASSERT(viterbi_trained_pi_begin == profile_precomputed_viterbi_trained_pi_begin_pc);
+			ASSERT(viterbi_trained_distributions == profile_precomputed_viterbi_trained_distributions_pc);
+		)
+
 		TEST_UNIT(
 			"baum-welch training (batch of sequences) basic (casino)",
 			HiddenMarkovModel hmm = casino_hmm;
@@ -1161,8 +1281,1094 @@ int main(){
 			ASSERT(bw_trained_distributions == profile_precomputed_bw_batch_trained_distributions);
 		)
 
+		TEST_UNIT(
+			"incremental brew after parameter edits (profile)",
+			HiddenMarkovModel hmm = profile_10_states_hmm;
+			std::vector<std::string> names = hmm.states_names();
+			std::string emitting_name = names[0];
+			std::string silent_name = names[names.size() - 1];
+			State& emitting = hmm.get_state(State(emitting_name));
+			std::string symbol = static_cast<DiscreteDistribution*>(&emitting.distribution())->symbols()[0];
+			emitting.distribution()[symbol] = 2 * emitting.distribution()[symbol];
+			Graph<State> graph = hmm.get_graph();
+			for(Edge<State>* edge : graph.get_out_edges(State(silent_name))){
+				hmm.set_transition(State(silent_name), *edge->to(), 0.2);
+			}
+			hmm.set_transition(hmm.begin(), *hmm.get_graph().get_out_vertices(hmm.begin())[0], 0.7);
+			hmm.brew();
+			/* Changing normalize forces a full brew. */
+			HiddenMarkovModel full = hmm;
+			full.brew(false);
+			full.brew(true);
+			ASSERT(hmm.states_names() == names);
+			ASSERT(hmm.raw_transitions() == full.raw_transitions());
+			ASSERT(hmm.raw_pi_begin() == full.raw_pi_begin());
+			ASSERT(hmm.raw_pi_end() == full.raw_pi_end());
+			ASSERT(*hmm.raw_pdfs()[0] == *full.raw_pdfs()[0]);
+			ASSERT(*hmm.raw_pdfs()[0] != *profile_10_states_hmm.raw_pdfs()[0]);
+			ASSERT(hmm.raw_transitions() != profile_10_states_hmm.raw_transitions());
+			ASSERT(hmm.log_likelihood(profile_training_sequences_1) == full.log_likelihood(profile_training_sequences_1));
+			/* Edits through a reference kept across brews are tracked as well. */
+			emitting.distribution()[symbol] = 3 * emitting.distribution()[symbol];
+			hmm.brew();
+			ASSERT(*hmm.raw_pdfs()[0] != *full.raw_pdfs()[0]);
+			HiddenMarkovModel edited = hmm;
+			edited.brew(false);
+			edited.brew(true);
+			ASSERT(*hmm.raw_pdfs()[0] == *edited.raw_pdfs()[0]);
+			ASSERT(hmm.log_likelihood(profile_training_sequences_1) == edited.log_likelihood(profile_training_sequences_1));
+			/* Unmodified, it leaves the brewed model shared. */
+			HiddenMarkovModel unmodified = hmm;
+			unmodified.brew();
+			ASSERT(unmodified.raw_pdfs() == hmm.raw_pdfs());
+			/* A modified free status triggers a full brew. */
+			hmm.get_state(State(emitting_name)).fix_emission();
+			hmm.brew();
+			HiddenMarkovModel trained = hmm;
+			trained.train(profile_training_sequences_1);
+			ASSERT(*trained.raw_pdfs()[0] == *hmm.raw_pdfs()[0]);
+		)
+
+		TEST_UNIT(
+			"training write-back to the graph (profile)",
+			HiddenMarkovModel hmm = profile_10_states_hmm;
+			hmm.set_training(LinearMemoryBaumWelchTraining(nullptr));
+			hmm.train(profile_training_sequences_1, 0.0, hmm_config::kDefaultConvergenceThreshold, hmm_config::kDefaultMinIterations, 2);
+			std::vector<std::vector<double>> trained_transitions = hmm.raw_transitions();
+			round_all(trained_transitions, 8);
+			std::vector<double> trained_pi_begin = hmm.raw_pi_begin();
+			round_all(trained_pi_begin, 8);
+			std::vector<double> trained_pi_end = hmm.raw_pi_end();
+			round_all(trained_pi_end, 8);
+			/* A full brew rebuilds the raw model from the written back graph. */
+			hmm.brew(false);
+			std::vector<std::vector<double>> rebrewed_transitions = hmm.raw_transitions();
+			round_all(rebrewed_transitions, 8);
+			std::vector<double> rebrewed_pi_begin = hmm.raw_pi_begin();
+			round_all(rebrewed_pi_begin, 8);
+			std::vector<double> rebrewed_pi_end = hmm.raw_pi_end();
+			round_all(rebrewed_pi_end, 8);
+			ASSERT(rebrewed_transitions == trained_transitions);
+			ASSERT(rebrewed_pi_begin == trained_pi_begin);
+			ASSERT(rebrewed_pi_end == trained_pi_end);
+		)
+
+		TEST_UNIT(
+			"copy-on-write copies (casino)",
+			HiddenMarkovModel copy = casino_hmm;
+			/* Copies share the brewed model until modified. */
+			ASSERT(copy.raw_pdfs() == casino_hmm.raw_pdfs());
+			double casino_likelihood = casino_hmm.log_likelihood(casino_symbols);
+			ASSERT(copy.log_likelihood(casino_symbols) == casino_likelihood);
+			copy.brew();
+			ASSERT(copy.raw_pdfs() == casino_hmm.raw_pdfs());
+			copy.set_transition(fair, biased, 0.5);
+			copy.get_state(fair).distribution()["H"] = 0.9;
+			copy.brew();
+			ASSERT(copy.raw_pdfs() != casino_hmm.raw_pdfs());
+			ASSERT(copy.get_transition(fair, biased) == 0.5);
+			ASSERT(casino_hmm.get_transition(fair, biased) == 0.1);
+			ASSERT(casino_hmm.get_state(fair).distribution()["H"] == 0.5);
+			ASSERT(casino_hmm.log_likelihood(casino_symbols) == casino_likelihood);
+			ASSERT(copy.log_likelihood(casino_symbols) != casino_likelihood);
+			HiddenMarkovModel trained = casino_hmm;
+			trained.train(casino_training_sequences_2);
+			ASSERT(casino_hmm.log_likelihood(casino_symbols) == casino_likelihood);
+			ASSERT(casino_hmm.get_transition(fair, biased) == 0.1);
+			/* A state obtained before a copy only modifies its own hmm. */
+			HiddenMarkovModel original = casino_hmm;
+			State& original_fair = original.get_state(fair);
+			HiddenMarkovModel independent = original;
+			HiddenMarkovModel assigned;
+			assigned = original;
+			original_fair.distribution()["H"] = 0.9;
+			original.brew();
+			independent.brew();
+			assigned.brew();
+			ASSERT(independent.get_state(fair).distribution()["H"] == 0.5);
+			ASSERT(assigned.get_state(fair).distribution()["H"] == 0.5);
+			ASSERT(independent.log_likelihood(casino_symbols) == casino_likelihood);
+			ASSERT(assigned.log_likelihood(casino_symbols) == casino_likelihood);
+			ASSERT(original.log_likelihood(casino_symbols) != casino_likelihood);
+			/* A state renamed in place is found under its new name, by the copies as well. */
+			HiddenMarkovModel renamed = casino_hmm;
+			renamed.get_state(fair).set_name("honest");
+			ASSERT(renamed.has_state(State("honest")));
+			ASSERT(! renamed.has_state(fair));
+			ASSERT(renamed.get_transition(State("honest"), State("honest")) == casino_hmm.get_transition(fair, fair));
+			renamed.set_transition(State("honest"), biased, 0.2);
+			ASSERT_EXCEPT(renamed.add_state(State("honest")), StateExistsException);
+			HiddenMarkovModel renamed_copy = renamed;
+			renamed_copy.brew();
+			renamed.brew();
+			ASSERT(renamed.states_indices().count("honest") == 1);
+			ASSERT(renamed_copy.states_indices().count("honest") == 1);
+			ASSERT(renamed_copy.log_likelihood(casino_symbols) == renamed.log_likelihood(casino_symbols));
+		)
+
+		TEST_UNIT(
+			"fixed size engine (casino)",
+			RawModel raw = raw_model_of(casino_hmm);
+			raw.alphabet = std::vector<std::string>({"H", "T"});
+			std::shared_ptr<FixedSizeEngine> engine(make_fixed_size_engine(raw));
+			ASSERT(engine != nullptr);
+			ASSERT(engine->num_states() == 2);
+			/* Same values as the linear memory algorithms, at every step. */
+			LinearMemoryForwardAlgorithm fwd(&raw);
+			LinearMemoryBackwardAlgorithm bwd(&raw);
+			LinearMemoryViterbiDecodingAlgorithm viterbi(&raw);
+			for(std::size_t t = 1; t <= casino_symbols.size(); ++t){
+				ASSERT(engine->forward(casino_symbols, t) == fwd.forward(casino_symbols, t));
+				ASSERT(engine->backward(casino_symbols, t) == bwd.backward(casino_symbols, t));
+				ASSERT(engine->decode_indices(casino_symbols, t) == viterbi.decode_indices(casino_symbols, t));
+			}
+			ASSERT(engine->forward_log_likelihood(casino_symbols) == fwd.log_likelihood(casino_symbols));
+			ASSERT(engine->backward_log_likelihood(casino_symbols) == bwd.log_likelihood(casino_symbols));
+			/* Symbols out of the alphabet are impossible. */
+			std::vector<std::string> unknown_symbols({"T", "X", "H"});
+			ASSERT(engine->forward_log_likelihood(unknown_symbols) == utils::kNegInf);
+			ASSERT(engine->decode_indices(unknown_symbols, 0).first.empty());
+			/* The hmm dispatches to the engine and still gives the precomputed values. */
+			ASSERT(utils::round_double(casino_hmm.likelihood(casino_symbols), 4) == casino_precomputed_likelihood);
+			ASSERT(utils::round_double(casino_hmm.likelihood(casino_symbols, false), 4) == casino_precomputed_likelihood);
+			ASSERT(casino_hmm.decode(casino_symbols).first == casino_precomputed_viterbi_path_2_states);
+			/* No specialization for silent states. */
+			raw.silent_states_index = 1;
+			ASSERT(make_fixed_size_engine(raw) == nullptr);
+		)
+
+		TEST_UNIT(
+			"transitions envelope (profile)",
+			RawModel raw = raw_model_of(profile_10_states_hmm);
+			RawModel banded = raw;
+			banded.compute_envelope();
+			/* Every transition is within the envelope, which leaves out most of the matrix. */
+			std::size_t envelope_size = 0;
+			for(std::size_t i = 0; i < banded.A.size(); ++i){
+				RawModel::Envelope from = banded.predecessors_of(i);
+				envelope_size += (from.emitting_end - from.emitting_begin) + (from.silent_end - from.silent_begin);
+				for(std::size_t j = 0; j < banded.A.size(); ++j){
+					if(banded.A[j][i] == utils::kNegInf) continue;
+					ASSERT((from.emitting_begin <= j && j < from.emitting_end) || (from.silent_begin <= j && j < from.silent_end));
+					RawModel::Envelope to = banded.successors_of(j);
+					ASSERT((to.emitting_begin <= i && i < to.emitting_end) || (to.silent_begin <= i && i < to.silent_end));
+				}
+			}
+			ASSERT(envelope_size < banded.A.size() * banded.A.size() / 2);
+			/* Same values as when iterating over all the states. */
+			LinearMemoryForwardAlgorithm fwd(&raw);
+			LinearMemoryForwardAlgorithm banded_fwd(&banded);
+			LinearMemoryBackwardAlgorithm bwd(&raw);
+			LinearMemoryBackwardAlgorithm banded_bwd(&banded);
+			LinearMemoryViterbiDecodingAlgorithm viterbi(&raw);
+			LinearMemoryViterbiDecodingAlgorithm banded_viterbi(&banded);
+			for(const std::vector<std::string>& sequence : profile_training_sequences_1){
+				ASSERT(banded_fwd.forward(sequence, 0) == fwd.forward(sequence, 0));
+				ASSERT(banded_fwd.log_likelihood(sequence) == fwd.log_likelihood(sequence));
+				ASSERT(banded_bwd.backward(sequence, 0) == bwd.backward(sequence, 0));
+				ASSERT(banded_bwd.log_likelihood(sequence) == bwd.log_likelihood(sequence));
+				ASSERT(banded_viterbi.decode_indices(sequence, 0) == viterbi.decode_indices(sequence, 0));
+			}
+			/* A null free transition that gains mass in training (here from the pseudocounts) enters the envelope. */
+			HiddenMarkovModel profile = profile_10_states_hmm;
+			std::vector<std::string> names = profile.states_names();
+			std::size_t from = raw.A.size();
+			std::size_t to = raw.A.size();
+			/* Transition between silent states, which the silent closure takes from the envelope. */
+			for(std::size_t i = raw.silent_states_index; i < raw.A.size() && from == raw.A.size(); ++i){
+				for(std::size_t j = i + 1; j < raw.A.size() && from == raw.A.size(); ++j){
+					if(raw.A[i][j] == utils::kNegInf) continue;
+					RawModel pruned = raw;
+					pruned.A[i][j] = utils::kNegInf;
+					pruned.compute_envelope();
+					RawModel::Envelope pruned_from = pruned.predecessors_of(j);
+					if(i < pruned_from.silent_begin || i >= pruned_from.silent_end) { from = i; to = j; }
+				}
+			}
+			ASSERT(from < raw.A.size());
+			profile.set_transition(State(names[from]), State(names[to]), 0.0);
+			profile.brew();
+			ASSERT(profile.raw_transitions()[from][to] == utils::kNegInf);
+			profile.train(profile_training_sequences_1, 1.0, 0, 1, 1);
+			ASSERT(profile.raw_transitions()[from][to] != utils::kNegInf);
+			HiddenMarkovModel rebrewed = profile;
+			rebrewed.brew(false);
+			rebrewed.brew(true);
+			ASSERT(std::abs(profile.log_likelihood(profile_training_sequences_1) - rebrewed.log_likelihood(profile_training_sequences_1)) < 1e-9);
+		)
+
+		TEST_UNIT(
+			"silent closure (profile)",
+			RawModel raw = raw_model_of(profile_10_states_hmm);
+			raw.compute_envelope();
+			RawModel closed = raw;
+			closed.compute_silent_closure(true);
+			ASSERT(closed.has_silent_closure());
+			ASSERT(! raw.has_silent_closure());
+			/* Same values as when propagating through the silent states, up to the rounding. */
+			LinearMemoryForwardAlgorithm fwd(&raw);
+			LinearMemoryForwardAlgorithm closed_fwd(&closed);
+			LinearMemoryBackwardAlgorithm bwd(&raw);
+			LinearMemoryBackwardAlgorithm closed_bwd(&closed);
+			LinearMemoryViterbiDecodingAlgorithm viterbi(&raw);
+			LinearMemoryViterbiDecodingAlgorithm closed_viterbi(&closed);
+			for(const std::vector<std::string>& sequence : profile_training_sequences_1){
+				for(std::size_t t = 1; t <= sequence.size(); ++t){
+					std::vector<double> alpha = fwd.forward(sequence, t);
+					std::vector<double> closed_alpha = closed_fwd.forward(sequence, t);
+					round_all(alpha, 8);
+					round_all(closed_alpha, 8);
+					ASSERT(closed_alpha == alpha);
+					std::vector<double> beta = bwd.backward(sequence, t);
+					std::vector<double> closed_beta = closed_bwd.backward(sequence, t);
+					round_all(beta, 8);
+					round_all(closed_beta, 8);
+					ASSERT(closed_beta == beta);
+					std::vector<std::size_t> path;
+					std::vector<std::size_t> closed_path;
+					double path_log_prob;
+					double closed_path_log_prob;
+					std::tie(path, path_log_prob) = viterbi.decode_indices(sequence, t);
+					std::tie(closed_path, closed_path_log_prob) = closed_viterbi.decode_indices(sequence, t);
+					ASSERT(closed_path == path);
+					ASSERT(utils::round_double(closed_path_log_prob, 8) == utils::round_double(path_log_prob, 8));
+				}
+				ASSERT(utils::round_double(closed_fwd.log_likelihood(sequence), 8) == utils::round_double(fwd.log_likelihood(sequence), 8));
+				ASSERT(utils::round_double(closed_bwd.log_likelihood(sequence), 8) == utils::round_double(bwd.log_likelihood(sequence), 8));
+			}
+			/* Impossible sequence. */
+			std::vector<std::string> impossible({"Z"});
+			ASSERT(closed_viterbi.decode_indices(impossible, 0).first.empty());
+			ASSERT(closed_fwd.log_likelihood(impossible) == utils::kNegInf);
+		)
+
+		TEST_UNIT(
+			"single precision (casino, nucleobase, profile)",
+			std::vector<HiddenMarkovModel> hmms;
+			hmms.push_back(casino_hmm);
+			hmms.push_back(nucleobase_3_states_hmm);
+			hmms.push_back(profile_10_states_hmm);
+			std::vector<std::vector<std::vector<std::string>>> hmms_sequences;
+			hmms_sequences.push_back(casino_training_sequences_2);
+			hmms_sequences.push_back(nucleobase_training_sequences);
+			hmms_sequences.push_back(profile_training_sequences_1);
+			for(std::size_t h = 0; h < hmms.size(); ++h){
+				HiddenMarkovModel single = hmms[h];
+				single.set_forward(SinglePrecisionForwardAlgorithm(nullptr));
+				single.set_decoding(SinglePrecisionViterbiDecodingAlgorithm(nullptr));
+				ASSERT(single.forward_type() == hmm_config::kSinglePrecisionForwardAlgorithmName);
+				ASSERT(single.decoding_type() == hmm_config::kSinglePrecisionViterbiDecodeAlgorithmName);
+				/* Within the float rounding of the double values, and same optimal paths. */
+				for(const std::vector<std::string>& sequence : hmms_sequences[h]){
+					double log_likelihood = hmms[h].log_likelihood(sequence);
+					ASSERT(std::abs(single.log_likelihood(sequence) - log_likelihood) <= 1e-5 * std::abs(log_likelihood));
+					std::vector<double> single_alpha = single.forward(sequence);
+					std::vector<double> alpha = hmms[h].forward(sequence);
+					for(std::size_t i = 0; i < alpha.size(); ++i){
+						ASSERT(single_alpha[i] == alpha[i] || std::abs(single_alpha[i] - alpha[i]) <= 1e-5 * std::abs(alpha[i]));
+					}
+					ASSERT(single.decode(sequence).first == hmms[h].decode(sequence).first);
+				}
+			}
+			/* Impossible sequence. */
+			HiddenMarkovModel single = casino_hmm;
+			single.set_decoding(SinglePrecisionViterbiDecodingAlgorithm(nullptr));
+			std::vector<std::string> impossible({"H", "Z"});
+			ASSERT(single.decode(impossible).first.empty());
+		)
+
+		TEST_UNIT(
+			"compiled model (casino, profile)",
+			std::vector<HiddenMarkovModel> hmms;
+			hmms.push_back(casino_hmm);
+			hmms.push_back(profile_10_states_hmm);
+			std::vector<std::vector<std::vector<std::string>>> hmms_sequences;
+			hmms_sequences.push_back(casino_training_sequences_2);
+			hmms_sequences.back().push_back(casino_symbols);
+			hmms_sequences.push_back(profile_training_sequences_1);
+			for(std::size_t h = 0; h < hmms.size(); ++h){
+				HiddenMarkovModel compiled = hmms[h];
+				compiled.set_forward(CompiledForwardAlgorithm(nullptr));
+				compiled.set_decoding(CompiledViterbiDecodingAlgorithm(nullptr));
+				ASSERT(compiled.forward_type() == hmm_config::kCompiledForwardAlgorithmName);
+				/* Same values as the linear memory algorithms, at every step (up to the rounding, the linear memory 
+				algorithms going through the silent closure of the profile hmm). */
+				for(const std::vector<std::string>& sequence : hmms_sequences[h]){
+					for(std::size_t t = 1; t <= sequence.size(); ++t){
+						std::vector<double> compiled_alpha = compiled.forward(sequence, t);
+						std::vector<double> alpha = hmms[h].forward(sequence, t);
+						round_all(compiled_alpha, 8);
+						round_all(alpha, 8);
+						ASSERT(compiled_alpha == alpha);
+						ASSERT(compiled.decode(sequence, t).first == hmms[h].decode(sequence, t).first);
+						ASSERT(utils::round_double(compiled.decode(sequence, t).second, 8) == utils::round_double(hmms[h].decode(sequence, t).second, 8));
+					}
+					ASSERT(utils::round_double(compiled.log_likelihood(sequence), 8) == utils::round_double(hmms[h].log_likelihood(sequence), 8));
+				}
+			}
+			/* Recompiled after a brew. */
+			HiddenMarkovModel compiled = casino_hmm;
+			compiled.set_forward(CompiledForwardAlgorithm(nullptr));
+			double casino_likelihood = compiled.log_likelihood(casino_symbols);
+			compiled.set_transition(fair, biased, 0.5);
+			compiled.brew();
+			HiddenMarkovModel modified = casino_hmm;
+			modified.set_transition(fair, biased, 0.5);
+			modified.brew();
+			ASSERT(compiled.log_likelihood(casino_symbols) != casino_likelihood);
+			ASSERT(compiled.log_likelihood(casino_symbols) == modified.log_likelihood(casino_symbols));
+			/* Symbols out of the alphabet are impossible. */
+			std::vector<std::string> unknown_symbols({"T", "X", "H"});
+			ASSERT(compiled.log_likelihood(unknown_symbols) == utils::kNegInf);
+			/* Only brewed models can be compiled. */
+			HiddenMarkovModel empty_hmm;
+			empty_hmm.set_forward(CompiledForwardAlgorithm(nullptr));
+			ASSERT_EXCEPT(empty_hmm.log_likelihood(casino_symbols), ModelCompilationException);
+			/* The cached source is compared to the model's : the object of another source with the same hash is not 
+			loaded. In a directory whose name needs quoting. */
+			RawModel raw = raw_model_of(casino_hmm);
+			raw.alphabet = std::vector<std::string>({"H", "T"});
+			const std::string cache_directory = "hmm_test_cache_'quoted";
+			double raw_likelihood = compile_model(raw, cache_directory)->log_likelihood(casino_symbols);
+			std::ostringstream hash;
+			hash << std::hex << std::hash<std::string>()(generate_model_source(raw));
+			const std::string colliding_path = cache_directory + "/hmm_" + hash.str();
+			std::ofstream colliding_source(colliding_path + ".cpp");
+			colliding_source << "/* Another model. */";
+			colliding_source.close();
+			std::ofstream colliding_library(colliding_path + ".so");
+			colliding_library << "not an object";
+			colliding_library.close();
+			ASSERT(compile_model(raw, cache_directory)->log_likelihood(casino_symbols) == raw_likelihood);
+			ASSERT(std::ifstream(colliding_path + "_1.cpp").good());
+			/* Found in the cache this time. */
+			ASSERT(compile_model(raw, cache_directory)->log_likelihood(casino_symbols) == raw_likelihood);
+			for(const std::string& path : {colliding_path + ".cpp", colliding_path + ".so", colliding_path + "_1.cpp", 
+				colliding_path + "_1.so", cache_directory}){
+				std::remove(path.c_str());
+			}
+		)
+
+		TEST_UNIT(
+			"continuous emissions (normal, uniform)",
+			NormalDistribution low_dist(0, 1);
+			NormalDistribution high_dist(5, 1);
+			UniformDistribution uniform_dist(-1, 3);
+			std::vector<double> values({0.1, -0.3, 0.2, 5.1, 4.8, 5.3, 1.2});
+			std::vector<double> batched(values.size());
+			low_dist.log_pdf(values.data(), values.size(), batched.data());
+			for(std::size_t t = 0; t < values.size(); ++t){
+				ASSERT(batched[t] == low_dist.log_pdf(values[t]));
+				ASSERT(utils::round_double(low_dist["" + std::to_string(values[t])], 8) == utils::round_double(exp(batched[t]), 8));
+			}
+			uniform_dist.log_pdf(values.data(), values.size(), batched.data());
+			ASSERT(utils::round_double(batched[0], 8) == utils::round_double(-log(4), 8));
+			ASSERT(batched[3] == -std::numeric_limits<double>::infinity());
+			HiddenMarkovModel hmm("continuous");
+			State low("low", low_dist);
+			State high("high", high_dist);
+			hmm.add_state(low);
+			hmm.add_state(high);
+			hmm.begin_transition(low, 0.5);
+			hmm.begin_transition(high, 0.5);
+			hmm.add_transition(low, low, 0.9);
+			hmm.add_transition(low, high, 0.1);
+			hmm.add_transition(high, high, 0.9);
+			hmm.add_transition(high, low, 0.1);
+			hmm.brew();
+			std::vector<double> alpha_1 = hmm.forward(values, 1);
+			ASSERT(utils::round_double(alpha_1[0], 8) == utils::round_double(log(0.5) + low_dist.log_pdf(values[0]), 8));
+			ASSERT(utils::round_double(alpha_1[1], 8) == utils::round_double(log(0.5) + high_dist.log_pdf(values[0]), 8));
+			ASSERT(utils::round_double(hmm.log_likelihood(values), 8) == utils::round_double(hmm.log_likelihood(values, false), 8));
+			ASSERT(hmm.decode(values).first == std::vector<std::string>({"low", "low", "low", "high", "high", "high", "low"}));
+			/* Same blocks in forward and backward order, whatever their size. */
+			RawModel raw_model;
+			raw_model.B.push_back(low_dist.clone());
+			raw_model.B.push_back(high_dist.clone());
+			raw_model.silent_states_index = 2;
+			FrameMatrix frames(values);
+			NumericEmissions small_blocks(&raw_model, frames, 2);
+			NumericEmissions single_block(&raw_model, frames);
+			for(std::size_t t = values.size(); t-- > 0;){
+				std::vector<double> small_row(small_blocks.at(t), small_blocks.at(t) + 2);
+				std::vector<double> single_row(single_block.at(t), single_block.at(t) + 2);
+				ASSERT(small_row == single_row);
+			}
+			/* Only continuous models accept numeric sequences. */
+			ASSERT_EXCEPT(casino_hmm.log_likelihood(values), std::invalid_argument);
+			std::string tmp_filename = "test_continuous_hmm_file_tmp";
+			hmm.save(tmp_filename);
+			HiddenMarkovModel loaded_hmm;
+			loaded_hmm.load(tmp_filename);
+			std::remove(std::string(tmp_filename + "." + global_config::kDefaultFileExtension).c_str());
+			ASSERT(loaded_hmm.get_state(low).distribution() == low_dist);
+			ASSERT(loaded_hmm.get_state(high).distribution() == high_dist);
+			loaded_hmm.brew();
+			ASSERT(utils::round_double(loaded_hmm.log_likelihood(values), 8) == utils::round_double(hmm.log_likelihood(values), 8));
+		)
+
+		TEST_UNIT(
+			"gaussian mixture emissions (frames)",
+			/* Two components over frames of dimension 2, against the product of their normal marginals. */
+			GaussianMixtureDistribution mixture(2, std::vector<double>({0.25, 0.75}), std::vector<double>({0, 1, 4, 5}), 
+				std::vector<double>({1, 4, 0.25, 1}));
+			ASSERT(mixture.dimension() == 2);
+			ASSERT(mixture.num_components() == 2);
+			std::vector<double> frames_data;
+			for(std::size_t t = 0; t < 100; ++t){
+				frames_data.push_back(std::sin((double) t) * 5);
+				frames_data.push_back(std::cos((double) t) * 5);
+			}
+			FrameMatrix frames(frames_data, 2);
+			ASSERT(frames.length() == 100);
+			std::vector<double> batched(frames.length());
+			mixture.log_pdf(frames.data(), frames.length(), batched.data());
+			for(std::size_t t = 0; t < frames.length(); ++t){
+				const double* frame = frames.frame(t);
+				double expected = log(0.25 * exp(NormalDistribution(0, 1).log_pdf(frame[0]) + NormalDistribution(1, 2).log_pdf(frame[1])) + 
+					0.75 * exp(NormalDistribution(4, 0.5).log_pdf(frame[0]) + NormalDistribution(5, 1).log_pdf(frame[1])));
+				ASSERT(utils::round_double(batched[t], 8) == utils::round_double(expected, 8));
+			}
+			/* Full covariances. */
+			GaussianMixtureDistribution correlated(2, std::vector<double>({1}), std::vector<double>({0, 0}), 
+				std::vector<double>({2, 0.5, 0.5, 1}), true);
+			std::vector<double> frame({1, -1});
+			double correlated_log_pdf;
+			correlated.log_pdf(frame.data(), 1, &correlated_log_pdf);
+			ASSERT(utils::round_double(correlated_log_pdf, 8) == utils::round_double(- log(2 * acos(-1.0)) - 0.5 * log(1.75) - 0.5 * 4 / 1.75, 8));
+			ASSERT_EXCEPT(GaussianMixtureDistribution(2, std::vector<double>({1}), std::vector<double>({0, 0}), std::vector<double>({1, 2, 2, 1}), true), std::invalid_argument);
+			ASSERT_EXCEPT(GaussianMixtureDistribution(2, std::vector<double>({1}), std::vector<double>({0}), std::vector<double>({1, 1})), std::invalid_argument);
+			ASSERT_EXCEPT(mixture.log_pdf(0.0), std::invalid_argument);
+			/* Hmm over the frames. */
+			HiddenMarkovModel hmm("frames");
+			State near("near", GaussianMixtureDistribution(2, std::vector<double>({0.5, 0.5}), std::vector<double>({0, 0, 1, 1}), std::vector<double>({1, 1, 1, 1})));
+			State far("far", GaussianMixtureDistribution(2, std::vector<double>({1}), std::vector<double>({10, 10}), std::vector<double>({1, 0, 0, 1}), true));
+			hmm.add_state(near);
+			hmm.add_state(far);
+			hmm.begin_transition(near, 0.5);
+			hmm.begin_transition(far, 0.5);
+			hmm.add_transition(near, near, 0.8);
+			hmm.add_transition(near, far, 0.2);
+			hmm.add_transition(far, far, 0.8);
+			hmm.add_transition(far, near, 0.2);
+			hmm.brew();
+			FrameMatrix signal(2);
+			std::vector<std::vector<double>> signal_frames({{0.2, 0.5}, {10.5, 9.5}, {9.8, 10.1}, {0.9, 1.2}});
+			for(const std::vector<double>& signal_frame : signal_frames){
+				signal.push_back(signal_frame.data());
+			}
+			ASSERT(hmm.decode(signal).first == std::vector<std::string>({"near", "far", "far", "near"}));
+			ASSERT(utils::round_double(hmm.log_likelihood(signal), 8) == utils::round_double(hmm.log_likelihood(signal, false), 8));
+			ASSERT_EXCEPT(hmm.log_likelihood(frames_data), std::invalid_argument);
+			ASSERT_EXCEPT(FrameMatrix(std::vector<double>({1, 2, 3}), 2), std::invalid_argument);
+			std::string tmp_filename = "test_frames_hmm_file_tmp";
+			hmm.save(tmp_filename);
+			HiddenMarkovModel loaded_hmm;
+			loaded_hmm.load(tmp_filename);
+			std::remove(std::string(tmp_filename + "." + global_config::kDefaultFileExtension).c_str());
+			ASSERT(loaded_hmm.get_state(near).distribution() == hmm.get_state(near).distribution());
+			ASSERT(loaded_hmm.get_state(far).distribution() == hmm.get_state(far).distribution());
+			loaded_hmm.brew();
+			ASSERT(utils::round_double(loaded_hmm.log_likelihood(signal), 8) == utils::round_double(hmm.log_likelihood(signal), 8));
+		)
+
+		TEST_UNIT(
+			"baum-welch training (continuous emissions)",
+			HiddenMarkovModel hmm("signal");
+			State low("low", NormalDistribution(1, 2));
+			State high("high", NormalDistribution(4, 2));
+			hmm.add_state(low);
+			hmm.add_state(high);
+			hmm.begin_transition(low, 0.5);
+			hmm.begin_transition(high, 0.5);
+			hmm.add_transition(low, low, 0.9);
+			hmm.add_transition(low, high, 0.1);
+			hmm.add_transition(high, high, 0.9);
+			hmm.add_transition(high, low, 0.1);
+			hmm.set_training(LinearMemoryBaumWelchTraining(nullptr));
+			hmm.brew();
+			std::vector<double> signal;
+			for(std::size_t t = 0; t < 90; ++t){
+				signal.push_back((((t / 15) % 2 == 0) ? 0.0 : 5.0) + std::sin((double) t * 1.3) * 0.8);
+			}
+			std::vector<FrameMatrix> signals({FrameMatrix(signal)});
+			/* One iteration re-estimates the means and variances from the posteriors of the states. */
+			double log_likelihood = hmm.log_likelihood(signal);
+			std::vector<double> expected_means;
+			std::vector<double> expected_variances;
+			for(std::size_t i = 0; i < 2; ++i){
+				double posterior_sum = 0;
+				double weighted_sum = 0;
+				double weighted_square_sum = 0;
+				for(std::size_t t = 0; t < signal.size(); ++t){
+					double posterior = exp(hmm.forward(signal, t + 1)[i] + hmm.backward(signal, t + 1)[i] - log_likelihood);
+					posterior_sum += posterior;
+					weighted_sum += posterior * signal[t];
+					weighted_square_sum += posterior * signal[t] * signal[t];
+				}
+				expected_means.push_back(weighted_sum / posterior_sum);
+				expected_variances.push_back(weighted_square_sum / posterior_sum - expected_means.back() * expected_means.back());
+			}
+			HiddenMarkovModel trained = hmm;
+			ASSERT(trained.train(signals, 0, 0, 1, 1) > 0);
+			const NormalDistribution& trained_low = static_cast<const NormalDistribution&>(trained.get_state(low).distribution());
+			const NormalDistribution& trained_high = static_cast<const NormalDistribution&>(trained.get_state(high).distribution());
+			ASSERT(utils::round_double(trained_low.mean(), 6) == utils::round_double(expected_means[0], 6));
+			ASSERT(utils::round_double(trained_high.mean(), 6) == utils::round_double(expected_means[1], 6));
+			ASSERT(utils::round_double(pow(trained_low.standard_deviation(), 2), 6) == utils::round_double(expected_variances[0], 6));
+			ASSERT(utils::round_double(pow(trained_high.standard_deviation(), 2), 6) == utils::round_double(expected_variances[1], 6));
+			/* Until convergence, the states fit the two levels of the signal. */
+			ASSERT(hmm.train(signals, 0, 1e-6, 1, 100) > 0);
+			ASSERT(std::abs(static_cast<const NormalDistribution&>(hmm.get_state(low).distribution()).mean()) < 0.2);
+			ASSERT(std::abs(static_cast<const NormalDistribution&>(hmm.get_state(high).distribution()).mean() - 5) < 0.2);
+			ASSERT(utils::round_double(hmm.log_likelihood(signal), 6) == utils::round_double(hmm.log_likelihood(signal, false), 6));
+			/* A single full covariance component re-estimated from all the frames is their sample mean and covariance. */
+			HiddenMarkovModel frames_hmm("frames");
+			State frames_state("frames_state", GaussianMixtureDistribution(2, std::vector<double>({1}), std::vector<double>({0, 0}), std::vector<double>({1, 0, 0, 1}), true));
+			frames_hmm.add_state(frames_state);
+			frames_hmm.begin_transition(frames_state, 1);
+			frames_hmm.add_transition(frames_state, frames_state, 1);
+			frames_hmm.set_training(LinearMemoryBaumWelchTraining(nullptr));
+			frames_hmm.brew();
+			FrameMatrix frames(2);
+			for(std::size_t t = 0; t < 50; ++t){
+				std::vector<double> frame({std::sin((double) t) * 2 - 3, std::sin((double) t) + std::cos((double) t * 0.7)});
+				frames.push_back(frame.data());
+			}
+			std::vector<double> sample_mean(2, 0.0);
+			std::vector<double> sample_covariance(4, 0.0);
+			for(std::size_t t = 0; t < frames.length(); ++t){
+				for(std::size_t d = 0; d < 2; ++d){ sample_mean[d] += frames.frame(t)[d] / 50; }
+			}
+			for(std::size_t t = 0; t < frames.length(); ++t){
+				for(std::size_t d = 0; d < 2; ++d){
+					for(std::size_t e = 0; e < 2; ++e){
+						sample_covariance[d * 2 + e] += (frames.frame(t)[d] - sample_mean[d]) * (frames.frame(t)[e] - sample_mean[e]) / 50;
+					}
+				}
+			}
+			frames_hmm.train(std::vector<FrameMatrix>({frames}), 0, 0, 1, 1);
+			const GaussianMixtureDistribution& trained_mixture = static_cast<const GaussianMixtureDistribution&>(frames_hmm.get_state(frames_state).distribution());
+			std::vector<double> trained_mean = trained_mixture.means();
+			std::vector<double> trained_covariance = trained_mixture.covariances();
+			round_all(trained_mean, 6);
+			round_all(sample_mean, 6);
+			round_all(trained_covariance, 6);
+			round_all(sample_covariance, 6);
+			ASSERT(trained_mean == sample_mean);
+			ASSERT(trained_covariance == sample_covariance);
+			/* Two diagonal components split two clusters of frames. */
+			HiddenMarkovModel clusters_hmm("clusters");
+			State clusters_state("clusters_state", GaussianMixtureDistribution(2, std::vector<double>({0.5, 0.5}), std::vector<double>({-1, -1, 1, 1}), std::vector<double>({4, 4, 4, 4})));
+			clusters_hmm.add_state(clusters_state);
+			clusters_hmm.begin_transition(clusters_state, 1);
+			clusters_hmm.add_transition(clusters_state, clusters_state, 1);
+			clusters_hmm.set_training(LinearMemoryBaumWelchTraining(nullptr));
+			clusters_hmm.brew();
+			FrameMatrix clusters(2);
+			for(std::size_t t = 0; t < 80; ++t){
+				double center = (t % 4 == 0) ? 3.0 : -3.0;
+				std::vector<double> frame({center + std::sin((double) t) * 0.5, center + std::cos((double) t) * 0.5});
+				clusters.push_back(frame.data());
+			}
+			ASSERT(clusters_hmm.train(std::vector<FrameMatrix>({clusters}), 0, 1e-8, 1, 200) > 0);
+			const GaussianMixtureDistribution& clusters_mixture = static_cast<const GaussianMixtureDistribution&>(clusters_hmm.get_state(clusters_state).distribution());
+			ASSERT(std::abs(clusters_mixture.weights()[0] - 0.75) < 0.01);
+			ASSERT(std::abs(clusters_mixture.means()[0] + 3) < 0.1);
+			ASSERT(std::abs(clusters_mixture.means()[2] - 3) < 0.1);
+			/* The Viterbi training only takes symbols. */
+			clusters_hmm.set_training(LinearMemoryViterbiTraining(nullptr));
+			ASSERT_EXCEPT(clusters_hmm.train(std::vector<FrameMatrix>({clusters})), std::logic_error);
+		)
+
+		TEST_UNIT(
+			"prefix cached forward (casino, profile)",
+			std::vector<HiddenMarkovModel> hmms;
+			hmms.push_back(casino_hmm);
+			hmms.push_back(profile_10_states_hmm);
+			std::vector<std::vector<std::vector<std::string>>> hmms_sequences;
+			hmms_sequences.push_back(casino_training_sequences_2);
+			hmms_sequences.push_back(profile_training_sequences_1);
+			for(std::size_t h = 0; h < hmms.size(); ++h){
+				HiddenMarkovModel cached = hmms[h];
+				cached.set_forward(PrefixCachedForwardAlgorithm(nullptr, 64, 4));
+				ASSERT(cached.forward_type() == hmm_config::kPrefixCachedForwardAlgorithmName);
+				const PrefixCachedForwardAlgorithm& cache = static_cast<const PrefixCachedForwardAlgorithm&>(cached.forward_algorithm());
+				/* Same values as the linear memory forward, from scratch then from the cached prefixes. */
+				for(std::size_t pass = 0; pass < 2; ++pass){
+					for(const std::vector<std::string>& sequence : hmms_sequences[h]){
+						double log_likelihood = hmms[h].log_likelihood(sequence);
+						ASSERT(std::abs(cached.log_likelihood(sequence) - log_likelihood) <= 1e-8 * std::abs(log_likelihood));
+						for(std::size_t t = 1; t <= sequence.size(); ++t){
+							std::vector<double> cached_alpha = cached.forward(sequence, t);
+							std::vector<double> alpha = hmms[h].forward(sequence, t);
+							for(std::size_t i = 0; i < alpha.size(); ++i){
+								ASSERT(cached_alpha[i] == alpha[i] || std::abs(cached_alpha[i] - alpha[i]) <= 1e-8 * std::abs(alpha[i]));
+							}
+						}
+					}
+				}
+				PrefixCachedForwardAlgorithm::CacheStatistics statistics = cache.cache_statistics();
+				ASSERT(statistics.hits > 0);
+				ASSERT(statistics.resumed_steps >= 4 * statistics.hits);
+				ASSERT(statistics.entries > 0 && statistics.entries <= 64);
+				ASSERT(statistics.memory > 0);
+				/* The cache is cleared when the model changes. */
+				cached.train(hmms_sequences[h], 0, 0, 1, 1);
+				ASSERT(cache.cache_statistics().entries == 0);
+				ASSERT(cache.cache_statistics().hits == 0);
+			}
+			/* A second call on a sequence resumes from its last checkpoint. */
+			HiddenMarkovModel cached = casino_hmm;
+			cached.set_forward(PrefixCachedForwardAlgorithm(nullptr, 2, 4));
+			const PrefixCachedForwardAlgorithm& cache = static_cast<const PrefixCachedForwardAlgorithm&>(cached.forward_algorithm());
+			std::vector<std::string> sequence({"H", "T", "T", "H", "H", "H", "T", "H", "T", "T"});
+			cached.log_likelihood(sequence);
+			PrefixCachedForwardAlgorithm::CacheStatistics statistics = cache.cache_statistics();
+			ASSERT(statistics.misses == 1 && statistics.hits == 0 && statistics.entries == 2);
+			cached.log_likelihood(sequence);
+			statistics = cache.cache_statistics();
+			ASSERT(statistics.hits == 1 && statistics.resumed_steps == 8);
+			/* Bounded : the deepest prefixes are evicted first. */
+			std::vector<std::string> longer(sequence);
+			longer.insert(longer.end(), sequence.begin(), sequence.end());
+			cached.log_likelihood(longer);
+			statistics = cache.cache_statistics();
+			ASSERT(statistics.hits == 2 && statistics.resumed_steps == 16);
+			ASSERT(statistics.entries == 2 && statistics.evictions == 3);
+			/* The symbols of the uncached sequences are not kept. */
+			HiddenMarkovModel uncached = casino_hmm;
+			uncached.set_forward(PrefixCachedForwardAlgorithm(nullptr, 0, 4));
+			const PrefixCachedForwardAlgorithm& empty_cache = static_cast<const PrefixCachedForwardAlgorithm&>(uncached.forward_algorithm());
+			for(std::size_t s = 0; s < 8; ++s){
+				std::vector<std::string> unknown(8, "unknown " + std::to_string(s));
+				ASSERT(uncached.log_likelihood(unknown) == utils::kNegInf);
+			}
+			ASSERT(uncached.log_likelihood(sequence) == casino_hmm.log_likelihood(sequence));
+			ASSERT(empty_cache.cache_statistics().misses == 9 && empty_cache.cache_statistics().memory == 0);
+		)
+
+		TEST_UNIT(
+			"weighted training and duplicate sequences (casino, profile)",
+			std::vector<HiddenMarkovModel> hmms;
+			hmms.push_back(casino_hmm);
+			hmms.push_back(profile_10_states_hmm);
+			std::vector<std::vector<std::vector<std::string>>> hmms_sequences;
+			hmms_sequences.push_back(casino_training_sequences_2);
+			hmms_sequences.push_back(profile_training_sequences_1);
+			std::vector<TrainingAlgorithm*> trainings;
+			trainings.push_back(new LinearMemoryViterbiTraining(nullptr));
+			trainings.push_back(new PathCountingViterbiTraining(nullptr));
+			trainings.push_back(new LinearMemoryBaumWelchTraining(nullptr));
+			for(std::size_t h = 0; h < hmms.size(); ++h){
+				/* The first sequence three times and the second one twice, against weights of 3 and 2. */
+				std::vector<std::vector<std::string>> repeated = hmms_sequences[h];
+				repeated.push_back(hmms_sequences[h][0]);
+				repeated.push_back(hmms_sequences[h][0]);
+				repeated.push_back(hmms_sequences[h][1]);
+				std::vector<double> weights(hmms_sequences[h].size(), 1.0);
+				weights[0] = 3.0;
+				weights[1] = 2.0;
+				for(TrainingAlgorithm* training : trainings){
+					HiddenMarkovModel repeated_hmm = hmms[h];
+					HiddenMarkovModel weighted_hmm = hmms[h];
+					repeated_hmm.set_training(*training);
+					weighted_hmm.set_training(*training);
+					double repeated_improvement = utils::round_double(repeated_hmm.train(repeated, 0, 0, 1, 5), 6);
+					double weighted_improvement = utils::round_double(weighted_hmm.train(hmms_sequences[h], weights, 0, 0, 1, 5), 6);
+					ASSERT(repeated_improvement == weighted_improvement);
+					std::vector<std::vector<double>> repeated_transitions = repeated_hmm.raw_transitions();
+					std::vector<std::vector<double>> weighted_transitions = weighted_hmm.raw_transitions();
+					exp_all(repeated_transitions);
+					exp_all(weighted_transitions);
+					round_all(repeated_transitions, 6);
+					round_all(weighted_transitions, 6);
+					ASSERT(repeated_transitions == weighted_transitions);
+					ASSERT(utils::round_double(repeated_hmm.log_likelihood(hmms_sequences[h][2]), 6) == utils::round_double(weighted_hmm.log_likelihood(hmms_sequences[h][2]), 6));
+				}
+			}
+			/* A null weight drops the sequence. */
+			std::vector<std::vector<std::string>> dropped(casino_training_sequences_2.begin() + 1, casino_training_sequences_2.end());
+			std::vector<double> weights(casino_training_sequences_2.size(), 1.0);
+			weights[0] = 0.0;
+			HiddenMarkovModel dropped_hmm = casino_hmm;
+			HiddenMarkovModel weighted_hmm = casino_hmm;
+			dropped_hmm.set_training(LinearMemoryBaumWelchTraining(nullptr));
+			weighted_hmm.set_training(LinearMemoryBaumWelchTraining(nullptr));
+			ASSERT(utils::round_double(dropped_hmm.train(dropped, 0, 0, 1, 5), 6) == utils::round_double(weighted_hmm.train(casino_training_sequences_2, weights, 0, 0, 1, 5), 6));
+			/* One non negative weight per sequence. */
+			ASSERT_EXCEPT(weighted_hmm.train(casino_training_sequences_2, std::vector<double>({1.0})), std::invalid_argument);
+			weights[0] = -1.0;
+			ASSERT_EXCEPT(weighted_hmm.train(casino_training_sequences_2, weights), std::invalid_argument);
+			for(TrainingAlgorithm* training : trainings){
+				delete training;
+			}
+		)
+
+		TEST_UNIT(
+			"memory instrumentation",
+			std::size_t current = utils::current_memory();
+			std::size_t peak = utils::peak_memory();
+			ASSERT(current == 0 || peak == 0 || peak >= current);
+			utils::MemoryProfile profile;
+			HiddenMarkovModel hmm = profile_10_states_hmm;
+			std::vector<std::string> short_sequence = profile_training_sequences_1[0];
+			std::vector<std::string> long_sequence;
+			for(std::size_t i = 0; i < 20; ++i){
+				long_sequence.insert(long_sequence.end(), short_sequence.begin(), short_sequence.end());
+			}
+			profile.start("forward");
+			hmm.log_likelihood(short_sequence);
+			profile.start("long forward");
+			hmm.log_likelihood(long_sequence);
+			profile.start("viterbi");
+			hmm.decode(short_sequence);
+			profile.stop();
+			ASSERT(profile.phases().size() == 3);
+			ASSERT(profile.phases()[1].name == "long forward");
+			for(const utils::MemoryProfile::Phase& phase : profile.phases()){
+				ASSERT(phase.peak_memory >= phase.end_memory);
+			}
+			ASSERT(profile.to_json().find("\"phase\": \"viterbi\"") != std::string::npos);
+			std::string csv = profile.to_csv();
+			ASSERT(std::count(csv.begin(), csv.end(), '\n') == 4);
+			if(utils::allocations_counted()){
+				ASSERT(profile.phases()[0].allocations > 0);
+				/* Linear memory : the forward of a 20 times longer sequence does not need more memory. */
+				ASSERT(profile.phases()[1].peak_live <= profile.phases()[0].peak_live);
+			}
+			else{
+				ASSERT(utils::allocation_counters().allocations == 0);
+			}
+		)
+
+		TEST_UNIT(
+			"instrumentation counters and phase timers (casino, profile)",
+			HiddenMarkovModel::reset_statistics();
+			HiddenMarkovModel profile = profile_10_states_hmm;
+			profile.log_likelihood(profile_training_sequences_1[0]);
+			profile.decode(profile_training_sequences_1[0]);
+			HiddenMarkovModel casino = casino_hmm;
+			casino.set_training(LinearMemoryViterbiTraining(nullptr));
+			casino.train(casino_training_sequences_2, 0, 0, 2, 2);
+			instrumentation::Statistics statistics = HiddenMarkovModel::statistics();
+			ASSERT(statistics.to_json().find("\"forward_step\": {\"seconds\": ") != std::string::npos);
+			if(instrumentation::enabled()){
+				ASSERT(statistics.counters[instrumentation::kCells] >= 2 * profile_training_sequences_1[0].size());
+				ASSERT(statistics.counters[instrumentation::kSumLogProb] > 0);
+				ASSERT(statistics.counters[instrumentation::kTracebackNodesAllocated] > 0);
+				ASSERT(statistics.counters[instrumentation::kTracebackNodesFreed] == statistics.counters[instrumentation::kTracebackNodesAllocated]);
+				/* 2 queries, then each distinct training sequence counted at each of the 2 iterations. */
+				ASSERT(statistics.counters[instrumentation::kSequences] >= 2 + 2);
+				ASSERT(statistics.calls[instrumentation::kEStep] == 2);
+				ASSERT(statistics.calls[instrumentation::kMStep] == 2);
+				ASSERT(statistics.calls[instrumentation::kLikelihood] == 3);
+				ASSERT(statistics.calls[instrumentation::kViterbiStep] > 0);
+				ASSERT(statistics.seconds[instrumentation::kEStep] > 0);
+				HiddenMarkovModel::reset_statistics();
+				ASSERT(HiddenMarkovModel::statistics().counters[instrumentation::kCells] == 0);
+			}
+			else{
+				ASSERT(statistics.counters[instrumentation::kCells] == 0);
+				ASSERT(statistics.calls[instrumentation::kEStep] == 0);
+			}
+		)
+
+		TEST_UNIT(
+			"training timeline in chrome trace format (casino)",
+			std::shared_ptr<instrumentation::Tracer> tracer = std::make_shared<instrumentation::Tracer>();
+			HiddenMarkovModel casino = casino_hmm;
+			casino.set_training(LinearMemoryBaumWelchTraining(nullptr));
+			casino.set_tracer(tracer);
+			casino.train(casino_training_sequences_2, 0, 0, 2, 2);
+			std::vector<instrumentation::Tracer::Event> events = tracer->events();
+			std::vector<std::string> spans;
+			std::size_t counters = 0;
+			std::vector<instrumentation::Tracer::Event> sequence_spans;
+			std::size_t nested = 0;
+			for(const instrumentation::Tracer::Event& event : events){
+				ASSERT(event.thread == 0);
+				if(event.type == 'C') { ++counters; continue; }
+				spans.push_back(event.name);
+				/* The spans are recorded when they end, the sequences before the E-step which contains them. */
+				if(event.name == "sequence") { sequence_spans.push_back(event); }
+				if(event.name == "E-step"){
+					for(const instrumentation::Tracer::Event& sequence : sequence_spans){
+						if(sequence.timestamp >= event.timestamp && sequence.timestamp + sequence.duration <= event.timestamp + event.duration) ++nested;
+					}
+					sequence_spans.clear();
+				}
+			}
+			std::size_t sequence_count = (std::size_t) std::count(spans.begin(), spans.end(), "sequence");
+			ASSERT(nested == sequence_count);
+			ASSERT(std::count(spans.begin(), spans.end(), "training") == 1);
+			ASSERT(std::count(spans.begin(), spans.end(), "iteration") == 2);
+			ASSERT(std::count(spans.begin(), spans.end(), "E-step") == 2);
+			ASSERT(std::count(spans.begin(), spans.end(), "M-step") == 2);
+			ASSERT(std::count(spans.begin(), spans.end(), "convergence check") == 3);
+			ASSERT(sequence_count > 0 && sequence_count % 2 == 0);
+			ASSERT(counters == 3);
+			std::string json = tracer->to_json();
+			ASSERT(json.find("{\"traceEvents\": [") == 0);
+			ASSERT(json.find("\"ph\": \"X\"") != std::string::npos);
+			ASSERT(json.find("\"name\": \"thread_name\"") != std::string::npos);
+			ASSERT(json.find("\"delta\": ") != std::string::npos);
+			/* The arguments are written exactly, the times to the nanosecond. */
+			std::ostringstream likelihood;
+			for(const instrumentation::Tracer::Event& event : events){
+				if(event.type != 'C') continue;
+				likelihood << "\"log_likelihood\": " << std::setprecision(17) << event.arguments[0].second << "}";
+				break;
+			}
+			ASSERT(json.find(likelihood.str()) != std::string::npos);
+			std::ostringstream last_timestamp;
+			last_timestamp << "\"ts\": " << std::fixed << std::setprecision(3) << events.back().timestamp << ",";
+			ASSERT(json.find(last_timestamp.str()) != std::string::npos);
+			/* Clones share the tracer, and a null tracer stops the recording. */
+			HiddenMarkovModel copy = casino;
+			copy.train(casino_training_sequences_2, 0, 0, 1, 1);
+			ASSERT(tracer->size() > events.size());
+			std::size_t size = tracer->size();
+			casino.set_tracer(nullptr);
+			casino.train(casino_training_sequences_2, 0, 0, 1, 1);
+			ASSERT(tracer->size() == size);
+			tracer->clear();
+			ASSERT(tracer->size() == 0);
+		)
+
+		TEST_UNIT(
+			"training callbacks, checkpoint and early stop (casino)",
+			HiddenMarkovModel casino = casino_hmm;
+			casino.set_training(LinearMemoryBaumWelchTraining(nullptr));
+			std::vector<TrainingProgress> progress;
+			RawModel checkpoint;
+			casino.set_training_callback([&](const TrainingProgress& current){
+				progress.push_back(current);
+				checkpoint = *current.model;
+				return current.iteration < 3;
+			});
+			double improvement = casino.train(casino_training_sequences_2, 0, 0, 5, 10);
+			ASSERT(progress.size() == 3);
+			double deltas = 0;
+			for(std::size_t i = 0; i < progress.size(); ++i){
+				ASSERT(progress[i].iteration == i + 1);
+				ASSERT(i == 0 || progress[i].elapsed_seconds >= progress[i - 1].elapsed_seconds);
+				ASSERT(i == 0 || std::abs(progress[i].delta - (progress[i].log_likelihood - progress[i - 1].log_likelihood)) < 1e-9);
+				deltas += progress[i].delta;
+			}
+			ASSERT(std::abs(improvement - deltas) < 1e-9);
+			ASSERT(std::abs(casino.log_likelihood(casino_training_sequences_2) - progress.back().log_likelihood) < 1e-6);
+			/* The checkpoint of the last iteration is the trained model. */
+			ASSERT(checkpoint.A == casino.raw_transitions());
+			ASSERT(checkpoint.pi_begin == casino.raw_pi_begin());
+			/* Same for the Viterbi training, and no callback once cleared. */
+			HiddenMarkovModel viterbi = casino_hmm;
+			viterbi.set_training_callback([&](const TrainingProgress&){ progress.clear(); return false; });
+			viterbi.train(casino_training_sequences_2, 0, 0, 5, 10);
+			ASSERT(progress.empty());
+			progress.resize(1);
+			viterbi.set_training_callback(TrainingCallback());
+			viterbi.train(casino_training_sequences_2, 0, 0, 2, 2);
+			ASSERT(progress.size() == 1);
+		)
+
+		TEST_UNIT(
+			"cpu dispatch of the emission kernels",
+			ASSERT(cpu_dispatch::supported(cpu_dispatch::kGeneric));
+			ASSERT(cpu_dispatch::supported(cpu_dispatch::detected_instruction_set()));
+			ASSERT(cpu_dispatch::instruction_set_name(cpu_dispatch::kAVX2) == "avx2");
+			cpu_dispatch::InstructionSet initial = cpu_dispatch::instruction_set();
+			NormalDistribution normal(1.5, 0.7);
+			GaussianMixtureDistribution diagonal(3, std::vector<double>({0.3, 0.7}), std::vector<double>({0, 1, -1, 2, 0.5, 0}), 
+				std::vector<double>({1, 2, 0.5, 1.5, 1, 3}));
+			GaussianMixtureDistribution full(3, std::vector<double>({0.6, 0.4}), std::vector<double>({0, 1, -1, 2, 0.5, 0}), 
+				std::vector<double>({2, 0.5, 0.1, 0.5, 1, 0.2, 0.1, 0.2, 1.5, 1, 0, 0, 0, 1, 0, 0, 0, 1}), true);
+			std::vector<double> frames(3 * 1000);
+			for(std::size_t i = 0; i < frames.size(); ++i) frames[i] = 3 * sin((double) i * 0.37);
+			std::vector<double> normal_generic(frames.size());
+			std::vector<double> diagonal_generic(1000);
+			std::vector<double> full_generic(1000);
+			cpu_dispatch::set_instruction_set(cpu_dispatch::kGeneric);
+			ASSERT(cpu_dispatch::instruction_set() == cpu_dispatch::kGeneric);
+			normal.log_pdf(frames.data(), frames.size(), normal_generic.data());
+			diagonal.log_pdf(frames.data(), 1000, diagonal_generic.data());
+			full.log_pdf(frames.data(), 1000, full_generic.data());
+			ASSERT(std::abs(normal_generic[7] - normal.log_pdf(frames[7])) < 1e-12);
+			/* Each supported instruction set gives the same results, the others cannot be selected. */
+			for(int i = 0; i < cpu_dispatch::kNumInstructionSets; ++i){
+				cpu_dispatch::InstructionSet instruction_set = cpu_dispatch::InstructionSet(i);
+				if(! cpu_dispatch::supported(instruction_set)){
+					ASSERT_EXCEPT(cpu_dispatch::set_instruction_set(instruction_set), std::invalid_argument);
+					continue;
+				}
+				cpu_dispatch::set_instruction_set(instruction_set);
+				std::vector<double> normal_out(frames.size());
+				std::vector<double> diagonal_out(1000);
+				std::vector<double> full_out(1000);
+				normal.log_pdf(frames.data(), frames.size(), normal_out.data());
+				diagonal.log_pdf(frames.data(), 1000, diagonal_out.data());
+				full.log_pdf(frames.data(), 1000, full_out.data());
+				ASSERT(normal_out == normal_generic);
+				ASSERT(diagonal_out == diagonal_generic);
+				ASSERT(full_out == full_generic);
+			}
+			cpu_dispatch::reset_instruction_set();
+			ASSERT(cpu_dispatch::instruction_set() == cpu_dispatch::detected_instruction_set());
+			cpu_dispatch::set_instruction_set(initial);
+		)
+
+		TEST_UNIT(
+			"sufficient statistics of sharded training (casino)",
+			std::vector<std::vector<std::string>> first_shard(casino_training_sequences_2.begin(), casino_training_sequences_2.begin() + 4);
+			std::vector<std::vector<std::string>> second_shard(casino_training_sequences_2.begin() + 4, casino_training_sequences_2.end());
+			std::vector<std::string> query({"H", "T", "T", "H", "H"});
+			auto same_transitions = [](const Matrix& a, const Matrix& b){
+				for(std::size_t i = 0; i < a.size(); ++i){
+					for(std::size_t j = 0; j < a[i].size(); ++j){
+						if(! (a[i][j] == b[i][j] || std::abs(a[i][j] - b[i][j]) < 1e-9)) return false;
+					}
+				}
+				return a.size() == b.size();
+			};
+			/* Viterbi counts, then log counts of the Baum-Welch training. */
+			for(int algorithm = 0; algorithm < 2; ++algorithm){
+				HiddenMarkovModel trained = casino_hmm;
+				if(algorithm == 1) trained.set_training(LinearMemoryBaumWelchTraining(nullptr));
+				HiddenMarkovModel sharded = trained;
+				SufficientStatistics statistics = sharded.expected_statistics(first_shard);
+				/* A worker sends its statistics to the reducer as text. */
+				SufficientStatistics received = SufficientStatistics::from_string(sharded.expected_statistics(second_shard).to_string());
+				ASSERT(received.log_counts == (algorithm == 1));
+				ASSERT(received.total_weight == 5);
+				statistics.merge(received);
+				ASSERT(statistics.total_weight == 9);
+				ASSERT(std::abs(statistics.log_likelihood - trained.log_likelihood(casino_training_sequences_2)) < 1e-9);
+				sharded.maximize(statistics, 0);
+				trained.train(casino_training_sequences_2, 0, 0, 1, 1);
+				ASSERT(same_transitions(sharded.raw_transitions(), trained.raw_transitions()));
+				ASSERT(std::abs(sharded.log_likelihood(query) - trained.log_likelihood(query)) < 1e-9);
+			}
+			/* Lossless round trip, infinite log counts included. */
+			HiddenMarkovModel baum_welch = casino_hmm;
+			baum_welch.set_training(LinearMemoryBaumWelchTraining(nullptr));
+			SufficientStatistics log_statistics = baum_welch.expected_statistics(casino_training_sequences_2);
+			log_statistics.emission_counts[0] = utils::kNegInf;
+			SufficientStatistics loaded = SufficientStatistics::from_string(log_statistics.to_string());
+			ASSERT(loaded.emission_counts == log_statistics.emission_counts);
+			ASSERT(loaded.transition_counts == log_statistics.transition_counts);
+			ASSERT(loaded.log_likelihood == log_statistics.log_likelihood);
+			/* Statistics of another kind of training or of another model are refused. */
+			HiddenMarkovModel viterbi = casino_hmm;
+			SufficientStatistics counts = viterbi.expected_statistics(casino_training_sequences_2);
+			ASSERT_EXCEPT(counts.merge(log_statistics), std::invalid_argument);
+			ASSERT_EXCEPT(viterbi.maximize(log_statistics), std::invalid_argument);
+			SufficientStatistics truncated = counts;
+			truncated.transition_counts.pop_back();
+			ASSERT_EXCEPT(viterbi.maximize(truncated), std::invalid_argument);
+			ASSERT_EXCEPT(SufficientStatistics::from_string("sufficient_statistics\nlog_counts 0\ntotal_weight x"), std::invalid_argument);
+		)
+
+		TEST_UNIT(
+			"resumable training checkpoints (casino, profile)",
+			const std::string filename = "hmm_test_checkpoint.bin";
+			std::remove(filename.c_str());
+			std::vector<HiddenMarkovModel> models({casino_hmm, profile_10_states_hmm});
+			std::vector<std::vector<std::vector<std::string>>> corpora({casino_training_sequences_2, profile_training_sequences_1});
+			/* Viterbi, then Baum-Welch training, without and with silent states. */
+			for(std::size_t m = 0; m < models.size(); ++m){
+				const std::vector<std::vector<std::string>>& sequences = corpora[m];
+				for(int algorithm = 0; algorithm < 2; ++algorithm){
+					HiddenMarkovModel initial = models[m];
+					if(algorithm == 1) initial.set_training(LinearMemoryBaumWelchTraining(nullptr));
+					HiddenMarkovModel uninterrupted = initial;
+					HiddenMarkovModel interrupted = initial;
+					HiddenMarkovModel resumed = initial;
+					double improvement = uninterrupted.train(sequences, 0, 0, 6, 6);
+					/* Killed after the third iteration, then started again from the initial model. */
+					interrupted.set_checkpoint(filename, 2);
+					interrupted.set_training_callback([](const TrainingProgress& progress){ return progress.iteration < 3; });
+					interrupted.train(sequences, 0, 0, 6, 6);
+					ASSERT(TrainingCheckpoint::load(filename).iteration == 3);
+					/* The checkpoint of other initial parameters or of other sequences is refused. */
+					std::vector<std::vector<std::string>> other_sequences(sequences.begin(), sequences.begin() + 2);
+					HiddenMarkovModel trained = initial;
+					trained.train(other_sequences, 0, 0, 1, 1);
+					trained.set_checkpoint(filename, 2);
+					ASSERT_EXCEPT(trained.train(sequences, 0, 0, 6, 6), std::invalid_argument);
+					HiddenMarkovModel other = initial;
+					other.set_checkpoint(filename);
+					ASSERT_EXCEPT(other.train(other_sequences), std::invalid_argument);
+					resumed.set_checkpoint(filename, 2);
+					double resumed_improvement = resumed.train(sequences, 0, 0, 6, 6);
+					ASSERT(resumed_improvement == improvement);
+					ASSERT(resumed.raw_transitions() == uninterrupted.raw_transitions());
+					ASSERT(resumed.raw_pi_begin() == uninterrupted.raw_pi_begin());
+					ASSERT(resumed.raw_pi_end() == uninterrupted.raw_pi_end());
+					ASSERT(resumed.log_likelihood(sequences) == uninterrupted.log_likelihood(sequences));
+					/* Removed once the training completed : a further training starts from the trained model. */
+					ASSERT(! std::ifstream(filename).is_open());
+					HiddenMarkovModel further = uninterrupted;
+					ASSERT(resumed.train(sequences, 0, 0, 6, 6) == further.train(sequences, 0, 0, 6, 6));
+					ASSERT(resumed.raw_transitions() == further.raw_transitions());
+					ASSERT(! std::ifstream(filename).is_open());
+					/* The model stopped by the callback resumes from its own checkpoint as well. */
+					HiddenMarkovModel stopped = initial;
+					stopped.set_checkpoint(filename, 2);
+					stopped.set_training_callback([](const TrainingProgress& progress){ return progress.iteration < 3; });
+					stopped.train(sequences, 0, 0, 6, 6);
+					stopped.set_training_callback(TrainingCallback());
+					ASSERT(stopped.train(sequences, 0, 0, 6, 6) == improvement);
+					ASSERT(stopped.raw_transitions() == uninterrupted.raw_transitions());
+					std::remove(filename.c_str());
+				}
+			}
+			std::ofstream malformed(filename);
+			malformed << "not a checkpoint";
+			malformed.close();
+			ASSERT_EXCEPT(TrainingCheckpoint::load(filename), std::invalid_argument);
+			std::remove(filename.c_str());
+		)
+
 		/* Test factory */
 
+		TEST_UNIT(
+			"from matrices with silent states (profile)",
+			std::vector<std::string> names = profile_10_states_hmm.states_names();
+			std::vector<std::vector<double>> A = profile_10_states_hmm.raw_transitions();
+			exp_all(A);
+			std::vector<double> pi_begin = profile_10_states_hmm.raw_pi_begin();
+			exp_all(pi_begin);
+			std::vector<double> pi_end = profile_10_states_hmm.raw_pi_end();
+			exp_all(pi_end);
+			std::vector<DiscreteDistribution> emissions;
+			std::vector<bool> silent_mask;
+			for(auto dist_p : profile_10_states_hmm.raw_pdfs()){
+				silent_mask.push_back(dist_p == nullptr);
+				emissions.push_back((dist_p == nullptr) ? DiscreteDistribution() : *((DiscreteDistribution*)dist_p));
+			}
+			exp_all(emissions);
+			HiddenMarkovModel hmm = HiddenMarkovModel::from_matrices(names, A, pi_begin, pi_end, emissions, silent_mask, "profile");
+			ASSERT(hmm.num_states() == profile_10_states_hmm.num_states());
+			ASSERT(hmm.num_transitions() == profile_10_states_hmm.num_transitions());
+			ASSERT(hmm.states_names() == names);
+			std::vector<std::vector<double>> built_A = hmm.raw_transitions();
+			exp_all(built_A);
+			round_all(built_A, 4);
+			round_all(A, 4);
+			ASSERT(built_A == A);
+			ASSERT(utils::round_double(hmm.log_likelihood(profile_training_sequences_1), 4) ==
+				utils::round_double(profile_10_states_hmm.log_likelihood(profile_training_sequences_1), 4));
+			bool thrown = false;
+			try { HiddenMarkovModel::from_matrices(names, A, pi_begin, std::vector<double>(), emissions, silent_mask); }
+			catch(const ModelDimensionException& e) { thrown = true; }
+			ASSERT(thrown);
+			thrown = false;
+			A[0][0] = -1;
+			try { HiddenMarkovModel::from_matrices(names, A, pi_begin, pi_end, emissions, silent_mask); }
+			catch(const TransitionLogicException& e) { thrown = true; }
+			ASSERT(thrown);
+		)
+
 		/* Test fix / free parameters */
 
 		/* Test update from raw model */
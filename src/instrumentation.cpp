@@ -0,0 +1,210 @@
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include "instrumentation.hpp"
+#include "constants.hpp"
+
+namespace instrumentation {
+#ifdef HMM_INSTRUMENTATION
+	Statistics __statistics = Statistics();
+#endif
+
+	std::string counter_name(Counter counter){
+		switch(counter){
+			case kCells: return "cells";
+			case kSumLogProb: return "sum_log_prob";
+			case kTracebackNodesAllocated: return "traceback_nodes_allocated";
+			case kTracebackNodesFreed: return "traceback_nodes_freed";
+			case kSequences: return "sequences";
+			default: return "";
+		}
+	}
+
+	std::string phase_name(Phase phase){
+		switch(phase){
+			case kForwardInit: return "forward_init";
+			case kForwardStep: return "forward_step";
+			case kForwardTerminate: return "forward_terminate";
+			case kBackwardInit: return "backward_init";
+			case kBackwardStep: return "backward_step";
+			case kBackwardTerminate: return "backward_terminate";
+			case kViterbiInit: return "viterbi_init";
+			case kViterbiStep: return "viterbi_step";
+			case kViterbiTerminate: return "viterbi_terminate";
+			case kEStep: return "e_step";
+			case kMStep: return "m_step";
+			case kLikelihood: return "likelihood";
+			default: return "";
+		}
+	}
+
+	bool enabled(){
+#ifdef HMM_INSTRUMENTATION
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	Statistics statistics(){
+#ifdef HMM_INSTRUMENTATION
+		return __statistics;
+#else
+		return Statistics();
+#endif
+	}
+
+	void reset(){
+#ifdef HMM_INSTRUMENTATION
+		__statistics = Statistics();
+#endif
+	}
+
+	std::string Statistics::to_json() const {
+		std::ostringstream out;
+		out << "{\"counters\": {";
+		for(std::size_t c = 0; c < kNumCounters; ++c){
+			out << ((c > 0) ? ", " : "") << "\"" << counter_name(Counter(c)) << "\": " << counters[c];
+		}
+		out << "}, \"phases\": {";
+		for(std::size_t p = 0; p < kNumPhases; ++p){
+			out << ((p > 0) ? ", " : "") << "\"" << phase_name(Phase(p)) << "\": {\"seconds\": " << seconds[p] 
+				<< ", \"calls\": " << calls[p] << "}";
+		}
+		out << "}}";
+		return out.str();
+	}
+
+	/* ===================== TRACER ===================== */
+
+	/* Exact (round-trip) values. JSON has no infinity nor NaN (e.g. the log likelihood of an impossible sequence), 
+	written as strings. */
+	static void __write_number(std::ostream& out, double value){
+		std::ostringstream oss;
+		oss << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+		if(std::isfinite(value)) out << oss.str();
+		else out << "\"" << oss.str() << "\"";
+	}
+
+	/* Microseconds, to the nanosecond. */
+	static void __write_time(std::ostream& out, double value){
+		std::ostringstream oss;
+		oss << std::fixed << std::setprecision(3) << value;
+		out << oss.str();
+	}
+
+	static void __write_string(std::ostream& out, const std::string& value){
+		out << "\"";
+		for(char c : value){
+			if(c == '"' || c == '\\') out << '\\';
+			out << c;
+		}
+		out << "\"";
+	}
+
+	Tracer::Span::Span(Tracer* tracer, const char* name) : _tracer(tracer), _name(name), _start(), _arguments() {
+		if(_tracer != nullptr) _start = std::chrono::steady_clock::now();
+	}
+
+	void Tracer::Span::argument(const std::string& name, double value){
+		if(_tracer != nullptr) _arguments.push_back(std::make_pair(name, value));
+	}
+
+	void Tracer::Span::end(){
+		if(_tracer == nullptr) return;
+		_tracer->span(_name, _start, std::chrono::steady_clock::now(), _arguments);
+		_tracer = nullptr;
+	}
+
+	Tracer::Span::~Span() { end(); }
+
+	Tracer::Tracer() : _origin(std::chrono::steady_clock::now()), _events(), _threads(), _mutex() {}
+
+	double Tracer::_microseconds(std::chrono::steady_clock::time_point time) const {
+		return std::chrono::duration<double, std::micro>(time - _origin).count();
+	}
+
+	/* Must be called with the mutex locked. */
+	std::size_t Tracer::_thread(){
+		std::map<std::thread::id, std::size_t>::const_iterator it = _threads.find(std::this_thread::get_id());
+		if(it != _threads.end()) return it->second;
+		std::size_t thread = _threads.size();
+		_threads[std::this_thread::get_id()] = thread;
+		return thread;
+	}
+
+	void Tracer::span(const std::string& name, std::chrono::steady_clock::time_point start, 
+		std::chrono::steady_clock::time_point end, const Arguments& arguments){
+		std::lock_guard<std::mutex> lock(_mutex);
+		_events.push_back(Event{name, 'X', _microseconds(start), _microseconds(end) - _microseconds(start), _thread(), arguments});
+	}
+
+	void Tracer::counter(const std::string& name, double value){
+		double now = _microseconds(std::chrono::steady_clock::now());
+		std::lock_guard<std::mutex> lock(_mutex);
+		_events.push_back(Event{name, 'C', now, 0.0, _thread(), Arguments({std::make_pair(name, value)})});
+	}
+
+	std::vector<Tracer::Event> Tracer::events() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _events;
+	}
+
+	std::size_t Tracer::size() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _events.size();
+	}
+
+	void Tracer::clear(){
+		std::lock_guard<std::mutex> lock(_mutex);
+		_events.clear();
+	}
+
+	std::string Tracer::to_json() const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		std::ostringstream out;
+		out << "{\"traceEvents\": [";
+		bool first = true;
+		/* Names the threads, in the order of their numbers. */
+		std::vector<std::size_t> threads;
+		for(const std::pair<const std::thread::id, std::size_t>& thread : _threads) threads.push_back(thread.second);
+		std::sort(threads.begin(), threads.end());
+		for(std::size_t thread : threads){
+			out << ((first) ? "" : ",") << "\n\t{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread 
+				<< ", \"args\": {\"name\": \"thread " << thread << "\"}}";
+			first = false;
+		}
+		for(const Event& event : _events){
+			out << ((first) ? "" : ",") << "\n\t{\"name\": ";
+			__write_string(out, event.name);
+			out << ", \"cat\": \"training\", \"ph\": \"" << event.type << "\", \"ts\": ";
+			__write_time(out, event.timestamp);
+			if(event.type == 'X'){
+				out << ", \"dur\": ";
+				__write_time(out, event.duration);
+			}
+			out << ", \"pid\": 1, \"tid\": " << event.thread << ", \"args\": {";
+			for(std::size_t a = 0; a < event.arguments.size(); ++a){
+				out << ((a > 0) ? ", " : "");
+				__write_string(out, event.arguments[a].first);
+				out << ": ";
+				__write_number(out, event.arguments[a].second);
+			}
+			out << "}}";
+			first = false;
+		}
+		out << "\n], \"displayTimeUnit\": \"ms\"}";
+		return out.str();
+	}
+
+	void Tracer::save(const std::string& filename) const {
+		std::ofstream file(filename);
+		if(! file.is_open()) throw std::runtime_error(error_message::format(error_message::kTraceWriteFailed, filename));
+		file << to_json() << std::endl;
+	}
+}
@@ -0,0 +1,153 @@
+#ifndef __INSTRUMENTATION_HPP
+#define __INSTRUMENTATION_HPP
+
+#include <string>
+#include <array>
+#include <vector>
+#include <map>
+#include <utility>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+/* Counters and phase timers of the algorithms. Only compiled in when the library is built with HMM_INSTRUMENTATION
+("make INSTRUMENT=1"), count and PhaseTimer being otherwise empty inline functions the compiler removes. The
+statistics are process wide and not synchronized. */
+namespace instrumentation {
+	enum Counter {
+		/* One per state and step of a recursion (forward, backward, Viterbi). */
+		kCells,
+		kSumLogProb,
+		kTracebackNodesAllocated,
+		kTracebackNodesFreed,
+		/* Sequences given to the algorithms through the hmm, and sequences counted by the trainings. */
+		kSequences,
+		kNumCounters
+	};
+
+	enum Phase {
+		kForwardInit,
+		kForwardStep,
+		kForwardTerminate,
+		kBackwardInit,
+		kBackwardStep,
+		kBackwardTerminate,
+		kViterbiInit,
+		kViterbiStep,
+		kViterbiTerminate,
+		/* Trainings : counting over the sequences, update of the model, and log likelihood for the convergence. */
+		kEStep,
+		kMStep,
+		kLikelihood,
+		kNumPhases
+	};
+
+	struct Statistics {
+		std::array<std::uint64_t, kNumCounters> counters;
+		/* Total time spent in each phase, and number of times it was entered. */
+		std::array<double, kNumPhases> seconds;
+		std::array<std::uint64_t, kNumPhases> calls;
+
+		std::string to_json() const;
+	};
+
+	std::string counter_name(Counter);
+	std::string phase_name(Phase);
+	/* True if built with HMM_INSTRUMENTATION. */
+	bool enabled();
+	Statistics statistics();
+	void reset();
+
+#ifdef HMM_INSTRUMENTATION
+	extern Statistics __statistics;
+
+	inline void count(Counter counter, std::uint64_t n = 1) { __statistics.counters[counter] += n; }
+
+	/* Charges the time from its construction to its phase, until next switches to another phase. */
+	class PhaseTimer {
+		Phase _phase;
+		std::chrono::steady_clock::time_point _start;
+	public:
+		PhaseTimer(Phase phase) : _phase(phase), _start(std::chrono::steady_clock::now()) {}
+		PhaseTimer(const PhaseTimer&) = delete;
+		PhaseTimer& operator=(const PhaseTimer&) = delete;
+		void next(Phase phase) {
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			__statistics.seconds[_phase] += std::chrono::duration<double>(now - _start).count();
+			++__statistics.calls[_phase];
+			_phase = phase;
+			_start = now;
+		}
+		~PhaseTimer() { next(_phase); }
+	};
+#else
+	inline void count(Counter, std::uint64_t = 1) {}
+
+	class PhaseTimer {
+	public:
+		PhaseTimer(Phase) {}
+		PhaseTimer(const PhaseTimer&) = delete;
+		PhaseTimer& operator=(const PhaseTimer&) = delete;
+		void next(Phase) {}
+	};
+#endif
+
+	/* Timeline of a training, exported as Chrome trace events (chrome://tracing, Perfetto) : spans for the training, 
+	its iterations, the E-step and each sequence it counts, the M-step and the convergence checks, and a counter for the 
+	log likelihood after each iteration. Unlike the counters above, the tracer is always compiled in and only records 
+	when one is attached to a training algorithm (TrainingAlgorithm::set_tracer). Recording is synchronized, and each 
+	event carries the thread which recorded it, numbered from 0 in order of first appearance. */
+	class Tracer {
+	public:
+		typedef std::vector<std::pair<std::string, double>> Arguments;
+		struct Event {
+			std::string name;
+			/* 'X' for a span, 'C' for a counter. */
+			char type;
+			/* In microseconds since the creation of the tracer. */
+			double timestamp;
+			double duration;
+			std::size_t thread;
+			Arguments arguments;
+		};
+
+		/* Records the span from its construction to end() or its destruction. Does nothing for a null tracer. */
+		class Span {
+			Tracer* _tracer;
+			const char* _name;
+			std::chrono::steady_clock::time_point _start;
+			Arguments _arguments;
+		public:
+			Span(Tracer*, const char*);
+			Span(const Span&) = delete;
+			Span& operator=(const Span&) = delete;
+			void argument(const std::string&, double);
+			void end();
+			~Span();
+		};
+
+	private:
+		std::chrono::steady_clock::time_point _origin;
+		std::vector<Event> _events;
+		std::map<std::thread::id, std::size_t> _threads;
+		mutable std::mutex _mutex;
+
+		double _microseconds(std::chrono::steady_clock::time_point) const;
+		std::size_t _thread();
+	public:
+		Tracer();
+		void span(const std::string&, std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point, 
+			const Arguments& = Arguments());
+		void counter(const std::string&, double);
+		std::vector<Event> events() const;
+		std::size_t size() const;
+		void clear();
+		/* Trace event format : {"traceEvents": [...], "displayTimeUnit": "ms"}. */
+		std::string to_json() const;
+		/* Throws if the file cannot be written. */
+		void save(const std::string&) const;
+	};
+}
+
+#endif
@@ -0,0 +1,71 @@
+#include <vector>
+#include <string>
+#include <memory> // std::shared_ptr
+#include <tuple> // std::tie
+#include "constants.hpp"
+#include "hmm_base.hpp"
+#include "scalar_model.hpp"
+
+template class ScalarModel<float>;
+template class ScalarModel<double>;
+
+/* ===================== SINGLE PRECISION ALGORITHMS ===================== */
+
+SinglePrecisionForwardAlgorithm::SinglePrecisionForwardAlgorithm(RawModel* model) :
+	ForwardAlgorithm(hmm_config::kSinglePrecisionForwardAlgorithmName, model), _scalar() {}
+SinglePrecisionForwardAlgorithm* SinglePrecisionForwardAlgorithm::clone() const { return new SinglePrecisionForwardAlgorithm(*this); }
+SinglePrecisionForwardAlgorithm::~SinglePrecisionForwardAlgorithm() {}
+
+void SinglePrecisionForwardAlgorithm::set_model(RawModel* model) {
+	HMMAlgorithm::set_model(model);
+	_scalar.reset();
+}
+
+const ScalarModel<float>& SinglePrecisionForwardAlgorithm::_scalar_model() {
+	if(! _scalar) _scalar = std::make_shared<const ScalarModel<float>>(*_model);
+	return *_scalar;
+}
+
+std::vector<double> SinglePrecisionForwardAlgorithm::forward(const std::vector<std::string>& sequence, std::size_t t_max) {
+	std::vector<float> alpha = _scalar_model().forward(sequence, t_max);
+	return std::vector<double>(alpha.begin(), alpha.end());
+}
+
+double SinglePrecisionForwardAlgorithm::log_likelihood(const std::vector<std::string>& sequence) {
+	return _scalar_model().log_likelihood(sequence);
+}
+
+double SinglePrecisionForwardAlgorithm::log_likelihood(const std::vector<std::vector<std::string>>& sequences) {
+	double likelihood = 0;
+	for(const std::vector<std::string>& sequence : sequences){
+		likelihood += log_likelihood(sequence);
+	}
+	return likelihood;
+}
+
+SinglePrecisionViterbiDecodingAlgorithm::SinglePrecisionViterbiDecodingAlgorithm(RawModel* model) :
+	DecodingAlgorithm(hmm_config::kSinglePrecisionViterbiDecodeAlgorithmName, model), _scalar() {}
+SinglePrecisionViterbiDecodingAlgorithm* SinglePrecisionViterbiDecodingAlgorithm::clone() const { return new SinglePrecisionViterbiDecodingAlgorithm(*this); }
+SinglePrecisionViterbiDecodingAlgorithm::~SinglePrecisionViterbiDecodingAlgorithm() {}
+
+void SinglePrecisionViterbiDecodingAlgorithm::set_model(RawModel* model) {
+	HMMAlgorithm::set_model(model);
+	_scalar.reset();
+}
+
+const ScalarModel<float>& SinglePrecisionViterbiDecodingAlgorithm::_scalar_model() {
+	if(! _scalar) _scalar = std::make_shared<const ScalarModel<float>>(*_model);
+	return *_scalar;
+}
+
+std::pair<std::vector<std::string>, double> SinglePrecisionViterbiDecodingAlgorithm::decode(const std::vector<std::string>& sequence, std::size_t t_max) {
+	std::vector<std::size_t> path_indices;
+	float max_phi_T;
+	std::tie(path_indices, max_phi_T) = _scalar_model().decode_indices(sequence, t_max);
+	std::vector<std::string> path;
+	path.reserve(path_indices.size());
+	for(std::size_t path_index : path_indices){
+		path.push_back(_model->states_names[path_index]);
+	}
+	return std::make_pair(path, max_phi_T);
+}
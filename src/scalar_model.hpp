@@ -0,0 +1,309 @@
+#ifndef __SCALAR_MODEL_HPP
+#define __SCALAR_MODEL_HPP
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <utility>	// std::pair
+#include <algorithm>	// std::min, std::max
+#include <limits>
+#include <cmath>
+#include <memory>	// std::shared_ptr
+#include <stdexcept>
+#include "constants.hpp"
+#include "distributions.hpp"
+#include "hmm_base.hpp"
+#include "hmm_algorithms.hpp"
+
+/* Forward and Viterbi on a brewed RawModel with the log probabilities and the recursions in the scalar type T.
+ScalarModel<float> halves the memory of the tables and of the recursion vectors, the log space keeping the
+values in range whatever the length of the sequence ; its results are within the float rounding of the double
+ones (see the "single precision" test). The recursions are the ones of the linear memory algorithms, in the same
+order, hence ScalarModel<double> gives the same results as them. Only discrete distributions. */
+template<typename T>
+class ScalarModel {
+private:
+	std::size_t _num_states;
+	std::size_t _silent_states_index;
+	/* Log probabilities, _A[i * _num_states + j] being the transition from i to j. */
+	std::vector<T> _A;
+	std::vector<T> _pi_begin;
+	std::vector<T> _pi_end;
+	bool _is_finite;
+	std::vector<RawModel::Envelope> _predecessors;
+	/* Emissions of the emitting states by symbol, _B[k * _silent_states_index + i] being the emission of the
+	k-th symbol by state i. The last row holds the emissions of the symbols out of the alphabet. */
+	std::vector<T> _B;
+	std::unordered_map<std::string, std::size_t> _symbols;
+
+	static T _neg_inf();
+	static T _sum_log_prob(T log_x, T log_y);
+	const T* _emissions(const std::string& symbol) const;
+	/* Fills the values of the silent states from the ones of the emitting states at the same step. */
+	void _forward_silent(std::vector<T>& alpha_t) const;
+
+public:
+	explicit ScalarModel(const RawModel& model);
+	std::size_t num_states() const;
+	/* Same parameters and results as the ForwardAlgorithm and LinearMemoryViterbiDecodingAlgorithm methods. */
+	std::vector<T> forward(const std::vector<std::string>& sequence, std::size_t t_max) const;
+	T log_likelihood(const std::vector<std::string>& sequence) const;
+	std::pair<std::vector<std::size_t>, T> decode_indices(const std::vector<std::string>& sequence, std::size_t t_max) const;
+};
+
+
+template<typename T>
+ScalarModel<T>::ScalarModel(const RawModel& model) :
+	_num_states(model.A.size()), _silent_states_index(model.silent_states_index), _A(), _pi_begin(), _pi_end(),
+	_is_finite(model.is_finite), _predecessors(), _B(), _symbols() {
+		for(const Distribution* distribution : model.B){
+			if(distribution != nullptr && ! distribution->is_discrete()){
+				throw std::invalid_argument(error_message::kScalarModelNotDiscrete);
+			}
+		}
+		_A.reserve(_num_states * _num_states);
+		for(std::size_t i = 0; i < _num_states; ++i){
+			for(std::size_t j = 0; j < _num_states; ++j){
+				_A.push_back(static_cast<T>(model.A[i][j]));
+			}
+			_pi_begin.push_back(static_cast<T>(model.pi_begin[i]));
+			_pi_end.push_back(static_cast<T>(model.pi_end[i]));
+			_predecessors.push_back(model.predecessors_of(i));
+		}
+		for(std::size_t k = 0; k <= model.alphabet.size(); ++k){
+			if(k < model.alphabet.size()) _symbols[model.alphabet[k]] = k;
+			for(std::size_t i = 0; i < _silent_states_index; ++i){
+				DiscreteDistribution* distribution = static_cast<DiscreteDistribution*>(model.B[i]);
+				_B.push_back((k < model.alphabet.size() && distribution->contains(model.alphabet[k])) ?
+					static_cast<T>((*distribution)[model.alphabet[k]]) : _neg_inf());
+			}
+		}
+	}
+
+template<typename T>
+std::size_t ScalarModel<T>::num_states() const { return _num_states; }
+
+template<typename T>
+T ScalarModel<T>::_neg_inf() { return -std::numeric_limits<T>::infinity(); }
+
+/* Same as utils::sum_log_prob, in T. */
+template<typename T>
+T ScalarModel<T>::_sum_log_prob(T log_x, T log_y) {
+	if(log_x == std::numeric_limits<T>::infinity() || log_y == std::numeric_limits<T>::infinity()) return std::numeric_limits<T>::infinity();
+	if(log_x == _neg_inf()) return log_y;
+	if(log_y == _neg_inf()) return log_x;
+	return (log_x > log_y) ? log_x + std::log(1 + std::exp(log_y - log_x)) : log_y + std::log(1 + std::exp(log_x - log_y));
+}
+
+template<typename T>
+const T* ScalarModel<T>::_emissions(const std::string& symbol) const {
+	typename std::unordered_map<std::string, std::size_t>::const_iterator it = _symbols.find(symbol);
+	std::size_t k = (it == _symbols.end()) ? _symbols.size() : it->second;
+	return _B.data() + k * _silent_states_index;
+}
+
+template<typename T>
+void ScalarModel<T>::_forward_silent(std::vector<T>& alpha_t) const {
+	for(std::size_t i = _silent_states_index; i < _num_states; ++i){
+		const RawModel::Envelope& from = _predecessors[i];
+		alpha_t[i] = _neg_inf();
+		for(std::size_t j = from.emitting_begin; j < from.emitting_end; ++j){
+			alpha_t[i] = _sum_log_prob(alpha_t[i], alpha_t[j] + _A[j * _num_states + i]);
+		}
+		for(std::size_t j = from.silent_begin; j < std::min(i, from.silent_end); ++j){
+			alpha_t[i] = _sum_log_prob(alpha_t[i], alpha_t[j] + _A[j * _num_states + i]);
+		}
+	}
+}
+
+template<typename T>
+std::vector<T> ScalarModel<T>::forward(const std::vector<std::string>& sequence, std::size_t t_max) const {
+	if(t_max == 0) t_max = sequence.size();
+	if(sequence.size() == 0) throw std::logic_error("forward on empty sequence");
+	/* Silent states before the first emission. */
+	std::vector<T> alpha_0(_num_states, _neg_inf());
+	for(std::size_t i = _silent_states_index; i < _num_states; ++i){
+		const RawModel::Envelope& from = _predecessors[i];
+		alpha_0[i] = _pi_begin[i];
+		for(std::size_t j = from.silent_begin; j < std::min(i, from.silent_end); ++j){
+			alpha_0[i] = _sum_log_prob(alpha_0[i], _A[j * _num_states + i] + alpha_0[j]);
+		}
+	}
+	std::vector<T> alpha(_num_states, _neg_inf());
+	const T* emissions = _emissions(sequence[0]);
+	for(std::size_t i = 0; i < _silent_states_index; ++i){
+		const RawModel::Envelope& from = _predecessors[i];
+		alpha[i] = _pi_begin[i];
+		for(std::size_t j = from.silent_begin; j < from.silent_end; ++j){
+			alpha[i] = _sum_log_prob(alpha[i], _A[j * _num_states + i] + alpha_0[j]);
+		}
+		alpha[i] = alpha[i] + emissions[i];
+	}
+	_forward_silent(alpha);
+	std::vector<T>& alpha_prev_t = alpha_0;
+	for(std::size_t t = 1; t < std::min(sequence.size(), t_max); ++t){
+		std::swap(alpha, alpha_prev_t);
+		emissions = _emissions(sequence[t]);
+		for(std::size_t i = 0; i < _silent_states_index; ++i){
+			const RawModel::Envelope& from = _predecessors[i];
+			alpha[i] = _neg_inf();
+			for(std::size_t j = from.emitting_begin; j < from.emitting_end; ++j){
+				alpha[i] = _sum_log_prob(alpha[i], alpha_prev_t[j] + _A[j * _num_states + i]);
+			}
+			for(std::size_t j = from.silent_begin; j < from.silent_end; ++j){
+				alpha[i] = _sum_log_prob(alpha[i], alpha_prev_t[j] + _A[j * _num_states + i]);
+			}
+			alpha[i] = alpha[i] + emissions[i];
+		}
+		_forward_silent(alpha);
+	}
+	return alpha;
+}
+
+template<typename T>
+T ScalarModel<T>::log_likelihood(const std::vector<std::string>& sequence) const {
+	std::vector<T> alpha_T = forward(sequence, sequence.size());
+	T log_prob = _neg_inf();
+	/* Non finite hmm end in non-silent states. */
+	std::size_t end_states = (_is_finite) ? _num_states : _silent_states_index;
+	for(std::size_t i = 0; i < end_states; ++i){
+		log_prob = _sum_log_prob(log_prob, (_is_finite) ? alpha_T[i] + _pi_end[i] : alpha_T[i]);
+	}
+	return log_prob;
+}
+
+template<typename T>
+std::pair<std::vector<std::size_t>, T> ScalarModel<T>::decode_indices(const std::vector<std::string>& sequence, std::size_t t_max) const {
+	if(t_max == 0) t_max = sequence.size();
+	if(sequence.size() == 0) throw std::logic_error("viterbi on empty sequence");
+	std::size_t length = std::min(sequence.size(), t_max);
+	std::size_t N = _num_states;
+	/* Best predecessor of each state after t emissions (column t, from 0 to length). The predecessor of an
+	emitting state is in the previous column, the one of a silent state in the same column, N being the begin state. */
+	std::vector<std::size_t> psi((length + 1) * N, N);
+	std::vector<T> phi_prev_t(N, _neg_inf());
+	for(std::size_t i = _silent_states_index; i < N; ++i){
+		const RawModel::Envelope& from = _predecessors[i];
+		T max_phi = _pi_begin[i];
+		for(std::size_t j = from.silent_begin; j < std::min(i, from.silent_end); ++j){
+			T current_phi = _A[j * N + i] + phi_prev_t[j];
+			if(current_phi > max_phi){
+				max_phi = current_phi;
+				psi[i] = j;
+			}
+		}
+		phi_prev_t[i] = max_phi;
+	}
+	std::vector<T> phi(N, _neg_inf());
+	for(std::size_t t = 0; t < length; ++t){
+		const T* emissions = _emissions(sequence[t]);
+		std::size_t* psi_t = psi.data() + (t + 1) * N;
+		for(std::size_t i = 0; i < _silent_states_index; ++i){
+			const RawModel::Envelope& from = _predecessors[i];
+			T max_phi = (t == 0) ? _pi_begin[i] : _neg_inf();
+			std::size_t max_psi = N;
+			if(t > 0){
+				for(std::size_t j = from.emitting_begin; j < from.emitting_end; ++j){
+					T current_phi = phi_prev_t[j] + _A[j * N + i];
+					if(current_phi > max_phi){
+						max_phi = current_phi;
+						max_psi = j;
+					}
+				}
+			}
+			for(std::size_t j = from.silent_begin; j < from.silent_end; ++j){
+				T current_phi = phi_prev_t[j] + _A[j * N + i];
+				if(current_phi > max_phi){
+					max_phi = current_phi;
+					max_psi = j;
+				}
+			}
+			/* After the first emission, a state is only reached through a predecessor. */
+			phi[i] = (max_phi != _neg_inf() && (t == 0 || max_psi != N)) ? max_phi + emissions[i] : _neg_inf();
+			psi_t[i] = max_psi;
+		}
+		for(std::size_t i = _silent_states_index; i < N; ++i){
+			const RawModel::Envelope& from = _predecessors[i];
+			T max_phi = _neg_inf();
+			std::size_t max_psi = N;
+			for(std::size_t j = from.emitting_begin; j < from.emitting_end; ++j){
+				T current_phi = _A[j * N + i] + phi[j];
+				if(current_phi > max_phi){
+					max_phi = current_phi;
+					max_psi = j;
+				}
+			}
+			for(std::size_t j = from.silent_begin; j < std::min(i, from.silent_end); ++j){
+				T current_phi = _A[j * N + i] + phi[j];
+				if(current_phi > max_phi){
+					max_phi = current_phi;
+					max_psi = j;
+				}
+			}
+			phi[i] = (max_phi != _neg_inf() && max_psi != N) ? max_phi : _neg_inf();
+			psi_t[i] = max_psi;
+		}
+		std::swap(phi, phi_prev_t);
+	}
+	/* phi_prev_t holds the values after the last emission. */
+	T max_phi_T = _neg_inf();
+	std::size_t max_state_index = N;
+	std::size_t end_states = (_is_finite) ? N : _silent_states_index;
+	for(std::size_t i = 0; i < end_states; ++i){
+		T phi_T = (_is_finite) ? phi_prev_t[i] + _pi_end[i] : phi_prev_t[i];
+		if(phi_T > max_phi_T){
+			max_phi_T = phi_T;
+			max_state_index = i;
+		}
+	}
+	if(max_state_index == N){
+		/* Sequence is impossible. */
+		return std::make_pair(std::vector<std::size_t>(), _neg_inf());
+	}
+	std::vector<std::size_t> path;
+	std::size_t column = length;
+	for(std::size_t i = max_state_index; i != N;){
+		path.push_back(i);
+		std::size_t previous = psi[column * N + i];
+		if(i < _silent_states_index) --column;
+		i = previous;
+	}
+	std::reverse(path.begin(), path.end());
+	return std::make_pair(path, max_phi_T);
+}
+
+
+/* ===================== SINGLE PRECISION ALGORITHMS ===================== */
+
+/* Build a ScalarModel<float> on first use, and again after each set_model (called by the hmm after each brew). */
+
+class SinglePrecisionForwardAlgorithm : public ForwardAlgorithm {
+private:
+	std::shared_ptr<const ScalarModel<float>> _scalar;
+	const ScalarModel<float>& _scalar_model();
+public:
+	SinglePrecisionForwardAlgorithm(RawModel*);
+	SinglePrecisionForwardAlgorithm* clone() const;
+	void set_model(RawModel*);
+	using ForwardAlgorithm::forward;
+	using ForwardAlgorithm::log_likelihood;
+	std::vector<double> forward(const std::vector<std::string>&, std::size_t);
+	double log_likelihood(const std::vector<std::string>&);
+	double log_likelihood(const std::vector<std::vector<std::string>>&);
+	~SinglePrecisionForwardAlgorithm();
+};
+
+class SinglePrecisionViterbiDecodingAlgorithm : public DecodingAlgorithm {
+private:
+	std::shared_ptr<const ScalarModel<float>> _scalar;
+	const ScalarModel<float>& _scalar_model();
+public:
+	SinglePrecisionViterbiDecodingAlgorithm(RawModel*);
+	SinglePrecisionViterbiDecodingAlgorithm* clone() const;
+	void set_model(RawModel*);
+	using DecodingAlgorithm::decode;
+	std::pair<std::vector<std::string>, double> decode(const std::vector<std::string>&, std::size_t);
+	~SinglePrecisionViterbiDecodingAlgorithm();
+};
+
+#endif
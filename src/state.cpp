@@ -15,6 +15,8 @@ StateDistributionException::StateDistributionException(const std::string& t) :
 
 /* <----------------------------> */
 
+std::atomic<std::size_t> State::_renames(0);
+
 State::State(const std::string& name) : _name(name), _distribution(nullptr), 
 	_free_emission(hmm_config::kDefaultFreeEmission), 
 	_free_transition(hmm_config::kDefaultFreeTransition) {}
@@ -42,6 +44,7 @@ _free_emission(other._free_emission), _free_transition(other._free_transition) {
 
 State& State::operator=(const State& other){
 	if(this != &other){
+		if(_name != other._name) { ++_renames; }
 		_name = other._name;
 		_free_emission = other._free_emission;
 		_free_transition = other._free_transition;
@@ -55,6 +58,7 @@ State& State::operator=(const State& other){
 
 State& State::operator=(State&& other){
 	if(this != &other){
+		if(_name != other._name) { ++_renames; }
 		_name = std::move(other._name);
 		_free_emission = other._free_emission;
 		_free_transition = other._free_transition;
@@ -105,7 +109,12 @@ void State::set_distribution(const Distribution& dist){
 }
 
 std::string State::name() const { return _name; }
-void State::set_name(const std::string& name) { _name = name; }   
+void State::set_name(const std::string& name) { 
+	if(_name != name) { ++_renames; }
+	_name = name; 
+}
+
+std::size_t State::renames() { return _renames; }
 
 bool State::is_silent() const { 
 	return _distribution == nullptr || _distribution->empty();
@@ -3,6 +3,8 @@
 
 #include <vector>
 #include <exception>
+#include <atomic>
+#include <functional> // std::hash
 #include "constants.hpp"
 #include "distributions.hpp"
 
@@ -30,6 +32,8 @@ private:
 	bool _free_emission;
 	/* Free transition */
 	bool _free_transition;
+	/* Number of renames, see renames(). */
+	static std::atomic<std::size_t> _renames;
 
 public:
 	State(const std::string&);
@@ -53,9 +57,22 @@ public:
 	std::string name() const;
 	void set_name(const std::string&);
 	bool is_silent() const;
+	/* Number of times a state changed its name (set_name or assignment) in the process. States are indexed on their 
+	name (e.g. by Graph), which has to be rebuilt when this number changed. */
+	static std::size_t renames();
 	virtual ~State();
 };
 
 std::ostream& operator<<(std::ostream& out, const State& state);
 
+/* States are identified by their name (see operator==), so they are hashed on it. */
+namespace std {
+	template<>
+	struct hash<State> {
+		std::size_t operator()(const State& state) const {
+			return std::hash<std::string>()(state.name());
+		}
+	};
+}
+
 #endif
\ No newline at end of file
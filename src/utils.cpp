@@ -6,7 +6,21 @@
 #include <typeinfo>
 #include <type_traits>
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#ifdef HMM_COUNT_ALLOCATIONS
+#include <atomic>
+#endif
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h> // getrusage
+#endif
 #include "utils.hpp"
+#include "instrumentation.hpp"
 
 
 namespace utils {
@@ -18,6 +32,7 @@ namespace utils {
 	}
 
 	double sum_log_prob(double log_x, double log_y){
+		instrumentation::count(instrumentation::kSumLogProb);
 		// prob(x) == inf, prob(y) == inf
 		if(log_x == kInf || log_y == kInf) return kInf;
 		// prob(x) == 0
@@ -43,14 +58,164 @@ namespace utils {
 		return std::make_pair(s.substr(0, split_i), s.substr(split_i + 1, std::string::npos));
 	}
 
-	void mem_info(){
+#if defined(__linux__)
+	/* Value in bytes of a "Field:   value kB" line of /proc/self/status. */
+	static std::size_t __proc_status_bytes(const std::string& field){
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while(std::getline(status, line)){
+			if(line.compare(0, field.size() + 1, field + ":") == 0){
+				return (std::size_t) std::strtoull(line.c_str() + field.size() + 1, nullptr, 10) * 1024;
+			}
+		}
+		return 0;
+	}
+#endif
+
+	std::size_t current_memory(){
+#if defined(__linux__)
+		return __proc_status_bytes("VmRSS");
+#elif defined(__APPLE__)
 		struct task_basic_info t_info;
 		mach_msg_type_number_t t_info_count = TASK_BASIC_INFO_COUNT;
+		if(KERN_SUCCESS != task_info(mach_task_self(), TASK_BASIC_INFO, (task_info_t)&t_info, &t_info_count)) { return 0; }
+		return (std::size_t) t_info.resident_size;
+#else
+		return 0;
+#endif
+	}
+
+	std::size_t peak_memory(){
+#if defined(__linux__)
+		return __proc_status_bytes("VmHWM");
+#elif defined(__unix__) || defined(__APPLE__)
+		struct rusage usage;
+		if(getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+#if defined(__APPLE__)
+		return (std::size_t) usage.ru_maxrss;
+#else
+		return (std::size_t) usage.ru_maxrss * 1024;
+#endif
+#else
+		return 0;
+#endif
+	}
+
+	bool reset_peak_memory(){
+#if defined(__linux__)
+		std::ofstream clear_refs("/proc/self/clear_refs");
+		if(! clear_refs) { return false; }
+		clear_refs << "5";
+		clear_refs.close();
+		return ! clear_refs.fail();
+#else
+		return false;
+#endif
+	}
+
+	void mem_info(){
+		std::cout << current_memory() << std::endl; 
+	}
+
+#ifdef HMM_COUNT_ALLOCATIONS
+	static std::atomic<std::size_t> __allocations(0);
+	static std::atomic<std::size_t> __allocated(0);
+	static std::atomic<std::size_t> __live(0);
+	static std::atomic<std::size_t> __peak_live(0);
+
+	/* Each block starts with its size, on a header keeping the alignment of the returned pointer. */
+	static const std::size_t kAllocationHeader = alignof(std::max_align_t);
+
+	static void* __counted_new(std::size_t size){
+		void* block = std::malloc(size + kAllocationHeader);
+		if(block == nullptr) { return nullptr; }
+		*static_cast<std::size_t*>(block) = size;
+		++__allocations;
+		__allocated += size;
+		std::size_t live = (__live += size);
+		std::size_t peak_live = __peak_live.load();
+		while(live > peak_live && ! __peak_live.compare_exchange_weak(peak_live, live)) {}
+		return static_cast<char*>(block) + kAllocationHeader;
+	}
+
+	static void __counted_delete(void* pointer){
+		if(pointer == nullptr) { return; }
+		void* block = static_cast<char*>(pointer) - kAllocationHeader;
+		__live -= *static_cast<std::size_t*>(block);
+		std::free(block);
+	}
+
+	bool allocations_counted() { return true; }
+	AllocationCounters allocation_counters() { return AllocationCounters{__allocations, __allocated, __live, __peak_live}; }
+	void reset_peak_live() { __peak_live = __live.load(); }
+#else
+	bool allocations_counted() { return false; }
+	AllocationCounters allocation_counters() { return AllocationCounters{0, 0, 0, 0}; }
+	void reset_peak_live() {}
+#endif
 
-		if (KERN_SUCCESS != task_info(mach_task_self(),
-			TASK_BASIC_INFO, (task_info_t)&t_info, &t_info_count)) {
-    			return;
+	MemoryProfile::MemoryProfile() : _phases(), _start_counters(), _running(false) {}
+
+	void MemoryProfile::start(const std::string& name){
+		if(_running) { stop(); }
+		reset_peak_memory();
+		reset_peak_live();
+		_start_counters = allocation_counters();
+		std::size_t memory = current_memory();
+		_phases.push_back(Phase{name, memory, memory, memory, 0, 0, 0});
+		_running = true;
+	}
+
+	void MemoryProfile::stop(){
+		if(! _running) { return; }
+		AllocationCounters counters = allocation_counters();
+		Phase& phase = _phases.back();
+		phase.end_memory = current_memory();
+		phase.peak_memory = std::max(peak_memory(), phase.end_memory);
+		phase.allocations = counters.allocations - _start_counters.allocations;
+		phase.allocated = counters.allocated - _start_counters.allocated;
+		phase.peak_live = (counters.peak_live > _start_counters.live) ? counters.peak_live - _start_counters.live : 0;
+		_running = false;
+	}
+
+	const std::vector<MemoryProfile::Phase>& MemoryProfile::phases() const { return _phases; }
+
+	std::string MemoryProfile::to_json() const {
+		std::ostringstream out;
+		out << "[";
+		for(std::size_t p = 0; p < _phases.size(); ++p){
+			const Phase& phase = _phases[p];
+			out << ((p > 0) ? ", " : "") << "{\"phase\": \"" << phase.name << "\", \"start_memory\": " << phase.start_memory 
+				<< ", \"end_memory\": " << phase.end_memory << ", \"peak_memory\": " << phase.peak_memory 
+				<< ", \"allocations\": " << phase.allocations << ", \"allocated\": " << phase.allocated 
+				<< ", \"peak_live\": " << phase.peak_live << "}";
 		}
-		std::cout << t_info.resident_size << std::endl; 
+		out << "]";
+		return out.str();
 	}
+
+	std::string MemoryProfile::to_csv() const {
+		std::ostringstream out;
+		out << "phase,start_memory,end_memory,peak_memory,allocations,allocated,peak_live" << std::endl;
+		for(const Phase& phase : _phases){
+			out << phase.name << "," << phase.start_memory << "," << phase.end_memory << "," << phase.peak_memory << "," 
+				<< phase.allocations << "," << phase.allocated << "," << phase.peak_live << std::endl;
+		}
+		return out.str();
+	}
+}
+
+#ifdef HMM_COUNT_ALLOCATIONS
+void* operator new(std::size_t size){
+	void* pointer = utils::__counted_new(size);
+	if(pointer == nullptr) { throw std::bad_alloc(); }
+	return pointer;
 }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return utils::__counted_new(size); }
+void* operator new[](std::size_t size){ return operator new(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return utils::__counted_new(size); }
+void operator delete(void* pointer) noexcept { utils::__counted_delete(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { utils::__counted_delete(pointer); }
+void operator delete[](void* pointer) noexcept { utils::__counted_delete(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { utils::__counted_delete(pointer); }
+#endif
@@ -8,7 +8,7 @@
 #include <limits>
 #include <typeinfo>
 #include <type_traits>
-#include <mach/mach.h>
+#include <vector>
 #include "constants.hpp"
 
 namespace utils {
@@ -23,7 +23,58 @@ namespace utils {
 
 	std::pair<std::string, std::string> split_first(const std::string& s, char c);
 
+	/* Memory of the process, in bytes : resident set size and its peak, from /proc/self/status on Linux, task_info 
+	and getrusage on macOS (0 when not available). reset_peak_memory lets peak_memory give the peak from now on, which 
+	is only supported on Linux (returns false otherwise). */
+	std::size_t current_memory();
+	std::size_t peak_memory();
+	bool reset_peak_memory();
+	/* Prints the current resident set size. */
 	void mem_info();
+
+	/* Heap allocations through operator new, counted by a replacement of the global operator new and delete when the
+	library is built with HMM_COUNT_ALLOCATIONS ("make COUNT_ALLOCATIONS=1"), else all null. */
+	struct AllocationCounters {
+		std::size_t allocations;
+		std::size_t allocated;
+		/* Bytes allocated and not yet freed, and their peak since the last reset_peak_live. */
+		std::size_t live;
+		std::size_t peak_live;
+	};
+	bool allocations_counted();
+	AllocationCounters allocation_counters();
+	void reset_peak_live();
+
+	/* Memory used by successive phases (e.g. the steps of an algorithm), each one delimited by start and stop. */
+	class MemoryProfile {
+	public:
+		struct Phase {
+			std::string name;
+			/* Resident set size at the start and at the end of the phase, and its peak during the phase (since the 
+			start of the process if the peak cannot be reset). */
+			std::size_t start_memory;
+			std::size_t end_memory;
+			std::size_t peak_memory;
+			/* Allocations during the phase, and the peak of the bytes allocated by the phase and not yet freed. */
+			std::size_t allocations;
+			std::size_t allocated;
+			std::size_t peak_live;
+		};
+	private:
+		std::vector<Phase> _phases;
+		AllocationCounters _start_counters;
+		bool _running;
+	public:
+		MemoryProfile();
+		/* Stops the running phase, if any, and starts a new one. */
+		void start(const std::string& name);
+		void stop();
+		const std::vector<Phase>& phases() const;
+		/* One object per phase. */
+		std::string to_json() const;
+		/* Header line, then one line per phase. */
+		std::string to_csv() const;
+	};
 }
 
 #endif
\ No newline at end of file